@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "bitmap.h"
+
+enum { kArrayContainer, kBitsetContainer, kRunContainer };
+static const int kBitsetWords = 65536 / 64;
+static const int kInitialUnits = 4;
+
+static void Reserve(bitmapcontainer *c, int units)
+{
+  if (units <= c->allocated) return;
+  c->allocated = c->allocated == 0 ? kInitialUnits : c->allocated;
+  while (c->allocated < units) c->allocated *= 2;
+  c->values = realloc(c->values, c->allocated * sizeof(unsigned short));
+  assert(c->values != NULL);
+}
+
+// Calls fn on every low 16 bits the container holds, in increasing order
+typedef void (*ContainerMapFunction)(unsigned short low, void *auxData);
+static void ContainerMap(const bitmapcontainer *c, ContainerMapFunction fn, void *auxData)
+{
+  if (c->type == kArrayContainer) {
+    for (int i = 0; i < c->length; i++) fn(c->values[i], auxData);
+  } else if (c->type == kRunContainer) {
+    for (int r = 0; r < c->length; r += 2)
+      for (int low = c->values[r]; low <= c->values[r] + c->values[r + 1]; low++) fn(low, auxData);
+  } else {
+    for (int w = 0; w < kBitsetWords; w++)
+      for (unsigned long long word = c->bits[w]; word != 0; word &= word - 1)
+	fn(64 * w + __builtin_ctzll(word), auxData);
+  }
+}
+
+static void SetBit(unsigned short low, void *auxData)
+{
+  unsigned long long *bits = auxData;
+  bits[low / 64] |= 1ULL << (low % 64);
+}
+
+static void AppendValue(unsigned short low, void *auxData)
+{
+  bitmapcontainer *c = auxData;
+  c->values[c->length++] = low;
+}
+
+// Appends low to the runs being built in c, which must come in increasing order
+static void AppendToRuns(unsigned short low, void *auxData)
+{
+  bitmapcontainer *c = auxData;
+  if (c->length > 0 && c->values[c->length - 2] + c->values[c->length - 1] + 1 == low) c->values[c->length - 1]++;
+  else {
+    Reserve(c, c->length + 2);
+    c->values[c->length++] = low;
+    c->values[c->length++] = 0;
+  }
+}
+
+static void CountRun(unsigned short low, void *auxData)
+{
+  int *state = auxData;  // the number of runs, and the last value seen, or -2 before the first
+  if (low != state[1] + 1) state[0]++;
+  state[1] = low;
+}
+
+static void ToBitset(bitmapcontainer *c)
+{
+  if (c->type == kBitsetContainer) return;
+  unsigned long long *bits = calloc(kBitsetWords, sizeof(unsigned long long));
+  assert(bits != NULL);
+  ContainerMap(c, SetBit, bits);
+  free(c->values);
+  c->values = NULL;
+  c->length = c->allocated = 0;
+  c->bits = bits;
+  c->type = kBitsetContainer;
+}
+
+// Rebuilds the container in the given form, from whichever form it's in
+static void Convert(bitmapcontainer *c, int type)
+{
+  if (c->type == type) return;
+  if (type == kBitsetContainer) {
+    ToBitset(c);
+    return;
+  }
+  bitmapcontainer converted = { c->key, type, c->cardinality, 0, 0, NULL, NULL };
+  if (type == kArrayContainer) {
+    Reserve(&converted, c->cardinality);
+    ContainerMap(c, AppendValue, &converted);
+  } else ContainerMap(c, AppendToRuns, &converted);
+  free(c->values);
+  free(c->bits);
+  *c = converted;
+}
+
+static bool ContainerContains(const bitmapcontainer *c, unsigned short low)
+{
+  if (c->type == kBitsetContainer) return (c->bits[low / 64] >> (low % 64)) & 1;
+  int step = c->type == kRunContainer ? 2 : 1;
+  int lowIndex = 0, highIndex = c->length / step;  // the first array value, or run start, past low
+  while (lowIndex < highIndex) {
+    int mid = (lowIndex + highIndex) / 2;
+    if (c->values[mid * step] <= low) lowIndex = mid + 1;
+    else highIndex = mid;
+  }
+  if (lowIndex == 0) return false;
+  int at = (lowIndex - 1) * step;
+  return c->type == kArrayContainer ? c->values[at] == low : low <= c->values[at] + c->values[at + 1];
+}
+
+static void ContainerAdd(bitmapcontainer *c, unsigned short low)
+{
+  if (c->type == kRunContainer) {
+    int last = c->length - 2;
+    if (c->values[last] + c->values[last + 1] + 1 == low) {  // extends the last run, as appends do
+      c->values[last + 1]++;
+      c->cardinality++;
+      return;
+    }
+    if (ContainerContains(c, low)) return;
+    Convert(c, c->cardinality < kBitmapArrayMax ? kArrayContainer : kBitsetContainer);
+  }
+  if (c->type == kArrayContainer) {
+    int at = c->length;
+    if (at > 0 && c->values[at - 1] >= low) {
+      int lowIndex = 0, highIndex = c->length;
+      while (lowIndex < highIndex) {
+	int mid = (lowIndex + highIndex) / 2;
+	if (c->values[mid] < low) lowIndex = mid + 1;
+	else highIndex = mid;
+      }
+      if (c->values[lowIndex] == low) return;
+      at = lowIndex;
+    }
+    if (c->cardinality < kBitmapArrayMax) {
+      Reserve(c, c->length + 1);
+      memmove(c->values + at + 1, c->values + at, (c->length - at) * sizeof(unsigned short));
+      c->values[at] = low;
+      c->length++;
+      c->cardinality++;
+      return;
+    }
+    ToBitset(c);
+  }
+  if (!ContainerContains(c, low)) {
+    SetBit(low, c->bits);
+    c->cardinality++;
+  }
+}
+
+// Returns the container for the key, or NULL if there isn't one
+static bitmapcontainer *Find(const bitmap *b, unsigned short key)
+{
+  int low = 0, high = b->numContainers;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (b->containers[mid].key < key) low = mid + 1;
+    else high = mid;
+  }
+  return low < b->numContainers && b->containers[low].key == key ? &b->containers[low] : NULL;
+}
+
+// Returns the container for the key, adding an empty array container if there isn't one
+static bitmapcontainer *FindOrInsert(bitmap *b, unsigned short key)
+{
+  int at = b->numContainers;
+  if (at > 0 && b->containers[at - 1].key >= key) {
+    bitmapcontainer *c = Find(b, key);
+    if (c != NULL) return c;
+    for (at = 0; b->containers[at].key < key; at++);
+  }
+  if (b->numContainers == b->allocated) {
+    b->allocated = b->allocated == 0 ? 1 : 2 * b->allocated;
+    b->containers = realloc(b->containers, b->allocated * sizeof(bitmapcontainer));
+    assert(b->containers != NULL);
+  }
+  memmove(b->containers + at + 1, b->containers + at, (b->numContainers - at) * sizeof(bitmapcontainer));
+  b->numContainers++;
+  bitmapcontainer empty = { key, kArrayContainer, 0, 0, 0, NULL, NULL };
+  b->containers[at] = empty;
+  return &b->containers[at];
+}
+
+void BitmapNew(bitmap *b)
+{
+  b->containers = NULL;
+  b->numContainers = b->allocated = 0;
+}
+
+void BitmapDispose(bitmap *b)
+{
+  for (int i = 0; i < b->numContainers; i++) {
+    free(b->containers[i].values);
+    free(b->containers[i].bits);
+  }
+  free(b->containers);
+}
+
+void BitmapAdd(bitmap *b, unsigned int id)
+{
+  ContainerAdd(FindOrInsert(b, id >> 16), id & 0xFFFF);
+}
+
+bool BitmapContains(const bitmap *b, unsigned int id)
+{
+  const bitmapcontainer *c = Find(b, id >> 16);
+  return c != NULL && ContainerContains(c, id & 0xFFFF);
+}
+
+int BitmapCardinality(const bitmap *b)
+{
+  int cardinality = 0;
+  for (int i = 0; i < b->numContainers; i++) cardinality += b->containers[i].cardinality;
+  return cardinality;
+}
+
+long BitmapBytes(const bitmap *b)
+{
+  long bytes = b->allocated * sizeof(bitmapcontainer);
+  for (int i = 0; i < b->numContainers; i++) {
+    bytes += b->containers[i].allocated * sizeof(unsigned short);
+    if (b->containers[i].bits != NULL) bytes += kBitsetWords * sizeof(unsigned long long);
+  }
+  return bytes;
+}
+
+static void AddValue(unsigned short low, void *auxData)
+{
+  ContainerAdd(auxData, low);
+}
+
+void BitmapOr(bitmap *dst, const bitmap *src)
+{
+  for (int i = 0; i < src->numContainers; i++) {
+    const bitmapcontainer *from = &src->containers[i];
+    bitmapcontainer *to = FindOrInsert(dst, from->key);
+    if (from->type != kBitsetContainer && to->cardinality + from->cardinality <= kBitmapArrayMax) {
+      ContainerMap(from, AddValue, to);
+      continue;
+    }
+    ToBitset(to);
+    if (from->type == kBitsetContainer)
+      for (int w = 0; w < kBitsetWords; w++) to->bits[w] |= from->bits[w];
+    else ContainerMap(from, SetBit, to->bits);
+    to->cardinality = 0;
+    for (int w = 0; w < kBitsetWords; w++) to->cardinality += __builtin_popcountll(to->bits[w]);
+  }
+}
+
+struct lookups {
+  const bitmapcontainer *in;
+  int found;
+};
+
+static void LookUp(unsigned short low, void *auxData)
+{
+  struct lookups *l = auxData;
+  l->found += ContainerContains(l->in, low);
+}
+
+int BitmapAndCardinality(const bitmap *a, const bitmap *b)
+{
+  int count = 0;
+  for (int i = 0, j = 0; i < a->numContainers && j < b->numContainers; ) {
+    const bitmapcontainer *x = &a->containers[i], *y = &b->containers[j];
+    if (x->key < y->key) i++;
+    else if (x->key > y->key) j++;
+    else {
+      if (x->type == kBitsetContainer && y->type == kBitsetContainer) {
+	for (int w = 0; w < kBitsetWords; w++) count += __builtin_popcountll(x->bits[w] & y->bits[w]);
+      } else {
+	const bitmapcontainer *smaller = x->cardinality <= y->cardinality ? x : y;
+	struct lookups l = { smaller == x ? y : x, 0 };
+	ContainerMap(smaller, LookUp, &l);
+	count += l.found;
+      }
+      i++;
+      j++;
+    }
+  }
+  return count;
+}
+
+void BitmapRunOptimize(bitmap *b)
+{
+  for (int i = 0; i < b->numContainers; i++) {
+    bitmapcontainer *c = &b->containers[i];
+    int runs[2] = { 0, -2 };
+    ContainerMap(c, CountRun, runs);
+    long arrayBytes = c->cardinality <= kBitmapArrayMax ? 2L * c->cardinality : 1L << 30;
+    long bitsetBytes = kBitsetWords * sizeof(unsigned long long), runBytes = 4L * runs[0];
+    if (runBytes < arrayBytes && runBytes < bitsetBytes) Convert(c, kRunContainer);
+    else if (arrayBytes <= bitsetBytes) Convert(c, kArrayContainer);
+    else Convert(c, kBitsetContainer);
+    if (c->values != NULL && c->allocated > c->length) {
+      c->allocated = c->length > 0 ? c->length : 1;
+      c->values = realloc(c->values, c->allocated * sizeof(unsigned short));
+    }
+  }
+}
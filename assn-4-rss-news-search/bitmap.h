@@ -0,0 +1,125 @@
+/**
+ * File: bitmap.h
+ * --------------
+ * Defines the bitmap, a compressed set of article ids laid out as a
+ * Roaring bitmap.  Ids are divided by their high 16 bits into chunks of
+ * 65536, and each chunk holding any ids is a container of its own, kept
+ * in whichever of three forms suits it:
+ *
+ *   - an array of the ids' low 16 bits, sorted, while there are no more
+ *     than kBitmapArrayMax of them,
+ *   - a bitset of 65536 bits once there are more, or
+ *   - a list of runs, as (start, length - 1) pairs, where the ids come in
+ *     long unbroken stretches, as the articles of a single feed, crawled
+ *     one after another, do.
+ *
+ * Containers begin as arrays and turn into bitsets as they fill;
+ * BitmapRunOptimize then converts every container to runs or back,
+ * whichever takes the fewest bytes.  Ids added in increasing order, as a
+ * crawl assigns them, extend a container without moving any of it.
+ */
+
+#ifndef __bitmap_
+#define __bitmap_
+
+#include "bool.h"
+
+/**
+ * Constant: kBitmapArrayMax
+ * -------------------------
+ * The most ids an array container holds; at 4096 of them, 8 KB, it's the
+ * size of a bitset.
+ */
+
+#define kBitmapArrayMax 4096
+
+/**
+ * Type: bitmap
+ * ------------
+ * The concrete representation of the bitmap.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  unsigned short key;        // the high 16 bits of every id in the container
+  unsigned char type;        // which of the three forms it's in
+  int cardinality;           // ids held
+  int length, allocated;     // units used and allocated in values: ids, or runs as two units each
+  unsigned short *values;    // the array's low bits, or the runs' (start, length - 1) pairs
+  unsigned long long *bits;  // the bitset's 65536 bits
+} bitmapcontainer;
+
+typedef struct {
+  bitmapcontainer *containers;  // in increasing key order
+  int numContainers, allocated;
+} bitmap;
+
+/**
+ * Function: BitmapNew
+ * -------------------
+ * Initializes the bitmap to the empty set.
+ */
+
+void BitmapNew(bitmap *b);
+
+/**
+ * Function: BitmapDispose
+ * -----------------------
+ * Frees the bitmap.
+ */
+
+void BitmapDispose(bitmap *b);
+
+/**
+ * Function: BitmapAdd
+ * -------------------
+ * Adds id to the bitmap, if it isn't there already.
+ */
+
+void BitmapAdd(bitmap *b, unsigned int id);
+
+/**
+ * Function: BitmapContains
+ * ------------------------
+ * Returns true if id is in the bitmap.
+ */
+
+bool BitmapContains(const bitmap *b, unsigned int id);
+
+/**
+ * Functions: BitmapCardinality, BitmapBytes
+ * -----------------------------------------
+ * Return the number of ids in the bitmap, and the bytes it occupies.
+ */
+
+int BitmapCardinality(const bitmap *b);
+long BitmapBytes(const bitmap *b);
+
+/**
+ * Function: BitmapOr
+ * ------------------
+ * Adds every id of src to dst.
+ */
+
+void BitmapOr(bitmap *dst, const bitmap *src);
+
+/**
+ * Function: BitmapAndCardinality
+ * ------------------------------
+ * Returns the number of ids in both a and b, without building their
+ * intersection: only the containers the two share a key for are visited,
+ * two bitsets are intersected a word at a time, and otherwise the ids of
+ * the smaller container are looked up in the larger.
+ */
+
+int BitmapAndCardinality(const bitmap *a, const bitmap *b);
+
+/**
+ * Function: BitmapRunOptimize
+ * ---------------------------
+ * Converts each container to whichever of its three forms is smallest.
+ */
+
+void BitmapRunOptimize(bitmap *b);
+
+#endif
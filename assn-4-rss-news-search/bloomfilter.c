@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "bloomfilter.h"
+
+static const int kMaxHashes = 16;
+
+void BloomFilterNew(bloomfilter *b, int capacity, int bitsPerElem)
+{
+  assert(capacity >= 0 && bitsPerElem > 0);
+  long bitsWanted = (long) (capacity > 0 ? capacity : 1) * bitsPerElem;
+  b->numBlocks = (bitsWanted + kBloomBlockBits - 1) / kBloomBlockBits;
+  void *blocks;
+  int err = posix_memalign(&blocks, sizeof(bloomblock), b->numBlocks * sizeof(bloomblock));
+  assert(err == 0);
+  b->blocks = blocks;
+  memset(b->blocks, 0, b->numBlocks * sizeof(bloomblock));
+
+  // bits per element times ln 2 minimizes the false-positive rate of a classic filter;
+  // uneven filling of the blocks shifts the blocked filter's optimum a little lower
+  double bitsPerElemActual = (double) b->numBlocks * kBloomBlockBits / (capacity > 0 ? capacity : 1);
+  b->numHashes = (int) (bitsPerElemActual * 0.6);
+  if (b->numHashes < 1) b->numHashes = 1;
+  if (b->numHashes > kMaxHashes) b->numHashes = kMaxHashes;
+  b->capacity = capacity;
+  b->numElems = 0;
+}
+
+void BloomFilterDispose(bloomfilter *b)
+{
+  free(b->blocks);
+}
+
+// The block is chosen by the top 32 bits of the hash code, scaled to the number of blocks
+// with a multiply rather than a division, and the bits within it by double hashing on the
+// low 32 bits, which are independent of the bits that chose the block
+static inline const bloomblock *BlockFor(const bloomfilter *b, unsigned long long hashcode)
+{
+  return &b->blocks[((hashcode >> 32) * (unsigned long long) b->numBlocks) >> 32];
+}
+
+static inline unsigned BitFor(unsigned long long hashcode, int i)
+{
+  unsigned h1 = hashcode & 0xFFFF, h2 = (hashcode >> 16) & 0xFFFF;
+  return (h1 + i * (h2 | 1)) % kBloomBlockBits;
+}
+
+void BloomFilterAdd(bloomfilter *b, unsigned long long hashcode)
+{
+  bloomblock *block = (bloomblock *) BlockFor(b, hashcode);
+  for (int i = 0; i < b->numHashes; i++) {
+    unsigned bit = BitFor(hashcode, i);
+    block->bits[bit / 64] |= 1ULL << (bit % 64);
+  }
+  b->numElems++;
+}
+
+bool BloomFilterMayContain(const bloomfilter *b, unsigned long long hashcode)
+{
+  const bloomblock *block = BlockFor(b, hashcode);
+  for (int i = 0; i < b->numHashes; i++) {
+    unsigned bit = BitFor(hashcode, i);
+    if ((block->bits[bit / 64] & (1ULL << (bit % 64))) == 0) return false;
+  }
+  return true;
+}
+
+long BloomFilterBytes(const bloomfilter *b)
+{
+  return (long) b->numBlocks * sizeof(bloomblock);
+}
+
+double BloomFilterFalsePositiveRate(const bloomfilter *b)
+{
+  double sum = 0;
+  for (int i = 0; i < b->numBlocks; i++) {
+    int set = 0;
+    for (int w = 0; w < kBloomBlockBits / 64; w++) set += __builtin_popcountll(b->blocks[i].bits[w]);
+    sum += pow((double) set / kBloomBlockBits, b->numHashes);
+  }
+  return sum / b->numBlocks;
+}
@@ -0,0 +1,119 @@
+/**
+ * File: bloomfilter.h
+ * -------------------
+ * Defines the interface for a blocked Bloom filter, a compact summary
+ * of a set that can answer "definitely not a member" without looking at
+ * the set itself.  It never misses a member, but now and then reports a
+ * non-member as possibly present (a false positive), at a rate that
+ * depends on how many bits it has per element.
+ *
+ * The bits are split into 64-byte blocks, one cache line each.  An element
+ * sets and tests all of its bits within the single block its hash selects,
+ * so a test touches exactly one cache line however many bits it checks.
+ * That costs a little accuracy against a classic Bloom filter of the same
+ * size (blocks fill unevenly), in exchange for never taking more than one
+ * cache miss.
+ *
+ * The filter works on 64-bit hash codes rather than on elements, so the
+ * client decides what equality means (case-insensitive words, say) by how
+ * it hashes.  Codes should be well mixed in all 64 bits.
+ */
+
+#ifndef __bloomfilter_
+#define __bloomfilter_
+
+#include "bool.h"
+
+/**
+ * Constant: kBloomBlockBits
+ * -------------------------
+ * The number of bits in a block: one 64-byte cache line.
+ */
+
+#define kBloomBlockBits 512
+
+/**
+ * Type: bloomblock
+ * ----------------
+ * One block of the filter.  Blocks are allocated on 64-byte boundaries.
+ */
+
+typedef struct {
+  unsigned long long bits[kBloomBlockBits / 64];
+} bloomblock;
+
+/**
+ * Type: bloomfilter
+ * -----------------
+ * The concrete representation of the filter.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  bloomblock *blocks;
+  int numBlocks;
+  int numHashes;    // bits set per element
+  int capacity;     // elements the filter was sized for
+  int numElems;     // elements added so far
+} bloomfilter;
+
+/**
+ * Function: BloomFilterNew
+ * ------------------------
+ * Initializes the filter to be empty, with room for capacity elements at
+ * roughly bitsPerElem bits each (rounded up to a whole number of blocks).
+ * Filled to capacity, eight bits per element gives a false-positive rate
+ * of a few percent, and sixteen a fraction of a percent.  Elements can
+ * still be added past capacity, but the false-positive rate climbs as
+ * they are.
+ */
+
+void BloomFilterNew(bloomfilter *b, int capacity, int bitsPerElem);
+
+/**
+ * Function: BloomFilterDispose
+ * ----------------------------
+ * Frees the filter's blocks.
+ */
+
+void BloomFilterDispose(bloomfilter *b);
+
+/**
+ * Function: BloomFilterAdd
+ * ------------------------
+ * Adds the element with the specified hash code to the filter.
+ */
+
+void BloomFilterAdd(bloomfilter *b, unsigned long long hashcode);
+
+/**
+ * Function: BloomFilterMayContain
+ * -------------------------------
+ * Returns false if no element with the specified hash code was ever added,
+ * and true if one may have been.  The filter isn't modified, so any number
+ * of threads may test it at once.
+ */
+
+bool BloomFilterMayContain(const bloomfilter *b, unsigned long long hashcode);
+
+/**
+ * Function: BloomFilterBytes
+ * --------------------------
+ * Returns the number of bytes the filter's blocks occupy.
+ */
+
+long BloomFilterBytes(const bloomfilter *b);
+
+/**
+ * Function: BloomFilterFalsePositiveRate
+ * --------------------------------------
+ * Returns the false-positive rate the filter should show for hash codes
+ * spread uniformly over it, computed from how full each block actually is:
+ * a non-member lands in a block whose fraction f of bits are set, and passes
+ * with probability f raised to the number of hashes.  The time taken is
+ * proportional to the size of the filter.
+ */
+
+double BloomFilterFalsePositiveRate(const bloomfilter *b);
+
+#endif
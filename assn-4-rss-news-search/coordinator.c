@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "coordinator.h"
+#include "newsindex.h"
+
+struct shardconnection {
+  FILE *in;
+  FILE *out;
+};
+
+struct connections {
+  int numShards;
+  struct shardconnection shards[];  // in and out are NULL until connected
+};
+
+static void CloseConnection(struct shardconnection *conn)
+{
+  if (conn->in != NULL) fclose(conn->in);
+  if (conn->out != NULL) fclose(conn->out);
+  conn->in = conn->out = NULL;
+}
+
+// Key destructor: closes the exiting thread's connections
+static void CloseConnections(void *aux)
+{
+  struct connections *conns = aux;
+  for (int i = 0; i < conns->numShards; i++) CloseConnection(&conns->shards[i]);
+  free(conns);
+}
+
+static bool Connect(struct shardconnection *conn, unsigned short port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    return false;
+  }
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  conn->in = fdopen(fd, "r");
+  conn->out = fdopen(dup(fd), "w");
+  if (conn->in == NULL || conn->out == NULL) {
+    if (conn->in == NULL) close(fd);
+    CloseConnection(conn);
+    return false;
+  }
+  return true;
+}
+
+// Returns the calling thread's connection to the shard, connecting first if need be, or NULL
+static struct shardconnection *ConnectionTo(coordinator *c, int shard)
+{
+  struct connections *conns = pthread_getspecific(c->connections);
+  if (conns == NULL) {
+    conns = malloc(sizeof(struct connections) + c->numShards * sizeof(struct shardconnection));
+    assert(conns != NULL);
+    conns->numShards = c->numShards;
+    for (int i = 0; i < c->numShards; i++) conns->shards[i].in = conns->shards[i].out = NULL;
+    pthread_setspecific(c->connections, conns);
+  }
+  struct shardconnection *conn = &conns->shards[shard];
+  if (conn->in == NULL && !Connect(conn, c->ports[shard])) return NULL;
+  return conn;
+}
+
+void CoordinatorNew(coordinator *c, const unsigned short ports[], int numShards)
+{
+  assert(numShards > 0);
+  c->numShards = numShards;
+  c->ports = malloc(numShards * sizeof(unsigned short));
+  assert(c->ports != NULL);
+  memcpy(c->ports, ports, numShards * sizeof(unsigned short));
+  pthread_key_create(&c->connections, CloseConnections);
+}
+
+void CoordinatorDispose(coordinator *c)
+{
+  struct connections *conns = pthread_getspecific(c->connections);
+  if (conns != NULL) CloseConnections(conns);
+  pthread_key_delete(c->connections);
+  free(c->ports);
+}
+
+// Reads a decimal number and the one character after it, returning false if there's no number
+static bool ReadNumber(FILE *in, int *value, int *after)
+{
+  int ch = getc_unlocked(in), n = 0;
+  if (ch < '0' || ch > '9') return false;
+  for (; ch >= '0' && ch <= '9'; ch = getc_unlocked(in)) n = 10 * n + ch - '0';
+  *value = n;
+  *after = ch;
+  return true;
+}
+
+// Reads one reply, of n matches, into replies (grown as needed), returning n or -1
+static int ReadReply(FILE *in, match **reply, int *allocated)
+{
+  int n, after;
+  if (!ReadNumber(in, &n, &after) || after != '\n') return -1;
+  if (n > *allocated) {
+    *allocated = n;
+    *reply = realloc(*reply, n * sizeof(match));
+    assert(*reply != NULL);
+  }
+  for (int i = 0; i < n; i++) {
+    if (!ReadNumber(in, &(*reply)[i].docID, &after) || after != ' ' ||
+	!ReadNumber(in, &(*reply)[i].occurrences, &after) || after != (i == n - 1 ? '\n' : ' ')) return -1;
+  }
+  if (n == 0 && getc_unlocked(in) != '\n') return -1;
+  return n;
+}
+
+// Merges the n matches of reply into the numSums of sums, both in docID order, into merged
+static int AddMatches(const match sums[], int numSums, const match reply[], int n, match merged[])
+{
+  int i = 0, j = 0, k = 0;
+  while (i < numSums || j < n) {
+    if (j == n || (i < numSums && sums[i].docID < reply[j].docID)) merged[k++] = sums[i++];
+    else if (i == numSums || reply[j].docID < sums[i].docID) merged[k++] = reply[j++];
+    else {
+      merged[k] = sums[i++];
+      merged[k++].occurrences += reply[j++].occurrences;
+    }
+  }
+  return k;
+}
+
+// Closes every one of the calling thread's connections, after a failed request: a half-read
+// reply would be taken for the next request's, so the next one starts over with every shard
+static void ResetConnections(coordinator *c)
+{
+  struct connections *all = pthread_getspecific(c->connections);
+  if (all != NULL)
+    for (int i = 0; i < all->numShards; i++) CloseConnection(&all->shards[i]);
+}
+
+bool CoordinatorGather(coordinator *c, const char *terms[], int numTerms, vector *matches)
+{
+  struct shardconnection *conns[numTerms];
+  int numRequests = 0;
+  bool ok = true;
+  for (int t = 0; t < numTerms && ok; t++) {
+    struct shardconnection *conn = ConnectionTo(c, NewsIndexWordShard(terms[t], c->numShards));
+    ok = conn != NULL && fprintf(conn->out, "%c%s\n", kCoordinatorRequestPrefix, terms[t]) > 0;
+    conns[numRequests++] = conn;
+  }
+  for (int r = 0; r < numRequests && ok; r++) ok = fflush(conns[r]->out) != EOF;
+
+  match *sums = NULL, *reply = NULL, *merged = NULL;
+  int numSums = 0, allocated = 0;
+  for (int r = 0; r < numRequests && ok; r++) {
+    int n = ReadReply(conns[r]->in, &reply, &allocated);
+    if (n < 0) {
+      ok = false;
+      break;
+    }
+    merged = realloc(merged, (numSums + n + 1) * sizeof(match));
+    assert(merged != NULL);
+    numSums = AddMatches(sums, numSums, reply, n, merged);
+    match *swap = sums;
+    sums = merged;
+    merged = swap;
+  }
+  if (ok) {
+    for (int i = 0; i < numSums; i++) VectorAppend(matches, &sums[i]);
+  } else ResetConnections(c);
+  free(sums);
+  free(reply);
+  free(merged);
+  return ok;
+}
+
+struct expansion {
+  int articles;
+  char *word;
+};
+
+static void FreeExpansion(void *elemAddr)
+{
+  free(((struct expansion *) elemAddr)->word);
+}
+
+// Most articles first, ties going to the word that sorts first
+static int CompareExpansions(const void *elemAddr1, const void *elemAddr2)
+{
+  const struct expansion *a = elemAddr1, *b = elemAddr2;
+  if (a->articles != b->articles) return b->articles - a->articles;
+  return strcmp(a->word, b->word);
+}
+
+// Reads one shard's expansions of a prefix onto the end of expansions, returning false if
+// they're unreadable
+static bool ReadExpansions(FILE *in, vector *expansions)
+{
+  int n, after;
+  if (!ReadNumber(in, &n, &after) || after != '\n') return false;
+  for (int i = 0; i < n; i++) {
+    struct expansion e;
+    char word[1024];
+    int length = 0, ch;
+    if (!ReadNumber(in, &e.articles, &after) || after != ' ') return false;
+    while ((ch = getc_unlocked(in)) != '\n') {
+      if (ch == EOF || length == sizeof(word) - 1) return false;
+      word[length++] = ch;
+    }
+    word[length] = '\0';
+    e.word = strdup(word);
+    VectorAppend(expansions, &e);
+  }
+  return true;
+}
+
+int CoordinatorExpand(coordinator *c, const char *prefix, int n, char *words[])
+{
+  struct shardconnection *conns[c->numShards];
+  int numRequests = 0;
+  bool ok = true;
+  for (int shard = 0; shard < c->numShards && ok; shard++) {
+    struct shardconnection *conn = ConnectionTo(c, shard);
+    ok = conn != NULL && fprintf(conn->out, "%c%s%c\n", kCoordinatorRequestPrefix, prefix, kCoordinatorPrefixWildcard) > 0;
+    conns[numRequests++] = conn;
+  }
+  for (int r = 0; r < numRequests && ok; r++) ok = fflush(conns[r]->out) != EOF;
+
+  vector expansions;
+  VectorNew(&expansions, sizeof(struct expansion), FreeExpansion, 0);
+  for (int r = 0; r < numRequests && ok; r++) ok = ReadExpansions(conns[r]->in, &expansions);
+  int found = -1;
+  if (ok) {
+    VectorSort(&expansions, CompareExpansions);
+    for (found = 0; found < n && found < VectorLength(&expansions); found++)
+      words[found] = strdup(((const struct expansion *) VectorNth(&expansions, found))->word);
+  } else ResetConnections(c);
+  VectorDispose(&expansions);
+  return found;
+}
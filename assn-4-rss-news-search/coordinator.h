@@ -0,0 +1,111 @@
+/**
+ * File: coordinator.h
+ * -------------------
+ * Defines the coordinator, the front end of a term-partitioned index.
+ * Each shard is an rss-news-search --serve process holding only the
+ * words NewsIndexWordShard assigns to it; the coordinator sends every
+ * term of a query to the shard holding it, and sums the matches that
+ * come back into a single list, which the caller then ranks as it would
+ * the matches of a single index.  A prefix term is first expanded, with
+ * CoordinatorExpand, to words, which then go to their shards like any other.
+ *
+ * A shard is asked for a term's matches with a line holding
+ * kCoordinatorRequestPrefix and the term, and answers with a line holding
+ * the number of matches, followed by a line of that many
+ * "<docID> <occurrences>" pairs, separated by spaces, in increasing docID
+ * order.  All of a query's requests are sent before any reply is read,
+ * so the shards work on a query's terms at the same time.
+ *
+ * A request for a prefix, ending in kCoordinatorPrefixWildcard, is
+ * answered instead with a line holding the number of words, followed by
+ * a line "<number of articles> <word>" for each of the shard's words
+ * beginning with the prefix that are in the most articles, most first.
+ *
+ * Every thread that calls CoordinatorGather gets connections of its own
+ * to each shard, opened on first use and kept open until the thread exits.
+ */
+
+#ifndef __coordinator_
+#define __coordinator_
+
+#include <pthread.h>
+#include "bool.h"
+#include "vector.h"
+
+/**
+ * Constant: kCoordinatorRequestPrefix
+ * -----------------------------------
+ * The character that marks a request line as one from a coordinator.
+ */
+
+#define kCoordinatorRequestPrefix '?'
+
+/**
+ * Constant: kCoordinatorPrefixWildcard
+ * ------------------------------------
+ * The character that ends a prefix term, as in elect*.  A prefix's words
+ * are spread over every shard, so it's sent to every shard rather than to
+ * one.
+ */
+
+#define kCoordinatorPrefixWildcard '*'
+
+/**
+ * Type: coordinator
+ * -----------------
+ * The concrete representation of the coordinator.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  unsigned short *ports;    // ports[i] is where shard i listens, on 127.0.0.1
+  int numShards;
+  pthread_key_t connections; // each thread's FILE *s, one per shard
+} coordinator;
+
+/**
+ * Function: CoordinatorNew
+ * ------------------------
+ * Initializes the coordinator for numShards shards, shard i listening on
+ * ports[i].  No connections are made until they're needed.
+ */
+
+void CoordinatorNew(coordinator *c, const unsigned short ports[], int numShards);
+
+/**
+ * Function: CoordinatorDispose
+ * ----------------------------
+ * Frees the coordinator.  Connections still open belong to their threads,
+ * and close when those threads exit.
+ */
+
+void CoordinatorDispose(coordinator *c);
+
+/**
+ * Function: CoordinatorGather
+ * ---------------------------
+ * Asks the shards for the matches of each of the numTerms terms and
+ * appends them to matches (a vector of match), in increasing docID order,
+ * each article once, with the occurrences of all of the terms in it added
+ * together.  Returns false, leaving matches empty, if any shard couldn't
+ * be reached or sent back something unreadable.
+ */
+
+bool CoordinatorGather(coordinator *c, const char *terms[], int numTerms, vector *matches);
+
+/**
+ * Function: CoordinatorExpand
+ * ---------------------------
+ * Fills words with the (at most) n words beginning with prefix that are
+ * in the most articles of all the shards', most first, ties going to the
+ * word that sorts first, just as a single index's term dictionary would
+ * expand it, and returns how many there are.  Each shard holds every
+ * article of its words, so the n best of each shard's own n best are the
+ * n best of all.  The words are dynamically allocated, and the caller
+ * frees them.  Returns -1, allocating nothing, if any shard couldn't be
+ * reached or sent back something unreadable.
+ */
+
+int CoordinatorExpand(coordinator *c, const char *prefix, int n, char *words[]);
+
+#endif
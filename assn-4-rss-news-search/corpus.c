@@ -0,0 +1,279 @@
+#define _GNU_SOURCE // for fopencookie
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include "corpus.h"
+#include "instrument.h"
+
+static const char *const kCorpusMagic = "RSSCORPUS 1";
+static const char *const kLocalFileMessage = "OK (local file)";
+static const char *const kNotRecordedMessage = "Not Recorded";
+
+static corpusmode mode = kCorpusLive;
+static char corpusDirectory[1024];
+
+void CorpusSetMode(corpusmode newMode, const char *directory)
+{
+  mode = newMode;
+  if (mode == kCorpusLive) return;
+  assert(strlen(directory) < sizeof(corpusDirectory) - 32);
+  strcpy(corpusDirectory, directory);
+  mkdir(corpusDirectory, 0777); // fine if it already exists
+}
+
+// 64-bit FNV-1a hash of the URL, which names the file holding its response.  The url module
+// drops the scheme from fullName, so it's ignored here too, whether or not it's present
+static const char *const kHTTPScheme = "http://";
+static unsigned long long URLHash(const char *fullName)
+{
+  unsigned long long hashcode = 14695981039346656037ULL;
+  if (strncasecmp(fullName, kHTTPScheme, strlen(kHTTPScheme)) == 0) fullName += strlen(kHTTPScheme);
+  for (const char *c = fullName; *c != '\0'; c++) {
+    hashcode ^= (unsigned char) *c;
+    hashcode *= 1099511628211ULL;
+  }
+  return hashcode;
+}
+
+// Builds the path of the URL's entry and, if create is true, makes sure its subdirectory exists
+static void EntryPath(const char *fullName, char path[], int pathLength, bool create)
+{
+  unsigned long long hashcode = URLHash(fullName);
+  snprintf(path, pathLength, "%s/%02x", corpusDirectory, (unsigned) (hashcode >> 56));
+  if (create) mkdir(path, 0777);
+  snprintf(path, pathLength, "%s/%02x/%016llx", corpusDirectory, (unsigned) (hashcode >> 56), hashcode);
+}
+
+// Reads "<key> <value>" from a header line into a freshly allocated string
+static char *ReadHeaderValue(FILE *infile, const char *key)
+{
+  char line[2048];
+  if (fgets(line, sizeof(line), infile) == NULL) return strdup("");
+  line[strcspn(line, "\r\n")] = '\0';
+  int keyLength = strlen(key);
+  if (strncmp(line, key, keyLength) != 0) return strdup("");
+  const char *value = line + keyLength;
+  if (*value == ' ') value++;
+  return strdup(value);
+}
+
+static void SetNotRecorded(urlconnection *urlconn, const url *u)
+{
+  urlconn->responseCode = 404;
+  urlconn->responseMessage = strdup(kNotRecordedMessage);
+  urlconn->contentType = strdup("");
+  urlconn->fullUrl = strdup(u->fullName);
+  urlconn->newUrl = strdup("");
+  urlconn->dataStream = NULL;
+}
+
+// Opens the recorded response for u and positions dataStream at the start of the document
+static void ReplayConnection(urlconnection *urlconn, const url *u)
+{
+  char path[1200];
+  char magic[64];
+  EntryPath(u->fullName, path, sizeof(path), false);
+  FILE *infile = fopen(path, "r");
+  if (infile == NULL || fgets(magic, sizeof(magic), infile) == NULL ||
+      strncmp(magic, kCorpusMagic, strlen(kCorpusMagic)) != 0) {
+    if (infile != NULL) fclose(infile);
+    SetNotRecorded(urlconn, u);
+    return;
+  }
+
+  urlconn->fullUrl = ReadHeaderValue(infile, "URL");
+  char *code = ReadHeaderValue(infile, "Code");
+  urlconn->responseCode = atoi(code);
+  free(code);
+  urlconn->responseMessage = ReadHeaderValue(infile, "Message");
+  urlconn->contentType = ReadHeaderValue(infile, "Type");
+  urlconn->newUrl = ReadHeaderValue(infile, "Location");
+  char blank[8];
+  if (fgets(blank, sizeof(blank), infile) == NULL) {}  // skip the line separating header from document
+  urlconn->dataStream = infile;
+}
+
+bool CorpusEntryBegin(corpusentry *entry, const char *fullName, int responseCode, const char *responseMessage,
+		      const char *contentType, const char *location)
+{
+  EntryPath(fullName, entry->path, sizeof(entry->path), true);
+  snprintf(entry->tempPath, sizeof(entry->tempPath), "%s.%d.tmp", entry->path, (int) getpid());
+  entry->document = fopen(entry->tempPath, "w");
+  if (entry->document == NULL) return false;
+  fprintf(entry->document, "%s\nURL %s\nCode %d\nMessage %s\nType %s\nLocation %s\n\n", kCorpusMagic, fullName,
+	  responseCode, responseMessage, contentType, location);
+  return true;
+}
+
+// The entry is written to a temporary file and renamed into place only once it's complete, so
+// concurrent or interrupted writers never leave a partial entry behind
+void CorpusEntryEnd(corpusentry *entry)
+{
+  fclose(entry->document);
+  rename(entry->tempPath, entry->path);
+}
+
+#ifdef INSTRUMENT
+
+/**
+ * Instrumented builds time name resolution separately by resolving the server's
+ * name themselves just before connecting.  The url library doesn't expose the
+ * stages of URLConnectionNew, so this is the only way to split them out, and it
+ * means the library's own lookup (usually answered from a resolver cache by
+ * then) is charged to the connect phase.
+ */
+
+static void ProbeDNS(const char *serverName)
+{
+  struct addrinfo hints, *result;
+  INSTRUMENT_PHASE(kPhaseDNS);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(serverName, NULL, &hints, &result) == 0) freeaddrinfo(result);
+  INSTRUMENT_RESTORE();
+}
+
+/**
+ * Documents are read through a stream of our own that passes every read on to
+ * the real one, charging the time spent waiting to the download phase and
+ * counting the bytes.  CorpusConnectionDispose closes the wrapper before the real
+ * stream; closing it hands the real stream back through unwrapped.
+ */
+
+typedef struct {
+  FILE *original;
+  long long nanos;
+} meteredstream;
+
+static __thread FILE *unwrapped;
+
+static ssize_t ReadMetered(void *cookie, char *buffer, size_t size)
+{
+  meteredstream *m = cookie;
+  long long start = MonotonicNanos();
+  INSTRUMENT_PHASE(kPhaseDownload);
+  size_t n = fread(buffer, 1, size, m->original);
+  INSTRUMENT_RESTORE();
+  m->nanos += MonotonicNanos() - start;
+  INSTRUMENT_COUNT(kCounterBytes, n);
+  return n;
+}
+
+static int CloseMetered(void *cookie)
+{
+  meteredstream *m = cookie;
+  INSTRUMENT_SAMPLE(kSampleDownload, m->nanos);
+  unwrapped = m->original;
+  free(m);
+  return 0;
+}
+
+static void MeterStream(urlconnection *urlconn)
+{
+  if (urlconn->responseCode != 200 || urlconn->dataStream == NULL) return;
+  static const cookie_io_functions_t kMeteredFunctions = { ReadMetered, NULL, NULL, CloseMetered };
+  meteredstream *m = malloc(sizeof(meteredstream));
+  assert(m != NULL);
+  m->original = urlconn->dataStream;
+  m->nanos = 0;
+  FILE *metered = fopencookie(m, "r", kMeteredFunctions);
+  if (metered == NULL) free(m);
+  else urlconn->dataStream = metered;
+}
+
+static void UnmeterStream(urlconnection *urlconn)
+{
+  if (urlconn->responseCode != 200 || urlconn->dataStream == NULL) return;
+  fclose(urlconn->dataStream);
+  urlconn->dataStream = unwrapped;
+}
+
+#else
+
+static void ProbeDNS(const char *serverName) {}
+static void MeterStream(urlconnection *urlconn) {}
+static void UnmeterStream(urlconnection *urlconn) {}
+
+#endif
+
+// Fetches u from the network and saves the response
+static void RecordConnection(const url *u)
+{
+  urlconnection live;
+  corpusentry entry;
+  ProbeDNS(u->serverName);
+  URLConnectionNew(&live, u);
+  if (CorpusEntryBegin(&entry, u->fullName, live.responseCode,
+		       live.responseCode == 0 || live.responseMessage == NULL ? "" : live.responseMessage,
+		       live.responseCode == 0 || live.contentType == NULL ? "" : live.contentType,
+		       (live.responseCode == 301 || live.responseCode == 302) && live.newUrl != NULL ? live.newUrl : "")) {
+    if (live.responseCode == 200) {
+      char buffer[8192];
+      size_t n;
+      while ((n = fread(buffer, 1, sizeof(buffer), live.dataStream)) > 0) fwrite(buffer, 1, n, entry.document);
+    }
+    CorpusEntryEnd(&entry);
+  }
+  URLConnectionDispose(&live);
+}
+
+void CorpusConnectionNew(urlconnection *urlconn, const url *u)
+{
+  long long start = INSTRUMENT_CLOCK();
+  INSTRUMENT_COUNT(kCounterFetches, 1);
+  if (mode == kCorpusLive) ProbeDNS(u->serverName);
+  INSTRUMENT_PHASE(kPhaseConnect);
+  switch (mode) {
+    case kCorpusLive: URLConnectionNew(urlconn, u);
+                      break;
+    case kCorpusRecord: RecordConnection(u);
+                        ReplayConnection(urlconn, u);
+			break;
+    case kCorpusReplay: ReplayConnection(urlconn, u);
+			break;
+  }
+  INSTRUMENT_RESTORE();
+  INSTRUMENT_SAMPLE(kSampleFetch, INSTRUMENT_CLOCK() - start);
+  int code = urlconn->responseCode;
+  INSTRUMENT_COUNT(kCounterFailures, code != 200 && code != 301 && code != 302 ? 1 : 0);
+  MeterStream(urlconn);
+}
+
+bool CorpusOpenFile(urlconnection *urlconn, const char *path)
+{
+  urlconn->responseMessage = kLocalFileMessage;
+  urlconn->contentType = "text/xml";
+  urlconn->fullUrl = path;
+  urlconn->newUrl = "";
+  urlconn->dataStream = fopen(path, "r");
+  urlconn->responseCode = urlconn->dataStream == NULL ? 404 : 200;
+  MeterStream(urlconn);
+  return urlconn->dataStream != NULL;
+}
+
+void CorpusConnectionDispose(urlconnection *urlconn)
+{
+  UnmeterStream(urlconn);
+  if (urlconn->responseMessage == kLocalFileMessage) { // from CorpusOpenFile, where nothing was allocated
+    if (urlconn->dataStream != NULL) fclose(urlconn->dataStream);
+    return;
+  }
+
+  if (mode == kCorpusLive) {
+    URLConnectionDispose(urlconn);
+    return;
+  }
+
+  if (urlconn->dataStream != NULL) fclose(urlconn->dataStream);
+  free((char *) urlconn->responseMessage);
+  free((char *) urlconn->contentType);
+  free((char *) urlconn->fullUrl);
+  free((char *) urlconn->newUrl);
+}
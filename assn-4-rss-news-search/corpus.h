@@ -0,0 +1,124 @@
+/**
+ * File: corpus.h
+ * --------------
+ * Defines a record/replay layer that sits on top of the urlconnection.
+ * Clients call CorpusConnectionNew and CorpusConnectionDispose exactly as
+ * they would URLConnectionNew and URLConnectionDispose, and read the
+ * document through the same dataStream.  What happens underneath depends
+ * on the mode selected with CorpusSetMode:
+ *
+ *   kCorpusLive:   connections go straight to the network, as always.
+ *   kCorpusRecord: connections go to the network, but every response (the
+ *                  response code, message, content type, redirect location
+ *                  and, for successful requests, the full document) is first
+ *                  saved into the corpus directory, and the client then
+ *                  reads the saved copy.
+ *   kCorpusReplay: nothing touches the network.  Responses are served from
+ *                  the corpus directory, and any URL that was never recorded
+ *                  gets a 404 response.
+ *
+ * Each response is saved to its own file, named after a 64-bit hash of the
+ * URL and spread over 256 subdirectories.  A file holds a short text header
+ * followed by a blank line and then the document itself:
+ *
+ *     RSSCORPUS 1
+ *     URL www.nytimes.com/services/xml/rss/nyt/HomePage.xml
+ *     Code 200
+ *     Message OK
+ *     Type text/xml
+ *     Location
+ *
+ *     <?xml version="1.0" ...
+ *
+ * so corpora can also be produced or inspected with other tools.
+ */
+
+#ifndef __corpus_
+#define __corpus_
+
+#include <stdio.h>
+#include "bool.h"
+#include "url.h"
+#include "urlconnection.h"
+
+typedef enum {
+  kCorpusLive,
+  kCorpusRecord,
+  kCorpusReplay
+} corpusmode;
+
+/**
+ * Function: CorpusSetMode
+ * -----------------------
+ * Selects how subsequent connections are made.  directory names the corpus
+ * used for recording or replay (it's ignored in live mode), and is created
+ * if it doesn't already exist.  This should be called before any connection
+ * is opened.
+ */
+
+void CorpusSetMode(corpusmode mode, const char *directory);
+
+/**
+ * Function: CorpusConnectionNew
+ * -----------------------------
+ * Drop-in replacement for URLConnectionNew that honors the current mode.
+ */
+
+void CorpusConnectionNew(urlconnection *urlconn, const url *u);
+
+/**
+ * Function: CorpusConnectionDispose
+ * ---------------------------------
+ * Drop-in replacement for URLConnectionDispose.  Must be used for every
+ * connection opened with CorpusConnectionNew or CorpusOpenFile.
+ */
+
+void CorpusConnectionDispose(urlconnection *urlconn);
+
+/**
+ * Function: CorpusOpenFile
+ * ------------------------
+ * Initializes urlconn as if the local file at path had been fetched with a
+ * 200 response, regardless of mode.  Returns false (and sets a 404 response
+ * code) if the file can't be opened.  This is how fixtures such as
+ * .test/index.xml.bak are fed through the same code paths as real feeds.
+ */
+
+bool CorpusOpenFile(urlconnection *urlconn, const char *path);
+
+/**
+ * Type: corpusentry
+ * -----------------
+ * A corpus entry that's in the process of being written.  Clients write
+ * the document itself to the document stream.
+ */
+
+typedef struct {
+  FILE *document;
+  char path[1200];
+  char tempPath[1300];
+} corpusentry;
+
+/**
+ * Function: CorpusEntryBegin
+ * --------------------------
+ * Starts writing the entry for fullName into the corpus directory selected
+ * by CorpusSetMode, recording the given response.  On success, the document
+ * (if there is one) should be written to entry->document, and CorpusEntryEnd
+ * called once it's complete.  Returns false if the entry can't be created.
+ * This is how tools other than the crawler, such as rss-corpusgen, produce
+ * corpora.
+ */
+
+bool CorpusEntryBegin(corpusentry *entry, const char *fullName, int responseCode, const char *responseMessage,
+		      const char *contentType, const char *location);
+
+/**
+ * Function: CorpusEntryEnd
+ * ------------------------
+ * Finishes the entry, which becomes visible to replays only now.
+ */
+
+void CorpusEntryEnd(corpusentry *entry);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "entities.h"
+
+#define kMaxEntityNameLength 8   // "thetasym"
+
+/**
+ * The named references, sorted by name (byte by byte, so capitals first)
+ * for binary search.  Names are case-sensitive: &Eacute; and &eacute; are
+ * different characters.
+ */
+
+typedef struct {
+  const char *name;
+  int codepoint;
+} namedentity;
+
+static const namedentity kNamedEntities[] = {
+  { "AElig", 198 }, { "Aacute", 193 }, { "Acirc", 194 }, { "Agrave", 192 }, { "Alpha", 913 },
+  { "Aring", 197 }, { "Atilde", 195 }, { "Auml", 196 }, { "Beta", 914 }, { "Ccedil", 199 },
+  { "Chi", 935 }, { "Dagger", 8225 }, { "Delta", 916 }, { "ETH", 208 }, { "Eacute", 201 },
+  { "Ecirc", 202 }, { "Egrave", 200 }, { "Epsilon", 917 }, { "Eta", 919 }, { "Euml", 203 },
+  { "Gamma", 915 }, { "Iacute", 205 }, { "Icirc", 206 }, { "Igrave", 204 }, { "Iota", 921 },
+  { "Iuml", 207 }, { "Kappa", 922 }, { "Lambda", 923 }, { "Mu", 924 }, { "Ntilde", 209 },
+  { "Nu", 925 }, { "OElig", 338 }, { "Oacute", 211 }, { "Ocirc", 212 }, { "Ograve", 210 },
+  { "Omega", 937 }, { "Omicron", 927 }, { "Oslash", 216 }, { "Otilde", 213 }, { "Ouml", 214 },
+  { "Phi", 934 }, { "Pi", 928 }, { "Prime", 8243 }, { "Psi", 936 }, { "Rho", 929 },
+  { "Scaron", 352 }, { "Sigma", 931 }, { "THORN", 222 }, { "Tau", 932 }, { "Theta", 920 },
+  { "Uacute", 218 }, { "Ucirc", 219 }, { "Ugrave", 217 }, { "Upsilon", 933 }, { "Uuml", 220 },
+  { "Xi", 926 }, { "Yacute", 221 }, { "Yuml", 376 }, { "Zeta", 918 }, { "aacute", 225 },
+  { "acirc", 226 }, { "acute", 180 }, { "aelig", 230 }, { "agrave", 224 }, { "alefsym", 8501 },
+  { "alpha", 945 }, { "amp", 38 }, { "and", 8743 }, { "ang", 8736 }, { "apos", 39 },
+  { "aring", 229 }, { "asymp", 8776 }, { "atilde", 227 }, { "auml", 228 }, { "bdquo", 8222 },
+  { "beta", 946 }, { "brvbar", 166 }, { "bull", 8226 }, { "cap", 8745 }, { "ccedil", 231 },
+  { "cedil", 184 }, { "cent", 162 }, { "chi", 967 }, { "circ", 710 }, { "clubs", 9827 },
+  { "cong", 8773 }, { "copy", 169 }, { "crarr", 8629 }, { "cup", 8746 }, { "curren", 164 },
+  { "dArr", 8659 }, { "dagger", 8224 }, { "darr", 8595 }, { "deg", 176 }, { "delta", 948 },
+  { "diams", 9830 }, { "divide", 247 }, { "eacute", 233 }, { "ecirc", 234 }, { "egrave", 232 },
+  { "empty", 8709 }, { "emsp", 8195 }, { "ensp", 8194 }, { "epsilon", 949 }, { "equiv", 8801 },
+  { "eta", 951 }, { "eth", 240 }, { "euml", 235 }, { "euro", 8364 }, { "exist", 8707 },
+  { "fnof", 402 }, { "forall", 8704 }, { "frac12", 189 }, { "frac14", 188 }, { "frac34", 190 },
+  { "frasl", 8260 }, { "gamma", 947 }, { "ge", 8805 }, { "gt", 62 }, { "hArr", 8660 },
+  { "harr", 8596 }, { "hearts", 9829 }, { "hellip", 8230 }, { "iacute", 237 }, { "icirc", 238 },
+  { "iexcl", 161 }, { "igrave", 236 }, { "image", 8465 }, { "infin", 8734 }, { "int", 8747 },
+  { "iota", 953 }, { "iquest", 191 }, { "isin", 8712 }, { "iuml", 239 }, { "kappa", 954 },
+  { "lArr", 8656 }, { "lambda", 955 }, { "lang", 9001 }, { "laquo", 171 }, { "larr", 8592 },
+  { "lceil", 8968 }, { "ldquo", 8220 }, { "le", 8804 }, { "lfloor", 8970 }, { "lowast", 8727 },
+  { "loz", 9674 }, { "lrm", 8206 }, { "lsaquo", 8249 }, { "lsquo", 8216 }, { "lt", 60 },
+  { "macr", 175 }, { "mdash", 8212 }, { "micro", 181 }, { "middot", 183 }, { "minus", 8722 },
+  { "mu", 956 }, { "nabla", 8711 }, { "nbsp", 160 }, { "ndash", 8211 }, { "ne", 8800 },
+  { "ni", 8715 }, { "not", 172 }, { "notin", 8713 }, { "nsub", 8836 }, { "ntilde", 241 },
+  { "nu", 957 }, { "oacute", 243 }, { "ocirc", 244 }, { "oelig", 339 }, { "ograve", 242 },
+  { "oline", 8254 }, { "omega", 969 }, { "omicron", 959 }, { "oplus", 8853 }, { "or", 8744 },
+  { "ordf", 170 }, { "ordm", 186 }, { "oslash", 248 }, { "otilde", 245 }, { "otimes", 8855 },
+  { "ouml", 246 }, { "para", 182 }, { "part", 8706 }, { "permil", 8240 }, { "perp", 8869 },
+  { "phi", 966 }, { "pi", 960 }, { "piv", 982 }, { "plusmn", 177 }, { "pound", 163 },
+  { "prime", 8242 }, { "prod", 8719 }, { "prop", 8733 }, { "psi", 968 }, { "quot", 34 },
+  { "rArr", 8658 }, { "radic", 8730 }, { "rang", 9002 }, { "raquo", 187 }, { "rarr", 8594 },
+  { "rceil", 8969 }, { "rdquo", 8221 }, { "real", 8476 }, { "reg", 174 }, { "rfloor", 8971 },
+  { "rho", 961 }, { "rlm", 8207 }, { "rsaquo", 8250 }, { "rsquo", 8217 }, { "sbquo", 8218 },
+  { "scaron", 353 }, { "sdot", 8901 }, { "sect", 167 }, { "shy", 173 }, { "sigma", 963 },
+  { "sigmaf", 962 }, { "sim", 8764 }, { "spades", 9824 }, { "sub", 8834 }, { "sube", 8838 },
+  { "sum", 8721 }, { "sup", 8835 }, { "sup1", 185 }, { "sup2", 178 }, { "sup3", 179 },
+  { "supe", 8839 }, { "szlig", 223 }, { "tau", 964 }, { "there4", 8756 }, { "theta", 952 },
+  { "thetasym", 977 }, { "thinsp", 8201 }, { "thorn", 254 }, { "tilde", 732 }, { "times", 215 },
+  { "trade", 8482 }, { "uArr", 8657 }, { "uacute", 250 }, { "uarr", 8593 }, { "ucirc", 251 },
+  { "ugrave", 249 }, { "uml", 168 }, { "upsih", 978 }, { "upsilon", 965 }, { "uuml", 252 },
+  { "weierp", 8472 }, { "xi", 958 }, { "yacute", 253 }, { "yen", 165 }, { "yuml", 255 },
+  { "zeta", 950 }, { "zwj", 8205 }, { "zwnj", 8204 }
+};
+
+static int CompareEntityNames(const void *key, const void *elem)
+{
+  return strcmp(key, ((const namedentity *) elem)->name);
+}
+
+// Returns the code point named by the length characters at name, or -1 if there's no such entity
+static int LookupNamedEntity(const char *name, int length)
+{
+  if (length == 0 || length > kMaxEntityNameLength) return -1;
+  char key[kMaxEntityNameLength + 1];
+  memcpy(key, name, length);
+  key[length] = '\0';
+  const namedentity *found = bsearch(key, kNamedEntities, sizeof(kNamedEntities) / sizeof(kNamedEntities[0]),
+				     sizeof(namedentity), CompareEntityNames);
+  return found == NULL ? -1 : found->codepoint;
+}
+
+// Parses the digits of a numeric reference, returning the code point or -1 if it isn't a character
+static int ParseCodepoint(const char *digits, int length, int base)
+{
+  if (length == 0 || length > (base == 16 ? 6 : 7)) return -1;
+  long codepoint = 0;
+  for (int i = 0; i < length; i++) {
+    int digit;
+    char c = digits[i];
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (base == 16 && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else if (base == 16 && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+    else return -1;
+    codepoint = codepoint * base + digit;
+  }
+  if (codepoint == 0 || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) return -1;
+  return codepoint;
+}
+
+// Writes the UTF-8 encoding of codepoint at out, returning the number of bytes written
+static int EncodeUTF8(int codepoint, char *out)
+{
+  if (codepoint < 0x80) {
+    out[0] = codepoint;
+    return 1;
+  } else if (codepoint < 0x800) {
+    out[0] = 0xC0 | (codepoint >> 6);
+    out[1] = 0x80 | (codepoint & 0x3F);
+    return 2;
+  } else if (codepoint < 0x10000) {
+    out[0] = 0xE0 | (codepoint >> 12);
+    out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+    out[2] = 0x80 | (codepoint & 0x3F);
+    return 3;
+  }
+  out[0] = 0xF0 | (codepoint >> 18);
+  out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+  out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+  out[3] = 0x80 | (codepoint & 0x3F);
+  return 4;
+}
+
+/**
+ * Function: FindAmpersandOrEnd
+ * ----------------------------
+ * Returns a pointer to the first '&' or '\0' at or after s.  The SSE2 version
+ * compares sixteen bytes at a time against both.  Its loads are aligned, so
+ * although they may read past the terminator, they never cross into another
+ * page, and so never fault; bytes before s in the first block are masked off.
+ */
+
+static inline char *FindAmpersandOrEnd(char *s)
+{
+#ifdef __SSE2__
+  const __m128i ampersands = _mm_set1_epi8('&'), zeros = _mm_setzero_si128();
+  uintptr_t offset = (uintptr_t) s & 15;
+  const __m128i *block = (const __m128i *) (s - offset);
+  unsigned mask = ~0u << offset;
+  for (;;) {
+    __m128i bytes = _mm_load_si128(block);
+    mask &= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, ampersands), _mm_cmpeq_epi8(bytes, zeros)));
+    if (mask != 0) return (char *) block + __builtin_ctz(mask);
+    block++;
+    mask = ~0u;
+  }
+#else
+  while (*s != '&' && *s != '\0') s++;
+  return s;
+#endif
+}
+
+/**
+ * Function: DecodeReference
+ * -------------------------
+ * Decodes the reference that starts with the '&' at in, if it's one, writing the
+ * character at out.  Returns the number of bytes of input consumed (0 if in doesn't
+ * start a reference) and sets *written to the number of bytes written.
+ */
+
+static int DecodeReference(const char *in, char *out, int *written)
+{
+  const char *body = in + 1;
+  int codepoint;
+  if (*body == '#') {
+    int base = 10;
+    body++;
+    if (*body == 'x' || *body == 'X') {
+      base = 16;
+      body++;
+    }
+    const char *semicolon = body;
+    while (semicolon - body <= 7 && *semicolon != ';' && *semicolon != '\0') semicolon++;
+    if (*semicolon != ';') return 0;
+    codepoint = ParseCodepoint(body, semicolon - body, base);
+    body = semicolon;
+  } else {
+    const char *semicolon = body;
+    while (semicolon - body <= kMaxEntityNameLength && *semicolon != ';' && *semicolon != '\0') semicolon++;
+    if (*semicolon != ';') return 0;
+    codepoint = LookupNamedEntity(body, semicolon - body);
+    body = semicolon;
+  }
+  if (codepoint == -1) return 0;
+  *written = EncodeUTF8(codepoint, out);
+  return body + 1 - in;
+}
+
+int DecodeEntities(char text[])
+{
+  char *in = FindAmpersandOrEnd(text);
+  if (*in == '\0') return in - text;   // the common case: nothing to decode
+
+  char *out = in;
+  while (*in != '\0') {
+    int written, consumed = DecodeReference(in, out, &written);
+    if (consumed == 0) {
+      *out++ = *in++;
+    } else {
+      in += consumed;
+      out += written;
+    }
+    char *next = FindAmpersandOrEnd(in);
+    memmove(out, in, next - in);
+    out += next - in;
+    in = next;
+  }
+  *out = '\0';
+  return out - text;
+}
@@ -0,0 +1,36 @@
+/**
+ * File: entities.h
+ * ----------------
+ * Defines an in-place decoder for HTML character references, the
+ * escape sequences that stand in for characters in HTML and XML text:
+ *
+ *   named:    &amp; &lt; &quot; &eacute; ...   (the 252 of HTML 4, plus &apos;)
+ *   decimal:  &#39; &#8217; ...
+ *   hex:      &#x27; &#X2019; ...
+ *
+ * Every reference must end with a ';'.  Anything that isn't a complete,
+ * known reference (a lone '&', "&amp" with no ';', an unknown name, or a
+ * numeric reference to something that isn't a character) is left as it
+ * is.  Characters outside of ASCII are written out in UTF-8, which never
+ * takes more bytes than the reference did, so the text only ever shrinks.
+ *
+ * Most text holds no references at all, so the decoder first looks for
+ * a '&' sixteen bytes at a time with SSE2 (where the compiler provides
+ * it), and text without one costs a single vector compare per sixteen
+ * bytes.
+ */
+
+#ifndef __entities_
+#define __entities_
+
+/**
+ * Function: DecodeEntities
+ * ------------------------
+ * Replaces every character reference in the null-terminated string text
+ * with the character it stands for, and returns the decoded string's
+ * length.  The drop-in replacement for html-utils' RemoveEscapeCharacters.
+ */
+
+int DecodeEntities(char text[]);
+
+#endif
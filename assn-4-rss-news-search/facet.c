@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+#include "facet.h"
+
+static const int kFacetBuckets = 1021;
+
+static int FacetValueHash(const void *elemAddr, int numBuckets)
+{
+  const facetvalue *value = *(const facetvalue **) elemAddr;
+  unsigned long hashcode = 0;
+  for (const char *c = value->name; *c != '\0'; c++) hashcode = hashcode * 31 + tolower((unsigned char) *c);
+  return hashcode % numBuckets;
+}
+
+static int FacetValueCompare(const void *elemAddr1, const void *elemAddr2)
+{
+  return strcasecmp((*(const facetvalue **) elemAddr1)->name, (*(const facetvalue **) elemAddr2)->name);
+}
+
+static void FreeFacetValue(void *elemAddr)
+{
+  facetvalue *value = *(facetvalue **) elemAddr;
+  free(value->name);
+  BitmapDispose(&value->articles);
+  free(value);
+}
+
+void FacetNew(facet *f)
+{
+  VectorNew(&f->values, sizeof(facetvalue *), FreeFacetValue, 0);
+  HashSetNew(&f->byName, sizeof(facetvalue *), kFacetBuckets, FacetValueHash, FacetValueCompare, NULL);
+}
+
+void FacetDispose(facet *f)
+{
+  HashSetDispose(&f->byName);
+  VectorDispose(&f->values);
+}
+
+// Returns the value called name, or NULL
+static facetvalue *Lookup(const facet *f, const char *name)
+{
+  facetvalue key = { (char *) name }, *keyAddr = &key;
+  facetvalue **found = HashSetLookup((hashset *) &f->byName, &keyAddr);
+  return found == NULL ? NULL : *found;
+}
+
+void FacetAdd(facet *f, const char *name, int docID)
+{
+  facetvalue *value = Lookup(f, name);
+  if (value == NULL) {
+    value = malloc(sizeof(facetvalue));
+    assert(value != NULL);
+    value->name = strdup(name);
+    value->n = VectorLength(&f->values);
+    BitmapNew(&value->articles);
+    VectorAppend(&f->values, &value);
+    HashSetEnter(&f->byName, &value);
+  }
+  BitmapAdd(&value->articles, docID);
+}
+
+int FacetCount(const facet *f)
+{
+  return VectorLength(&f->values);
+}
+
+const char *FacetName(const facet *f, int n)
+{
+  return (*(facetvalue **) VectorNth(&f->values, n))->name;
+}
+
+const bitmap *FacetArticles(const facet *f, int n)
+{
+  return &(*(facetvalue **) VectorNth(&f->values, n))->articles;
+}
+
+int FacetFind(const facet *f, const char *name)
+{
+  facetvalue *value = Lookup(f, name);
+  return value == NULL ? -1 : value->n;
+}
+
+void FacetRunOptimize(facet *f)
+{
+  for (int n = 0; n < FacetCount(f); n++) BitmapRunOptimize(&(*(facetvalue **) VectorNth(&f->values, n))->articles);
+}
+
+long FacetBytes(const facet *f)
+{
+  long bytes = 0;
+  for (int n = 0; n < FacetCount(f); n++) bytes += BitmapBytes(FacetArticles(f, n));
+  return bytes;
+}
@@ -0,0 +1,101 @@
+/**
+ * File: facet.h
+ * -------------
+ * Defines the facet, which divides an index's articles by one of their
+ * attributes, such as the server they came from or the feed that listed
+ * them.  Each distinct value of the attribute (each server, each feed)
+ * keeps a compressed bitmap (see bitmap.h) of the ids of the articles
+ * with that value, so a query's matches can be limited to a few sources
+ * by looking each match up in their bitmaps, and counted by source by
+ * intersecting the matches' bitmap with each source's, without touching
+ * the article table.
+ */
+
+#ifndef __facet_
+#define __facet_
+
+#include "hashset.h"
+#include "vector.h"
+#include "bitmap.h"
+
+/**
+ * Type: facetvalue
+ * ----------------
+ * One value of the attribute, and the articles that have it.
+ */
+
+typedef struct {
+  char *name;
+  int n;              // the value's position among the facet's values
+  bitmap articles;
+} facetvalue;
+
+/**
+ * Type: facet
+ * -----------
+ * The concrete representation of the facet.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  vector values;      // facetvalue *, in the order they were first seen
+  hashset byName;     // the same, found by name without regard to case
+} facet;
+
+/**
+ * Function: FacetNew
+ * ------------------
+ * Initializes the facet with no values.
+ */
+
+void FacetNew(facet *f);
+
+/**
+ * Function: FacetDispose
+ * ----------------------
+ * Frees the facet and all of its values.
+ */
+
+void FacetDispose(facet *f);
+
+/**
+ * Function: FacetAdd
+ * ------------------
+ * Notes that the article docID has the value name, adding the value if
+ * it's new.  Articles are cheapest to add in increasing docID order.
+ */
+
+void FacetAdd(facet *f, const char *name, int docID);
+
+/**
+ * Functions: FacetCount, FacetName, FacetArticles
+ * -----------------------------------------------
+ * Return the number of values the facet has, and the name of value n and
+ * the bitmap of the articles having it, numbered as they were first seen.
+ */
+
+int FacetCount(const facet *f);
+const char *FacetName(const facet *f, int n);
+const bitmap *FacetArticles(const facet *f, int n);
+
+/**
+ * Function: FacetFind
+ * -------------------
+ * Returns the number of the value called name, compared without regard
+ * to case, or -1 if the facet hasn't one.
+ */
+
+int FacetFind(const facet *f, const char *name);
+
+/**
+ * Functions: FacetRunOptimize, FacetBytes
+ * ---------------------------------------
+ * Compact every value's bitmap with BitmapRunOptimize, which is worth
+ * doing once an index is built, and return the bytes all of the facet's
+ * bitmaps take.
+ */
+
+void FacetRunOptimize(facet *f);
+long FacetBytes(const facet *f);
+
+#endif
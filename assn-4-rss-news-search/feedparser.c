@@ -0,0 +1,291 @@
+#define _GNU_SOURCE // for memmem
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+#include "feedparser.h"
+
+static const int kInitialBufferSize = 16 << 10;
+static const int kReadSize = 8 << 10;
+static const int kMaxItemSize = 1 << 20;   // an item still open after this many bytes is abandoned
+static const int kLongestMarkupPrefix = 9; // strlen("<![CDATA[")
+
+/**
+ * Dispatch table: the tag names the parser acts on, indexed by their
+ * length.  No two names of the same length share a first letter, so a
+ * tag name is matched after at most one full comparison.
+ */
+
+typedef enum { kTagOther, kTagItem, kTagTitle, kTagLink, kTagDescription, kTagDate, kTagTTL } feedtag;
+
+typedef struct {
+  const char *name;
+  feedtag tag;
+} feedtagname;
+
+#define kMaxTagNameLength 11
+#define kMaxTagsPerLength 4
+static const feedtagname kTagsByLength[kMaxTagNameLength + 1][kMaxTagsPerLength] = {
+  [3] = { { "ttl", kTagTTL } },
+  [4] = { { "item", kTagItem }, { "link", kTagLink } },
+  [5] = { { "entry", kTagItem }, { "title", kTagTitle } },
+  [7] = { { "content", kTagDescription }, { "summary", kTagDescription }, { "pubDate", kTagDate },
+	  { "updated", kTagDate } },
+  [9] = { { "published", kTagDate } },
+  [11] = { { "description", kTagDescription } },
+};
+
+static const feedfield kFieldForTag[] = { [kTagTitle] = kFeedTitle, [kTagLink] = kFeedLink,
+					  [kTagDescription] = kFeedDescription, [kTagDate] = kFeedDate };
+
+static feedtag LookupTag(const char *name, int length)
+{
+  if (length > kMaxTagNameLength) return kTagOther;
+  for (int i = 0; i < kMaxTagsPerLength && kTagsByLength[length][i].name != NULL; i++) {
+    const feedtagname *candidate = &kTagsByLength[length][i];
+    if (tolower((unsigned char) name[0]) == candidate->name[0] && strncasecmp(name, candidate->name, length) == 0)
+      return candidate->tag;
+  }
+  return kTagOther;
+}
+
+void FeedParserNew(feedparser *p, FeedItemFunction itemfn, void *auxData)
+{
+  p->itemfn = itemfn;
+  p->auxData = auxData;
+  p->allocated = kInitialBufferSize;
+  p->buffer = malloc(p->allocated);
+  assert(p->buffer != NULL);
+  p->next = p->end = 0;
+  p->inItem = false;
+  p->bytesParsed = 0;
+  p->itemsParsed = 0;
+  p->ttlMinutes = 0;
+}
+
+void FeedParserDispose(feedparser *p)
+{
+  free(p->buffer);
+}
+
+// Reads more of the feed into the buffer, first discarding whatever's no longer needed:
+// everything before the current item, or before next when outside of an item.  The
+// buffer grows if the current item fills it.  Returns false at the end of the feed.
+static bool Refill(feedparser *p, FILE *infile)
+{
+  if (p->atEOF) return false;
+  if (p->inItem && p->end - p->itemStart > kMaxItemSize) p->inItem = false;
+  int keep = p->inItem ? p->itemStart : p->next;
+  if (keep > 0) {
+    memmove(p->buffer, p->buffer + keep, p->end - keep);
+    p->end -= keep;
+    p->next -= keep;
+    p->itemStart -= keep;
+    for (int f = 0; f < kNumFeedFields; f++) p->fieldStart[f] -= keep;
+  }
+  if (p->allocated - p->end < kReadSize) {
+    p->allocated *= 2;
+    p->buffer = realloc(p->buffer, p->allocated);
+    assert(p->buffer != NULL);
+  }
+  int n = fread(p->buffer + p->end, 1, p->allocated - p->end, infile);
+  p->end += n;
+  p->bytesParsed += n;
+  if (n == 0) p->atEOF = true;
+  return n > 0;
+}
+
+// Returns the offset of the first occurrence of pattern at or after from, or -1
+static int Find(const feedparser *p, int from, const char *pattern)
+{
+  const char *found = memmem(p->buffer + from, p->end - from, pattern, strlen(pattern));
+  return found == NULL ? -1 : found - p->buffer;
+}
+
+static bool StartsWith(const feedparser *p, int at, const char *prefix)
+{
+  int length = strlen(prefix);
+  return p->end - at >= length && memcmp(p->buffer + at, prefix, length) == 0;
+}
+
+// Finds the value of the named attribute within the tag text[0..length), returning false if it's absent
+static bool FindAttribute(const char *text, int length, const char *name, int *valueStart, int *valueLength)
+{
+  int nameLength = strlen(name);
+  for (int i = 1; i + nameLength < length; i++) {
+    if (!isspace((unsigned char) text[i - 1]) || strncasecmp(text + i, name, nameLength) != 0) continue;
+    int j = i + nameLength;
+    while (j < length && isspace((unsigned char) text[j])) j++;
+    if (j == length || text[j] != '=') continue;
+    for (j++; j < length && isspace((unsigned char) text[j]); j++);
+    if (j == length || (text[j] != '"' && text[j] != '\'')) continue;
+    const char *close = memchr(text + j + 1, text[j], length - j - 1);
+    if (close == NULL) return false;
+    *valueStart = j + 1;
+    *valueLength = close - (text + j + 1);
+    return true;
+  }
+  return false;
+}
+
+static void StartItem(feedparser *p, int at)
+{
+  p->inItem = true;
+  p->itemStart = at;
+  for (int f = 0; f < kNumFeedFields; f++) p->fieldStart[f] = p->fieldLength[f] = 0;
+}
+
+static void DeliverItem(feedparser *p)
+{
+  static char empty[1];
+  feeditem item;
+  for (int f = 0; f < kNumFeedFields; f++) {
+    item.fields[f].length = p->fieldLength[f];
+    if (p->fieldLength[f] == 0) item.fields[f].text = empty;
+    else {
+      item.fields[f].text = p->buffer + p->fieldStart[f];
+      item.fields[f].text[p->fieldLength[f]] = '\0';  // overwrites markup that's already been parsed
+    }
+  }
+  p->inItem = false;
+  p->itemsParsed++;
+  p->itemfn(&item, p->auxData);
+}
+
+/**
+ * Function: ParseTextField
+ * ------------------------
+ * Records the text following the start tag that ends at gt as the specified field,
+ * unwrapping it if it's a CDATA section.  Returns the offset just past the text,
+ * or -1 if the text's end isn't in the buffer yet.
+ */
+
+static int ParseTextField(feedparser *p, int gt, feedfield field)
+{
+  int start = gt + 1, stop, resume;
+  if (!p->atEOF && p->end - start < kLongestMarkupPrefix) return -1;
+  if (StartsWith(p, start, "<![CDATA[")) {
+    start += kLongestMarkupPrefix;
+    if ((stop = Find(p, start, "]]>")) == -1) return -1;
+    resume = stop + 3;
+  } else {
+    const char *lt = memchr(p->buffer + start, '<', p->end - start);
+    if (lt == NULL) return -1;
+    stop = resume = lt - p->buffer;
+  }
+  p->fieldStart[field] = start;
+  p->fieldLength[field] = stop - start;
+  return resume;
+}
+
+/**
+ * Function: ParseNext
+ * -------------------
+ * Parses the next piece of markup in the buffer, along with any text leading up to
+ * it.  Returns false, without consuming anything but text outside of markup, if the
+ * buffer ends before the markup (or the field text that follows it) does.
+ */
+
+static bool ParseNext(feedparser *p)
+{
+  const char *lt = memchr(p->buffer + p->next, '<', p->end - p->next);
+  if (lt == NULL) {
+    p->next = p->end;
+    return false;
+  }
+  p->next = lt - p->buffer;
+  if (!p->atEOF && p->end - p->next < kLongestMarkupPrefix) return false;
+
+  // comments, and CDATA sections outside of the fields wanted, are skipped whole
+  const char *terminator = NULL;
+  int prefixLength = 0;
+  if (StartsWith(p, p->next, "<!--")) {
+    terminator = "-->";
+    prefixLength = 4;
+  } else if (StartsWith(p, p->next, "<![CDATA[")) {
+    terminator = "]]>";
+    prefixLength = kLongestMarkupPrefix;
+  }
+  if (terminator != NULL) {
+    int stop = Find(p, p->next + prefixLength, terminator);
+    if (stop == -1) return false;
+    p->next = stop + strlen(terminator);
+    return true;
+  }
+
+  const char *gtp = memchr(p->buffer + p->next, '>', p->end - p->next);
+  if (gtp == NULL) return false;
+  int gt = gtp - p->buffer;
+  char *tag = p->buffer + p->next;
+  int tagLength = gt - p->next + 1;
+  bool closing = tag[1] == '/';
+  int nameStart = closing ? 2 : 1, nameLength = 0;
+  while (nameStart + nameLength < tagLength - 1 && !isspace((unsigned char) tag[nameStart + nameLength]) &&
+	 tag[nameStart + nameLength] != '/') nameLength++;
+  bool selfClosing = tag[tagLength - 2] == '/';
+  feedtag kind = LookupTag(tag + nameStart, nameLength);
+
+  if (kind == kTagTTL) {
+    // the channel's <ttl>: how many minutes readers may wait before polling the feed again
+    if (!p->inItem && !closing && !selfClosing) {
+      const char *end = memchr(p->buffer + gt + 1, '<', p->end - gt - 1);
+      if (end == NULL) return false;
+      int minutes = 0;
+      for (const char *c = p->buffer + gt + 1; c < end && minutes < 1 << 20; c++)
+	if (isdigit((unsigned char) *c)) minutes = 10 * minutes + *c - '0';
+      p->ttlMinutes = minutes;
+      p->next = end - p->buffer;
+      return true;
+    }
+  } else if (kind == kTagItem) {
+    if (!closing) StartItem(p, p->next);
+    else if (p->inItem) {
+      p->next = gt + 1;
+      DeliverItem(p);
+      return true;
+    }
+  } else if (kind != kTagOther && p->inItem && !closing && p->fieldLength[kFieldForTag[kind]] == 0) {
+    feedfield field = kFieldForTag[kind];
+    int valueStart, valueLength, relStart, relLength;
+    if (kind == kTagLink && FindAttribute(tag, tagLength, "href", &valueStart, &valueLength)) {
+      // an Atom link: only the article itself (no rel, or rel="alternate") is wanted
+      if (!FindAttribute(tag, tagLength, "rel", &relStart, &relLength) ||
+	  (relLength == 9 && strncasecmp(tag + relStart, "alternate", 9) == 0)) {
+	p->fieldStart[field] = p->next + valueStart;
+	p->fieldLength[field] = valueLength;
+      }
+    } else if (!selfClosing) {
+      int resume = ParseTextField(p, gt, field);
+      if (resume == -1) return false;
+      p->next = resume;
+      return true;
+    }
+  }
+  p->next = gt + 1;
+  return true;
+}
+
+void FeedParserParse(feedparser *p, FILE *infile)
+{
+  p->next = p->end = 0;
+  p->atEOF = false;
+  p->inItem = false;
+  p->ttlMinutes = 0;
+  while (ParseNext(p) || Refill(p, infile));
+}
+
+long FeedParserBytesParsed(const feedparser *p)
+{
+  return p->bytesParsed;
+}
+
+long FeedParserItemsParsed(const feedparser *p)
+{
+  return p->itemsParsed;
+}
+
+int FeedParserTTL(const feedparser *p)
+{
+  return p->ttlMinutes;
+}
@@ -0,0 +1,160 @@
+/**
+ * File: feedparser.h
+ * ------------------
+ * Defines the interface for the feedparser, a streaming, event-driven
+ * parser for RSS 2.0 and Atom feeds.  Rather than building the feed up
+ * in memory, the parser reads it a block at a time and, each time it
+ * reaches the end of a news item, hands the item's title, link,
+ * description and publication date to a client callback.
+ *
+ * Both dialects are understood:
+ *
+ *   - RSS 2.0 items are <item> elements holding <title>, <link>,
+ *     <description> and <pubDate> elements.
+ *   - Atom entries are <entry> elements holding <title>, a
+ *     <link href="..."/> (the one with no rel attribute, or with
+ *     rel="alternate"), <summary> or <content> for the description, and
+ *     <published> or <updated> for the date (whichever comes first).
+ *
+ * Tag names are matched case-insensitively, through a small dispatch
+ * table indexed by name length, so most tags in a feed are rejected
+ * after a length check and one character comparison.  Namespaced names
+ * such as <atom:link> or <media:title> are different tags and are
+ * ignored.  Fields wrapped in <![CDATA[ ... ]]> are delivered without
+ * the wrapper.  Anything else within an item (<author>, <guid>, ...) is
+ * skipped, as are elements outside of items, except for the channel's
+ * <ttl>, which is kept for FeedParserTTL.
+ *
+ * Fields are delivered as slices of the parser's own buffer rather than
+ * as copies: the whole of the current item is kept in the buffer until
+ * the callback returns, so no field ever needs to be copied out.
+ */
+
+#ifndef __feedparser_
+#define __feedparser_
+
+#include <stdio.h>
+#include "bool.h"
+
+/**
+ * Type: feedfield
+ * ---------------
+ * The fields of a news item that the parser extracts.
+ */
+
+typedef enum {
+  kFeedTitle,
+  kFeedLink,
+  kFeedDescription,
+  kFeedDate,
+  kNumFeedFields
+} feedfield;
+
+/**
+ * Type: feedslice
+ * ---------------
+ * One field of an item: length characters at text, which the parser
+ * null-terminates before the item is delivered, so text can also be used
+ * as a C string.  The characters are exactly as they appear in the feed,
+ * escape sequences included, and the client may rewrite them in place
+ * (to decode escape sequences, say) as long as it doesn't lengthen them.
+ * A field the item didn't supply has length 0.
+ */
+
+typedef struct {
+  char *text;
+  int length;
+} feedslice;
+
+/**
+ * Type: feeditem
+ * --------------
+ * One news item, as delivered to the client.  Its slices are only valid
+ * until the callback returns.
+ */
+
+typedef struct {
+  feedslice fields[kNumFeedFields];
+} feeditem;
+
+/**
+ * Type: FeedItemFunction
+ * ----------------------
+ * Class of function the parser calls once for every complete news item,
+ * in the order the items appear in the feed.
+ */
+
+typedef void (*FeedItemFunction)(feeditem *item, void *auxData);
+
+/**
+ * Type: feedparser
+ * ----------------
+ * The concrete representation of the parser.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  FeedItemFunction itemfn;
+  void *auxData;
+  char *buffer;
+  int allocated;
+  int next, end;          // the unparsed bytes are buffer[next] through buffer[end - 1]
+  bool atEOF;
+  bool inItem;
+  int itemStart;          // where the current item's start tag begins in the buffer
+  int fieldStart[kNumFeedFields];   // offsets into buffer, since the buffer can move
+  int fieldLength[kNumFeedFields];
+  long bytesParsed;
+  long itemsParsed;
+  int ttlMinutes;         // the current feed's <ttl>, or 0
+} feedparser;
+
+/**
+ * Function: FeedParserNew
+ * -----------------------
+ * Initializes the parser to deliver items to itemfn, along with the
+ * specified auxData.
+ */
+
+void FeedParserNew(feedparser *p, FeedItemFunction itemfn, void *auxData);
+
+/**
+ * Function: FeedParserDispose
+ * ---------------------------
+ * Frees the parser's buffer.
+ */
+
+void FeedParserDispose(feedparser *p);
+
+/**
+ * Function: FeedParserParse
+ * -------------------------
+ * Reads the feed from infile through to its end, calling the item function
+ * for each complete item.  An item cut off by the end of the feed is
+ * dropped.  The parser doesn't take ownership of infile, and it reads it
+ * a block at a time, so it should be infile's only reader.  A parser may
+ * parse any number of feeds, one after another.
+ */
+
+void FeedParserParse(feedparser *p, FILE *infile);
+
+/**
+ * Functions: FeedParserBytesParsed, FeedParserItemsParsed
+ * -------------------------------------------------------
+ * Return the number of bytes read and of items delivered by the parser
+ * over all the feeds it has parsed.
+ */
+
+long FeedParserBytesParsed(const feedparser *p);
+long FeedParserItemsParsed(const feedparser *p);
+
+/**
+ * Function: FeedParserTTL
+ * -----------------------
+ * Returns the number of minutes the last feed parsed asked, in its <ttl>,
+ * that readers wait before polling it again, or 0 if it didn't say.
+ */
+
+int FeedParserTTL(const feedparser *p);
+
+#endif
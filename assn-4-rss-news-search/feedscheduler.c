@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "feedscheduler.h"
+
+static const double kRateSmoothing = 0.5;   // weight of the newest poll's rate in the average
+static const double kMaxShrink = 4;         // how far one poll may shorten the interval
+static const double kMaxGrowth = 2;         // and lengthen it
+static const int kInitialListing = 32;
+static const long long kNanosPerSecond = 1000000000LL;
+
+// 64-bit FNV-1a hash of the string
+static unsigned long long StringHash(const char *s)
+{
+  unsigned long long hashcode = 14695981039346656037ULL;
+  for (; *s != '\0'; s++) hashcode = (hashcode ^ (unsigned char) *s) * 1099511628211ULL;
+  return hashcode;
+}
+
+static unsigned long long Mix(unsigned long long x)
+{
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static void FreeSchedule(void *elemAddr)
+{
+  feedschedule *f = *(feedschedule **) elemAddr;
+  free(f->url);
+  free(f->listed);
+  free(f->listing);
+  free(f);
+}
+
+void FeedSchedulerNew(feedscheduler *s, double initialSeconds, double minSeconds, double maxSeconds)
+{
+  assert(minSeconds > 0 && minSeconds <= initialSeconds && initialSeconds <= maxSeconds);
+  VectorNew(&s->feeds, sizeof(feedschedule *), FreeSchedule, 0);
+  s->heap = NULL;
+  s->heapSize = 0;
+  s->started = 0;
+  s->initialInterval = initialSeconds * kNanosPerSecond;
+  s->minInterval = minSeconds * kNanosPerSecond;
+  s->maxInterval = maxSeconds * kNanosPerSecond;
+}
+
+void FeedSchedulerDispose(feedscheduler *s)
+{
+  VectorDispose(&s->feeds);
+  free(s->heap);
+}
+
+void FeedSchedulerAdd(feedscheduler *s, const char *url)
+{
+  feedschedule *f = calloc(1, sizeof(feedschedule));
+  assert(f != NULL);
+  f->url = strdup(url);
+  f->interval = s->initialInterval;
+  f->itemRate = -1;
+  VectorAppend(&s->feeds, &f);
+}
+
+// Moves the feed at position i toward the root until it's due no sooner than its parent
+static void SiftUp(feedscheduler *s, int i)
+{
+  feedschedule *f = s->heap[i];
+  while (i > 0 && s->heap[(i - 1) / 2]->due > f->due) {
+    s->heap[i] = s->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  s->heap[i] = f;
+}
+
+// Moves the feed at position i toward the leaves until it's due no later than its children
+static void SiftDown(feedscheduler *s, int i)
+{
+  feedschedule *f = s->heap[i];
+  while (2 * i + 1 < s->heapSize) {
+    int child = 2 * i + 1;
+    if (child + 1 < s->heapSize && s->heap[child + 1]->due < s->heap[child]->due) child++;
+    if (s->heap[child]->due >= f->due) break;
+    s->heap[i] = s->heap[child];
+    i = child;
+  }
+  s->heap[i] = f;
+}
+
+void FeedSchedulerStart(feedscheduler *s, long long now)
+{
+  int n = VectorLength(&s->feeds);
+  s->heap = malloc((n + 1) * sizeof(feedschedule *));
+  assert(s->heap != NULL);
+  s->started = now;
+  for (int i = 0; i < n; i++) {
+    feedschedule *f = *(feedschedule **) VectorNth(&s->feeds, i);
+    f->due = now + s->minInterval * i / n;
+    s->heap[s->heapSize++] = f;  // already in due order
+  }
+}
+
+int FeedSchedulerCount(const feedscheduler *s)
+{
+  return VectorLength(&s->feeds);
+}
+
+feedschedule *FeedSchedulerNth(const feedscheduler *s, int n)
+{
+  return *(feedschedule **) VectorNth(&s->feeds, n);
+}
+
+long long FeedSchedulerNextDue(const feedscheduler *s)
+{
+  return s->heapSize < VectorLength(&s->feeds) || s->heapSize == 0 ? -1 : s->heap[0]->due;
+}
+
+feedschedule *FeedSchedulerBeginPoll(feedscheduler *s)
+{
+  assert(s->heapSize == VectorLength(&s->feeds) && s->heapSize > 0);
+  feedschedule *f = s->heap[0];
+  s->heap[0] = s->heap[--s->heapSize];
+  if (s->heapSize > 0) SiftDown(s, 0);
+  f->numListing = 0;
+  f->itemsThisPoll = f->newThisPoll = 0;
+  return f;
+}
+
+static int CompareHashes(const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+  return x < y ? -1 : x > y;
+}
+
+static void AddToListing(feedschedule *f, unsigned int hashcode)
+{
+  if (f->numListing == f->allocatedListing) {
+    f->allocatedListing = f->allocatedListing == 0 ? kInitialListing : 2 * f->allocatedListing;
+    f->listing = realloc(f->listing, f->allocatedListing * sizeof(unsigned int));
+    assert(f->listing != NULL);
+  }
+  f->listing[f->numListing++] = hashcode;
+}
+
+bool FeedScheduleListItem(feedschedule *f, const char *link, time_t published, time_t now)
+{
+  unsigned int hashcode = StringHash(link) >> 32;
+  f->itemsThisPoll++;
+  f->listedItems++;
+  if (f->numListed > 0 && bsearch(&hashcode, f->listed, f->numListed, sizeof(unsigned int), CompareHashes) != NULL) {
+    AddToListing(f, hashcode);
+    return false;
+  }
+  f->newThisPoll++;
+  f->newItems++;
+  if (published != -1 && f->lastPoll != 0) {  // the first poll's items were published before we were looking
+    f->lagSeconds += now > published ? now - published : 0;
+    f->datedItems++;
+  }
+  return true;
+}
+
+void FeedScheduleKeepItem(feedschedule *f, const char *link)
+{
+  AddToListing(f, StringHash(link) >> 32);
+}
+
+// Returns the interval the poll just finished suggests, before it's bounded
+static double NextInterval(feedschedule *f, long long now, bool everyItemNew)
+{
+  double interval = f->interval;
+  if (f->itemsThisPoll == 0) {
+    f->failures++;
+    return interval * kMaxGrowth;
+  }
+  if (f->newThisPoll == 0) f->idlePolls++;
+  if (f->lastPoll == 0) return interval;  // everything's new the first time, which says nothing of the rate
+  double sample = f->newThisPoll / ((double) (now - f->lastPoll) / kNanosPerSecond);
+  f->itemRate = f->itemRate < 0 ? sample : kRateSmoothing * sample + (1 - kRateSmoothing) * f->itemRate;
+  double target;
+  if (everyItemNew) target = interval / 2;
+  else if (f->itemRate > 0) target = kFeedTargetNewItems / f->itemRate * kNanosPerSecond;
+  else target = interval * kMaxGrowth;
+  if (target < interval / kMaxShrink) target = interval / kMaxShrink;
+  if (target > interval * kMaxGrowth) target = interval * kMaxGrowth;
+  return target;
+}
+
+void FeedSchedulerFinishPoll(feedscheduler *s, feedschedule *f, long long now, int ttlMinutes)
+{
+  bool everyItemNew = f->itemsThisPoll > 0 && f->newThisPoll == f->itemsThisPoll && f->numListed > 0;
+  double interval = NextInterval(f, now, everyItemNew);
+  f->ttlSeconds = ttlMinutes > 0 ? 60 * ttlMinutes : 0;
+  double ttl = (double) f->ttlSeconds * kNanosPerSecond;
+  if (interval < ttl) interval = ttl;
+  if (interval < s->minInterval) interval = s->minInterval;
+  if (interval > s->maxInterval) interval = s->maxInterval;
+  f->interval = interval;
+  f->polls++;
+
+  // this poll's listing becomes the one the next poll is compared against, unless the poll
+  // found nothing at all
+  if (f->itemsThisPoll > 0) {
+    qsort(f->listing, f->numListing, sizeof(unsigned int), CompareHashes);
+    f->listed = realloc(f->listed, (f->numListing + 1) * sizeof(unsigned int));  // + 1, as the listing may be empty
+    assert(f->listed != NULL);
+    memcpy(f->listed, f->listing, f->numListing * sizeof(unsigned int));
+    f->numListed = f->numListing;
+  }
+  f->lastPoll = now;
+
+  // a jitter of its own for every poll of every feed, the same from one run to the next
+  double u = (double) (Mix(StringHash(f->url) + f->polls * 0x9E3779B97F4A7C15ULL) >> 11) / (1ULL << 53);
+  f->due = now + (long long) (interval * (1 + kFeedJitter * (2 * u - 1)));
+  s->heap[s->heapSize] = f;
+  SiftUp(s, s->heapSize++);
+}
@@ -0,0 +1,194 @@
+/**
+ * File: feedscheduler.h
+ * ---------------------
+ * Defines the feedscheduler, which decides when each feed of a continuously
+ * running crawl is next polled.  Every feed has an interval of its own,
+ * adapted after each poll to how quickly the feed has been publishing:
+ *
+ *   - the feed's rate of new items is tracked as an exponentially weighted
+ *     average of what each poll found, and the interval is set to the time
+ *     the feed takes to publish kFeedTargetNewItems of them;
+ *   - a poll that finds every item the feed lists new may have missed
+ *     some, so the interval is halved; one that finds nothing new doubles
+ *     it, as does a poll that fails or finds no items at all;
+ *   - no one poll moves the interval by more than a factor of four down or
+ *     two up, and the interval is never below the <ttl> the feed last asked
+ *     its readers to wait, nor outside the scheduler's bounds, which win
+ *     over the <ttl> when the two disagree.
+ *
+ * Feeds wait their turn in a binary heap ordered by the time they're next
+ * due, and each due time is jittered by up to kFeedJitter of the interval,
+ * so feeds that share an interval drift apart rather than all being
+ * polled in the same instant.  The first polls are spread evenly over the
+ * shortest interval.
+ *
+ * An item is new if its link wasn't listed the last time the feed was
+ * polled; the feed's previous listing is kept as a sorted array of link
+ * hashes, so the crawler can skip the articles it already has without
+ * fetching them again.  A new item only joins the listing once the
+ * crawler reports it's been dealt with, so an article that couldn't be
+ * fetched is new again, and fetched again, on the next poll.
+ */
+
+#ifndef __feedscheduler_
+#define __feedscheduler_
+
+#include <time.h>
+#include "bool.h"
+#include "vector.h"
+
+/**
+ * Constants: kFeedTargetNewItems, kFeedJitter
+ * -------------------------------------------
+ * The number of new items a poll of a feed is meant to find, and the
+ * fraction of an interval by which due times are jittered either way.
+ */
+
+#define kFeedTargetNewItems 2
+#define kFeedJitter 0.1
+
+/**
+ * Type: feedschedule
+ * ------------------
+ * One feed's schedule and the statistics of its polls.  Times are in
+ * nanoseconds on the monotonic clock (see latency.h).
+ */
+
+typedef struct {
+  char *url;
+  long long due;             // when the feed is next to be polled
+  long long interval;        // the time between polls
+  long long lastPoll;        // when the last poll finished, or 0 before the first
+  double itemRate;           // new items per second, smoothed; negative until measured
+  int ttlSeconds;            // what the feed's <ttl> last asked for, or 0
+  long polls;
+  long failures;             // polls that found no items at all
+  long idlePolls;            // polls that found items, but none of them new
+  long newItems;
+  long listedItems;          // items seen over all polls, new or not
+  double lagSeconds;         // summed over the datedItems new items that had a <pubDate>
+  long datedItems;
+  unsigned int *listed;      // hashes of the links the last poll listed, sorted
+  int numListed;
+  unsigned int *listing;     // those of the poll underway, as they're found, or, if new, dealt with
+  int numListing, allocatedListing;
+  int itemsThisPoll;         // found by the poll underway, new or not
+  int newThisPoll;
+} feedschedule;
+
+/**
+ * Type: feedscheduler
+ * -------------------
+ * The concrete representation of the scheduler.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  vector feeds;              // of feedschedule *, in the order they were added
+  feedschedule **heap;       // the feeds waiting to be polled, soonest due first
+  int heapSize;
+  long long initialInterval, minInterval, maxInterval;
+  long long started;         // when FeedSchedulerStart was called
+} feedscheduler;
+
+/**
+ * Function: FeedSchedulerNew
+ * --------------------------
+ * Initializes an empty scheduler whose feeds start out polled every
+ * initialSeconds, and are never polled more often than every minSeconds
+ * or less often than every maxSeconds.
+ */
+
+void FeedSchedulerNew(feedscheduler *s, double initialSeconds, double minSeconds, double maxSeconds);
+
+/**
+ * Function: FeedSchedulerDispose
+ * ------------------------------
+ * Frees the scheduler and all of its feeds' schedules.
+ */
+
+void FeedSchedulerDispose(feedscheduler *s);
+
+/**
+ * Function: FeedSchedulerAdd
+ * --------------------------
+ * Adds the feed at url to the scheduler.  Feeds are added before polling
+ * starts, and then FeedSchedulerStart spreads their first polls out.
+ */
+
+void FeedSchedulerAdd(feedscheduler *s, const char *url);
+
+/**
+ * Function: FeedSchedulerStart
+ * ----------------------------
+ * Schedules every feed's first poll, spreading them evenly over the
+ * shortest interval from now on.
+ */
+
+void FeedSchedulerStart(feedscheduler *s, long long now);
+
+/**
+ * Functions: FeedSchedulerCount, FeedSchedulerNth
+ * -----------------------------------------------
+ * Return the number of feeds, and the schedule of feed n, numbered in
+ * the order they were added.
+ */
+
+int FeedSchedulerCount(const feedscheduler *s);
+feedschedule *FeedSchedulerNth(const feedscheduler *s, int n);
+
+/**
+ * Function: FeedSchedulerNextDue
+ * ------------------------------
+ * Returns the time the next feed is due to be polled, or -1 if a poll is
+ * underway (or the scheduler has no feeds).
+ */
+
+long long FeedSchedulerNextDue(const feedscheduler *s);
+
+/**
+ * Function: FeedSchedulerBeginPoll
+ * --------------------------------
+ * Takes the feed due soonest out of the heap and returns it, for the
+ * caller to poll, reporting each item it lists to FeedScheduleListItem
+ * (and each new one it deals with to FeedScheduleKeepItem) and then
+ * handing it back with FeedSchedulerFinishPoll.  Only one poll may be
+ * underway at a time.
+ */
+
+feedschedule *FeedSchedulerBeginPoll(feedscheduler *s);
+
+/**
+ * Function: FeedScheduleListItem
+ * ------------------------------
+ * Notes that the poll underway found an item linking to link, published
+ * at the given time (or -1 if the item isn't dated), and returns true if
+ * the item is new, or false if the last poll listed it too.  now is the
+ * wall-clock time, to which the item's publication time is compared.  An
+ * item listed before stays listed, but a new one is listed only once it's
+ * passed to FeedScheduleKeepItem.
+ */
+
+bool FeedScheduleListItem(feedschedule *f, const char *link, time_t published, time_t now);
+
+/**
+ * Function: FeedScheduleKeepItem
+ * ------------------------------
+ * Lists the new item linking to link, which the crawler has dealt with
+ * (indexed, or turned away as one it already has), so the next poll
+ * skips it.
+ */
+
+void FeedScheduleKeepItem(feedschedule *f, const char *link);
+
+/**
+ * Function: FeedSchedulerFinishPoll
+ * ---------------------------------
+ * Completes the poll of f that finished at now, after the feed asked for a
+ * <ttl> of ttlMinutes (0 if it didn't say), adapting the feed's interval
+ * to what the poll found and putting it back in the heap.
+ */
+
+void FeedSchedulerFinishPoll(feedscheduler *s, feedschedule *f, long long now, int ttlMinutes);
+
+#endif
@@ -1,16 +1,19 @@
 #ifndef __hashsets_functions_
 #define __hashsets_functions_
+#include "postings.h"
 
 typedef struct article {
-  char title[1024];
-  char URL[1024];
-  char server[1024];
-  int occurrences; //could've used short here but it anyway will be rounded off to be the multiple of 4
+  char *title;  // the strings are allocated to fit, rather than in fixed 1024-byte arrays,
+  char *URL;    // since the article table of a large crawl would otherwise be mostly padding
+  char *server;
+  char *feed;   // URL of the feed that listed the article, or "" if that isn't known
+  int id; // position in the index's article table, which is what posting lists refer to
+  int duplicateOf; // id of the article this one was folded into as a near-duplicate, or -1
 } article;
 
 typedef struct wordArticles {
-  char word[1024];
-  vector articles; // vector of articles
+  char *word;
+  postings articles; // compressed list of (article id, occurrences) pairs
 } wordArticles;
 
 
@@ -72,6 +75,10 @@ static int ArticleHash(const void *elemAddr, int numBuckets)
 static void FreeArticle(void *elemAddr)
 {
   struct article *art = *(struct article **) elemAddr;
+  free(art->title);
+  free(art->URL);
+  free(art->server);
+  free(art->feed);
   free(art);
 }
 
@@ -113,7 +120,8 @@ static int IndexHash(const void *elemAddr, int numBuckets)
 static void FreeIndex(void *elemAddr)
 {
   struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
-  VectorDispose(&wordArt->articles);
+  PostingsDispose(&wordArt->articles);
+  free(wordArt->word);
   free(wordArt);
 }
 
@@ -131,7 +139,7 @@ static int IndexCmp(const void *elemAddr1, const void *elemAddr2)
 static void PrintIndex(void *elemAddr, void *auxData)
 {
   struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
-  printf("For word \"%s\" there are \"%d\" articles \n", wordArt->word, VectorLength(&wordArt->articles));
+  printf("For word \"%s\" there are \"%d\" articles \n", wordArt->word, PostingsLength(&wordArt->articles));
 }
 /******end of Index functions*/
 
@@ -0,0 +1,47 @@
+#include <string.h>
+#include "hashsetstats.h"
+
+void HashSetGetStats(const hashset *h, hashsetstats *stats)
+{
+  long comparesToFindAll = 0;   // finding the i-th element of a chain takes i compares
+  long comparesToMissAll = 0;   // missing in a chain compares against all of it
+  memset(stats, 0, sizeof(hashsetstats));
+  stats->numBuckets = h->numBuckets;
+  for (int i = 0; i < h->numBuckets; i++) {
+    int length = VectorLength(&h->buckets[i]);
+    stats->elemCount += length;
+    if (length > 0) stats->usedBuckets++;
+    if (length > stats->maxChain) stats->maxChain = length;
+    stats->chainHistogram[length < kChainHistogramSize - 1 ? length : kChainHistogramSize - 1]++;
+    comparesToFindAll += (long) length * (length + 1) / 2;
+    comparesToMissAll += (long) length * length;  // weighted by the length elements' keys land in
+  }
+
+  stats->loadFactor = stats->numBuckets == 0 ? 0 : (double) stats->elemCount / stats->numBuckets;
+  stats->comparesPerHit = stats->elemCount == 0 ? 0 : (double) comparesToFindAll / stats->elemCount;
+  stats->comparesPerMiss = stats->elemCount == 0 ? 0 : (double) comparesToMissAll / stats->elemCount;
+  stats->maxCompares = stats->maxChain;
+  // with uniform hashing, the other elements sharing a given element's bucket number (n - 1) / m
+  // on average; half of them come before it when it's found, and all of them are scanned on a miss
+  stats->idealComparesPerHit = stats->elemCount == 0 ? 0 :
+    1 + (stats->elemCount - 1) / (2.0 * stats->numBuckets);
+  stats->idealComparesPerMiss = stats->elemCount == 0 ? 0 :
+    1 + (double) (stats->elemCount - 1) / stats->numBuckets;
+}
+
+void HashSetPrintStats(const hashsetstats *stats, FILE *outfile, const char *label)
+{
+  fprintf(outfile, "%s: %d elements in %d buckets (load factor %.2f, %.1f%% of buckets used)\n",
+	  label, stats->elemCount, stats->numBuckets, stats->loadFactor,
+	  stats->numBuckets == 0 ? 0.0 : 100.0 * stats->usedBuckets / stats->numBuckets);
+  fprintf(outfile, "  compares per lookup: %.2f to find (ideal %.2f), %.2f to miss (ideal %.2f), %d at worst\n",
+	  stats->comparesPerHit, stats->idealComparesPerHit, stats->comparesPerMiss,
+	  stats->idealComparesPerMiss, stats->maxCompares);
+  fprintf(outfile, "  chain lengths:");
+  for (int i = 0; i < kChainHistogramSize; i++) {
+    if (stats->chainHistogram[i] == 0) continue;
+    if (i < kChainHistogramSize - 1) fprintf(outfile, " %d:%d", i, stats->chainHistogram[i]);
+    else fprintf(outfile, " %d+:%d", i, stats->chainHistogram[i]);
+  }
+  fprintf(outfile, "\n");
+}
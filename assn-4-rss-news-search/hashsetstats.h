@@ -0,0 +1,70 @@
+/**
+ * File: hashsetstats.h
+ * --------------------
+ * Defines an introspection facility for the hashset, which reports how
+ * evenly a hashset's elements are spread over its buckets and what that
+ * costs lookups.  It's meant for sizing tables and for catching hash
+ * functions that cluster their keys.
+ *
+ * The hashset keeps each bucket as an unsorted vector and looks an element
+ * up by comparing it against the bucket's elements in order, so the cost of
+ * every possible lookup follows directly from the chain lengths.  The figures
+ * below are therefore computed from the table's current layout rather than
+ * counted as lookups happen, which keeps lookups themselves free of any
+ * bookkeeping.
+ */
+
+#ifndef __hashsetstats_
+#define __hashsetstats_
+
+#include <stdio.h>
+#include "hashset.h"
+
+/**
+ * Constant: kChainHistogramSize
+ * -----------------------------
+ * The chain-length histogram counts chains of length 0 through
+ * kChainHistogramSize - 2 individually, and lumps all longer chains
+ * into its last entry.
+ */
+
+#define kChainHistogramSize 9
+
+/**
+ * Type: hashsetstats
+ * ------------------
+ * A hashset's health at a moment in time.
+ */
+
+typedef struct {
+  int elemCount;
+  int numBuckets;
+  int usedBuckets;              // buckets holding at least one element
+  double loadFactor;            // elements per bucket
+  int maxChain;
+  int chainHistogram[kChainHistogramSize];
+  double comparesPerHit;        // mean compare calls to find an element, over all elements
+  double comparesPerMiss;       // mean compare calls to miss, for keys that hash the way the elements do
+  int maxCompares;              // compare calls for the worst possible lookup
+  double idealComparesPerHit;   // what a perfectly uniform hash function would give at this load factor
+  double idealComparesPerMiss;
+} hashsetstats;
+
+/**
+ * Function: HashSetGetStats
+ * -------------------------
+ * Fills in stats for the specified hashset, which isn't modified.  The
+ * time taken is proportional to the number of buckets.
+ */
+
+void HashSetGetStats(const hashset *h, hashsetstats *stats);
+
+/**
+ * Function: HashSetPrintStats
+ * ---------------------------
+ * Prints a short human-readable report of stats to outfile, headed by label.
+ */
+
+void HashSetPrintStats(const hashsetstats *stats, FILE *outfile, const char *label);
+
+#endif
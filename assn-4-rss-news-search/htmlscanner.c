@@ -0,0 +1,149 @@
+#include <string.h>
+#include <ctype.h>
+#include "htmlscanner.h"
+
+// The scanner's states.  Only kText produces words; each of the others consumes markup.
+enum {
+  kText,          // visible text
+  kTagOpen,       // just after '<' (or "</")
+  kTagName,       // within a tag's name
+  kTagBody,       // within a tag, past its name: attributes and whitespace
+  kTagQuoted,     // within a quoted attribute value
+  kBang,          // just after "<!"
+  kBangDash,      // just after "<!-"
+  kComment,       // within "<!--" ... "-->"
+  kDeclaration,   // within "<!...>" or "<?...>"
+  kRawText        // within a script or style element, looking for its end tag
+};
+
+void HTMLScannerNew(htmlscanner *s, FILE *infile, const char *delimiters)
+{
+  s->infile = infile;
+  memset(s->isDelimiter, false, sizeof(s->isDelimiter));
+  for (; *delimiters != '\0'; delimiters++) s->isDelimiter[(unsigned char) *delimiters] = true;
+  s->state = kText;
+  s->tagNameLength = 0;
+  s->closingTag = false;
+  s->rawTextEnd = NULL;
+  s->matched = 0;
+  s->next = s->end = 0;
+  s->bytesScanned = 0;
+}
+
+void HTMLScannerDispose(htmlscanner *s) {}
+
+// Called on the '>' that closes a tag: the contents of script and style elements are skipped too
+static void EndTag(htmlscanner *s)
+{
+  s->state = kText;
+  if (s->closingTag) return;
+  if (s->tagNameLength == 6 && memcmp(s->tagName, "script", 6) == 0) s->rawTextEnd = "</script";
+  else if (s->tagNameLength == 5 && memcmp(s->tagName, "style", 5) == 0) s->rawTextEnd = "</style";
+  else return;
+  s->matched = 0;
+  s->state = kRawText;
+}
+
+bool HTMLScannerNextWord(htmlscanner *s, char word[], int wordLength)
+{
+  int length = 0;
+  while (true) {
+    if (s->next == s->end) {
+      s->end = fread(s->buffer, 1, sizeof(s->buffer), s->infile);
+      s->next = 0;
+      s->bytesScanned += s->end;
+      if (s->end == 0) break;
+    }
+
+    unsigned char c = s->buffer[s->next];
+    switch (s->state) {
+      case kText:
+	if (c == '<' || s->isDelimiter[c]) {
+	  if (c == '<') {
+	    s->state = kTagOpen;
+	    s->closingTag = false;
+	  }
+	  s->next++;
+	  if (length > 0) {
+	    word[length] = '\0';
+	    return true;
+	  }
+	  continue;
+	}
+	if (length < wordLength - 1) word[length++] = c;
+	break;
+      case kTagOpen:
+	if (isalpha(c)) {
+	  s->state = kTagName;
+	  s->tagNameLength = 0;
+	  continue;   // the name's first character is taken by kTagName
+	}
+	if (c == '/' && !s->closingTag) s->closingTag = true;
+	else if (c == '!') s->state = kBang;
+	else if (c == '?') s->state = kDeclaration;
+	else {
+	  s->state = kText;   // a '<' that doesn't start markup is just a delimiter
+	  continue;
+	}
+	break;
+      case kTagName:
+	if (c == '>') EndTag(s);
+	else if (isspace(c) || c == '/') s->state = kTagBody;
+	else if (s->tagNameLength < (int) sizeof(s->tagName)) s->tagName[s->tagNameLength++] = tolower(c);
+	break;
+      case kTagBody:
+	if (c == '>') EndTag(s);
+	else if (c == '"' || c == '\'') {
+	  s->quote = c;
+	  s->state = kTagQuoted;
+	}
+	break;
+      case kTagQuoted:
+	if (c == s->quote) s->state = kTagBody;
+	break;
+      case kBang:
+	if (c == '-') s->state = kBangDash;
+	else {
+	  s->state = kDeclaration;
+	  continue;
+	}
+	break;
+      case kBangDash:
+	if (c == '-') {
+	  s->state = kComment;
+	  s->matched = 0;
+	} else {
+	  s->state = kDeclaration;
+	  continue;
+	}
+	break;
+      case kComment:
+	if (c == '-') {
+	  if (s->matched < 2) s->matched++;
+	} else if (c == '>' && s->matched == 2) s->state = kText;
+	else s->matched = 0;
+	break;
+      case kDeclaration:
+	if (c == '>') s->state = kText;
+	break;
+      case kRawText:
+	if (tolower(c) == s->rawTextEnd[s->matched]) {
+	  if (s->rawTextEnd[++s->matched] == '\0') {
+	    s->state = kTagBody;   // the end tag itself is consumed like any other tag
+	    s->closingTag = true;
+	  }
+	} else s->matched = c == '<';
+	break;
+    }
+    s->next++;
+  }
+
+  if (length == 0) return false;
+  word[length] = '\0';
+  return true;
+}
+
+long HTMLScannerBytesScanned(const htmlscanner *s)
+{
+  return s->bytesScanned;
+}
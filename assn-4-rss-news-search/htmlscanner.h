@@ -0,0 +1,94 @@
+/**
+ * File: htmlscanner.h
+ * -------------------
+ * Defines the interface for the htmlscanner, which pulls the words of an
+ * HTML page's visible text out of a stream in a single pass.
+ *
+ * The scanner is a state machine over the page's bytes.  Text outside of
+ * markup is split into words at a client-supplied set of delimiter
+ * characters, just as a streamtokenizer would split it.  Everything else
+ * is consumed without ever being tokenized: tags along with their
+ * attributes (quoted attribute values may contain '>'), comments (which
+ * may contain anything up to "-->"), declarations and processing
+ * instructions such as <!DOCTYPE ...> and <?xml ...?>, and the contents
+ * of <script> and <style> elements, which are code rather than text and
+ * run through the matching end tag.
+ *
+ * The stream is read a block at a time, so the scanner should be the only
+ * reader of the stream for as long as it's in use.
+ */
+
+#ifndef __htmlscanner_
+#define __htmlscanner_
+
+#include <stdio.h>
+#include "bool.h"
+
+/**
+ * Constant: kHTMLScannerBufferSize
+ * --------------------------------
+ * The number of bytes the scanner reads from its stream at a time.
+ */
+
+#define kHTMLScannerBufferSize 8192
+
+/**
+ * Type: htmlscanner
+ * -----------------
+ * The concrete representation of the scanner.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  FILE *infile;
+  bool isDelimiter[256];
+  int state;
+  char tagName[8];          // lowercased start of the current tag's name, enough to spot script and style
+  int tagNameLength;
+  bool closingTag;
+  char quote;               // the quote character of the attribute value being skipped
+  const char *rawTextEnd;   // "</script" or "</style" while skipping an element's contents
+  int matched;              // characters matched so far of rawTextEnd or of "-->"
+  unsigned char buffer[kHTMLScannerBufferSize];
+  int next, end;            // the unscanned bytes are buffer[next] through buffer[end - 1]
+  long bytesScanned;
+} htmlscanner;
+
+/**
+ * Function: HTMLScannerNew
+ * ------------------------
+ * Initializes the scanner to read the page from infile, splitting its text
+ * into words at every character in delimiters.  The scanner doesn't take
+ * ownership of infile, so HTMLScannerDispose won't close it.
+ */
+
+void HTMLScannerNew(htmlscanner *s, FILE *infile, const char *delimiters);
+
+/**
+ * Function: HTMLScannerDispose
+ * ----------------------------
+ * Frees whatever the scanner allocated (currently nothing).
+ */
+
+void HTMLScannerDispose(htmlscanner *s);
+
+/**
+ * Function: HTMLScannerNextWord
+ * -----------------------------
+ * Copies the next word of visible text into word as a C string and returns
+ * true, or returns false once the page is exhausted.  Words longer than
+ * wordLength - 1 characters are truncated.  HTML escape sequences are left
+ * as they appear in the page.
+ */
+
+bool HTMLScannerNextWord(htmlscanner *s, char word[], int wordLength);
+
+/**
+ * Function: HTMLScannerBytesScanned
+ * ---------------------------------
+ * Returns the number of bytes of the page the scanner has read so far.
+ */
+
+long HTMLScannerBytesScanned(const htmlscanner *s);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "indexfile.h"
+
+static const char kMagic[8] = "RSSIDX3\n";
+static const char kMagicWithoutFeeds[8] = "RSSIDX2\n";
+static const int kReaderBufferSize = 64 << 10;
+static const int kCopyBufferSize = 64 << 10;
+
+static void WriteNumber(indexwriter *w, unsigned int value)
+{
+  while (value >= 0x80) {
+    putc((unsigned char) (value | 0x80), w->outfile);
+    value >>= 7;
+    w->bytesWritten++;
+  }
+  putc((unsigned char) value, w->outfile);
+  w->bytesWritten++;
+}
+
+// Appends a variable-byte integer to the current word's postings, which can't be written
+// until their length is known
+static void BufferNumber(indexwriter *w, unsigned int value)
+{
+  if (w->postingsLength + 5 > w->postingsAllocated) {
+    w->postingsAllocated = w->postingsAllocated == 0 ? 256 : 2 * w->postingsAllocated;
+    w->postings = realloc(w->postings, w->postingsAllocated);
+    assert(w->postings != NULL);
+  }
+  while (value >= 0x80) {
+    w->postings[w->postingsLength++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  w->postings[w->postingsLength++] = (unsigned char) value;
+}
+
+static void WriteString(indexwriter *w, const char *s)
+{
+  int length = strlen(s);
+  WriteNumber(w, length);
+  fwrite(s, 1, length, w->outfile);
+  w->bytesWritten += length;
+}
+
+bool IndexWriterNew(indexwriter *w, const char *fileName, int numArticles)
+{
+  w->outfile = fopen(fileName, "wb");
+  if (w->outfile == NULL) return false;
+  w->articlesLeft = numArticles;
+  w->postingsLeft = 0;
+  w->postings = NULL;
+  w->postingsLength = w->postingsAllocated = 0;
+  w->bytesWritten = 0;
+  fwrite(kMagic, 1, sizeof(kMagic), w->outfile);
+  w->bytesWritten += sizeof(kMagic);
+  WriteNumber(w, numArticles);
+  return true;
+}
+
+void IndexWriterAddArticle(indexwriter *w, const char *title, const char *URL, const char *server, const char *feed,
+			   int duplicateOf)
+{
+  assert(w->articlesLeft > 0);
+  w->articlesLeft--;
+  WriteString(w, title);
+  WriteString(w, URL);
+  WriteString(w, server);
+  WriteString(w, feed);
+  WriteNumber(w, duplicateOf + 1);
+}
+
+void IndexWriterBeginWord(indexwriter *w, const char *word, int numPostings)
+{
+  assert(w->articlesLeft == 0 && w->postingsLeft == 0);
+  assert(word[0] != '\0' && numPostings > 0);
+  WriteString(w, word);
+  WriteNumber(w, numPostings);
+  w->postingsLeft = numPostings;
+  w->postingsLength = 0;
+  w->lastDocID = -1;
+}
+
+void IndexWriterAddPosting(indexwriter *w, int docID, int freq)
+{
+  assert(w->postingsLeft > 0 && docID > w->lastDocID && freq > 0);
+  BufferNumber(w, docID - w->lastDocID);
+  BufferNumber(w, freq - 1);
+  w->lastDocID = docID;
+  if (--w->postingsLeft == 0) {
+    WriteNumber(w, w->postingsLength);
+    fwrite(w->postings, 1, w->postingsLength, w->outfile);
+    w->bytesWritten += w->postingsLength;
+  }
+}
+
+bool IndexWriterAppendWords(indexwriter *w, const char *fileName)
+{
+  assert(w->articlesLeft == 0 && w->postingsLeft == 0);
+  FILE *infile = fopen(fileName, "rb");
+  if (infile == NULL) return false;
+  // the file is the magic, a one-byte article count of zero, its words and a one-byte
+  // end marker, and only the words are wanted
+  char header[sizeof(kMagic) + 1];
+  long length = -1;
+  if (fread(header, 1, sizeof(header), infile) == sizeof(header) && memcmp(header, kMagic, sizeof(kMagic)) == 0 &&
+      header[sizeof(kMagic)] == 0 && fseek(infile, 0, SEEK_END) == 0) {
+    length = ftell(infile) - (long) sizeof(header) - 1;
+    fseek(infile, sizeof(header), SEEK_SET);
+  }
+  if (length < 0) {
+    fclose(infile);
+    return false;
+  }
+  char *buffer = malloc(kCopyBufferSize);
+  assert(buffer != NULL);
+  while (length > 0) {
+    size_t chunk = length < kCopyBufferSize ? length : kCopyBufferSize;
+    if (fread(buffer, 1, chunk, infile) != chunk) break;
+    fwrite(buffer, 1, chunk, w->outfile);
+    w->bytesWritten += chunk;
+    length -= chunk;
+  }
+  free(buffer);
+  bool ok = length == 0 && getc(infile) == 0;  // the copy ran right up to the end marker
+  fclose(infile);
+  return ok;
+}
+
+bool IndexWriterClose(indexwriter *w)
+{
+  assert(w->articlesLeft == 0 && w->postingsLeft == 0);
+  WriteNumber(w, 0);  // the empty word
+  free(w->postings);
+  bool ok = !ferror(w->outfile);
+  return fclose(w->outfile) == 0 && ok;
+}
+
+long IndexWriterBytes(const indexwriter *w)
+{
+  return w->bytesWritten;
+}
+
+// Reads a variable-byte integer, returning false at the end of the file (or if the
+// integer runs on past 32 bits, which only a damaged file could hold)
+static bool ReadNumber(indexreader *r, unsigned int *value)
+{
+  int c, shift = 0;
+  *value = 0;
+  do {
+    if (shift > 28 || (c = getc(r->infile)) == EOF) return false;
+    r->offset++;
+    *value |= (unsigned int) (c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  return true;
+}
+
+// Reads a string into r->strings[which], returning false at the end of the file
+static bool ReadString(indexreader *r, int which, int *length)
+{
+  unsigned int n;
+  if (!ReadNumber(r, &n)) return false;
+  if (n + 1 > (unsigned) r->allocated[which]) {
+    r->allocated[which] = n + 1;
+    r->strings[which] = realloc(r->strings[which], r->allocated[which]);
+    assert(r->strings[which] != NULL);
+  }
+  if (fread(r->strings[which], 1, n, r->infile) != n) return false;
+  r->offset += n;
+  r->strings[which][n] = '\0';
+  if (length != NULL) *length = n;
+  return true;
+}
+
+bool IndexReaderNew(indexreader *r, const char *fileName)
+{
+  char magic[sizeof(kMagic)];
+  unsigned int numArticles;
+  r->infile = fopen(fileName, "rb");
+  if (r->infile == NULL) return false;
+  setvbuf(r->infile, NULL, _IOFBF, kReaderBufferSize);
+  if (fread(magic, 1, sizeof(magic), r->infile) != sizeof(magic) ||
+      (memcmp(magic, kMagic, sizeof(magic)) != 0 && memcmp(magic, kMagicWithoutFeeds, sizeof(magic)) != 0)) {
+    fclose(r->infile);
+    return false;
+  }
+  r->hasFeeds = memcmp(magic, kMagic, sizeof(magic)) == 0;
+  r->offset = sizeof(kMagic);
+  if (!ReadNumber(r, &numArticles)) {
+    fclose(r->infile);
+    return false;
+  }
+  r->numArticles = r->articlesLeft = numArticles;
+  r->postingsLeft = 0;
+  r->atEnd = r->damaged = false;
+  for (int i = 0; i < 4; i++) {
+    r->strings[i] = NULL;
+    r->allocated[i] = 0;
+  }
+  return true;
+}
+
+void IndexReaderDispose(indexreader *r)
+{
+  fclose(r->infile);
+  for (int i = 0; i < 4; i++) free(r->strings[i]);
+}
+
+int IndexReaderArticleCount(const indexreader *r)
+{
+  return r->numArticles;
+}
+
+bool IndexReaderNextArticle(indexreader *r, const char **title, const char **URL, const char **server,
+			    const char **feed, int *duplicateOf)
+{
+  unsigned int folded;
+  if (r->articlesLeft == 0) return false;
+  if (!ReadString(r, 0, NULL) || !ReadString(r, 1, NULL) || !ReadString(r, 2, NULL) ||
+      (r->hasFeeds && !ReadString(r, 3, NULL)) || !ReadNumber(r, &folded)) {
+    r->articlesLeft = 0;
+    r->atEnd = r->damaged = true;  // a truncated file: there's nothing more to be had from it
+    return false;
+  }
+  r->articlesLeft--;
+  *title = r->strings[0];
+  *URL = r->strings[1];
+  *server = r->strings[2];
+  *feed = r->hasFeeds ? r->strings[3] : "";
+  *duplicateOf = (int) folded - 1;
+  return true;
+}
+
+bool IndexReaderNextWord(indexreader *r, const char **word, int *numPostings)
+{
+  const char *title, *URL, *server, *feed;
+  int duplicateOf, length;
+  unsigned int n, bytes;
+  while (IndexReaderNextArticle(r, &title, &URL, &server, &feed, &duplicateOf));
+  if (r->postingsLeft > 0) {
+    r->postingsLeft = 0;
+    if (fseek(r->infile, r->postingsEnd, SEEK_SET) != 0) r->atEnd = r->damaged = true;
+    r->offset = r->postingsEnd;
+  }
+  if (r->atEnd) return false;
+  r->wordOffset = r->offset;
+  if (!ReadString(r, 0, &length)) {
+    r->atEnd = r->damaged = true;
+    return false;
+  }
+  if (length == 0) {
+    r->atEnd = true;
+    return false;
+  }
+  if (!ReadNumber(r, &n) || n == 0 || !ReadNumber(r, &bytes)) {
+    r->atEnd = r->damaged = true;
+    return false;
+  }
+  *word = r->strings[0];
+  *numPostings = r->postingsLeft = n;
+  r->postingsEnd = r->offset + bytes;
+  r->lastDocID = -1;
+  return true;
+}
+
+bool IndexReaderNextPosting(indexreader *r, int *docID, int *freq)
+{
+  unsigned int delta, extra;
+  if (r->postingsLeft == 0) return false;
+  if (!ReadNumber(r, &delta) || !ReadNumber(r, &extra)) {
+    r->postingsLeft = 0;
+    r->atEnd = r->damaged = true;
+    return false;
+  }
+  if (--r->postingsLeft == 0 && r->offset != r->postingsEnd) r->atEnd = r->damaged = true;
+  *docID = r->lastDocID += delta;
+  *freq = extra + 1;
+  return true;
+}
+
+long IndexReaderWordOffset(const indexreader *r)
+{
+  return r->wordOffset;
+}
+
+bool IndexReaderSeekWord(indexreader *r, long offset)
+{
+  r->articlesLeft = r->postingsLeft = 0;
+  r->atEnd = r->damaged = false;
+  r->offset = offset;
+  if (fseek(r->infile, offset, SEEK_SET) == 0) return true;
+  r->atEnd = r->damaged = true;
+  return false;
+}
+
+bool IndexReaderComplete(const indexreader *r)
+{
+  return r->atEnd && !r->damaged;
+}
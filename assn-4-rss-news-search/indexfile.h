@@ -0,0 +1,212 @@
+/**
+ * File: indexfile.h
+ * -----------------
+ * Defines the on-disk form of a news index, along with a streaming
+ * writer and reader for it.  The same format serves for complete indices,
+ * for the sorted runs spilled during a memory-budgeted build, and for the
+ * shards rss-merge combines.
+ *
+ * A file holds, in order:
+ *
+ *   - the eight bytes "RSSIDX3\n",
+ *   - the number of articles, then each article: its title, URL, server
+ *     and feed, and the id of the article it was folded into plus one
+ *     (0 if it wasn't folded), article ids being positions in this list,
+ *   - the words, in strcasecmp order, each given as the word, its number
+ *     of postings, the number of bytes its postings take, and then every
+ *     posting as <docID - previous docID> <occurrences - 1>, the first
+ *     relative to -1, and
+ *   - an empty word, marking the end.
+ *
+ * Files written before articles recorded their feeds begin "RSSIDX2\n"
+ * instead, and are read as if every article's feed were empty.
+ *
+ * Numbers are variable-byte integers, as in postings.h, and strings are
+ * a variable-byte length followed by that many bytes.  Since every word is
+ * written in one go, and the words are sorted, any number of index files
+ * can be merged by reading each of them once, front to back.  Since the
+ * postings' length comes before them, a reader can also step over a word
+ * it isn't interested in without decoding a single posting.
+ */
+
+#ifndef __indexfile_
+#define __indexfile_
+
+#include <stdio.h>
+#include "bool.h"
+
+/**
+ * Type: indexwriter
+ * -----------------
+ * The concrete representation of the writer.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  FILE *outfile;
+  int articlesLeft;   // articles promised to IndexWriterNew but not yet written
+  int postingsLeft;   // postings promised for the current word but not yet written
+  int lastDocID;      // docID of the current word's last posting, -1 before its first
+  unsigned char *postings;   // the current word's postings, encoded, until the last arrives
+  int postingsLength, postingsAllocated;
+  long bytesWritten;
+} indexwriter;
+
+/**
+ * Function: IndexWriterNew
+ * ------------------------
+ * Creates (or truncates) the named file and starts an index holding
+ * numArticles articles.  Returns false if the file can't be created.
+ */
+
+bool IndexWriterNew(indexwriter *w, const char *fileName, int numArticles);
+
+/**
+ * Function: IndexWriterAddArticle
+ * -------------------------------
+ * Writes the next article.  Every article must be written before the first
+ * word is.  duplicateOf is -1 for an article that wasn't folded.
+ */
+
+void IndexWriterAddArticle(indexwriter *w, const char *title, const char *URL, const char *server, const char *feed,
+			   int duplicateOf);
+
+/**
+ * Functions: IndexWriterBeginWord, IndexWriterAddPosting
+ * ------------------------------------------------------
+ * Write the next word, which must follow the previous one in strcasecmp
+ * order, and then its numPostings postings, in increasing docID order.
+ */
+
+void IndexWriterBeginWord(indexwriter *w, const char *word, int numPostings);
+void IndexWriterAddPosting(indexwriter *w, int docID, int freq);
+
+/**
+ * Function: IndexWriterAppendWords
+ * --------------------------------
+ * Copies every word of the named index file, which must hold no articles,
+ * into the index being written, as they are, without decoding them.  All of
+ * its words must follow those written so far.  Returns false if the file
+ * can't be read.
+ */
+
+bool IndexWriterAppendWords(indexwriter *w, const char *fileName);
+
+/**
+ * Function: IndexWriterClose
+ * --------------------------
+ * Marks the end of the words and closes the file, returning false if
+ * anything couldn't be written.
+ */
+
+bool IndexWriterClose(indexwriter *w);
+
+/**
+ * Function: IndexWriterBytes
+ * --------------------------
+ * Returns the number of bytes written so far.
+ */
+
+long IndexWriterBytes(const indexwriter *w);
+
+/**
+ * Type: indexreader
+ * -----------------
+ * The concrete representation of the reader.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  FILE *infile;
+  int numArticles;
+  int articlesLeft;
+  int postingsLeft;
+  int lastDocID;
+  long offset;          // bytes consumed from the file so far
+  long wordOffset;      // offset of the current word
+  long postingsEnd;     // offset just past the current word's postings
+  char *strings[4];     // the last article's title, URL, server and feed, or the last word in strings[0]
+  int allocated[4];
+  bool hasFeeds;        // false for a file from before articles recorded their feeds
+  bool atEnd;
+  bool damaged;         // the file ended, or held something impossible, before its end marker
+} indexreader;
+
+/**
+ * Function: IndexReaderNew
+ * ------------------------
+ * Opens the named index file for reading.  Returns false if the file can't
+ * be opened or isn't an index file.
+ */
+
+bool IndexReaderNew(indexreader *r, const char *fileName);
+
+/**
+ * Function: IndexReaderDispose
+ * ----------------------------
+ * Closes the file and frees the reader's buffers.
+ */
+
+void IndexReaderDispose(indexreader *r);
+
+/**
+ * Function: IndexReaderArticleCount
+ * ---------------------------------
+ * Returns the number of articles in the file.
+ */
+
+int IndexReaderArticleCount(const indexreader *r);
+
+/**
+ * Function: IndexReaderNextArticle
+ * --------------------------------
+ * Reads the next article, setting the pointers to its title, URL, server and feed
+ * (which stay valid only until the reader's next call) and *duplicateOf, and
+ * returns true, or returns false once every article has been read.
+ */
+
+bool IndexReaderNextArticle(indexreader *r, const char **title, const char **URL, const char **server,
+			    const char **feed, int *duplicateOf);
+
+/**
+ * Function: IndexReaderNextWord
+ * -----------------------------
+ * Skips whatever articles and postings haven't been read (postings without
+ * being decoded), reads the next word, setting *word (valid until the
+ * reader's next call) and *numPostings, and returns true, or returns false
+ * at the end of the words.
+ */
+
+bool IndexReaderNextWord(indexreader *r, const char **word, int *numPostings);
+
+/**
+ * Function: IndexReaderNextPosting
+ * --------------------------------
+ * Reads the current word's next posting into *docID and *freq and returns
+ * true, or returns false once all of the word's postings have been read.
+ */
+
+bool IndexReaderNextPosting(indexreader *r, int *docID, int *freq);
+
+/**
+ * Functions: IndexReaderWordOffset, IndexReaderSeekWord
+ * -----------------------------------------------------
+ * IndexReaderWordOffset returns where in the file the word last read by
+ * IndexReaderNextWord begins, and IndexReaderSeekWord, given such an
+ * offset, moves the reader there, so that IndexReaderNextWord reads that
+ * word next.  Together they let a reader start partway through the words.
+ */
+
+long IndexReaderWordOffset(const indexreader *r);
+bool IndexReaderSeekWord(indexreader *r, long offset);
+
+/**
+ * Function: IndexReaderComplete
+ * -----------------------------
+ * Returns true if the reader has read through to the file's end marker, and
+ * false if it hasn't yet, or if the file turned out to be truncated or damaged.
+ */
+
+bool IndexReaderComplete(const indexreader *r);
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "instrument.h"
+
+#ifdef INSTRUMENT
+
+static const char *const kPhaseNames[kNumPhases] = { "other", "dns", "connect", "download", "parse", "scan", "insert" };
+static const char *const kCounterNames[kNumCounters] = { "fetches", "failures", "bytes", "articles", "tokens", "indexed" };
+static const char *const kSampleNames[kNumSamples] = { "fetch", "download", "article" };
+
+typedef struct {
+  long long phaseNanos[kNumPhases];
+  long counters[kNumCounters];
+} instrumenttotals;
+
+// Totals for one feed or one host, chained into the table below
+typedef struct breakdown {
+  char *name;
+  bool isFeed;
+  instrumenttotals totals;
+  struct breakdown *next;
+  struct breakdown *nextInOrder;  // first-seen order, so reports list feeds as they were crawled
+} breakdown;
+
+#define kNumBreakdownBuckets 1024
+
+// Shared state, all guarded by lock
+static struct {
+  pthread_mutex_t lock;
+  long long startNanos;
+  instrumenttotals totals;
+  breakdown *buckets[kNumBreakdownBuckets];
+  breakdown *first, *last;
+  latencysamples samples[kNumSamples];
+  bool initialized;
+} shared = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Each thread accumulates privately, and only folds its totals into the shared state (taking the
+// lock) when its context changes, so the per-word cost of a phase switch is two clock reads
+static __thread struct {
+  instrumentphase phase;
+  long long since;              // when the current phase began, or 0 before the first switch
+  instrumentcontext context;
+  instrumenttotals pending;
+} local;
+
+static void EnsureInitialized(void)
+{
+  if (shared.initialized) return;
+  shared.startNanos = MonotonicNanos();
+  for (int i = 0; i < kNumSamples; i++) LatencyNew(&shared.samples[i]);
+  shared.initialized = true;
+}
+
+static void AddTotals(instrumenttotals *dst, const instrumenttotals *src)
+{
+  for (int i = 0; i < kNumPhases; i++) dst->phaseNanos[i] += src->phaseNanos[i];
+  for (int i = 0; i < kNumCounters; i++) dst->counters[i] += src->counters[i];
+}
+
+// FNV-1a over the name, with the kind folded in so a feed and a host can share a name
+static breakdown *FindBreakdown(const char *name, bool isFeed)
+{
+  unsigned long hashcode = isFeed ? 2166136261UL : 2166136262UL;
+  for (const char *c = name; *c != '\0'; c++) hashcode = (hashcode ^ (unsigned char) *c) * 16777619UL;
+  breakdown **bucket = &shared.buckets[hashcode % kNumBreakdownBuckets];
+  for (breakdown *b = *bucket; b != NULL; b = b->next) {
+    if (b->isFeed == isFeed && strcmp(b->name, name) == 0) return b;
+  }
+
+  breakdown *b = calloc(1, sizeof(breakdown));
+  assert(b != NULL);
+  b->name = strdup(name);
+  b->isFeed = isFeed;
+  b->next = *bucket;
+  *bucket = b;
+  if (shared.last == NULL) shared.first = b;
+  else shared.last->nextInOrder = b;
+  shared.last = b;
+  return b;
+}
+
+// Charges the time since the last switch to the current phase
+static void ChargeElapsed(void)
+{
+  long long now = MonotonicNanos();
+  if (local.since != 0) local.pending.phaseNanos[local.phase] += now - local.since;
+  local.since = now;
+}
+
+// Moves the thread's pending totals into the shared totals and its current feed and host
+static void Flush(void)
+{
+  ChargeElapsed();
+  pthread_mutex_lock(&shared.lock);
+  EnsureInitialized();
+  AddTotals(&shared.totals, &local.pending);
+  if (local.context.feed != NULL) AddTotals(&FindBreakdown(local.context.feed, true)->totals, &local.pending);
+  if (local.context.host != NULL) AddTotals(&FindBreakdown(local.context.host, false)->totals, &local.pending);
+  pthread_mutex_unlock(&shared.lock);
+  memset(&local.pending, 0, sizeof(local.pending));
+}
+
+instrumentphase InstrumentSwitchPhase(instrumentphase phase)
+{
+  instrumentphase previous = local.phase;
+  ChargeElapsed();
+  local.phase = phase;
+  return previous;
+}
+
+instrumentcontext InstrumentPushContext(const char *feed, const char *host)
+{
+  instrumentcontext saved = local.context;
+  Flush();
+  if (feed != NULL) local.context.feed = feed;
+  if (host != NULL) local.context.host = host;
+  return saved;
+}
+
+void InstrumentPopContext(instrumentcontext saved)
+{
+  Flush();
+  local.context = saved;
+}
+
+void InstrumentCount(instrumentcounter counter, long n)
+{
+  local.pending.counters[counter] += n;
+}
+
+void InstrumentSample(instrumentsample sample, long long nanos)
+{
+  pthread_mutex_lock(&shared.lock);
+  EnsureInitialized();
+  LatencyRecord(&shared.samples[sample], nanos);
+  pthread_mutex_unlock(&shared.lock);
+}
+
+bool InstrumentEnabled(void)
+{
+  return true;
+}
+
+// Writes s as a JSON string, escaping whatever JSON requires
+static void WriteString(FILE *outfile, const char *s)
+{
+  fputc('"', outfile);
+  for (const unsigned char *c = (const unsigned char *) s; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') fprintf(outfile, "\\%c", *c);
+    else if (*c < 0x20) fprintf(outfile, "\\u%04x", *c);
+    else fputc(*c, outfile);
+  }
+  fputc('"', outfile);
+}
+
+static void WriteTotals(FILE *outfile, const instrumenttotals *totals, const char *indent)
+{
+  fprintf(outfile, "%s\"phase_seconds\": {", indent);
+  for (int i = 0; i < kNumPhases; i++)
+    fprintf(outfile, "%s\"%s\": %.6f", i == 0 ? "" : ", ", kPhaseNames[i], totals->phaseNanos[i] / 1e9);
+  fprintf(outfile, "},\n%s\"counters\": {", indent);
+  for (int i = 0; i < kNumCounters; i++)
+    fprintf(outfile, "%s\"%s\": %ld", i == 0 ? "" : ", ", kCounterNames[i], totals->counters[i]);
+  fprintf(outfile, "}");
+}
+
+static void WriteBreakdowns(FILE *outfile, bool feeds)
+{
+  bool first = true;
+  fprintf(outfile, "  \"%s\": [", feeds ? "feeds" : "hosts");
+  for (breakdown *b = shared.first; b != NULL; b = b->nextInOrder) {
+    if (b->isFeed != feeds) continue;
+    fprintf(outfile, "%s\n    {\"%s\": ", first ? "" : ",", feeds ? "feed" : "host");
+    WriteString(outfile, b->name);
+    fprintf(outfile, ",\n");
+    WriteTotals(outfile, &b->totals, "     ");
+    fprintf(outfile, "}");
+    first = false;
+  }
+  fprintf(outfile, "%s]", first ? "" : "\n  ");
+}
+
+void InstrumentWriteReport(FILE *outfile)
+{
+  Flush(); // the calling thread's own time, at least, is then up to date
+  pthread_mutex_lock(&shared.lock);
+  fprintf(outfile, "{\n  \"elapsed_seconds\": %.6f,\n", (MonotonicNanos() - shared.startNanos) / 1e9);
+  WriteTotals(outfile, &shared.totals, "  ");
+  fprintf(outfile, ",\n  \"samples_us\": {");
+  for (int i = 0; i < kNumSamples; i++) {
+    latencysamples *l = &shared.samples[i];
+    fprintf(outfile, "%s\n    \"%s\": {\"count\": %d, \"p50\": %.1f, \"p95\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+	    i == 0 ? "" : ",", kSampleNames[i], l->count, LatencyPercentile(l, 50) / 1e3,
+	    LatencyPercentile(l, 95) / 1e3, LatencyPercentile(l, 99) / 1e3, LatencyPercentile(l, 100) / 1e3);
+  }
+  fprintf(outfile, "\n  },\n");
+  WriteBreakdowns(outfile, true);
+  fprintf(outfile, ",\n");
+  WriteBreakdowns(outfile, false);
+  fprintf(outfile, "\n}\n");
+  pthread_mutex_unlock(&shared.lock);
+}
+
+#else
+
+instrumentphase InstrumentSwitchPhase(instrumentphase phase) { return kPhaseOther; }
+instrumentcontext InstrumentPushContext(const char *feed, const char *host) { return (instrumentcontext) { NULL, NULL }; }
+void InstrumentPopContext(instrumentcontext saved) {}
+void InstrumentCount(instrumentcounter counter, long n) {}
+void InstrumentSample(instrumentsample sample, long long nanos) {}
+bool InstrumentEnabled(void) { return false; }
+void InstrumentWriteReport(FILE *outfile) {}
+
+#endif
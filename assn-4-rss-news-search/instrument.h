@@ -0,0 +1,130 @@
+/**
+ * File: instrument.h
+ * ------------------
+ * Defines the crawl and index instrumentation.  When the program is built
+ * with -DINSTRUMENT (make INSTRUMENT=1), the macros below time each stage
+ * of a crawl against the monotonic clock and count what flows through it;
+ * otherwise they compile away to nothing, so ordinary builds pay nothing.
+ *
+ * Timing works like a sampling-free profiler.  Every thread is always in
+ * exactly one phase, and INSTRUMENT_PHASE switches the calling thread into
+ * a new phase until the matching INSTRUMENT_RESTORE switches it back.  The
+ * time between two switches is charged to whichever phase was current, so
+ * phases nest without double counting: the time an article spends being
+ * downloaded is charged to kPhaseDownload even though the download happens
+ * in the middle of kPhaseScan.
+ *
+ * Time and counts are also attributed to the feed and host being processed,
+ * which INSTRUMENT_CONTEXT establishes, and whole operations (fetches,
+ * downloads, articles) can be recorded as samples whose percentiles appear in
+ * the report.  InstrumentWriteReport writes everything out as JSON.
+ */
+
+#ifndef __instrument_
+#define __instrument_
+
+#include <stdio.h>
+#include "bool.h"
+#include "latency.h"
+
+typedef enum {
+  kPhaseOther,          // anything not covered by the phases below
+  kPhaseDNS,            // resolving the server's name
+  kPhaseConnect,        // connecting, sending the request and waiting for the response headers
+  kPhaseDownload,       // waiting on the body of a feed or article
+  kPhaseParse,          // picking feeds apart with GetNextTag and friends
+  kPhaseScan,           // tokenizing articles in ScanArticle
+  kPhaseInsert,         // adding words to the index in ProcessWord
+  kNumPhases
+} instrumentphase;
+
+typedef enum {
+  kCounterFetches,      // connections attempted
+  kCounterFailures,     // connections that didn't produce a document
+  kCounterBytes,        // bytes of feeds and articles read
+  kCounterArticles,     // articles scanned
+  kCounterTokens,       // well-formed words scanned
+  kCounterIndexed,      // words added to the index
+  kNumCounters
+} instrumentcounter;
+
+typedef enum {
+  kSampleFetch,         // time from starting a connection to having its response headers
+  kSampleDownload,      // time spent downloading one document
+  kSampleArticle,       // time spent on one article, start to finish
+  kNumSamples
+} instrumentsample;
+
+#ifdef INSTRUMENT
+
+#define INSTRUMENT_PHASE(phase) instrumentphase instrumentSavedPhase = InstrumentSwitchPhase(phase)
+#define INSTRUMENT_RESTORE() InstrumentSwitchPhase(instrumentSavedPhase)
+#define INSTRUMENT_CONTEXT(feed, host) instrumentcontext instrumentSavedContext = InstrumentPushContext(feed, host)
+#define INSTRUMENT_CONTEXT_END() InstrumentPopContext(instrumentSavedContext)
+#define INSTRUMENT_COUNT(counter, n) InstrumentCount(counter, n)
+#define INSTRUMENT_SAMPLE(sample, nanos) InstrumentSample(sample, nanos)
+#define INSTRUMENT_CLOCK() MonotonicNanos()
+
+#else
+
+#define INSTRUMENT_PHASE(phase) do {} while (0)
+#define INSTRUMENT_RESTORE() do {} while (0)
+#define INSTRUMENT_CONTEXT(feed, host) do {} while (0)
+#define INSTRUMENT_CONTEXT_END() do {} while (0)
+#define INSTRUMENT_COUNT(counter, n) ((void) (n))
+#define INSTRUMENT_SAMPLE(sample, nanos) ((void) (nanos))
+#define INSTRUMENT_CLOCK() 0LL
+
+#endif
+
+/**
+ * Type: instrumentcontext
+ * -----------------------
+ * The feed and host that time and counts are currently charged to.  It's
+ * returned by InstrumentPushContext only so it can be handed back to
+ * InstrumentPopContext.
+ */
+
+typedef struct {
+  const char *feed;
+  const char *host;
+} instrumentcontext;
+
+/**
+ * Functions: InstrumentSwitchPhase, InstrumentPushContext, InstrumentPopContext,
+ *            InstrumentCount, InstrumentSample
+ * ------------------------------------------------------------------------------
+ * The functions behind the macros above, which are the intended interface.
+ * In uninstrumented builds they do nothing.  InstrumentSwitchPhase returns
+ * the phase being left, and InstrumentPushContext the context being replaced;
+ * NULL for either name leaves that part of the context unchanged.
+ */
+
+instrumentphase InstrumentSwitchPhase(instrumentphase phase);
+instrumentcontext InstrumentPushContext(const char *feed, const char *host);
+void InstrumentPopContext(instrumentcontext saved);
+void InstrumentCount(instrumentcounter counter, long n);
+void InstrumentSample(instrumentsample sample, long long nanos);
+
+/**
+ * Function: InstrumentEnabled
+ * ---------------------------
+ * Returns true if and only if this is an instrumented build.
+ */
+
+bool InstrumentEnabled(void);
+
+/**
+ * Function: InstrumentWriteReport
+ * -------------------------------
+ * Writes everything gathered so far to outfile as a JSON object with the
+ * wall time since the first instrumented event, the seconds spent in each phase, the
+ * counters, the percentiles of each kind of sample (in microseconds), and the
+ * same phase and counter breakdown for each feed and each host.  Time that
+ * other threads are still accumulating is included only up to their last
+ * change of phase or context.  Does nothing in uninstrumented builds.
+ */
+
+void InstrumentWriteReport(FILE *outfile);
+
+#endif
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+#include "latency.h"
+
+long long MonotonicNanos(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void LatencyNew(latencysamples *l)
+{
+  l->samples = NULL;
+  l->count = l->allocated = 0;
+  l->sorted = 1;
+}
+
+void LatencyDispose(latencysamples *l)
+{
+  free(l->samples);
+}
+
+void LatencyRecord(latencysamples *l, long long nanos)
+{
+  if (l->count == l->allocated) {
+    l->allocated = l->allocated == 0 ? 256 : 2 * l->allocated;
+    l->samples = realloc(l->samples, l->allocated * sizeof(long long));
+    assert(l->samples != NULL);
+  }
+  l->samples[l->count++] = nanos;
+  l->sorted = 0;
+}
+
+void LatencyMerge(latencysamples *dst, const latencysamples *src)
+{
+  for (int i = 0; i < src->count; i++) LatencyRecord(dst, src->samples[i]);
+}
+
+static int CompareSamples(const void *elemAddr1, const void *elemAddr2)
+{
+  long long s1 = *(const long long *) elemAddr1;
+  long long s2 = *(const long long *) elemAddr2;
+  return (s1 > s2) - (s1 < s2);
+}
+
+long long LatencyPercentile(latencysamples *l, double percentile)
+{
+  if (l->count == 0) return 0;
+  if (!l->sorted) {
+    qsort(l->samples, l->count, sizeof(long long), CompareSamples);
+    l->sorted = 1;
+  }
+
+  int rank = (int) ceil(percentile / 100.0 * l->count);
+  if (rank < 1) rank = 1;
+  if (rank > l->count) rank = l->count;
+  return l->samples[rank - 1];
+}
+
+void LatencyReport(latencysamples *l, FILE *outfile, const char *label, long long elapsedNanos)
+{
+  double seconds = elapsedNanos / 1e9;
+  fprintf(outfile, "%s: %d operations in %.3f s (%.1f/sec); latency p50 %.1f us, p95 %.1f us, p99 %.1f us, max %.1f us\n",
+	  label, l->count, seconds, seconds > 0 ? l->count / seconds : 0.0,
+	  LatencyPercentile(l, 50) / 1e3, LatencyPercentile(l, 95) / 1e3,
+	  LatencyPercentile(l, 99) / 1e3, LatencyPercentile(l, 100) / 1e3);
+}
@@ -0,0 +1,90 @@
+/**
+ * File: latency.h
+ * ---------------
+ * Defines a small facility for timing operations against the monotonic
+ * clock and summarizing the collected samples as throughput and latency
+ * percentiles.  It's what batch query mode and the load generator use to
+ * report query performance, so the two report numbers the same way.
+ */
+
+#ifndef __latency_
+#define __latency_
+
+#include <stdio.h>
+
+/**
+ * Function: MonotonicNanos
+ * ------------------------
+ * Returns the current reading of the monotonic clock, in nanoseconds.
+ * Only differences between two readings are meaningful.
+ */
+
+long long MonotonicNanos(void);
+
+/**
+ * Type: latencysamples
+ * --------------------
+ * A growable collection of latency samples, each measured in nanoseconds.
+ * Clients should interact with it only via the functions below.
+ */
+
+typedef struct {
+  long long *samples;
+  int count;
+  int allocated;
+  int sorted;      // nonzero if samples are known to be in increasing order
+} latencysamples;
+
+/**
+ * Function: LatencyNew
+ * --------------------
+ * Initializes the specified collection to be empty.
+ */
+
+void LatencyNew(latencysamples *l);
+
+/**
+ * Function: LatencyDispose
+ * ------------------------
+ * Releases the memory held by the collection.
+ */
+
+void LatencyDispose(latencysamples *l);
+
+/**
+ * Function: LatencyRecord
+ * -----------------------
+ * Adds one sample, expressed in nanoseconds, to the collection.
+ */
+
+void LatencyRecord(latencysamples *l, long long nanos);
+
+/**
+ * Function: LatencyMerge
+ * ----------------------
+ * Appends all of the samples in src to dst.  src is left unchanged.
+ */
+
+void LatencyMerge(latencysamples *dst, const latencysamples *src);
+
+/**
+ * Function: LatencyPercentile
+ * ---------------------------
+ * Returns the sample at the specified percentile (a number in [0, 100]),
+ * using the nearest-rank method, or 0 if the collection is empty.
+ */
+
+long long LatencyPercentile(latencysamples *l, double percentile);
+
+/**
+ * Function: LatencyReport
+ * -----------------------
+ * Prints a one-line summary of the collection to outfile: the number of
+ * operations, the throughput they represent given that they completed in
+ * elapsedNanos of wall-clock time, and the p50, p95, p99 and maximum
+ * latencies in microseconds.
+ */
+
+void LatencyReport(latencysamples *l, FILE *outfile, const char *label, long long elapsedNanos);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "minhash.h"
+#include "wordhash.h"
+
+static const int kBinShift = 58;                 // 64 - log2(kMinHashValues)
+static const int kBandRows = kMinHashValues / kMinHashBands;
+static const int kInitialSlots = 1024;
+static const int kInitialEntries = 256;
+
+// splitmix64's finalizer, which spreads every input bit over all 64 output bits
+static inline unsigned long long Mix(unsigned long long x)
+{
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+void MinHashBuilderNew(minhashbuilder *b)
+{
+  memset(b->filled, false, sizeof(b->filled));
+  b->previous = 0;
+  b->numWords = 0;
+}
+
+void MinHashBuilderAddWord(minhashbuilder *b, const char *word)
+{
+  unsigned long long hashcode = WordHash(word);
+  if (b->numWords++ > 0) {
+    unsigned long long shingle = Mix(b->previous * 0x9E3779B97F4A7C15ULL + hashcode);
+    int bin = shingle >> kBinShift;
+    unsigned value = (unsigned) shingle;
+    if (!b->filled[bin] || value < b->values[bin]) {
+      b->values[bin] = value;
+      b->filled[bin] = true;
+    }
+  }
+  b->previous = hashcode;
+}
+
+bool MinHashBuilderFinish(minhashbuilder *b, minhashsignature *signature, int minWords)
+{
+  if (b->numWords < minWords || b->numWords < 2) return false;
+  // each empty bin borrows from the nearest filled bin to its right (wrapping around), and
+  // the distance borrowed over is mixed in, so that two borrowing bins don't agree just
+  // because they borrowed from the same place
+  for (int bin = 0; bin < kMinHashValues; bin++) {
+    int from = bin, distance = 0;
+    while (!b->filled[from]) {
+      from = (from + 1) % kMinHashValues;
+      distance++;
+    }
+    signature->values[bin] = distance == 0 ? b->values[bin] :
+      (unsigned short) Mix(b->values[from] + distance * 0x9E3779B97F4A7C15ULL);
+  }
+  return true;
+}
+
+double MinHashSimilarity(const minhashsignature *s1, const minhashsignature *s2)
+{
+  int agree = 0;
+  for (int bin = 0; bin < kMinHashValues; bin++) agree += s1->values[bin] == s2->values[bin];
+  return (double) agree / kMinHashValues;
+}
+
+// The table key for one band of a signature: the band's values and its position, hashed.  Keys
+// of different bands can collide, but that only costs a comparison of the signatures.
+static unsigned BandKey(const minhashsignature *signature, int band)
+{
+  unsigned long long rows = 0;  // the band's four 16-bit values, packed
+  for (int row = 0; row < kBandRows; row++) rows = rows << 16 | signature->values[band * kBandRows + row];
+  return Mix(rows + band * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+void MinHashIndexNew(minhashindex *mi, double threshold)
+{
+  assert(threshold > 0 && threshold <= 1);
+  mi->threshold = threshold;
+  mi->numEntries = 0;
+  mi->allocatedEntries = kInitialEntries;
+  mi->signatures = malloc(mi->allocatedEntries * sizeof(minhashsignature));
+  mi->ids = malloc(mi->allocatedEntries * sizeof(int));
+  mi->numSlots = kInitialSlots;
+  mi->slots = malloc(mi->numSlots * sizeof(struct bandslot));
+  assert(mi->signatures != NULL && mi->ids != NULL && mi->slots != NULL);
+  for (int i = 0; i < mi->numSlots; i++) mi->slots[i].entry = -1;
+}
+
+void MinHashIndexDispose(minhashindex *mi)
+{
+  free(mi->signatures);
+  free(mi->ids);
+  free(mi->slots);
+}
+
+int MinHashIndexFind(const minhashindex *mi, const minhashsignature *signature)
+{
+  int best = -1;
+  double bestSimilarity = 0;
+  for (int band = 0; band < kMinHashBands; band++) {
+    unsigned key = BandKey(signature, band);
+    for (int slot = key & (mi->numSlots - 1); mi->slots[slot].entry != -1; slot = (slot + 1) & (mi->numSlots - 1)) {
+      if (mi->slots[slot].key != key) continue;
+      int entry = mi->slots[slot].entry;
+      double similarity = MinHashSimilarity(signature, &mi->signatures[entry]);
+      if (similarity >= mi->threshold && (best == -1 || similarity > bestSimilarity)) {
+	best = entry;
+	bestSimilarity = similarity;
+      }
+    }
+  }
+  return best == -1 ? -1 : mi->ids[best];
+}
+
+static void InsertSlot(minhashindex *mi, unsigned key, int entry)
+{
+  int slot = key & (mi->numSlots - 1);
+  while (mi->slots[slot].entry != -1) slot = (slot + 1) & (mi->numSlots - 1);
+  mi->slots[slot].key = key;
+  mi->slots[slot].entry = entry;
+}
+
+// Doubles the band table, reinserting every slot in use
+static void GrowSlots(minhashindex *mi)
+{
+  struct bandslot *old = mi->slots;
+  int oldSlots = mi->numSlots;
+  mi->numSlots *= 2;
+  mi->slots = malloc(mi->numSlots * sizeof(struct bandslot));
+  assert(mi->slots != NULL);
+  for (int i = 0; i < mi->numSlots; i++) mi->slots[i].entry = -1;
+  for (int i = 0; i < oldSlots; i++)
+    if (old[i].entry != -1) InsertSlot(mi, old[i].key, old[i].entry);
+  free(old);
+}
+
+void MinHashIndexAdd(minhashindex *mi, const minhashsignature *signature, int id)
+{
+  if (mi->numEntries == mi->allocatedEntries) {
+    mi->allocatedEntries *= 2;
+    mi->signatures = realloc(mi->signatures, mi->allocatedEntries * sizeof(minhashsignature));
+    mi->ids = realloc(mi->ids, mi->allocatedEntries * sizeof(int));
+    assert(mi->signatures != NULL && mi->ids != NULL);
+  }
+  int entry = mi->numEntries++;
+  mi->signatures[entry] = *signature;
+  mi->ids[entry] = id;
+  while ((long) mi->numEntries * kMinHashBands * 2 > mi->numSlots) GrowSlots(mi);
+  for (int band = 0; band < kMinHashBands; band++) InsertSlot(mi, BandKey(signature, band), entry);
+}
+
+void MinHashIndexPrune(minhashindex *mi, MinHashIndexKeepFunction keep, void *auxData)
+{
+  int kept = 0;
+  for (int entry = 0; entry < mi->numEntries; entry++) {
+    if (!keep(mi->ids[entry], auxData)) continue;
+    mi->signatures[kept] = mi->signatures[entry];
+    mi->ids[kept++] = mi->ids[entry];
+  }
+  mi->numEntries = kept;
+  while (mi->allocatedEntries > kInitialEntries && mi->allocatedEntries / 2 >= kept) mi->allocatedEntries /= 2;
+  mi->signatures = realloc(mi->signatures, mi->allocatedEntries * sizeof(minhashsignature));
+  mi->ids = realloc(mi->ids, mi->allocatedEntries * sizeof(int));
+  assert(mi->signatures != NULL && mi->ids != NULL);
+
+  // the band table is rebuilt from scratch, at the size MinHashIndexAdd would have grown it to
+  free(mi->slots);
+  mi->numSlots = kInitialSlots;
+  while ((long) kept * kMinHashBands * 2 > mi->numSlots) mi->numSlots *= 2;
+  mi->slots = malloc(mi->numSlots * sizeof(struct bandslot));
+  assert(mi->slots != NULL);
+  for (int i = 0; i < mi->numSlots; i++) mi->slots[i].entry = -1;
+  for (int entry = 0; entry < kept; entry++)
+    for (int band = 0; band < kMinHashBands; band++) InsertSlot(mi, BandKey(&mi->signatures[entry], band), entry);
+}
+
+long MinHashIndexBytes(const minhashindex *mi)
+{
+  return (long) mi->allocatedEntries * (sizeof(minhashsignature) + sizeof(int)) +
+    (long) mi->numSlots * sizeof(struct bandslot);
+}
@@ -0,0 +1,182 @@
+/**
+ * File: minhash.h
+ * ---------------
+ * Defines MinHash signatures, compact fingerprints of a document's text
+ * that estimate how much two documents overlap, and the minhashindex,
+ * which finds the indexed document most like a new one without
+ * comparing the new one against every document indexed so far.
+ *
+ * A document is reduced to its shingles, the pairs of adjacent words in
+ * it, and two documents are as similar as the Jaccard similarity of their
+ * shingle sets: the shingles they share over the shingles either has.
+ * Replacing a word changes only the two shingles it belongs to, so the
+ * same story reprinted under a different byline or with a line of
+ * boilerplate added still shares nearly all of its shingles.
+ *
+ * The signature is a one-permutation MinHash: each shingle is hashed
+ * once, the hash's top bits pick one of kMinHashValues bins, and each
+ * bin keeps the smallest hash it sees.  Two documents agree on any given
+ * bin with probability equal to their similarity, so the fraction of
+ * bins they agree on estimates it.  That takes one hash per word, where
+ * the classic form takes one per bin.  Bins that no shingle lands in are
+ * filled from their nearest non-empty neighbor ("densification"), so
+ * short documents still get complete signatures.
+ *
+ * The index uses locality-sensitive hashing: signatures are cut into
+ * kMinHashBands bands of consecutive bins, and only documents that agree
+ * on every bin of at least one band are compared in full.  Two documents
+ * of similarity s become candidates with probability 1 - (1 - s^4)^16,
+ * which is about 99% at s = 0.7 and under 3% at s = 0.2.
+ */
+
+#ifndef __minhash_
+#define __minhash_
+
+#include "bool.h"
+
+/**
+ * Constants: kMinHashValues, kMinHashBands
+ * ----------------------------------------
+ * The number of bins in a signature, and the number of bands they're
+ * grouped into for the index.
+ */
+
+#define kMinHashValues 64
+#define kMinHashBands 16
+
+/**
+ * Type: minhashsignature
+ * ----------------------
+ * A finished signature: the low 16 bits of the smallest shingle hash in
+ * each bin.  Unrelated bins then agree by chance one time in 65536, which
+ * inflates estimated similarities by a negligible amount and halves the
+ * size of every signature kept.
+ */
+
+typedef struct {
+  unsigned short values[kMinHashValues];
+} minhashsignature;
+
+/**
+ * Type: minhashbuilder
+ * --------------------
+ * Accumulates a signature one word at a time, as a document is scanned.
+ */
+
+typedef struct {
+  unsigned int values[kMinHashValues];
+  bool filled[kMinHashValues];
+  unsigned long long previous;  // hash of the last word added, for the next shingle
+  int numWords;
+} minhashbuilder;
+
+/**
+ * Function: MinHashBuilderNew
+ * ---------------------------
+ * Initializes the builder for a new, empty document.
+ */
+
+void MinHashBuilderNew(minhashbuilder *b);
+
+/**
+ * Function: MinHashBuilderAddWord
+ * -------------------------------
+ * Adds the next word of the document.  Words are compared case-insensitively.
+ */
+
+void MinHashBuilderAddWord(minhashbuilder *b, const char *word);
+
+/**
+ * Function: MinHashBuilderFinish
+ * ------------------------------
+ * Completes the signature of the words added so far and copies it into
+ * signature, returning true.  Documents of fewer than minWords words say
+ * too little to be judged, and for those false is returned instead.
+ */
+
+bool MinHashBuilderFinish(minhashbuilder *b, minhashsignature *signature, int minWords);
+
+/**
+ * Function: MinHashSimilarity
+ * ---------------------------
+ * Returns the estimated similarity of the documents with the two signatures,
+ * between 0 and 1.
+ */
+
+double MinHashSimilarity(const minhashsignature *s1, const minhashsignature *s2);
+
+/**
+ * Type: minhashindex
+ * ------------------
+ * The concrete representation of the index.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  minhashsignature *signatures;  // signatures[i] is the signature of the ith document added
+  int *ids;                      // and ids[i] its client-supplied id
+  int numEntries, allocatedEntries;
+  struct bandslot {
+    unsigned int key;            // hash of one band of a signature, and of the band's position
+    int entry;                   // index into signatures, or -1 for an empty slot
+  } *slots;                      // open addressing with linear probing, at most half full
+  int numSlots;
+  double threshold;
+} minhashindex;
+
+/**
+ * Function: MinHashIndexNew
+ * -------------------------
+ * Initializes the index to be empty.  Documents count as near-duplicates when
+ * their estimated similarity is at least threshold.
+ */
+
+void MinHashIndexNew(minhashindex *mi, double threshold);
+
+/**
+ * Function: MinHashIndexDispose
+ * -----------------------------
+ * Frees the index's signatures and band table.
+ */
+
+void MinHashIndexDispose(minhashindex *mi);
+
+/**
+ * Function: MinHashIndexFind
+ * --------------------------
+ * Returns the id of the indexed document most similar to the one with the
+ * specified signature, provided it's a near-duplicate, or -1 if no indexed
+ * document is.  The index isn't modified, so any number of threads may
+ * search it at once.
+ */
+
+int MinHashIndexFind(const minhashindex *mi, const minhashsignature *signature);
+
+/**
+ * Function: MinHashIndexAdd
+ * -------------------------
+ * Adds the document with the specified signature and id to the index.
+ */
+
+void MinHashIndexAdd(minhashindex *mi, const minhashsignature *signature, int id);
+
+/**
+ * Function: MinHashIndexPrune
+ * ---------------------------
+ * Drops every document whose id keep returns false for (keep being passed
+ * the id and the client's auxData), and shrinks the signatures and band
+ * table to what the documents kept need.
+ */
+
+typedef bool (*MinHashIndexKeepFunction)(int id, void *auxData);
+void MinHashIndexPrune(minhashindex *mi, MinHashIndexKeepFunction keep, void *auxData);
+
+/**
+ * Function: MinHashIndexBytes
+ * ---------------------------
+ * Returns the number of bytes the index's signatures and band table occupy.
+ */
+
+long MinHashIndexBytes(const minhashindex *mi);
+
+#endif
@@ -0,0 +1,753 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <unistd.h>
+#include "newsindex.h"
+#include "hashsets-functions.h"
+#include "latency.h"
+#include "wordhash.h"
+
+static const int kNumBuckets = 1009;
+static const int kMinFilterCapacity = 1024;
+static const int kSecondsPerDay = 24 * 60 * 60;
+static unsigned long lastVersion = 0; // most recent version handed out to any index
+static int lastRun = 0;               // most recent run number handed out to any index, for file names
+
+static newssegment *NewSegment(int day)
+{
+  newssegment *segment = malloc(sizeof(newssegment));
+  assert(segment != NULL);
+  segment->day = day;
+  HashSetNew(&segment->words, sizeof(struct wordArticles *), kNumBuckets, IndexHash, IndexCmp, FreeIndex);
+  HashSetNew(&segment->seenArticles, sizeof(struct article *), kNumBuckets, ArticleHash, ArticleCmp, FreeArticle);
+  segment->wordBytes = 0;
+  return segment;
+}
+
+static void FreeSegment(void *elemAddr)
+{
+  newssegment *segment = *(newssegment **) elemAddr;
+  HashSetDispose(&segment->words);
+  HashSetDispose(&segment->seenArticles);
+  free(segment);
+}
+
+static newssegment *Segment(const newsindex *index, int segment)
+{
+  return *(newssegment **) VectorNth(&index->segments, segment);
+}
+
+void NewsIndexNew(newsindex *index)
+{
+  VectorNew(&index->segments, sizeof(newssegment *), FreeSegment, 0);
+  index->current = NewSegment(-1);
+  VectorAppend(&index->segments, &index->current);
+  index->retentionDays = 0;
+  index->newestDay = -1;
+  index->numExpired = index->numTooOld = 0;
+  VectorNew(&index->articles, sizeof(struct article *), NULL, 0); // the segments own the articles
+  index->firstArticleID = 0;
+  index->version = ++lastVersion;
+  index->filter = NULL;
+  index->signatures = NULL;
+  index->numFolded = 0;
+  index->wordBytes = 0;
+  index->spill = NULL;
+  index->shard = index->numShards = 0;
+  index->dictionary = NULL;
+  index->trigrams = NULL;
+  FacetNew(&index->servers);
+  FacetNew(&index->feeds);
+  TermStatsNew(&index->stats);
+}
+
+void NewsIndexDispose(newsindex *index)
+{
+  if (index->filter != NULL) {
+    BloomFilterDispose(index->filter);
+    free(index->filter);
+  }
+  if (index->signatures != NULL) {
+    MinHashIndexDispose(index->signatures);
+    free(index->signatures);
+  }
+  if (index->spill != NULL) {
+    for (int i = 0; i < VectorLength(&index->spill->runs); i++) unlink(*(char **) VectorNth(&index->spill->runs, i));
+    VectorDispose(&index->spill->runs);
+    free(index->spill->directory);
+    free(index->spill);
+  }
+  NewsIndexSetDictionary(index, NULL, NULL);
+  FacetDispose(&index->servers);
+  FacetDispose(&index->feeds);
+  TermStatsDispose(&index->stats);
+  VectorDispose(&index->articles);
+  VectorDispose(&index->segments);
+}
+
+// Empties the word index of an index that isn't divided by day
+static void ClearWords(newsindex *index)
+{
+  newssegment *whole = Segment(index, 0);
+  HashSetDispose(&whole->words);
+  HashSetNew(&whole->words, sizeof(struct wordArticles *), kNumBuckets, IndexHash, IndexCmp, FreeIndex);
+  whole->wordBytes = index->wordBytes = 0;
+}
+
+// Empties the article table of an index that isn't divided by day
+static void ClearArticles(newsindex *index)
+{
+  newssegment *whole = Segment(index, 0);
+  VectorDispose(&index->articles);
+  HashSetDispose(&whole->seenArticles);
+  HashSetNew(&whole->seenArticles, sizeof(struct article *), kNumBuckets, ArticleHash, ArticleCmp, FreeArticle);
+  VectorNew(&index->articles, sizeof(struct article *), NULL, 0);
+  index->numFolded = 0;
+  FacetDispose(&index->servers);
+  FacetDispose(&index->feeds);
+  FacetNew(&index->servers);
+  FacetNew(&index->feeds);
+}
+
+// Files the article under its server and its feed
+static void AddToFacets(newsindex *index, const struct article *art)
+{
+  FacetAdd(&index->servers, art->server, art->id);
+  if (art->feed[0] != '\0') FacetAdd(&index->feeds, art->feed, art->id);
+}
+
+void NewsIndexDivideByDay(newsindex *index, int retentionDays)
+{
+  assert(retentionDays > 0 && VectorLength(&index->articles) == 0 && index->spill == NULL);
+  VectorDispose(&index->segments);
+  VectorNew(&index->segments, sizeof(newssegment *), FreeSegment, 0);
+  index->current = NULL;
+  index->retentionDays = retentionDays;
+}
+
+static void ForgetArticle(void *elemAddr, void *auxData)
+{
+  newsindex *index = auxData;
+  struct article *art = *(struct article **) elemAddr;
+  struct article *expired = NULL;
+  VectorReplace(&index->articles, &expired, art->id - index->firstArticleID);
+}
+
+static bool IsKept(int docID, void *auxData)
+{
+  return NewsIndexArticle(auxData, docID) != NULL;
+}
+
+// Drops the slots at the front of the article table once their articles are all gone.  An
+// article is kept only while its day is, so the slots left span the ids handed out over
+// about the days kept, and the table stops growing once the crawl's been going that long.
+static void TrimArticleTable(newsindex *index)
+{
+  int dropped = 0;
+  while (dropped < VectorLength(&index->articles) && *(struct article **) VectorNth(&index->articles, dropped) == NULL)
+    dropped++;
+  if (dropped == 0) return;
+  vector kept;
+  VectorNew(&kept, sizeof(struct article *), NULL, VectorLength(&index->articles) - dropped);
+  for (int i = dropped; i < VectorLength(&index->articles); i++) VectorAppend(&kept, VectorNth(&index->articles, i));
+  VectorDispose(&index->articles);
+  index->articles = kept;
+  index->firstArticleID += dropped;
+}
+
+// Files the articles kept afresh under their sources, so the facets let go of those dropped
+static void RebuildFacets(newsindex *index)
+{
+  FacetDispose(&index->servers);
+  FacetDispose(&index->feeds);
+  FacetNew(&index->servers);
+  FacetNew(&index->feeds);
+  for (int i = 0; i < VectorLength(&index->articles); i++) {
+    const struct article *art = *(struct article **) VectorNth(&index->articles, i);
+    if (art != NULL) AddToFacets(index, art);
+  }
+  NewsIndexOptimizeFacets(index);
+}
+
+// Drops every segment of a day no longer kept.  They're the oldest, and so the last in the
+// list.  The segments kept aren't touched; only what the index holds about the articles of
+// the segments dropped, outside of them, goes with them: their slots in the article table,
+// their signatures and their places in the facets.
+static void ExpireSegments(newsindex *index)
+{
+  int oldestKept = index->newestDay - index->retentionDays + 1, expired = 0;
+  while (VectorLength(&index->segments) > 0) {
+    int last = VectorLength(&index->segments) - 1;
+    newssegment *segment = Segment(index, last);
+    if (segment->day >= oldestKept) break;
+    HashSetMap(&segment->seenArticles, ForgetArticle, index);
+    expired += HashSetCount(&segment->seenArticles);
+    index->wordBytes -= segment->wordBytes;
+    if (segment == index->current) index->current = NULL;
+    VectorDelete(&index->segments, last);
+  }
+  if (expired == 0) return;
+  index->numExpired += expired;
+  if (index->signatures != NULL) MinHashIndexPrune(index->signatures, IsKept, index);
+  RebuildFacets(index);
+  TrimArticleTable(index);
+  // the filter still holds the words dropped, which costs only false positives, until
+  // it next fills up and is rebuilt from the words kept
+}
+
+// Returns the segment of the specified day, adding it if there isn't one yet, or NULL if
+// the day is too long ago to be kept
+static newssegment *SegmentForDay(newsindex *index, int day)
+{
+  if (day > index->newestDay) {
+    index->newestDay = day;
+    ExpireSegments(index);
+  }
+  if (day <= index->newestDay - index->retentionDays) return NULL;
+  int position = 0;
+  for (; position < VectorLength(&index->segments); position++) {
+    newssegment *segment = Segment(index, position);
+    if (segment->day == day) return segment;
+    if (segment->day < day) break;
+  }
+  newssegment *segment = NewSegment(day);
+  VectorInsert(&index->segments, &segment, position);
+  return segment;
+}
+
+static bool AlreadySeen(const newsindex *index, struct article *key)
+{
+  for (int i = 0; i < VectorLength(&index->segments); i++)
+    if (HashSetLookup(&Segment(index, i)->seenArticles, &key) != NULL) return true;
+  return false;
+}
+
+static void SpillWords(newsindex *index);
+
+int NewsIndexAddArticle(newsindex *index, const char *title, const char *URL, const char *server, const char *feed,
+			time_t published)
+{
+  struct article key = { (char *) title, (char *) URL, (char *) server };
+  if (AlreadySeen(index, &key)) return -1;
+  newssegment *segment;
+  if (index->retentionDays == 0) segment = Segment(index, 0);
+  else {
+    time_t now = time(NULL);
+    if (published < 0 || published > now) published = now;
+    if ((segment = SegmentForDay(index, published / kSecondsPerDay)) == NULL) {
+      index->numTooOld++;
+      return -1;
+    }
+  }
+  if (index->spill != NULL && index->wordBytes > index->spill->budget) SpillWords(index);
+
+  struct article *art = malloc(sizeof(struct article));
+  art->title = strdup(title);
+  art->URL = strdup(URL);
+  art->server = strdup(server);
+  art->feed = strdup(feed);
+  index->version = ++lastVersion;
+  art->id = index->firstArticleID + VectorLength(&index->articles);
+  art->duplicateOf = -1;
+  AddToFacets(index, art);
+  HashSetEnter(&segment->seenArticles, &art);
+  VectorAppend(&index->articles, &art);
+  index->current = segment;
+  return art->id;
+}
+
+// 64-bit FNV-1a hash of the lowercased word, so words that differ only in case hash alike,
+// as they do in the word index
+static unsigned long long FilterHash(const char *word)
+{
+  unsigned long long hashcode = WordHash(word);
+  return hashcode ^ (hashcode >> 29);  // FNV's top bits are weakly mixed, and they pick the filter block
+}
+
+static void AddToFilter(void *elemAddr, void *auxData)
+{
+  struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
+  BloomFilterAdd(auxData, FilterHash(wordArt->word));
+}
+
+// (Re)builds the filter with room for twice the current number of words
+static void RebuildFilter(newsindex *index)
+{
+  int capacity = 2 * NewsIndexWordCount(index);
+  if (capacity < kMinFilterCapacity) capacity = kMinFilterCapacity;
+  if (index->filter != NULL) BloomFilterDispose(index->filter);
+  else index->filter = malloc(sizeof(bloomfilter));
+  BloomFilterNew(index->filter, capacity, index->filterBitsPerWord);
+  NewsIndexMapWords(index, AddToFilter, index->filter);
+}
+
+void NewsIndexUseFilter(newsindex *index, int bitsPerWord)
+{
+  index->filterBitsPerWord = bitsPerWord;
+  RebuildFilter(index);
+}
+
+void NewsIndexDetectNearDuplicates(newsindex *index, double threshold)
+{
+  index->signatures = malloc(sizeof(minhashindex));
+  MinHashIndexNew(index->signatures, threshold);
+}
+
+int NewsIndexFindNearDuplicate(const newsindex *index, const minhashsignature *signature)
+{
+  int originalID = index->signatures == NULL ? -1 : MinHashIndexFind(index->signatures, signature);
+  return originalID == -1 || NewsIndexArticle(index, originalID) == NULL ? -1 : originalID;
+}
+
+void NewsIndexAddSignature(newsindex *index, int docID, const minhashsignature *signature)
+{
+  if (index->signatures != NULL) MinHashIndexAdd(index->signatures, signature, docID);
+}
+
+void NewsIndexFoldArticle(newsindex *index, int docID, int originalID)
+{
+  struct article *art = *(struct article **) VectorNth(&index->articles, docID - index->firstArticleID);
+  art->duplicateOf = originalID;
+  index->numFolded++;
+  index->version = ++lastVersion;
+}
+
+// Looks a word up without allocating, since IndexHash and IndexCmp only look at the word
+static struct wordArticles *LookupWord(newssegment *segment, const char *word)
+{
+  struct wordArticles key;
+  struct wordArticles *keyp = &key;
+  key.word = (char *) word;
+  void *found = HashSetLookup(&segment->words, &keyp);
+  return found == NULL ? NULL : *(struct wordArticles **) found;
+}
+
+void NewsIndexSetPartition(newsindex *index, int shard, int numShards)
+{
+  assert(numShards > 0 && shard >= -1 && shard < numShards);
+  index->shard = shard;
+  index->numShards = numShards;
+}
+
+int NewsIndexWordShard(const char *word, int numShards)
+{
+  // the filter's hash, remixed, since its top and bottom bits already pick filter blocks and bits
+  unsigned long long mixed = FilterHash(word) * 0x9E3779B97F4A7C15ULL;
+  return ((mixed >> 32) * numShards) >> 32;
+}
+
+// Returns whether the index is a shard that doesn't hold the word
+static bool OutsidePartition(const newsindex *index, const char *word)
+{
+  return index->numShards > 0 && (index->shard == -1 || NewsIndexWordShard(word, index->numShards) != index->shard);
+}
+
+void NewsIndexAddWord(newsindex *index, const char *word, int docID)
+{
+  unsigned long long hashcode = 0;
+  struct wordArticles *wordArt = NULL;
+  newssegment *segment = index->current;
+  if (OutsidePartition(index, word)) return;
+  if (index->filter == NULL) wordArt = LookupWord(segment, word);
+  else {
+    hashcode = FilterHash(word);
+    if (BloomFilterMayContain(index->filter, hashcode)) wordArt = LookupWord(segment, word);
+  }
+  if (wordArt == NULL) { // word seen first time
+    long bytes = sizeof(struct wordArticles) + sizeof(struct wordArticles *) + strlen(word) + 1;
+    wordArt = malloc(sizeof(struct wordArticles));
+    wordArt->word = strdup(word);
+    PostingsNew(&wordArt->articles);
+    HashSetEnter(&segment->words, &wordArt);
+    segment->wordBytes += bytes;
+    index->wordBytes += bytes;
+    if (index->filter != NULL) {
+      if (index->filter->numElems < index->filter->capacity) BloomFilterAdd(index->filter, hashcode);
+      else RebuildFilter(index);
+    }
+  }
+
+  int bytes = PostingsBytes(&wordArt->articles);
+  PostingsAdd(&wordArt->articles, docID);
+  segment->wordBytes += PostingsBytes(&wordArt->articles) - bytes;
+  index->wordBytes += PostingsBytes(&wordArt->articles) - bytes;
+  index->version = ++lastVersion;
+}
+
+int NewsIndexSegmentCount(const newsindex *index)
+{
+  return VectorLength(&index->segments);
+}
+
+int NewsIndexSegmentDay(const newsindex *index, int segment)
+{
+  return Segment(index, segment)->day;
+}
+
+const postings *NewsIndexLookup(newsindex *index, int segment, const char *word)
+{
+  if (!NewsIndexMayContain(index, word)) return NULL;
+  struct wordArticles *wordArt = LookupWord(Segment(index, segment), word);
+  return wordArt == NULL ? NULL : &wordArt->articles;
+}
+
+void NewsIndexMapWords(const newsindex *index, HashSetMapFunction mapfn, void *auxData)
+{
+  for (int i = 0; i < VectorLength(&index->segments); i++) HashSetMap(&Segment(index, i)->words, mapfn, auxData);
+}
+
+int NewsIndexWordCount(const newsindex *index)
+{
+  int count = 0;
+  for (int i = 0; i < VectorLength(&index->segments); i++) count += HashSetCount(&Segment(index, i)->words);
+  return count;
+}
+
+// What NewsIndexBuildDictionary collects: every word, lowercased, and its document frequency
+struct termcount {
+  char *term;
+  int frequency;
+};
+
+static void CollectTerm(void *elemAddr, void *auxData)
+{
+  struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
+  struct termcount count = { strdup(wordArt->word), PostingsLength(&wordArt->articles) };
+  for (char *c = count.term; *c != '\0'; c++) *c = tolower((unsigned char) *c);
+  VectorAppend(auxData, &count);
+}
+
+static int CompareTerms(const void *elemAddr1, const void *elemAddr2)
+{
+  return strcmp(((const struct termcount *) elemAddr1)->term, ((const struct termcount *) elemAddr2)->term);
+}
+
+termdictionary *NewsIndexBuildDictionary(const newsindex *index)
+{
+  vector counts;
+  VectorNew(&counts, sizeof(struct termcount), NULL, NewsIndexWordCount(index) + 1);
+  NewsIndexMapWords(index, CollectTerm, &counts);
+  VectorSort(&counts, CompareTerms);
+
+  // a word in several segments is one word of the dictionary, in the articles of all of them
+  int n = 0, length = VectorLength(&counts);
+  char **terms = malloc((length + 1) * sizeof(char *));
+  int *frequencies = malloc((length + 1) * sizeof(int));
+  assert(terms != NULL && frequencies != NULL);
+  for (int i = 0; i < length; i++) {
+    struct termcount *count = VectorNth(&counts, i);
+    if (n > 0 && strcmp(terms[n - 1], count->term) == 0) {
+      frequencies[n - 1] += count->frequency;
+      free(count->term);
+    } else {
+      terms[n] = count->term;
+      frequencies[n++] = count->frequency;
+    }
+  }
+  termdictionary *dictionary = malloc(sizeof(termdictionary));
+  assert(dictionary != NULL);
+  TermDictionaryNew(dictionary, terms, frequencies, n);
+  for (int i = 0; i < n; i++) free(terms[i]);
+  free(terms);
+  free(frequencies);
+  VectorDispose(&counts);
+  return dictionary;
+}
+
+void NewsIndexSetDictionary(newsindex *index, termdictionary *dictionary, trigramindex *trigrams)
+{
+  if (index->trigrams != NULL) {
+    TrigramIndexDispose(index->trigrams);
+    free(index->trigrams);
+  }
+  index->trigrams = trigrams;
+  if (index->dictionary != NULL) {
+    TermDictionaryDispose(index->dictionary);
+    free(index->dictionary);
+  }
+  index->dictionary = dictionary;
+}
+
+const termdictionary *NewsIndexDictionary(const newsindex *index)
+{
+  return index->dictionary;
+}
+
+const trigramindex *NewsIndexTrigrams(const newsindex *index)
+{
+  return index->trigrams;
+}
+
+const facet *NewsIndexServers(const newsindex *index)
+{
+  return &index->servers;
+}
+
+const facet *NewsIndexFeeds(const newsindex *index)
+{
+  return &index->feeds;
+}
+
+void NewsIndexOptimizeFacets(newsindex *index)
+{
+  FacetRunOptimize(&index->servers);
+  FacetRunOptimize(&index->feeds);
+}
+
+bool NewsIndexMayContain(const newsindex *index, const char *word)
+{
+  return index->filter == NULL || BloomFilterMayContain(index->filter, FilterHash(word));
+}
+
+const struct article *NewsIndexArticle(const newsindex *index, int docID)
+{
+  if (docID < index->firstArticleID) return NULL;
+  return *(struct article **) VectorNth(&index->articles, docID - index->firstArticleID);
+}
+
+unsigned long NewsIndexVersion(const newsindex *index)
+{
+  return index->version;
+}
+
+int NewsIndexArticleCount(const newsindex *index)
+{
+  return index->firstArticleID + VectorLength(&index->articles);
+}
+
+int NewsIndexFoldedCount(const newsindex *index)
+{
+  return index->numFolded;
+}
+
+int NewsIndexExpiredCount(const newsindex *index)
+{
+  return index->numExpired;
+}
+
+int NewsIndexTooOldCount(const newsindex *index)
+{
+  return index->numTooOld;
+}
+
+void NewsIndexSetMemoryBudget(newsindex *index, long budget, const char *directory)
+{
+  assert(index->retentionDays == 0);
+  index->spill = malloc(sizeof(spillstate));
+  index->spill->budget = budget;
+  index->spill->directory = strdup(directory);
+  VectorNew(&index->spill->runs, sizeof(char *), FreeString, 0);
+  index->spill->runsWritten = 0;
+  index->spill->bytesSpilled = 0;
+  index->spill->mergeNanos = 0;
+}
+
+static void CollectWord(void *elemAddr, void *auxData)
+{
+  VectorAppend(auxData, elemAddr);
+}
+
+static int CompareWords(const void *elemAddr1, const void *elemAddr2)
+{
+  const struct wordArticles *wordArt1 = *(struct wordArticles **) elemAddr1;
+  const struct wordArticles *wordArt2 = *(struct wordArticles **) elemAddr2;
+  return strcasecmp(wordArt1->word, wordArt2->word);
+}
+
+static void WriteArticles(newsindex *index, indexwriter *w)
+{
+  for (int i = 0; i < VectorLength(&index->articles); i++) {
+    const struct article *art = *(struct article **) VectorNth(&index->articles, i);
+    IndexWriterAddArticle(w, art->title, art->URL, art->server, art->feed, art->duplicateOf);
+  }
+}
+
+// Writes every word of the word index, in strcasecmp order
+static void WriteWords(newsindex *index, indexwriter *w)
+{
+  vector sorted;
+  VectorNew(&sorted, sizeof(struct wordArticles *), NULL, NewsIndexWordCount(index) + 1);
+  NewsIndexMapWords(index, CollectWord, &sorted);
+  VectorSort(&sorted, CompareWords);
+  for (int i = 0; i < VectorLength(&sorted); i++) {
+    const struct wordArticles *wordArt = *(struct wordArticles **) VectorNth(&sorted, i);
+    postingsiterator it;
+    int docID, freq;
+    IndexWriterBeginWord(w, wordArt->word, PostingsLength(&wordArt->articles));
+    PostingsIteratorNew(&it, &wordArt->articles);
+    while (PostingsIteratorNext(&it, &docID, &freq)) IndexWriterAddPosting(w, docID, freq);
+  }
+  VectorDispose(&sorted);
+}
+
+// Writes the word index out as the next run file and empties it.  There's no carrying
+// on without the run, so a run that can't be written ends the program.
+static void SpillWords(newsindex *index)
+{
+  spillstate *spill = index->spill;
+  char name[2048];
+  indexwriter w;
+  snprintf(name, sizeof(name), "%s/rss-run-%d-%d.idx", spill->directory, (int) getpid(),
+	   __atomic_add_fetch(&lastRun, 1, __ATOMIC_RELAXED));
+  if (!IndexWriterNew(&w, name, 0)) {
+    fprintf(stderr, "Unable to create the run file \"%s\".\n", name);
+    exit(1);
+  }
+  WriteWords(index, &w);
+  spill->bytesSpilled += IndexWriterBytes(&w);
+  if (!IndexWriterClose(&w)) {
+    fprintf(stderr, "Unable to write the run file \"%s\".\n", name);
+    exit(1);
+  }
+  char *copy = strdup(name);
+  VectorAppend(&spill->runs, &copy);
+  spill->runsWritten++;
+  ClearWords(index);
+}
+
+/**
+ * Merging runs
+ * ------------
+ * Each run is read by a cursor that sits on the run's current word, and the cursors
+ * are kept in a binary min-heap ordered by word and then by run.  The cursors on
+ * the smallest word are popped together, in run order, which is docID order, since
+ * each run holds only articles added after those of the runs before it, so their
+ * posting lists are simply concatenated.
+ */
+
+typedef struct {
+  indexreader reader;
+  const char *word;
+  int numPostings;
+  int run;
+} runcursor;
+
+static bool CursorLess(const runcursor *c1, const runcursor *c2)
+{
+  int cmp = strcasecmp(c1->word, c2->word);
+  return cmp < 0 || (cmp == 0 && c1->run < c2->run);
+}
+
+static void HeapPush(runcursor *heap[], int *n, runcursor *cursor)
+{
+  int i = (*n)++;
+  for (; i > 0 && CursorLess(cursor, heap[(i - 1) / 2]); i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+  heap[i] = cursor;
+}
+
+static runcursor *HeapPop(runcursor *heap[], int *n)
+{
+  runcursor *top = heap[0], *last = heap[--*n];
+  int i = 0;
+  while (2 * i + 1 < *n) {
+    int child = 2 * i + 1;
+    if (child + 1 < *n && CursorLess(heap[child + 1], heap[child])) child++;
+    if (!CursorLess(heap[child], last)) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+static bool MergeRuns(newsindex *index, const char *fileName)
+{
+  spillstate *spill = index->spill;
+  long long start = MonotonicNanos();
+  int numRuns = VectorLength(&spill->runs), heapSize = 0, numPopped;
+  runcursor cursors[numRuns], *heap[numRuns], *popped[numRuns];
+  indexwriter w;
+  if (!IndexWriterNew(&w, fileName, VectorLength(&index->articles))) return false;
+  WriteArticles(index, &w);
+  for (int run = 0; run < numRuns; run++) {
+    const char *name = *(char **) VectorNth(&spill->runs, run);
+    if (!IndexReaderNew(&cursors[run].reader, name)) {
+      fprintf(stderr, "Unable to read the run file \"%s\".\n", name);
+      exit(1);
+    }
+    cursors[run].run = run;
+    if (IndexReaderNextWord(&cursors[run].reader, &cursors[run].word, &cursors[run].numPostings))
+      HeapPush(heap, &heapSize, &cursors[run]);
+  }
+
+  while (heapSize > 0) {
+    int total = 0, docID, freq;
+    numPopped = 0;
+    do {
+      popped[numPopped] = HeapPop(heap, &heapSize);
+      total += popped[numPopped++]->numPostings;
+    } while (heapSize > 0 && strcasecmp(heap[0]->word, popped[0]->word) == 0);
+    IndexWriterBeginWord(&w, popped[0]->word, total);
+    for (int i = 0; i < numPopped; i++)
+      while (IndexReaderNextPosting(&popped[i]->reader, &docID, &freq)) IndexWriterAddPosting(&w, docID, freq);
+    for (int i = 0; i < numPopped; i++)
+      if (IndexReaderNextWord(&popped[i]->reader, &popped[i]->word, &popped[i]->numPostings))
+	HeapPush(heap, &heapSize, popped[i]);
+  }
+
+  for (int run = 0; run < numRuns; run++) {
+    IndexReaderDispose(&cursors[run].reader);
+    unlink(*(char **) VectorNth(&spill->runs, run));
+  }
+  VectorDispose(&spill->runs);
+  VectorNew(&spill->runs, sizeof(char *), FreeString, 0);
+  spill->mergeNanos += MonotonicNanos() - start;
+  return IndexWriterClose(&w);
+}
+
+bool NewsIndexSave(newsindex *index, const char *fileName)
+{
+  assert(index->retentionDays == 0);
+  if (index->spill != NULL && VectorLength(&index->spill->runs) > 0) {
+    SpillWords(index);
+    return MergeRuns(index, fileName);
+  }
+  indexwriter w;
+  if (!IndexWriterNew(&w, fileName, VectorLength(&index->articles))) return false;
+  WriteArticles(index, &w);
+  WriteWords(index, &w);
+  return IndexWriterClose(&w);
+}
+
+bool NewsIndexLoad(newsindex *index, const char *fileName)
+{
+  indexreader r;
+  const char *title, *URL, *server, *feed, *word;
+  int duplicateOf, numPostings, docID, freq;
+  assert(index->retentionDays == 0);
+  if (!IndexReaderNew(&r, fileName)) return false;
+  ClearArticles(index);
+  ClearWords(index);
+  while (IndexReaderNextArticle(&r, &title, &URL, &server, &feed, &duplicateOf)) {
+    struct article *art = malloc(sizeof(struct article));
+    art->title = strdup(title);
+    art->URL = strdup(URL);
+    art->server = strdup(server);
+    art->feed = strdup(feed);
+    art->id = VectorLength(&index->articles);
+    art->duplicateOf = duplicateOf;
+    AddToFacets(index, art);
+    if (duplicateOf != -1) index->numFolded++;
+    HashSetEnter(&Segment(index, 0)->seenArticles, &art);
+    VectorAppend(&index->articles, &art);
+  }
+  while (IndexReaderNextWord(&r, &word, &numPostings)) {
+    if (OutsidePartition(index, word)) continue;
+    struct wordArticles *wordArt = malloc(sizeof(struct wordArticles));
+    wordArt->word = strdup(word);
+    PostingsNew(&wordArt->articles);
+    while (IndexReaderNextPosting(&r, &docID, &freq)) PostingsAppend(&wordArt->articles, docID, freq);
+    HashSetEnter(&Segment(index, 0)->words, &wordArt);
+    index->wordBytes += sizeof(struct wordArticles) + sizeof(struct wordArticles *) + strlen(word) + 1 +
+      PostingsBytes(&wordArt->articles);
+  }
+  Segment(index, 0)->wordBytes = index->wordBytes;
+  bool complete = IndexReaderComplete(&r);
+  IndexReaderDispose(&r);
+  if (index->filter != NULL) RebuildFilter(index);
+  NewsIndexOptimizeFacets(index);
+  index->version = ++lastVersion;
+  return complete;
+}
@@ -0,0 +1,456 @@
+/**
+ * File: newsindex.h
+ * -----------------
+ * Defines the interface for the newsindex, which bundles together
+ * everything BuildIndices learns about the articles it crawls:
+ *
+ *   - the word index, mapping each well-formed word to the compressed
+ *     posting list of articles that contain it,
+ *   - the set of articles seen so far, used to avoid indexing the
+ *     same article twice, and
+ *   - the article table, which maps the integer article ids stored in
+ *     posting lists back to the article records themselves, and
+ *   - optionally, a Bloom filter over the word index's words, which lets
+ *     lookups of words the index doesn't hold (most of the words an index
+ *     is asked about while it's being built, and many queries) give up
+ *     without walking a bucket chain of the word index, and
+ *   - optionally, MinHash signatures of the articles indexed, which let a
+ *     new article that's a near-duplicate of one already indexed (the same
+ *     story syndicated under another URL and title) be folded into it
+ *     rather than indexed all over again.
+ *
+ * An index can be saved to an index file (see indexfile.h) and loaded back.
+ * It can also be given a memory budget, in which case its word index is
+ * written out to a sorted run file whenever it grows past the budget and
+ * started afresh, and NewsIndexSave merges the runs into the saved file:
+ * crawls whose word index wouldn't fit in memory can still be indexed.
+ *
+ * An index can be made one shard of a term-partitioned index, holding
+ * only the words that hash to it (but every article), so that several
+ * processes can share the work of answering queries.
+ *
+ * Finally, an index can be divided by day of publication, into segments
+ * each holding the words and seen articles of one day's news, and told
+ * how many days to keep.  Once news of a newer day arrives, the segments
+ * of days that have fallen out of the window are dropped whole: nothing
+ * in the segments that remain is touched, so a crawler that keeps running
+ * holds only the last few days of news however long it runs.  What the
+ * index keeps about the dropped articles outside their segments goes with
+ * them: their MinHash signatures, their places in the facets (and the
+ * sources with no articles left), and, once every article before them has
+ * gone too, their slots in the article table.  An index that isn't
+ * divided has a single segment, which is never dropped.
+ *
+ * Once it's built, an index can be given a term dictionary (see
+ * termdictionary.h) of its words, sorted, for prefix searches and
+ * completions, which the word index's hashset can't answer, and a trigram
+ * index of the dictionary (see trigramindex.h), for correcting misspelled
+ * query words.
+ *
+ * Articles are also filed by the server they came from and the feed that
+ * listed them, as two facets (see facet.h), so that matches can be limited
+ * to, and counted by, their sources.
+ *
+ * The index also carries term statistics (see termstats.h), which the
+ * crawler counts the words it indexes in, for estimates of how often each
+ * word has been seen and of which have been seen most, in fixed memory.
+ * They describe the words as they were scanned, so a loaded index has
+ * none, and the words of articles later dropped with their segments stay
+ * counted.
+ */
+
+#ifndef __newsindex_
+#define __newsindex_
+
+#include <time.h>
+#include "hashset.h"
+#include "vector.h"
+#include "postings.h"
+#include "bloomfilter.h"
+#include "minhash.h"
+#include "indexfile.h"
+#include "trigramindex.h"
+#include "facet.h"
+#include "termstats.h"
+
+struct article;
+
+/**
+ * Type: spillstate
+ * ----------------
+ * What a memory-budgeted index knows about the runs it's spilled.
+ */
+
+typedef struct {
+  long budget;             // bytes the word index may hold before it's spilled
+  char *directory;         // where run files are written
+  vector runs;             // char *, the names of the run files not yet merged
+  int runsWritten;
+  long bytesSpilled;       // total size of the run files written
+  long long mergeNanos;    // time NewsIndexSave spent merging them
+} spillstate;
+
+/**
+ * Type: newssegment
+ * -----------------
+ * The words and articles of one day's news, or, in an index that isn't
+ * divided by day, of all of it.
+ */
+
+typedef struct {
+  int day;                 // days from 1970-01-01 (UTC) to its articles' publication, or -1 if undivided
+  hashset words;           // wordArticles *, keyed case-insensitively on the word
+  hashset seenArticles;    // article *, keyed on URL (or on title and server); owns the segment's articles
+  long wordBytes;          // estimated bytes held by its words and their posting lists
+} newssegment;
+
+/**
+ * Type: newsindex
+ * ---------------
+ * The concrete representation of the index.  Clients should initialize,
+ * populate, query, and dispose of it via the functions below.
+ */
+
+typedef struct {
+  vector segments;         // newssegment *, newest first
+  newssegment *current;    // the segment of the article added last, which its words go to
+  int retentionDays;       // days of news kept, or 0 if the index isn't divided by day
+  int newestDay;           // the newest day of publication seen, which the days kept count back from
+  int numExpired;          // articles dropped with their segments
+  int numTooOld;           // articles turned away for being older than the days kept
+  vector articles;         // article *, indexed by article id less firstArticleID; NULL once an article's segment is dropped
+  int firstArticleID;      // the ids before it are all of articles dropped with their segments, and have no slots
+  unsigned long version;   // changes every time the index does
+  bloomfilter *filter;     // summarizes words, or NULL if NewsIndexUseFilter wasn't called
+  int filterBitsPerWord;
+  minhashindex *signatures; // signatures of the articles indexed, or NULL if near-duplicates aren't detected
+  int numFolded;            // articles folded into others as near-duplicates
+  long wordBytes;           // estimated bytes held by every segment's words and their posting lists
+  spillstate *spill;        // NULL unless NewsIndexSetMemoryBudget was called
+  int shard, numShards;     // holds only the words of shard shard of numShards, unless numShards is 0
+  termdictionary *dictionary; // the words as of the last NewsIndexSetDictionary, or NULL
+  trigramindex *trigrams;     // the dictionary's trigrams, or NULL
+  facet servers, feeds;       // the articles of each server, and of each feed
+  termstats stats;            // estimates of the words' counts, as they were scanned
+} newsindex;
+
+/**
+ * Type: match
+ * -----------
+ * One search hit: the id of an article containing a query term,
+ * and the number of times the term appears in that article.
+ */
+
+typedef struct {
+  int docID;
+  int occurrences;
+} match;
+
+/**
+ * Function: NewsIndexNew
+ * ----------------------
+ * Initializes the specified index to be empty.
+ */
+
+void NewsIndexNew(newsindex *index);
+
+/**
+ * Function: NewsIndexDispose
+ * --------------------------
+ * Releases all of the words, posting lists, and articles owned by the index.
+ */
+
+void NewsIndexDispose(newsindex *index);
+
+/**
+ * Function: NewsIndexUseFilter
+ * ----------------------------
+ * Puts a Bloom filter with about bitsPerWord bits per word in front of the
+ * word index.  The filter is sized to the words already in the index and
+ * rebuilt at twice the size whenever the index outgrows it, so it stays at
+ * or above bitsPerWord bits per word however large the index gets.
+ */
+
+void NewsIndexUseFilter(newsindex *index, int bitsPerWord);
+
+/**
+ * Function: NewsIndexDetectNearDuplicates
+ * ---------------------------------------
+ * Starts keeping a MinHash signature for each article indexed, so that
+ * NewsIndexFindNearDuplicate can recognize articles whose estimated
+ * similarity to one already indexed is at least threshold.
+ */
+
+void NewsIndexDetectNearDuplicates(newsindex *index, double threshold);
+
+/**
+ * Function: NewsIndexSetMemoryBudget
+ * ----------------------------------
+ * Limits the word index to about budget bytes: whenever an article is added
+ * while the word index holds more, its words are written to a new run file in
+ * directory and dropped from memory.  Until NewsIndexSave merges the runs, the
+ * index holds only the words added since the last spill, so it shouldn't be
+ * queried.
+ */
+
+void NewsIndexSetMemoryBudget(newsindex *index, long budget, const char *directory);
+
+/**
+ * Function: NewsIndexDivideByDay
+ * ------------------------------
+ * Divides the index, which must still be empty, into segments by day of
+ * publication, keeping retentionDays days of news: the newest day seen and
+ * the retentionDays - 1 before it.  Such an index can't have a memory budget
+ * and can't be saved or loaded.
+ */
+
+void NewsIndexDivideByDay(newsindex *index, int retentionDays);
+
+/**
+ * Function: NewsIndexSetPartition
+ * -------------------------------
+ * Makes the index shard shard of numShards: from now on, words added to it or
+ * loaded into it are dropped unless NewsIndexWordShard assigns them to shard.
+ * A shard of -1 keeps no words at all, only the article table.
+ */
+
+void NewsIndexSetPartition(newsindex *index, int shard, int numShards);
+
+/**
+ * Function: NewsIndexWordShard
+ * ----------------------------
+ * Returns which of numShards shards holds the specified word, case-insensitively.
+ */
+
+int NewsIndexWordShard(const char *word, int numShards);
+
+/**
+ * Function: NewsIndexSave
+ * -----------------------
+ * Writes the index to the named file, returning false if it can't be written.
+ * If the index spilled any runs, the words still in memory are spilled as one
+ * last run, and all the runs are merged into the file and deleted, which leaves
+ * the index without any words; NewsIndexLoad the file to query it.
+ */
+
+bool NewsIndexSave(newsindex *index, const char *fileName);
+
+/**
+ * Function: NewsIndexLoad
+ * -----------------------
+ * Replaces the index's articles and words with those of the named file,
+ * returning false if it can't be read.  A Bloom filter, if the index has one,
+ * is rebuilt for the new words.
+ */
+
+bool NewsIndexLoad(newsindex *index, const char *fileName);
+
+/**
+ * Function: NewsIndexAddArticle
+ * -----------------------------
+ * Registers a new article with the index and returns the article id that
+ * should be used when adding its words.  If the article has already been
+ * seen (same URL, or same title on the same server), nothing is added and
+ * -1 is returned.  feed is the URL of the feed that listed the article, or
+ * "" if there wasn't one.
+ *
+ * published is when the article was published, in seconds since the epoch,
+ * or -1 if that isn't known, and matters only to an index divided by day.
+ * There, an article without a date, or with one still to come, is taken to
+ * have been published now; an article older than the days kept is turned
+ * away (returning -1); and one newer than any seen before moves the window
+ * of days kept forward, dropping the segments left behind.
+ */
+
+int NewsIndexAddArticle(newsindex *index, const char *title, const char *URL, const char *server, const char *feed,
+			time_t published);
+
+/**
+ * Function: NewsIndexAddWord
+ * --------------------------
+ * Records one occurrence of word within the article identified by docID.
+ * Words are added article by article, so docID is never less than the
+ * docID of any previous call.
+ */
+
+void NewsIndexAddWord(newsindex *index, const char *word, int docID);
+
+/**
+ * Function: NewsIndexFindNearDuplicate
+ * ------------------------------------
+ * Returns the id of the indexed article that the article with the specified
+ * signature near-duplicates, or -1 if there's none (or if the index isn't
+ * detecting near-duplicates).
+ */
+
+int NewsIndexFindNearDuplicate(const newsindex *index, const minhashsignature *signature);
+
+/**
+ * Function: NewsIndexAddSignature
+ * -------------------------------
+ * Records the signature of article docID, whose words have been indexed, so
+ * later articles can be checked against it.  Does nothing if the index isn't
+ * detecting near-duplicates.
+ */
+
+void NewsIndexAddSignature(newsindex *index, int docID, const minhashsignature *signature);
+
+/**
+ * Function: NewsIndexFoldArticle
+ * ------------------------------
+ * Marks article docID, none of whose words have been added, as a near-duplicate
+ * of article originalID.  The article stays registered, so its URL and title are
+ * still recognized if they come up again, but it has no postings of its own:
+ * searches find the original in its place.
+ */
+
+void NewsIndexFoldArticle(newsindex *index, int docID, int originalID);
+
+/**
+ * Functions: NewsIndexSegmentCount, NewsIndexSegmentDay
+ * -----------------------------------------------------
+ * Return the number of segments the index holds, and the day (counted from
+ * 1970-01-01, UTC) of the news in the specified one, or -1 for the single
+ * segment of an index that isn't divided by day.  Segment 0 is the newest.
+ */
+
+int NewsIndexSegmentCount(const newsindex *index);
+int NewsIndexSegmentDay(const newsindex *index, int segment);
+
+/**
+ * Function: NewsIndexLookup
+ * -------------------------
+ * Returns the posting list for the specified word (compared case-insensitively)
+ * within the specified segment, or NULL if none of that segment's articles
+ * contains it.  A search of the whole index looks the word up in each of the
+ * segments in turn, newest first; the articles of different segments are
+ * different, so their matches never need to be combined.
+ */
+
+const postings *NewsIndexLookup(newsindex *index, int segment, const char *word);
+
+/**
+ * Functions: NewsIndexMapWords, NewsIndexWordCount
+ * ------------------------------------------------
+ * NewsIndexMapWords calls mapfn on every word of every segment (each a
+ * struct wordArticles **, as HashSetMap would pass it), and NewsIndexWordCount
+ * returns how many calls that makes.  A word in several segments is counted
+ * once for each.
+ */
+
+void NewsIndexMapWords(const newsindex *index, HashSetMapFunction mapfn, void *auxData);
+int NewsIndexWordCount(const newsindex *index);
+
+/**
+ * Function: NewsIndexBuildDictionary
+ * ----------------------------------
+ * Returns a newly allocated term dictionary of the index's words, lowercased,
+ * each with the number of articles (over all segments) that contain it.  The
+ * index isn't changed, so the dictionary can be built while the index is being
+ * read, and then attached with NewsIndexSetDictionary.
+ */
+
+termdictionary *NewsIndexBuildDictionary(const newsindex *index);
+
+/**
+ * Function: NewsIndexSetDictionary
+ * --------------------------------
+ * Attaches the dictionary, and a trigram index of it (or NULL), to the index,
+ * which takes ownership of both, freeing those it had before, if any.  The
+ * dictionary isn't updated as words are added, so an index that goes on
+ * growing needs to be given a new one now and then; words a dictionary holds
+ * that the index has since dropped just have no postings.
+ */
+
+void NewsIndexSetDictionary(newsindex *index, termdictionary *dictionary, trigramindex *trigrams);
+
+/**
+ * Functions: NewsIndexDictionary, NewsIndexTrigrams
+ * -------------------------------------------------
+ * Return the index's term dictionary and its trigram index, or NULL if the
+ * index hasn't been given them.
+ */
+
+const termdictionary *NewsIndexDictionary(const newsindex *index);
+const trigramindex *NewsIndexTrigrams(const newsindex *index);
+
+/**
+ * Functions: NewsIndexServers, NewsIndexFeeds
+ * -------------------------------------------
+ * Return the facets dividing the index's articles by server and by feed.
+ * Articles are added to them as they're added to the index, so they're
+ * read under the same rules as the rest of the index.
+ */
+
+const facet *NewsIndexServers(const newsindex *index);
+const facet *NewsIndexFeeds(const newsindex *index);
+
+/**
+ * Function: NewsIndexOptimizeFacets
+ * ---------------------------------
+ * Compacts the facets' bitmaps, once the index is built (loading an index
+ * does so itself).  The facets remain correct without it, only larger.
+ */
+
+void NewsIndexOptimizeFacets(newsindex *index);
+
+/**
+ * Function: NewsIndexMayContain
+ * -----------------------------
+ * Returns false if the index's filter rules out the word, and true if the
+ * word may be in the index (always true for an index without a filter).
+ * Meant for measuring the filter; NewsIndexLookup consults it already.
+ */
+
+bool NewsIndexMayContain(const newsindex *index, const char *word);
+
+/**
+ * Function: NewsIndexArticle
+ * --------------------------
+ * Returns the article record with the specified id, or NULL if the article's
+ * segment has been dropped.
+ */
+
+const struct article *NewsIndexArticle(const newsindex *index, int docID);
+
+/**
+ * Function: NewsIndexVersion
+ * --------------------------
+ * Returns the index's current version number.  Versions are unique across
+ * every index created by the process, and an index gets a new one each time
+ * an article or word is added, so anything derived from an index (cached
+ * query results, for instance) can tell whether it's still current.
+ */
+
+unsigned long NewsIndexVersion(const newsindex *index);
+
+/**
+ * Function: NewsIndexArticleCount
+ * -------------------------------
+ * Returns the number of articles registered with the index, counting those
+ * whose segments have since been dropped.
+ */
+
+int NewsIndexArticleCount(const newsindex *index);
+
+/**
+ * Function: NewsIndexFoldedCount
+ * ------------------------------
+ * Returns the number of those articles that were folded into others as
+ * near-duplicates.
+ */
+
+int NewsIndexFoldedCount(const newsindex *index);
+
+/**
+ * Functions: NewsIndexExpiredCount, NewsIndexTooOldCount
+ * ------------------------------------------------------
+ * Return the number of articles dropped along with their segments (which
+ * NewsIndexArticleCount still counts), and the number turned away, never
+ * registered at all, for being older than the days kept.
+ */
+
+int NewsIndexExpiredCount(const newsindex *index);
+int NewsIndexTooOldCount(const newsindex *index);
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "postings.h"
+
+static const int kInitialByteAllocation = 8;
+
+void PostingsNew(postings *p)
+{
+  p->bytes = NULL;
+  p->logicalLength = p->allocatedLength = 0;
+  p->encodedCount = 0;
+  p->encodedDocID = -1;
+  p->lastDocID = -1;
+  p->lastFreq = 0;
+  p->skips = NULL;
+  p->numSkips = 0;
+}
+
+void PostingsDispose(postings *p)
+{
+  free(p->bytes);
+  free(p->skips);
+}
+
+// Makes sure there's room for at least extra more bytes, doubling the allocation as needed
+static void EnsureCapacity(postings *p, int extra)
+{
+  if (p->logicalLength + extra <= p->allocatedLength) return;
+  int newLength = p->allocatedLength == 0 ? kInitialByteAllocation : 2 * p->allocatedLength;
+  while (newLength < p->logicalLength + extra) newLength *= 2;
+  p->bytes = realloc(p->bytes, newLength);
+  assert(p->bytes != NULL);
+  p->allocatedLength = newLength;
+}
+
+// Writes value as a variable-byte integer, seven bits at a time, low bits first
+static void EncodeVarByte(postings *p, unsigned int value)
+{
+  while (value >= 0x80) {
+    p->bytes[p->logicalLength++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  p->bytes[p->logicalLength++] = (unsigned char) value;
+}
+
+// Inverse of EncodeVarByte: decodes the integer at *offset and advances *offset past it
+static inline unsigned int DecodeVarByte(const unsigned char *bytes, int *offset)
+{
+  const unsigned char *b = bytes + *offset;
+  unsigned int value = *b & 0x7f;
+  int shift = 7;
+  while (*b++ & 0x80) {
+    value |= (unsigned int) (*b & 0x7f) << shift;
+    shift += 7;
+  }
+  *offset = b - bytes;
+  return value;
+}
+
+// Moves the open posting into the encoded byte stream, recording a skip entry at block boundaries
+static void EncodeOpenPosting(postings *p)
+{
+  if (p->lastDocID == -1) return;
+  if (p->encodedCount > 0 && p->encodedCount % kPostingsBlockSize == 0) {
+    p->skips = realloc(p->skips, (p->numSkips + 1) * sizeof(postingsskip));
+    assert(p->skips != NULL);
+    p->skips[p->numSkips].baseDocID = p->encodedDocID;
+    p->skips[p->numSkips].offset = p->logicalLength;
+    p->numSkips++;
+  }
+
+  EnsureCapacity(p, 10); // two 32-bit values never need more than five bytes each
+  EncodeVarByte(p, p->lastDocID - p->encodedDocID);
+  EncodeVarByte(p, p->lastFreq - 1);
+  p->encodedDocID = p->lastDocID;
+  p->encodedCount++;
+  p->lastDocID = -1;
+  p->lastFreq = 0;
+}
+
+void PostingsAdd(postings *p, int docID)
+{
+  assert(docID >= 0);
+  if (docID == p->lastDocID) {
+    p->lastFreq++;
+    return;
+  }
+
+  PostingsAppend(p, docID, 1);
+}
+
+void PostingsAppend(postings *p, int docID, int freq)
+{
+  assert(freq > 0);
+  assert(docID > p->lastDocID && docID > p->encodedDocID);
+  EncodeOpenPosting(p);
+  p->lastDocID = docID;
+  p->lastFreq = freq;
+}
+
+int PostingsLength(const postings *p)
+{
+  return p->encodedCount + (p->lastDocID == -1 ? 0 : 1);
+}
+
+int PostingsBytes(const postings *p)
+{
+  return p->allocatedLength + p->numSkips * sizeof(postingsskip);
+}
+
+void PostingsIteratorNew(postingsiterator *it, const postings *p)
+{
+  it->p = p;
+  it->offset = 0;
+  it->index = 0;
+  it->docID = -1;
+}
+
+bool PostingsIteratorNext(postingsiterator *it, int *docID, int *freq)
+{
+  const postings *p = it->p;
+  if (it->index < p->encodedCount) {
+    it->docID += DecodeVarByte(p->bytes, &it->offset);
+    *docID = it->docID;
+    *freq = DecodeVarByte(p->bytes, &it->offset) + 1;
+    it->index++;
+    return true;
+  }
+
+  if (it->index == p->encodedCount && p->lastDocID != -1) { // the open posting comes last
+    it->docID = *docID = p->lastDocID;
+    *freq = p->lastFreq;
+    it->index++;
+    return true;
+  }
+
+  return false;
+}
+
+bool PostingsIteratorSkipTo(postingsiterator *it, int target, int *docID, int *freq)
+{
+  const postings *p = it->p;
+
+  // binary search for the last block whose predecessor is still short of the target
+  int lo = 0, hi = p->numSkips - 1, best = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (p->skips[mid].baseDocID < target) {
+      best = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  if (best != -1 && (best + 1) * kPostingsBlockSize > it->index) {
+    it->index = (best + 1) * kPostingsBlockSize;
+    it->offset = p->skips[best].offset;
+    it->docID = p->skips[best].baseDocID;
+  }
+
+  while (PostingsIteratorNext(it, docID, freq)) {
+    if (*docID >= target) return true;
+  }
+
+  return false;
+}
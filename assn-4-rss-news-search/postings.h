@@ -0,0 +1,180 @@
+/**
+ * File: postings.h
+ * ----------------
+ * Defines the interface for the compressed posting list.
+ *
+ * A posting list records, for a single word, every document (identified by
+ * its integer document id) that contains the word along with the number of
+ * times the word appears in that document.  Rather than storing one heap
+ * allocated record per posting, the list keeps a single growable byte
+ * stream in which each posting is encoded as two variable-byte integers:
+ *
+ *     <docID - previous docID> <occurrences - 1>
+ *
+ * Each integer is written seven bits at a time, least significant group
+ * first, with the high bit of a byte set whenever more bytes follow.  Since
+ * document ids are handed out in increasing order as articles are scanned,
+ * the deltas are small and the vast majority of postings fit in two bytes.
+ *
+ * Every kPostingsBlockSize postings the list also records a skip entry,
+ * which lets readers jump over whole blocks without decoding them when
+ * they're hunting for a particular document id.
+ */
+
+#ifndef __postings_
+#define __postings_
+
+#include "bool.h"
+
+/**
+ * Constant: kPostingsBlockSize
+ * ----------------------------
+ * Number of postings covered by a single skip entry.
+ */
+
+#define kPostingsBlockSize 128
+
+/**
+ * Type: postingsskip
+ * ------------------
+ * Identifies where a block of kPostingsBlockSize postings begins.
+ * baseDocID is the document id of the last posting of the block before
+ * it, which is what the first delta in the block is relative to, and
+ * offset is the byte offset of the block within the encoded stream.  The
+ * very first block, which starts the stream, has no entry; every block
+ * after it has one, written as its first posting is encoded.
+ */
+
+typedef struct {
+  int baseDocID;
+  int offset;
+} postingsskip;
+
+/**
+ * Type: postings
+ * --------------
+ * The concrete representation of a posting list.  As with the vector and
+ * the hashset, the fields are exposed only because there's no easy way to
+ * hide them in C; clients should rely on the functions below.
+ *
+ * The most recently added posting is kept "open" in lastDocID/lastFreq
+ * rather than encoded, since a scanner adds the same document over and over
+ * again while it walks an article.  It's encoded as soon as a posting for a
+ * different document arrives.
+ */
+
+typedef struct {
+  unsigned char *bytes;      // encoded postings
+  int logicalLength;         // number of bytes in use
+  int allocatedLength;       // number of bytes allocated
+  int encodedCount;          // number of postings encoded in bytes
+  int encodedDocID;          // docID of the last encoded posting, -1 if none
+  int lastDocID;             // docID of the open posting, -1 if none
+  int lastFreq;              // occurrences recorded for the open posting
+  postingsskip *skips;       // one entry per block after the first, in stream order
+  int numSkips;
+} postings;
+
+/**
+ * Function: PostingsNew
+ * ---------------------
+ * Initializes the specified posting list to be empty.  No memory is
+ * allocated until the first posting is added, since the majority of
+ * words in a news index appear in exactly one article.
+ */
+
+void PostingsNew(postings *p);
+
+/**
+ * Function: PostingsDispose
+ * -------------------------
+ * Releases all memory held by the specified posting list.
+ */
+
+void PostingsDispose(postings *p);
+
+/**
+ * Function: PostingsAdd
+ * ---------------------
+ * Records one more occurrence of the word in the document identified
+ * by docID.  If docID matches the most recently added document, its
+ * occurrence count is bumped; otherwise a new posting is started.
+ * An assert is raised if docID is less than the most recently added
+ * document id, since posting lists are kept in increasing docID order.
+ */
+
+void PostingsAdd(postings *p, int docID);
+
+/**
+ * Function: PostingsAppend
+ * ------------------------
+ * Appends a complete posting recording that the word appears freq times
+ * in docID.  Used when posting lists are copied or merged wholesale.
+ * An assert is raised unless docID is greater than every document id
+ * already in the list and freq is positive.
+ */
+
+void PostingsAppend(postings *p, int docID, int freq);
+
+/**
+ * Function: PostingsLength
+ * ------------------------
+ * Returns the number of postings (that is, the number of distinct
+ * documents) in the specified list.
+ */
+
+int PostingsLength(const postings *p);
+
+/**
+ * Function: PostingsBytes
+ * -----------------------
+ * Returns the number of bytes of heap memory used to store the specified
+ * list: the encoded stream plus the skip table, not counting the postings
+ * record itself.
+ */
+
+int PostingsBytes(const postings *p);
+
+/**
+ * Type: postingsiterator
+ * ----------------------
+ * Cursor used to decode a posting list in increasing docID order.
+ * The list must not be modified while an iterator is walking it.
+ */
+
+typedef struct {
+  const postings *p;
+  int offset;     // byte offset of the next encoded posting
+  int index;      // number of postings decoded so far
+  int docID;      // docID of the posting most recently decoded, -1 initially
+} postingsiterator;
+
+/**
+ * Function: PostingsIteratorNew
+ * -----------------------------
+ * Positions the iterator before the first posting in the specified list.
+ */
+
+void PostingsIteratorNew(postingsiterator *it, const postings *p);
+
+/**
+ * Function: PostingsIteratorNext
+ * ------------------------------
+ * Decodes the next posting into *docID and *freq and returns true, or
+ * returns false if the list has been exhausted.
+ */
+
+bool PostingsIteratorNext(postingsiterator *it, int *docID, int *freq);
+
+/**
+ * Function: PostingsIteratorSkipTo
+ * --------------------------------
+ * Advances the iterator to the first posting whose docID is greater than
+ * or equal to target, using the skip table to jump over whole blocks,
+ * and decodes that posting into *docID and *freq.  Returns false if no
+ * such posting exists.
+ */
+
+bool PostingsIteratorSkipTo(postingsiterator *it, int target, int *docID, int *freq);
+
+#endif
@@ -0,0 +1,139 @@
+#define _GNU_SOURCE // for timegm
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "bool.h"
+#include "pubdate.h"
+
+static const char *const kMonths[] = { "jan", "feb", "mar", "apr", "may", "jun",
+				       "jul", "aug", "sep", "oct", "nov", "dec" };
+
+typedef struct {
+  const char *name;
+  int minutes;   // east of UTC
+} zonename;
+
+static const zonename kZones[] = {
+  { "UT", 0 }, { "UTC", 0 }, { "GMT", 0 }, { "Z", 0 },
+  { "EST", -300 }, { "EDT", -240 }, { "CST", -360 }, { "CDT", -300 },
+  { "MST", -420 }, { "MDT", -360 }, { "PST", -480 }, { "PDT", -420 },
+};
+
+static const char *SkipSpaces(const char *s)
+{
+  while (isspace((unsigned char) *s)) s++;
+  return s;
+}
+
+// Reads exactly digits digits (or, with digits 0, one or more) into *value, returning
+// the text after them, or NULL if they aren't there
+static const char *ReadDigits(const char *s, int digits, int *value)
+{
+  int n = 0, i = 0;
+  for (; isdigit((unsigned char) s[i]) && (digits == 0 || i < digits); i++) n = 10 * n + s[i] - '0';
+  if (i == 0 || (digits > 0 && i < digits)) return NULL;
+  *value = n;
+  return s + i;
+}
+
+// Reads hh:mm and, optionally, :ss
+static const char *ReadClock(const char *s, struct tm *tm)
+{
+  if ((s = ReadDigits(s, 2, &tm->tm_hour)) == NULL || *s != ':' ||
+      (s = ReadDigits(s + 1, 2, &tm->tm_min)) == NULL) return NULL;
+  tm->tm_sec = 0;
+  if (*s == ':' && (s = ReadDigits(s + 1, 2, &tm->tm_sec)) == NULL) return NULL;
+  return s;
+}
+
+// Reads a numeric zone, +hhmm or +hh:mm (or -), into *minutes
+static const char *ReadOffset(const char *s, int *minutes)
+{
+  int sign = *s == '-' ? -1 : 1, hours, mins;
+  if ((s = ReadDigits(s + 1, 2, &hours)) == NULL) return NULL;
+  if (*s == ':') s++;
+  if ((s = ReadDigits(s, 2, &mins)) == NULL) return NULL;
+  *minutes = sign * (60 * hours + mins);
+  return s;
+}
+
+static bool ValidDate(const struct tm *tm)
+{
+  return tm->tm_mon >= 0 && tm->tm_mon < 12 && tm->tm_mday >= 1 && tm->tm_mday <= 31 &&
+    tm->tm_hour < 24 && tm->tm_min < 60 && tm->tm_sec <= 60;
+}
+
+// 2005-04-24, optionally followed by T00:00:00, fractions of a second, and Z or an offset
+static time_t ParseISO8601(const char *s)
+{
+  struct tm tm;
+  int minutes = 0;
+  memset(&tm, 0, sizeof(tm));
+  if ((s = ReadDigits(s, 4, &tm.tm_year)) == NULL || *s != '-' ||
+      (s = ReadDigits(s + 1, 2, &tm.tm_mon)) == NULL || *s != '-' ||
+      (s = ReadDigits(s + 1, 2, &tm.tm_mday)) == NULL) return -1;
+  if (*s == 'T' || *s == 't' || *s == ' ') {
+    if ((s = ReadClock(s + 1, &tm)) == NULL) return -1;
+    if (*s == '.') for (s++; isdigit((unsigned char) *s); s++);
+    if (*s == 'Z' || *s == 'z') s++;
+    else if ((*s == '+' || *s == '-') && (s = ReadOffset(s, &minutes)) == NULL) return -1;
+  }
+  tm.tm_year -= 1900;
+  tm.tm_mon--;
+  if (*SkipSpaces(s) != '\0' || !ValidDate(&tm)) return -1;
+  return timegm(&tm) - 60L * minutes;
+}
+
+// [Sun, ]24 Apr 2005 00:00[:00] EDT
+static time_t ParseRFC822(const char *s)
+{
+  struct tm tm;
+  int minutes = 0;
+  memset(&tm, 0, sizeof(tm));
+  s = SkipSpaces(s);
+  if (isalpha((unsigned char) *s)) {
+    while (isalpha((unsigned char) *s)) s++;
+    if (*s == ',') s++;
+    s = SkipSpaces(s);
+  }
+  if ((s = ReadDigits(s, 0, &tm.tm_mday)) == NULL) return -1;
+  s = SkipSpaces(s);
+  tm.tm_mon = -1;
+  for (int m = 0; m < 12; m++)
+    if (strncasecmp(s, kMonths[m], 3) == 0) tm.tm_mon = m;
+  if (tm.tm_mon == -1) return -1;
+  while (isalpha((unsigned char) *s)) s++;  // some feeds spell the month out
+  const char *year = SkipSpaces(s);
+  if ((s = ReadDigits(year, 0, &tm.tm_year)) == NULL) return -1;
+  if (s - year == 2) tm.tm_year += tm.tm_year < 50 ? 2000 : 1900;
+  tm.tm_year -= 1900;
+  if ((s = ReadClock(SkipSpaces(s), &tm)) == NULL) return -1;
+  s = SkipSpaces(s);
+  if (*s == '+' || *s == '-') {
+    if ((s = ReadOffset(s, &minutes)) == NULL) return -1;
+  } else if (isalpha((unsigned char) *s)) {
+    int length = 0;
+    while (isalpha((unsigned char) s[length])) length++;
+    for (int z = 0; z < sizeof(kZones) / sizeof(kZones[0]); z++)
+      if (strlen(kZones[z].name) == length && strncasecmp(s, kZones[z].name, length) == 0) minutes = kZones[z].minutes;
+    s += length;  // unknown names, military letters among them, are taken to be UTC
+  }
+  if (*SkipSpaces(s) != '\0' || !ValidDate(&tm)) return -1;
+  return timegm(&tm) - 60L * minutes;
+}
+
+time_t ParsePubDate(const char *text)
+{
+  text = SkipSpaces(text);
+  if (isdigit((unsigned char) text[0]) && isdigit((unsigned char) text[1]) &&
+      isdigit((unsigned char) text[2]) && isdigit((unsigned char) text[3]) && text[4] == '-')
+    return ParseISO8601(text);
+  return ParseRFC822(text);
+}
+
+void FormatPubDate(time_t when, char buffer[], int bufferLength)
+{
+  struct tm tm;
+  gmtime_r(&when, &tm);
+  strftime(buffer, bufferLength, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
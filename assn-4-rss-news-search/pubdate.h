@@ -0,0 +1,40 @@
+/**
+ * File: pubdate.h
+ * ---------------
+ * Defines a reader and writer for the dates feeds give their items'
+ * publication in.  Two forms are understood:
+ *
+ *   RFC 822, as in RSS 2.0's <pubDate>:  Sun, 24 Apr 2005 00:00:00 EDT
+ *   ISO 8601, as in Atom's <published>:  2005-04-24T00:00:00-04:00
+ *
+ * The day of the week is optional, as are the seconds, and a two-digit
+ * year is taken to be in 1950-2049.  RFC 822 zones may be numeric offsets
+ * (+0200) or names (UT, GMT, Z, and the North American zones EST through
+ * PDT); the single-letter military zones are taken to be UTC, since feeds
+ * that use them rarely mean what RFC 822 says they do.
+ */
+
+#ifndef __pubdate_
+#define __pubdate_
+
+#include <time.h>
+
+/**
+ * Function: ParsePubDate
+ * ----------------------
+ * Returns the time, in seconds since the epoch, that text gives in either
+ * form, or -1 if text isn't a date in either.
+ */
+
+time_t ParsePubDate(const char *text);
+
+/**
+ * Function: FormatPubDate
+ * -----------------------
+ * Writes the time into buffer as an RFC 822 date in GMT, which takes at
+ * most 32 bytes, null included.
+ */
+
+void FormatPubDate(time_t when, char buffer[], int bufferLength);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "querycache.h"
+
+static const int kNumBuckets = 1024; // power of two, so a bucket is picked with a mask
+
+// Lower-cases the query and trims/collapses its whitespace into key
+static void NormalizeQuery(const char *query, char key[], int keyLength)
+{
+  int n = 0;
+  bool pendingSpace = false;
+  for (const char *c = query; *c != '\0' && n < keyLength - 1; c++) {
+    if (isspace((unsigned char) *c)) {
+      pendingSpace = n > 0;
+      continue;
+    }
+    if (pendingSpace && n < keyLength - 2) key[n++] = ' ';
+    pendingSpace = false;
+    key[n++] = tolower((unsigned char) *c);
+  }
+  key[n] = '\0';
+}
+
+static unsigned int KeyHash(const char *key)
+{
+  unsigned int hashcode = 2166136261u; // FNV-1a
+  for (const char *c = key; *c != '\0'; c++) {
+    hashcode ^= (unsigned char) *c;
+    hashcode *= 16777619u;
+  }
+  return hashcode;
+}
+
+static querycacheentry **FindSlot(querycache *cache, const char *key)
+{
+  querycacheentry **slot = &cache->buckets[KeyHash(key) & (cache->numBuckets - 1)];
+  while (*slot != NULL && strcmp((*slot)->query, key) != 0) slot = &(*slot)->bucketNext;
+  return slot;
+}
+
+static void Unlink(querycache *cache, querycacheentry *entry)
+{
+  if (entry->newer != NULL) entry->newer->older = entry->older; else cache->newest = entry->older;
+  if (entry->older != NULL) entry->older->newer = entry->newer; else cache->oldest = entry->newer;
+}
+
+static void PushNewest(querycache *cache, querycacheentry *entry)
+{
+  entry->newer = NULL;
+  entry->older = cache->newest;
+  if (cache->newest != NULL) cache->newest->newer = entry; else cache->oldest = entry;
+  cache->newest = entry;
+}
+
+static void Remove(querycache *cache, querycacheentry *entry)
+{
+  querycacheentry **slot = FindSlot(cache, entry->query);
+  assert(*slot == entry);
+  *slot = entry->bucketNext;
+  Unlink(cache, entry);
+  cache->stats.entries--;
+  cache->stats.bytes -= entry->bytes;
+  free(entry->query);
+  free(entry->results);
+  free(entry);
+}
+
+static void RemoveAll(querycache *cache)
+{
+  while (cache->oldest != NULL) Remove(cache, cache->oldest);
+}
+
+void QueryCacheNew(querycache *cache, int maxEntries, long maxBytes)
+{
+  assert(maxEntries >= 0 && maxBytes >= 0);
+  assert(maxEntries > 0 || maxBytes > 0);
+  cache->numBuckets = kNumBuckets;
+  cache->buckets = calloc(cache->numBuckets, sizeof(querycacheentry *));
+  assert(cache->buckets != NULL);
+  cache->newest = cache->oldest = NULL;
+  cache->version = 0;
+  cache->maxEntries = maxEntries;
+  cache->maxBytes = maxBytes;
+  memset(&cache->stats, 0, sizeof(cache->stats));
+  cache->stats.maxEntries = maxEntries;
+  cache->stats.maxBytes = maxBytes;
+  pthread_mutex_init(&cache->lock, NULL);
+}
+
+void QueryCacheDispose(querycache *cache)
+{
+  RemoveAll(cache);
+  free(cache->buckets);
+  pthread_mutex_destroy(&cache->lock);
+}
+
+// Drops everything cached against older versions of the index, and returns false if the
+// caller is the one still working against an older version (versions only ever increase)
+static bool SyncVersion(querycache *cache, unsigned long version)
+{
+  if (version == cache->version) return true;
+  if (version < cache->version) return false;
+  if (cache->stats.entries > 0) cache->stats.invalidations++;
+  RemoveAll(cache);
+  cache->version = version;
+  return true;
+}
+
+bool QueryCacheLookup(querycache *cache, const char *query, unsigned long version, vector *results)
+{
+  char key[1024];
+  NormalizeQuery(query, key, sizeof(key));
+  pthread_mutex_lock(&cache->lock);
+  querycacheentry *entry = SyncVersion(cache, version) ? *FindSlot(cache, key) : NULL;
+  if (entry == NULL) {
+    cache->stats.misses++;
+    pthread_mutex_unlock(&cache->lock);
+    return false;
+  }
+
+  cache->stats.hits++;
+  Unlink(cache, entry);
+  PushNewest(cache, entry);
+  for (int i = 0; i < entry->numResults; i++) VectorAppend(results, &entry->results[i]);
+  pthread_mutex_unlock(&cache->lock);
+  return true;
+}
+
+void QueryCacheInsert(querycache *cache, const char *query, unsigned long version, const vector *results)
+{
+  char key[1024];
+  NormalizeQuery(query, key, sizeof(key));
+  int numResults = VectorLength(results);
+  long bytes = sizeof(querycacheentry) + strlen(key) + 1 + numResults * sizeof(match);
+  if (cache->maxBytes > 0 && bytes > cache->maxBytes) return;
+
+  querycacheentry *entry = malloc(sizeof(querycacheentry));
+  entry->query = strdup(key);
+  entry->numResults = numResults;
+  entry->results = malloc(numResults * sizeof(match) + 1); // + 1 so empty lists still get a pointer
+  for (int i = 0; i < numResults; i++) entry->results[i] = *(const match *) VectorNth(results, i);
+  entry->bytes = bytes;
+  entry->bucketNext = NULL;
+
+  pthread_mutex_lock(&cache->lock);
+  if (!SyncVersion(cache, version)) {
+    pthread_mutex_unlock(&cache->lock);
+    free(entry->query);
+    free(entry->results);
+    free(entry);
+    return;
+  }
+  querycacheentry **slot = FindSlot(cache, key);
+  if (*slot != NULL) Remove(cache, *slot);
+  *FindSlot(cache, key) = entry;
+  PushNewest(cache, entry);
+  cache->stats.entries++;
+  cache->stats.bytes += bytes;
+
+  while ((cache->maxEntries > 0 && cache->stats.entries > cache->maxEntries) ||
+	 (cache->maxBytes > 0 && cache->stats.bytes > cache->maxBytes)) {
+    Remove(cache, cache->oldest);
+    cache->stats.evictions++;
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void QueryCacheGetStats(querycache *cache, querycachestats *stats)
+{
+  pthread_mutex_lock(&cache->lock);
+  *stats = cache->stats;
+  pthread_mutex_unlock(&cache->lock);
+}
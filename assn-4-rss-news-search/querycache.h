@@ -0,0 +1,134 @@
+/**
+ * File: querycache.h
+ * ------------------
+ * Defines the interface for the query cache, a bounded LRU cache of
+ * ranked result lists keyed on the normalized query string.
+ *
+ * Queries are normalized before they're used as keys: leading and trailing
+ * whitespace is dropped, interior runs of whitespace collapse to a single
+ * space, and letters are folded to lower case, since the index itself
+ * matches words case-insensitively.
+ *
+ * Every cached list is tagged with the version of the index that produced
+ * it.  The index bumps its version whenever it changes, and the first lookup
+ * against a newer version throws away everything cached so far, so stale
+ * rankings are never served.  Versions only ever increase, so lookups and
+ * inserts made on behalf of an older version are simply treated as misses.
+ *
+ * The cache can be bounded by number of entries, by bytes, or both; once
+ * either limit is exceeded, the least recently used entries are evicted.
+ *
+ * All of the functions below may be called from several threads at once.
+ */
+
+#ifndef __querycache_
+#define __querycache_
+
+#include <pthread.h>
+#include "bool.h"
+#include "vector.h"
+#include "newsindex.h"
+
+/**
+ * Type: querycacheentry
+ * ---------------------
+ * A single cached result list.  Entries are chained together both
+ * within a hash bucket and along the recency list.
+ */
+
+typedef struct querycacheentry {
+  char *query;                         // normalized query
+  match *results;                      // numResults matches, best first
+  int numResults;
+  long bytes;                          // everything this entry accounts for
+  struct querycacheentry *bucketNext;
+  struct querycacheentry *newer;
+  struct querycacheentry *older;
+} querycacheentry;
+
+/**
+ * Type: querycachestats
+ * ---------------------
+ * Snapshot of the cache's counters, as reported by QueryCacheGetStats.
+ */
+
+typedef struct {
+  long hits;
+  long misses;
+  long evictions;
+  long invalidations;   // number of times a new index version flushed the cache
+  int entries;
+  long bytes;
+  int maxEntries;
+  long maxBytes;
+} querycachestats;
+
+/**
+ * Type: querycache
+ * ----------------
+ * The concrete representation of the cache.  The hashset can't be used
+ * here because it has no way to remove an element, and eviction needs
+ * exactly that.
+ */
+
+typedef struct {
+  querycacheentry **buckets;
+  int numBuckets;
+  querycacheentry *newest;
+  querycacheentry *oldest;
+  unsigned long version;
+  int maxEntries;
+  long maxBytes;
+  querycachestats stats;
+  pthread_mutex_t lock;    // guards everything above, since lookups reorder the recency list
+} querycache;
+
+/**
+ * Function: QueryCacheNew
+ * -----------------------
+ * Initializes the cache to be empty.  maxEntries bounds the number of
+ * cached queries and maxBytes bounds the memory they consume; pass 0 for
+ * either one to leave that dimension unbounded.  An assert is raised if
+ * both are 0.
+ */
+
+void QueryCacheNew(querycache *cache, int maxEntries, long maxBytes);
+
+/**
+ * Function: QueryCacheDispose
+ * ---------------------------
+ * Releases every cached entry and the cache's own storage.
+ */
+
+void QueryCacheDispose(querycache *cache);
+
+/**
+ * Function: QueryCacheLookup
+ * --------------------------
+ * Searches the cache for the specified query as answered by the given index
+ * version.  On a hit, the cached matches are appended to results (which must
+ * have been initialized by the client to hold matches) and true is returned.
+ * On a miss, false is returned and results is left alone.
+ */
+
+bool QueryCacheLookup(querycache *cache, const char *query, unsigned long version, vector *results);
+
+/**
+ * Function: QueryCacheInsert
+ * --------------------------
+ * Caches a copy of the ranked matches in results as the answer to query
+ * under the specified index version, evicting older entries as necessary.
+ * Result lists too large to ever fit within the byte budget are not cached.
+ */
+
+void QueryCacheInsert(querycache *cache, const char *query, unsigned long version, const vector *results);
+
+/**
+ * Function: QueryCacheGetStats
+ * ----------------------------
+ * Copies the cache's current counters into the specified record.
+ */
+
+void QueryCacheGetStats(querycache *cache, querycachestats *stats);
+
+#endif
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "queryserver.h"
+
+static const int kListenBacklog = 128;
+
+struct connection {
+  int fd;
+  QueryServerHandler handler;
+  void *auxData;
+};
+
+static void *ServeConnection(void *aux)
+{
+  struct connection *conn = aux;
+  FILE *in = fdopen(conn->fd, "r");
+  FILE *out = fdopen(dup(conn->fd), "w");
+  char query[kQueryServerMaxLineLength];
+
+  while (in != NULL && out != NULL && fgets(query, sizeof(query), in) != NULL) {
+    if (strchr(query, '\n') == NULL && !feof(in)) {
+      int ch;
+      while ((ch = getc(in)) != '\n' && ch != EOF) ; // the rest of an over-long line
+      conn->handler(NULL, out, conn->auxData);
+    } else {
+      query[strcspn(query, "\r\n")] = '\0';
+      conn->handler(query, out, conn->auxData);
+    }
+    if (fflush(out) == EOF) break; // client went away
+  }
+
+  if (in != NULL) fclose(in);
+  if (out != NULL) fclose(out);
+  free(conn);
+  return NULL;
+}
+
+int QueryServerRun(unsigned short port, QueryServerHandler handler, void *auxData)
+{
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  int on = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(listener, kListenBacklog) < 0) {
+    perror("bind/listen");
+    close(listener);
+    return -1;
+  }
+
+  signal(SIGPIPE, SIG_IGN); // a client hanging up mid-reply shouldn't take the server down
+  printf("Serving queries on 127.0.0.1:%d\n", port);
+  fflush(stdout);
+  while (1) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) continue;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // replies are small and latency matters
+    struct connection *conn = malloc(sizeof(struct connection));
+    conn->fd = fd;
+    conn->handler = handler;
+    conn->auxData = auxData;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ServeConnection, conn) != 0) {
+      close(fd);
+      free(conn);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  return 0;
+}
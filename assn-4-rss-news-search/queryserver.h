@@ -0,0 +1,51 @@
+/**
+ * File: queryserver.h
+ * -------------------
+ * Defines a small line-oriented TCP server used to answer queries against
+ * an index that's been built (or loaded) once.  The server listens on the
+ * loopback interface only, and hands each connection its own thread.  Each
+ * line a client sends is passed to a client-supplied handler along with a
+ * FILE * on which to write the reply; the server flushes the reply once
+ * the handler returns.  The server knows nothing about the reply format,
+ * which is entirely the handler's business.
+ */
+
+#ifndef __queryserver_
+#define __queryserver_
+
+#include <stdio.h>
+
+/**
+ * Constant: kQueryServerMaxLineLength
+ * -----------------------------------
+ * The longest line, end-of-line characters included, that's read as a
+ * query.  The rest of a longer line is read and discarded.
+ */
+
+#define kQueryServerMaxLineLength 1024
+
+/**
+ * Type: QueryServerHandler
+ * ------------------------
+ * Class of function called once for every line received by the server.
+ * query is the line with its end-of-line characters removed, or NULL if
+ * the line was longer than kQueryServerMaxLineLength, reply is the
+ * connection's output stream, and auxData is whatever was passed to
+ * QueryServerRun.  An over-long line is answered just once, so the
+ * replies stay in step with the lines.  Handlers are called from many
+ * threads at once.
+ */
+
+typedef void (*QueryServerHandler)(const char *query, FILE *reply, void *auxData);
+
+/**
+ * Function: QueryServerRun
+ * ------------------------
+ * Listens on 127.0.0.1 at the specified port and serves connections until
+ * the process is terminated.  If the listening socket can't be established,
+ * an error is printed and -1 is returned.
+ */
+
+int QueryServerRun(unsigned short port, QueryServerHandler handler, void *auxData);
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * File: rss-corpusgen.c
+ * ---------------------
+ * Generates a synthetic corpus of RSS feeds and HTML articles in the format
+ * read by rss-news-search --replay, so indexing can be measured at sizes no
+ * real crawl would reach.  Everything is derived from a seeded pseudo-random
+ * generator, so the same options always produce the same corpus.
+ *
+ *   rss-corpusgen --out <dir> [--articles <n>] [--words <n>] [--vocabulary <n>]
+ *                 [--zipf <s>] [--duplicates <fraction>] [--near-duplicates <fraction>]
+ *                 [--edit-rate <fraction>] [--items-per-feed <n>] [--seed <n>]
+ *                 [--queries <n> [--query-terms <n>]] [--days <n>]
+ *
+ *   --articles         number of distinct articles (default 1000)
+ *   --words            mean number of words per article; actual lengths vary
+ *                      uniformly between half and one and a half times this (default 300)
+ *   --vocabulary       number of distinct words (default 50000)
+ *   --zipf             exponent of the Zipfian distribution words are drawn from;
+ *                      the word of rank r appears with probability proportional
+ *                      to 1/r^s (default 1.0)
+ *   --duplicates       fraction of feed items that link to an article some earlier
+ *                      item already linked to, as happens when stories are syndicated
+ *                      across feeds (default 0.1)
+ *   --near-duplicates  fraction of the distinct articles that are lightly edited copies
+ *                      of earlier ones, under URLs and titles of their own, as when one
+ *                      wire story is republished by several sites (default 0)
+ *   --edit-rate        fraction of a near-duplicate's words that differ from the
+ *                      original's (default 0.02)
+ *   --items-per-feed   number of items in each feed (default 1000)
+ *   --queries          number of queries to write to <dir>/queries.txt, for load
+ *                      testing the indexed corpus (default 0, for no query file)
+ *   --query-terms      number of words in each query, drawn as the articles'
+ *                      words are (default 2)
+ *   --days             give every item a <pubDate>, spreading the articles evenly over
+ *                      this many days, in order, from kFirstDay on, so later articles are
+ *                      newer news (default 0, for items without dates)
+ *
+ * Besides the corpus entries, the generator writes <dir>/feeds.txt, a feed list
+ * naming every generated feed, so the corpus can be indexed with
+ *
+ *   rss-news-search --feeds <dir>/feeds.txt --replay <dir>
+ *
+ * (the feed list path must be absolute unless it lives in the data directory).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <getopt.h>
+#include "bool.h"
+#include "corpus.h"
+#include "synthetic.h"
+#include "pubdate.h"
+
+static const char *const kServer = "synthetic.invalid";
+static const time_t kFirstDay = 1114300800;  // Sun, 24 Apr 2005 00:00:00 GMT
+
+typedef struct {
+  const char *outputDirectory;
+  long numArticles;
+  int meanWords;
+  int vocabularySize;
+  double zipfExponent;
+  double duplicateRate;
+  double nearDuplicateRate;
+  double editRate;
+  int itemsPerFeed;
+  unsigned long long seed;
+  long numQueries;
+  int queryTerms;
+  int numDays;
+} generatoroptions;
+
+static unsigned long long state;
+
+// Writes article id, as a near-duplicate of article originalID unless originalID is -1
+static void WriteArticle(long id, long originalID, double editRate, const synthetictext *text,
+			 const char *outputDirectory)
+{
+  char fullName[256];
+  corpusentry entry;
+  sprintf(fullName, "http://%s/articles/%ld.html", kServer, id);
+  if (!CorpusEntryBegin(&entry, fullName, 200, "OK", "text/html", "")) {
+    fprintf(stderr, "Unable to write \"%s\" into \"%s\".\n", fullName, outputDirectory);
+    exit(1);
+  }
+  if (originalID == -1) SyntheticWriteArticle(text, id, entry.document);
+  else SyntheticWriteNearDuplicate(text, id, originalID, editRate, entry.document);
+  CorpusEntryEnd(&entry);
+}
+
+static void BeginFeed(corpusentry *entry, int feed, FILE *feedList, const char *outputDirectory)
+{
+  char fullName[256], link[256];
+  sprintf(fullName, "http://%s/feeds/%d.xml", kServer, feed);
+  sprintf(link, "http://%s/", kServer);
+  if (!CorpusEntryBegin(entry, fullName, 200, "OK", "text/xml", "")) {
+    fprintf(stderr, "Unable to write \"%s\" into \"%s\".\n", fullName, outputDirectory);
+    exit(1);
+  }
+  fprintf(feedList, "Synthetic Feed %d: %s\n", feed, fullName);
+  SyntheticWriteFeedStart(entry->document, feed, link);
+}
+
+static void EndFeed(corpusentry *entry)
+{
+  SyntheticWriteFeedEnd(entry->document);
+  CorpusEntryEnd(entry);
+}
+
+// Writes the query file, which draws on streams of its own, so the corpus is the same with or without it
+static void WriteQueries(const synthetictext *text, const generatoroptions *opts)
+{
+  char queryFileName[1200];
+  sprintf(queryFileName, "%s/queries.txt", opts->outputDirectory);
+  FILE *outfile = fopen(queryFileName, "w");
+  if (outfile == NULL) {
+    fprintf(stderr, "Unable to create \"%s\".\n", queryFileName);
+    exit(1);
+  }
+  for (long id = 0; id < opts->numQueries; id++) SyntheticWriteQuery(text, id, opts->queryTerms, outfile);
+  fclose(outfile);
+}
+
+/**
+ * Function: GenerateCorpus
+ * ------------------------
+ * Writes every article, and spreads links to them over as many feeds as needed.
+ * Each item either introduces the next new article or, with probability
+ * duplicateRate, links again to one of the articles introduced so far.  A new
+ * article is, with probability nearDuplicateRate, a near-duplicate of one of the
+ * original (not near-duplicate) articles introduced so far.
+ */
+
+static void GenerateCorpus(const generatoroptions *opts)
+{
+  synthetictext text;
+  SyntheticTextNew(&text, opts->vocabularySize, opts->zipfExponent, opts->meanWords, opts->seed);
+
+  char feedListName[1200];
+  sprintf(feedListName, "%s/feeds.txt", opts->outputDirectory);
+  FILE *feedList = fopen(feedListName, "w");
+  if (feedList == NULL) {
+    fprintf(stderr, "Unable to create \"%s\".\n", feedListName);
+    exit(1);
+  }
+
+  long *originals = malloc(opts->numArticles * sizeof(long));
+  assert(originals != NULL);
+  long numOriginals = 0;
+
+  corpusentry feed;
+  long articlesWritten = 0, items = 0;
+  int numFeeds = 0;
+  while (articlesWritten < opts->numArticles) {
+    if (items % opts->itemsPerFeed == 0) {
+      if (items > 0) EndFeed(&feed);
+      BeginFeed(&feed, numFeeds++, feedList, opts->outputDirectory);
+    }
+    long id;
+    if (articlesWritten > 0 && SyntheticUniform(&state) < opts->duplicateRate) {
+      id = SyntheticRandom(&state) % articlesWritten;
+    } else {
+      id = articlesWritten++;
+      long originalID = -1;
+      if (opts->nearDuplicateRate > 0 && numOriginals > 0 && SyntheticUniform(&state) < opts->nearDuplicateRate)
+	originalID = originals[SyntheticRandom(&state) % numOriginals];
+      else originals[numOriginals++] = id;
+      WriteArticle(id, originalID, opts->editRate, &text, opts->outputDirectory);
+    }
+    char articleURL[256], pubDate[32];
+    sprintf(articleURL, "http://%s/articles/%ld.html", kServer, id);
+    if (opts->numDays > 0)  // the day spread evenly by id, and the hour by id as well, so times vary within the day
+      FormatPubDate(kFirstDay + (time_t) (id * opts->numDays / opts->numArticles) * 24 * 60 * 60 + (id % 24) * 60 * 60,
+		    pubDate, sizeof(pubDate));
+    SyntheticWriteFeedItem(feed.document, id, articleURL, opts->numDays > 0 ? pubDate : NULL);
+    items++;
+  }
+  if (items > 0) EndFeed(&feed);
+  fclose(feedList);
+
+  printf("Wrote %ld articles (%ld near-duplicates) in %d feeds (%ld items) to \"%s\".\n",
+	 articlesWritten, articlesWritten - numOriginals, numFeeds, items, opts->outputDirectory);
+  free(originals);
+  if (opts->numQueries > 0) WriteQueries(&text, opts);
+  SyntheticTextDispose(&text);
+}
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "Usage: %s --out <dir> [--articles n] [--words n] [--vocabulary n] [--zipf s] "
+	  "[--duplicates fraction] [--near-duplicates fraction] [--edit-rate fraction] "
+	  "[--items-per-feed n] [--seed n] [--queries n [--query-terms n]] [--days n]\n", program);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option kLongOptions[] = {
+    { "out", required_argument, NULL, 'o' },
+    { "articles", required_argument, NULL, 'a' },
+    { "words", required_argument, NULL, 'w' },
+    { "vocabulary", required_argument, NULL, 'v' },
+    { "zipf", required_argument, NULL, 'z' },
+    { "duplicates", required_argument, NULL, 'd' },
+    { "near-duplicates", required_argument, NULL, 'n' },
+    { "edit-rate", required_argument, NULL, 'e' },
+    { "items-per-feed", required_argument, NULL, 'i' },
+    { "seed", required_argument, NULL, 's' },
+    { "queries", required_argument, NULL, 'q' },
+    { "query-terms", required_argument, NULL, 't' },
+    { "days", required_argument, NULL, 'D' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  generatoroptions opts = { NULL, 1000, 300, 50000, 1.0, 0.1, 0, 0.02, 1000, 107, 0, 2, 0 };
+  int c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'o': opts.outputDirectory = optarg; break;
+      case 'a': opts.numArticles = atol(optarg); break;
+      case 'w': opts.meanWords = atoi(optarg); break;
+      case 'v': opts.vocabularySize = atoi(optarg); break;
+      case 'z': opts.zipfExponent = atof(optarg); break;
+      case 'd': opts.duplicateRate = atof(optarg); break;
+      case 'n': opts.nearDuplicateRate = atof(optarg); break;
+      case 'e': opts.editRate = atof(optarg); break;
+      case 'i': opts.itemsPerFeed = atoi(optarg); break;
+      case 's': opts.seed = strtoull(optarg, NULL, 10); break;
+      case 'q': opts.numQueries = atol(optarg); break;
+      case 't': opts.queryTerms = atoi(optarg); break;
+      case 'D': opts.numDays = atoi(optarg); break;
+      default: Usage(argv[0]);
+    }
+  }
+  if (opts.outputDirectory == NULL || opts.numArticles < 1 || opts.meanWords < 1 || opts.vocabularySize < 1 ||
+      opts.zipfExponent < 0 || opts.duplicateRate < 0 || opts.duplicateRate >= 1 || opts.itemsPerFeed < 1 ||
+      opts.nearDuplicateRate < 0 || opts.nearDuplicateRate >= 1 || opts.editRate < 0 || opts.editRate > 1 ||
+      opts.numQueries < 0 || opts.queryTerms < 1 || opts.numDays < 0)
+    Usage(argv[0]);
+
+  state = SyntheticSeed(opts.seed, -1); // articles use streams 0, 1, 2, ..., so feeds use another
+  CorpusSetMode(kCorpusRecord, opts.outputDirectory);
+  GenerateCorpus(&opts);
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * File: rss-feedbench.c
+ * ---------------------
+ * Measures how fast feeds are parsed.  The feed named on the command line
+ * (sample-rss-feed.txt, say) is scaled up by repeating its items, and the
+ * result is parsed from memory, repeatedly, both by the feedparser that
+ * rss-news-search uses and by the tag-at-a-time loop it used before:
+ * GetNextTag to find each <item>, then GetNextTag and a strncasecmp against
+ * every field's tag prefix for each tag within it.  Both hand each item's
+ * decoded title, link and description to the same trivial consumer, which
+ * checksums them so the two parsers can be checked against each other.
+ *
+ *   rss-feedbench [--copies <n>] [--rounds <n>] <feed file>
+ *
+ *   --copies   number of times the feed's items are repeated (default 2000)
+ *   --rounds   number of times each parser parses the scaled feed (default 5)
+ *
+ * One line per parser is printed, giving items and megabytes parsed per
+ * second over all the rounds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <getopt.h>
+#include "bool.h"
+#include "streamtokenizer.h"
+#include "html-utils.h"
+#include "feedparser.h"
+#include "latency.h"
+
+static const char *const kTextDelimiters = " \t\n\r\b!@$%^*()_+={[}]|\\'\":;/?.>,<~`";
+
+typedef struct {
+  long items;
+  unsigned long checksum;
+} tally;
+
+static void Consume(tally *t, const char *title, const char *link, const char *description)
+{
+  t->items++;
+  for (const char *fields[] = { title, link, description }, **f = fields; f < fields + 3; f++)
+    for (const char *c = *f; *c != '\0'; c++) t->checksum = t->checksum * 31 + (unsigned char) *c;
+}
+
+static void ConsumeItem(feeditem *item, void *auxData)
+{
+  for (int f = 0; f < kNumFeedFields; f++) {
+    if (item->fields[f].length > 1023) item->fields[f].text[1023] = '\0';
+    RemoveEscapeCharacters(item->fields[f].text);
+  }
+  Consume(auxData, item->fields[kFeedTitle].text, item->fields[kFeedLink].text, item->fields[kFeedDescription].text);
+}
+
+static void ParseWithFeedParser(FILE *infile, tally *t)
+{
+  feedparser parser;
+  FeedParserNew(&parser, ConsumeItem, t);
+  FeedParserParse(&parser, infile);
+  FeedParserDispose(&parser);
+}
+
+// The element extraction rss-news-search did before it used the feedparser
+static void ExtractElement(streamtokenizer *st, const char *htmlTag, char dataBuffer[], int bufferLength)
+{
+  if (htmlTag[strlen(htmlTag) - 2] == '/') return;
+  STNextTokenUsingDifferentDelimiters(st, dataBuffer, bufferLength, "<");
+  RemoveEscapeCharacters(dataBuffer);
+  if (dataBuffer[0] == '<') strcpy(dataBuffer, "");
+  STSkipUntil(st, ">");
+  STSkipOver(st, ">");
+}
+
+static void ParseWithTagLoop(FILE *infile, tally *t)
+{
+  streamtokenizer st;
+  char htmlTag[1024], title[1024], description[1024], link[1024];
+  STNew(&st, infile, kTextDelimiters, false);
+  while (GetNextTag(&st, htmlTag, sizeof(htmlTag))) {
+    if (strncasecmp(htmlTag, "<item", strlen("<item")) != 0) continue;
+    title[0] = description[0] = link[0] = '\0';
+    while (GetNextTag(&st, htmlTag, sizeof(htmlTag)) && strcasecmp(htmlTag, "</item>") != 0) {
+      if (strncasecmp(htmlTag, "<title", strlen("<title")) == 0) ExtractElement(&st, htmlTag, title, sizeof(title));
+      if (strncasecmp(htmlTag, "<description", strlen("<description")) == 0)
+	ExtractElement(&st, htmlTag, description, sizeof(description));
+      if (strncasecmp(htmlTag, "<link", strlen("<link")) == 0) ExtractElement(&st, htmlTag, link, sizeof(link));
+    }
+    Consume(t, title, link, description);
+  }
+  STDispose(&st);
+}
+
+// Reads the whole of the named file into a null-terminated buffer
+static char *ReadFile(const char *fileName, long *length)
+{
+  FILE *infile = fopen(fileName, "r");
+  if (infile == NULL) return NULL;
+  fseek(infile, 0, SEEK_END);
+  *length = ftell(infile);
+  rewind(infile);
+  char *contents = malloc(*length + 1);
+  assert(contents != NULL);
+  *length = fread(contents, 1, *length, infile);
+  contents[*length] = '\0';
+  fclose(infile);
+  return contents;
+}
+
+// Builds the scaled feed: everything before the first <item>, the items themselves copies
+// times over, then everything after the last </item>
+static char *ScaleFeed(const char *feed, int copies, long *length)
+{
+  const char *first = strstr(feed, "<item");
+  const char *last = NULL;
+  for (const char *end = first; end != NULL; end = strstr(end + 1, "</item>")) last = end;
+  if (first == NULL || last == NULL || last == first) return NULL;
+  last += strlen("</item>");
+  long head = first - feed, items = last - first, tail = strlen(last);
+  *length = head + items * copies + tail;
+  char *scaled = malloc(*length + 1);
+  assert(scaled != NULL);
+  memcpy(scaled, feed, head);
+  for (int i = 0; i < copies; i++) memcpy(scaled + head + i * items, first, items);
+  strcpy(scaled + head + items * copies, last);
+  return scaled;
+}
+
+static void Run(const char *name, void (*parse)(FILE *, tally *), char *feed, long length, int rounds)
+{
+  tally t = { 0, 0 };
+  long long start = MonotonicNanos();
+  for (int r = 0; r < rounds; r++) {
+    FILE *infile = fmemopen(feed, length, "r");
+    assert(infile != NULL);
+    parse(infile, &t);
+    fclose(infile);
+  }
+  double seconds = (MonotonicNanos() - start) / 1e9;
+  printf("%-12s items %ld  bytes %ld  seconds %.3f  items/sec %.0f  MB/sec %.1f  checksum %016lx\n",
+	 name, t.items, length * rounds, seconds, t.items / seconds, length * rounds / seconds / 1e6, t.checksum);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option kLongOptions[] = {
+    { "copies", required_argument, NULL, 'c' },
+    { "rounds", required_argument, NULL, 'r' },
+    { NULL, 0, NULL, 0 }
+  };
+  int copies = 2000, rounds = 5, c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'c': copies = atoi(optarg); break;
+      case 'r': rounds = atoi(optarg); break;
+      default: fprintf(stderr, "Usage: %s [--copies n] [--rounds n] <feed file>\n", argv[0]);
+	       return 1;
+    }
+  }
+  if (optind != argc - 1 || copies < 1 || rounds < 1) {
+    fprintf(stderr, "Usage: %s [--copies n] [--rounds n] <feed file>\n", argv[0]);
+    return 1;
+  }
+
+  long length;
+  char *feed = ReadFile(argv[optind], &length);
+  if (feed == NULL) {
+    fprintf(stderr, "Unable to read \"%s\".\n", argv[optind]);
+    return 1;
+  }
+  char *scaled = ScaleFeed(feed, copies, &length);
+  if (scaled == NULL) {
+    fprintf(stderr, "\"%s\" doesn't hold any <item> elements.\n", argv[optind]);
+    return 1;
+  }
+  Run("feedparser", ParseWithFeedParser, scaled, length, rounds);
+  Run("tag-loop", ParseWithTagLoop, scaled, length, rounds);
+  free(scaled);
+  free(feed);
+  return 0;
+}
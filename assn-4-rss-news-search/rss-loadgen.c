@@ -0,0 +1,195 @@
+/**
+ * File: rss-loadgen.c
+ * -------------------
+ * Load generator for rss-news-search's server mode.  It opens a number of
+ * concurrent client connections to the server, has each one issue queries
+ * drawn round-robin from a query file (one query per line), and waits for
+ * every reply before sending the next query on that connection.  Once all
+ * requests have been answered, it prints the overall throughput and the
+ * latency percentiles as seen by the clients.
+ *
+ *   rss-loadgen --port <port> --queries <file> [--host <addr>] [--clients <n>] [--requests <n>]
+ *
+ * The reply format it expects is documented with ServeQuery in rss-news-search.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "bool.h"
+#include "latency.h"
+
+static const char *const kDefaultHost = "127.0.0.1";
+static const int kDefaultClients = 8;
+static const int kDefaultRequests = 100000;
+
+struct loadclient {
+  int id;
+  int numRequests;
+  const char *host;
+  unsigned short port;
+  char **queries;
+  int numQueries;
+  latencysamples latencies;
+  int failures;
+};
+
+static FILE *Connect(const char *host, unsigned short port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return NULL;
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    return NULL;
+  }
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return fdopen(fd, "r+");
+}
+
+// Sends one query and reads the complete reply, returning false if the connection failed
+static bool Request(FILE *conn, const char *query)
+{
+  char line[4096];
+  int matches, listed;
+  fprintf(conn, "%s\n", query);
+  if (fflush(conn) == EOF) return false;
+  if (fgets(line, sizeof(line), conn) == NULL) return false;
+  if (sscanf(line, "%*s %d %d", &matches, &listed) != 2) return false;
+  for (int i = 0; i < listed; i++) {
+    if (fgets(line, sizeof(line), conn) == NULL) return false;
+  }
+  return true;
+}
+
+static void *RunClient(void *aux)
+{
+  struct loadclient *client = aux;
+  FILE *conn = Connect(client->host, client->port);
+  if (conn == NULL) {
+    client->failures = client->numRequests;
+    return NULL;
+  }
+
+  for (int i = 0; i < client->numRequests; i++) {
+    const char *query = client->queries[(client->id + i) % client->numQueries];
+    long long start = MonotonicNanos();
+    if (!Request(conn, query)) {
+      client->failures += client->numRequests - i;
+      break;
+    }
+    LatencyRecord(&client->latencies, MonotonicNanos() - start);
+  }
+
+  fclose(conn);
+  return NULL;
+}
+
+static int ReadQueries(const char *fileName, char ***queries)
+{
+  FILE *infile = fopen(fileName, "r");
+  if (infile == NULL) return 0;
+  char line[1024];
+  int n = 0, allocated = 0;
+  *queries = NULL;
+  while (fgets(line, sizeof(line), infile) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (strcmp(line, "") == 0) continue;
+    if (n == allocated) {
+      allocated = allocated == 0 ? 64 : 2 * allocated;
+      *queries = realloc(*queries, allocated * sizeof(char *));
+      assert(*queries != NULL);
+    }
+    (*queries)[n++] = strdup(line);
+  }
+  fclose(infile);
+  return n;
+}
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "Usage: %s --port <port> --queries <file> [--host <addr>] [--clients <n>] [--requests <n>]\n", program);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option kLongOptions[] = {
+    { "host", required_argument, NULL, 'h' },
+    { "port", required_argument, NULL, 'p' },
+    { "queries", required_argument, NULL, 'q' },
+    { "clients", required_argument, NULL, 'c' },
+    { "requests", required_argument, NULL, 'n' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  const char *host = kDefaultHost;
+  const char *queryFileName = NULL;
+  int port = 0, numClients = kDefaultClients, numRequests = kDefaultRequests;
+  int c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'h': host = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 'q': queryFileName = optarg; break;
+      case 'c': numClients = atoi(optarg); break;
+      case 'n': numRequests = atoi(optarg); break;
+      default: Usage(argv[0]);
+    }
+  }
+  if (port <= 0 || queryFileName == NULL || numClients < 1 || numRequests < 1) Usage(argv[0]);
+
+  char **queries;
+  int numQueries = ReadQueries(queryFileName, &queries);
+  if (numQueries == 0) {
+    fprintf(stderr, "No queries found in \"%s\".\n", queryFileName);
+    return 1;
+  }
+
+  struct loadclient clients[numClients];
+  pthread_t threads[numClients];
+  long long start = MonotonicNanos();
+  for (int i = 0; i < numClients; i++) {
+    clients[i].id = i;
+    clients[i].numRequests = numRequests / numClients + (i < numRequests % numClients ? 1 : 0);
+    clients[i].host = host;
+    clients[i].port = port;
+    clients[i].queries = queries;
+    clients[i].numQueries = numQueries;
+    clients[i].failures = 0;
+    LatencyNew(&clients[i].latencies);
+    pthread_create(&threads[i], NULL, RunClient, &clients[i]);
+  }
+
+  latencysamples all;
+  LatencyNew(&all);
+  int failures = 0;
+  for (int i = 0; i < numClients; i++) {
+    pthread_join(threads[i], NULL);
+    LatencyMerge(&all, &clients[i].latencies);
+    LatencyDispose(&clients[i].latencies);
+    failures += clients[i].failures;
+  }
+  long long elapsed = MonotonicNanos() - start;
+
+  char label[64];
+  sprintf(label, "Load test (%d clients)", numClients);
+  LatencyReport(&all, stdout, label, elapsed);
+  if (failures > 0) printf("%d requests failed.\n", failures);
+  LatencyDispose(&all);
+  for (int i = 0; i < numQueries; i++) free(queries[i]);
+  free(queries);
+  return failures > 0 ? 1 : 0;
+}
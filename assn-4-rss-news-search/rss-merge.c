@@ -0,0 +1,445 @@
+/**
+ * File: rss-merge.c
+ * -----------------
+ * Combines index files built separately (say, by rss-news-search
+ * --save-index on several machines, each crawling its own share of the
+ * feeds) into a single index file that rss-news-search --load-index can
+ * serve.
+ *
+ *   rss-merge --out <file> [--threads n] [--temp-dir dir] shard...
+ *
+ * Articles are numbered in shard order: the first shard's articles keep
+ * their ids, and each later shard's articles follow on.  An article that
+ * some earlier shard already holds (judged as the indexer judges repeats:
+ * by URL, or by title and server) isn't added again, and its postings are
+ * credited to the earlier copy.  Where both copies have a posting for the
+ * same word, the earlier shard's posting is kept.
+ *
+ * The merge happens in three passes:
+ *
+ *   1. Each shard's article table and dictionary are read, skipping every
+ *      posting list, which gives the merged article table, a map from
+ *      each shard's article ids to merged ones, and the position and
+ *      number of postings of every word in every shard.
+ *   2. The range of words is cut into as many pieces as there are
+ *      threads, each holding about the same number of postings, and each
+ *      thread merges one piece of every shard into a file of its own,
+ *      reading from the first word of its piece (found in pass 1) and
+ *      holding only the postings of one word at a time.
+ *   3. The article table and then the threads' files, in order, are
+ *      written to the output.  Those files are copied as they are,
+ *      without decoding a single posting.
+ *
+ * Pass 2 is where nearly all of the time goes, and its threads share
+ * nothing but the shard files, so the merge runs about as many times
+ * faster as there are cores to run it on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "bool.h"
+#include "hashset.h"
+#include "vector.h"
+#include "hashsets-functions.h"
+#include "indexfile.h"
+#include "latency.h"
+
+static const int kArticleBuckets = 100003;
+static const int kMaxThreads = 64;
+
+typedef struct {
+  char *word;
+  long offset;      // where the word begins in the shard's file
+  int numPostings;
+} dictentry;
+
+typedef struct {
+  const char *fileName;
+  int numArticles;
+  int *docMap;      // docMap[id] is the merged id of the shard's article id
+  bool inOrder;     // whether docMap is increasing, so remapped postings stay sorted
+  dictentry *words;
+  int numWords;
+} shard;
+
+typedef struct {
+  shard *shards;
+  int numShards;
+  int *first;       // first[s] is the shard s word this piece starts at
+  int *count;       // and count[s] the number of its words in the piece
+  char segmentName[1024];
+  long numWords, numPostings;
+  bool ok;
+} piece;
+
+typedef struct {
+  indexreader reader;
+  int shard;
+  int wordsLeft;
+  const char *word;
+  int numPostings;
+} shardcursor;
+
+typedef struct {
+  int docID;
+  int freq;
+  int seq;          // the order it was read in, so the earliest shard's copy sorts first
+} posting;
+
+static int CompareDictEntries(const void *a, const void *b)
+{
+  return strcasecmp((*(const dictentry **) a)->word, (*(const dictentry **) b)->word);
+}
+
+static int ComparePostings(const void *a, const void *b)
+{
+  const posting *p1 = a, *p2 = b;
+  if (p1->docID != p2->docID) return p1->docID < p2->docID ? -1 : 1;
+  return p1->seq - p2->seq;
+}
+
+/**
+ * Function: ReadShard
+ * -------------------
+ * Pass 1 for one shard: adds the shard's articles that aren't already in
+ * seen to seen and to articles, fills in its docMap, and reads its
+ * dictionary.  Returns the number of its articles that were already seen.
+ */
+
+static int ReadShard(shard *s, hashset *seen, vector *articles)
+{
+  indexreader r;
+  const char *title, *URL, *server, *feed, *word;
+  int duplicateOf, numPostings, repeats = 0;
+  if (!IndexReaderNew(&r, s->fileName)) {
+    fprintf(stderr, "Unable to read the index file \"%s\".\n", s->fileName);
+    exit(1);
+  }
+  s->numArticles = IndexReaderArticleCount(&r);
+  s->docMap = malloc((s->numArticles + 1) * sizeof(int));
+  assert(s->docMap != NULL);
+  s->inOrder = true;
+  for (int id = 0; IndexReaderNextArticle(&r, &title, &URL, &server, &feed, &duplicateOf); id++) {
+    struct article key = { (char *) title, (char *) URL, (char *) server, (char *) feed, -1, -1 }, *keyp = &key;
+    struct article **found = HashSetLookup(seen, &keyp);
+    if (found != NULL) {
+      s->docMap[id] = (*found)->id;
+      repeats++;
+    } else {
+      struct article *art = malloc(sizeof(struct article));
+      art->title = strdup(title);
+      art->URL = strdup(URL);
+      art->server = strdup(server);
+      art->feed = strdup(feed);
+      art->id = VectorLength(articles);
+      art->duplicateOf = duplicateOf == -1 ? -1 : s->docMap[duplicateOf];
+      HashSetEnter(seen, &art);
+      VectorAppend(articles, &art);
+      s->docMap[id] = art->id;
+    }
+    if (id > 0 && s->docMap[id] <= s->docMap[id - 1]) s->inOrder = false;
+  }
+
+  int allocated = 1024;
+  s->words = malloc(allocated * sizeof(dictentry));
+  s->numWords = 0;
+  while (IndexReaderNextWord(&r, &word, &numPostings)) {
+    if (s->numWords == allocated) {
+      allocated *= 2;
+      s->words = realloc(s->words, allocated * sizeof(dictentry));
+      assert(s->words != NULL);
+    }
+    s->words[s->numWords].word = strdup(word);
+    s->words[s->numWords].offset = IndexReaderWordOffset(&r);
+    s->words[s->numWords++].numPostings = numPostings;
+  }
+  if (!IndexReaderComplete(&r)) {
+    fprintf(stderr, "The index file \"%s\" is truncated or damaged.\n", s->fileName);
+    exit(1);
+  }
+  IndexReaderDispose(&r);
+  return repeats;
+}
+
+// Returns the position of the first of the shard's words that doesn't sort before word
+static int LowerBound(const shard *s, const char *word)
+{
+  int low = 0, high = s->numWords;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (strcasecmp(s->words[middle].word, word) < 0) low = middle + 1;
+    else high = middle;
+  }
+  return low;
+}
+
+/**
+ * Function: CutPieces
+ * -------------------
+ * Chooses where each piece's words begin, so that the pieces hold about the
+ * same number of postings, and sets every piece's first and count.  Returns
+ * the number of pieces, which is fewer than requested when there are too few
+ * distinct words to go around.
+ */
+
+static int CutPieces(shard shards[], int numShards, piece pieces[], int numPieces)
+{
+  long total = 0, totalWords = 0, sofar = 0;
+  for (int s = 0; s < numShards; s++) totalWords += shards[s].numWords;
+  dictentry **all = malloc((totalWords + 1) * sizeof(dictentry *));
+  assert(all != NULL);
+  int n = 0;
+  for (int s = 0; s < numShards; s++)
+    for (int i = 0; i < shards[s].numWords; i++) {
+      all[n++] = &shards[s].words[i];
+      total += shards[s].words[i].numPostings;
+    }
+  qsort(all, n, sizeof(dictentry *), CompareDictEntries);
+
+  const char *starts[numPieces + 1];
+  int made = 1;
+  starts[0] = "";
+  for (int i = 0; i < n && made < numPieces; i++) {
+    if (sofar >= total * made / numPieces && strcasecmp(all[i]->word, starts[made - 1]) > 0)
+      starts[made++] = all[i]->word;
+    sofar += all[i]->numPostings;
+  }
+
+  for (int p = 0; p < made; p++) {
+    pieces[p].first = malloc(numShards * sizeof(int));
+    pieces[p].count = malloc(numShards * sizeof(int));
+    for (int s = 0; s < numShards; s++) {
+      pieces[p].first[s] = p == 0 ? 0 : LowerBound(&shards[s], starts[p]);
+      int end = p + 1 == made ? shards[s].numWords : LowerBound(&shards[s], starts[p + 1]);
+      pieces[p].count[s] = end - pieces[p].first[s];
+    }
+  }
+  free(all);
+  return made;
+}
+
+// Cursors are ordered by their current word and then by shard, so that equal words
+// come off the heap earliest shard first
+static bool CursorLess(const shardcursor *c1, const shardcursor *c2)
+{
+  int cmp = strcasecmp(c1->word, c2->word);
+  return cmp < 0 || (cmp == 0 && c1->shard < c2->shard);
+}
+
+static void HeapPush(shardcursor *heap[], int *n, shardcursor *cursor)
+{
+  int i = (*n)++;
+  for (; i > 0 && CursorLess(cursor, heap[(i - 1) / 2]); i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+  heap[i] = cursor;
+}
+
+static shardcursor *HeapPop(shardcursor *heap[], int *n)
+{
+  shardcursor *top = heap[0], *last = heap[--*n];
+  int i = 0;
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= *n) break;
+    if (child + 1 < *n && CursorLess(heap[child + 1], heap[child])) child++;
+    if (!CursorLess(heap[child], last)) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (*n > 0) heap[i] = last;
+  return top;
+}
+
+// Moves the cursor on to its next word within the piece, returning false once there are none
+static bool Advance(shardcursor *cursor)
+{
+  if (cursor->wordsLeft == 0) return false;
+  cursor->wordsLeft--;
+  return IndexReaderNextWord(&cursor->reader, &cursor->word, &cursor->numPostings);
+}
+
+/**
+ * Function: MergePiece
+ * --------------------
+ * Pass 2 for one piece, run in a thread of its own: merges the piece's words
+ * from every shard into the piece's segment file, an index file of words only.
+ */
+
+static void *MergePiece(void *data)
+{
+  piece *p = data;
+  shardcursor cursors[p->numShards], *heap[p->numShards], *popped[p->numShards];
+  int heapSize = 0, numPopped, allocated = 1024;
+  posting *postings = malloc(allocated * sizeof(posting));
+  indexwriter w;
+  p->ok = IndexWriterNew(&w, p->segmentName, 0);
+  if (!p->ok) return NULL;
+  for (int s = 0; s < p->numShards; s++) {
+    shardcursor *cursor = &cursors[s];
+    cursor->shard = s;
+    cursor->wordsLeft = p->count[s];
+    if (cursor->wordsLeft == 0) continue;
+    if (!IndexReaderNew(&cursor->reader, p->shards[s].fileName)) {
+      fprintf(stderr, "Unable to read the index file \"%s\".\n", p->shards[s].fileName);
+      exit(1);
+    }
+    IndexReaderSeekWord(&cursor->reader, p->shards[s].words[p->first[s]].offset);
+    if (Advance(cursor)) HeapPush(heap, &heapSize, cursor);
+  }
+
+  while (heapSize > 0) {
+    int n = 0, docID, freq;
+    bool sorted = true;
+    numPopped = 0;
+    do {
+      popped[numPopped] = HeapPop(heap, &heapSize);
+      shardcursor *cursor = popped[numPopped++];
+      const shard *s = &p->shards[cursor->shard];
+      if (n + cursor->numPostings > allocated) {
+	while (n + cursor->numPostings > allocated) allocated *= 2;
+	postings = realloc(postings, allocated * sizeof(posting));
+	assert(postings != NULL);
+      }
+      sorted = sorted && s->inOrder && numPopped == 1;
+      while (IndexReaderNextPosting(&cursor->reader, &docID, &freq)) {
+	if (docID >= s->numArticles) {
+	  p->ok = false;  // a posting for an article the shard doesn't have
+	  continue;
+	}
+	postings[n].docID = s->docMap[docID];
+	postings[n].freq = freq;
+	postings[n].seq = n;
+	n++;
+      }
+    } while (heapSize > 0 && strcasecmp(heap[0]->word, popped[0]->word) == 0);
+
+    if (!sorted) qsort(postings, n, sizeof(posting), ComparePostings);
+    int unique = 0;
+    for (int i = 0; i < n; i++)
+      if (unique == 0 || postings[i].docID != postings[unique - 1].docID) postings[unique++] = postings[i];
+    if (unique > 0) {
+      IndexWriterBeginWord(&w, popped[0]->word, unique);
+      for (int i = 0; i < unique; i++) IndexWriterAddPosting(&w, postings[i].docID, postings[i].freq);
+      p->numWords++;
+      p->numPostings += unique;
+    }
+    for (int i = 0; i < numPopped; i++)
+      if (Advance(popped[i])) HeapPush(heap, &heapSize, popped[i]);
+  }
+
+  for (int s = 0; s < p->numShards; s++) {
+    if (p->count[s] == 0) continue;
+    if (cursors[s].reader.damaged) p->ok = false;
+    IndexReaderDispose(&cursors[s].reader);
+  }
+  free(postings);
+  if (!IndexWriterClose(&w)) p->ok = false;
+  return NULL;
+}
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "Usage: %s --out <file> [--threads n] [--temp-dir dir] shard...\n", program);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option kLongOptions[] = {
+    { "out", required_argument, NULL, 'o' },
+    { "threads", required_argument, NULL, 't' },
+    { "temp-dir", required_argument, NULL, 'd' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  const char *outputFile = NULL, *tempDirectory = "/tmp";
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN), c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'o': outputFile = optarg; break;
+      case 't': numThreads = atoi(optarg); break;
+      case 'd': tempDirectory = optarg; break;
+      default: Usage(argv[0]);
+    }
+  }
+  if (outputFile == NULL || optind == argc || numThreads < 1) Usage(argv[0]);
+  if (numThreads > kMaxThreads) numThreads = kMaxThreads;
+
+  long long start = MonotonicNanos();
+  int numShards = argc - optind, repeats = 0, shardArticles = 0;
+  long bytesIn = 0;
+  shard shards[numShards];
+  hashset seen;
+  vector articles;
+  HashSetNew(&seen, sizeof(struct article *), kArticleBuckets, ArticleHash, ArticleCmp, NULL);
+  VectorNew(&articles, sizeof(struct article *), FreeArticle, 0);
+  for (int s = 0; s < numShards; s++) {
+    struct stat info;
+    shards[s].fileName = argv[optind + s];
+    if (stat(shards[s].fileName, &info) == 0) bytesIn += info.st_size;
+    repeats += ReadShard(&shards[s], &seen, &articles);
+    shardArticles += shards[s].numArticles;
+  }
+  HashSetDispose(&seen);
+
+  piece pieces[numThreads];
+  pthread_t threads[numThreads];
+  int numPieces = CutPieces(shards, numShards, pieces, numThreads);
+  for (int p = 0; p < numPieces; p++) {
+    pieces[p].shards = shards;
+    pieces[p].numShards = numShards;
+    pieces[p].numWords = pieces[p].numPostings = 0;
+    snprintf(pieces[p].segmentName, sizeof(pieces[p].segmentName), "%s/rss-merge-%d-%d.idx",
+	     tempDirectory, (int) getpid(), p);
+    pthread_create(&threads[p], NULL, MergePiece, &pieces[p]);
+  }
+  for (int p = 0; p < numPieces; p++) pthread_join(threads[p], NULL);
+
+  indexwriter w;
+  bool ok = true;
+  long numWords = 0, numPostings = 0;
+  if (!IndexWriterNew(&w, outputFile, VectorLength(&articles))) {
+    fprintf(stderr, "Unable to create the index file \"%s\".\n", outputFile);
+    for (int p = 0; p < numPieces; p++) unlink(pieces[p].segmentName);
+    exit(1);
+  }
+  for (int i = 0; i < VectorLength(&articles); i++) {
+    struct article *art = *(struct article **) VectorNth(&articles, i);
+    IndexWriterAddArticle(&w, art->title, art->URL, art->server, art->feed, art->duplicateOf);
+  }
+  for (int p = 0; p < numPieces; p++) {
+    if (!pieces[p].ok) fprintf(stderr, "Unable to merge piece %d of the words.\n", p);
+    ok = ok && pieces[p].ok && IndexWriterAppendWords(&w, pieces[p].segmentName);
+    unlink(pieces[p].segmentName);
+    numWords += pieces[p].numWords;
+    numPostings += pieces[p].numPostings;
+    free(pieces[p].first);
+    free(pieces[p].count);
+  }
+  long bytesOut = IndexWriterBytes(&w);
+  if (!IndexWriterClose(&w) || !ok) {
+    fprintf(stderr, "Unable to write the index file \"%s\".\n", outputFile);
+    unlink(outputFile);
+    exit(1);
+  }
+
+  double seconds = (MonotonicNanos() - start) / 1e9;
+  printf("Merged %d shards (%d articles, %d repeated) into %d articles, %ld words and %ld postings "
+	 "in %.3f seconds with %d threads (%.1f MB/s in, %.1f MB out).\n",
+	 numShards, shardArticles, repeats, VectorLength(&articles), numWords, numPostings,
+	 seconds, numPieces, bytesIn / 1e6 / seconds, bytesOut / 1e6);
+  for (int s = 0; s < numShards; s++) {
+    for (int i = 0; i < shards[s].numWords; i++) free(shards[s].words[i].word);
+    free(shards[s].words);
+    free(shards[s].docMap);
+  }
+  VectorDispose(&articles);
+  return 0;
+}
@@ -0,0 +1,437 @@
+/**
+ * File: rss-mockorigin.c
+ * ----------------------
+ * A mock origin server for load testing the crawler without network access.
+ * It serves synthetic RSS feeds and articles (see synthetic.h) over HTTP/1.0
+ * on 127.0.0.1, and can be told to misbehave the way real news sites do:
+ * respond slowly, trickle bytes through a bandwidth cap, bounce requests
+ * through chains of 301 and 302 redirects, fail with 4xx and 5xx errors, or
+ * accept a connection and then stall.
+ *
+ *   rss-mockorigin --port <port> [--feeds <n>] [--items-per-feed <n>] [--duplicates <fraction>]
+ *                  [--words <n>] [--vocabulary <n>] [--zipf <s>] [--seed <n>]
+ *                  [--latency <ms>] [--bandwidth <bytes/sec>] [--redirects <fraction>]
+ *                  [--redirect-chain <n>] [--errors <fraction>] [--stalls <fraction>]
+ *                  [--stall-seconds <n>] [--publish <items/hour> [--publish-spread <ratio>]]
+ *                  [--ttl <minutes>] [--feed-list <file>]
+ *
+ *   --feeds, --items-per-feed  how many feeds there are and how many items each lists
+ *                              (defaults 10 and 100)
+ *   --duplicates               fraction of items linking to an article an earlier item
+ *                              already linked to (default 0.1)
+ *   --words, --vocabulary,
+ *   --zipf, --seed             shape the article text, as for rss-corpusgen
+ *   --latency                  delay before each response is started (default 0)
+ *   --bandwidth                cap on each connection's transfer rate (default: none)
+ *   --redirects                fraction of articles that are only reachable through a
+ *                              chain of redirects (default 0)
+ *   --redirect-chain           length of each such chain, alternating 301 and 302 (default 2)
+ *   --errors                   fraction of articles answered with 403, 404, 500 or 503 (default 0)
+ *   --stalls                   fraction of requests, of any kind, that get no response at all:
+ *                              the connection is held open for --stall-seconds (default 10)
+ *                              and then closed (default 0)
+ *   --publish                  make the feeds move: feed 0 publishes a new item this many
+ *                              times an hour, and each feed lists only its newest
+ *                              --items-per-feed items, each with the <pubDate> it was
+ *                              published on (default 0, for feeds that never change)
+ *   --publish-spread           how many times more slowly the last feed publishes than
+ *                              feed 0; the feeds between are spaced geometrically (default 100)
+ *   --ttl                      give every feed a <ttl> of this many minutes (default: none)
+ *   --feed-list                write a feed list naming every feed, suitable for
+ *                              rss-news-search --feeds, to this file
+ *
+ * Which articles redirect or fail is a fixed function of the seed, so repeated
+ * crawls see the same site; stalls are drawn afresh for each request.  When sent
+ * SIGINT or SIGTERM, the server prints what it served, including the peak and
+ * average number of requests it was handling at once, and exits.  That's how
+ * "make crawlbench" measures the fetch concurrency a crawl achieves, and
+ * "make pollbench" the requests a continuous crawl of moving feeds costs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "bool.h"
+#include "latency.h"
+#include "synthetic.h"
+#include "pubdate.h"
+
+typedef struct {
+  unsigned short port;
+  int numFeeds;
+  int itemsPerFeed;
+  double duplicateRate;
+  int latencyMillis;
+  long bandwidth;
+  double redirectRate;
+  int redirectChain;
+  double errorRate;
+  double stallRate;
+  int stallSeconds;
+  double publishRate;         // items per hour of feed 0, or 0 for feeds that never change
+  double publishSpread;
+  int ttlMinutes;
+  const char *feedListName;
+} originoptions;
+
+static originoptions opts;
+static synthetictext text;
+static char baseURL[64];
+static long long startNanos;  // when the server started, on the monotonic clock
+static time_t startTime;      // and on the wall clock
+
+// Everything below is updated atomically by the connection threads
+static struct {
+  long requests;
+  long byClass[6];            // by first digit of the response code
+  long stalls;
+  long bytes;
+  int inFlight;
+  int peakInFlight;
+  long long busyNanos;        // summed over requests, so busyNanos / span is the average concurrency
+  long long firstStart;
+  long long lastEnd;
+  unsigned long long requestCounter;
+} stats;
+
+static void Usage(const char *program)
+{
+  fprintf(stderr, "Usage: %s --port <port> [--feeds n] [--items-per-feed n] [--duplicates fraction] "
+	  "[--words n] [--vocabulary n] [--zipf s] [--seed n] [--latency ms] [--bandwidth bytes/sec] "
+	  "[--redirects fraction] [--redirect-chain n] [--errors fraction] [--stalls fraction] "
+	  "[--stall-seconds n] [--publish items/hour [--publish-spread ratio]] [--ttl minutes] [--feed-list file]\n", program);
+  exit(1);
+}
+
+// Writes all of the buffer, pacing it to the bandwidth cap; returns false if the client went away
+static const int kSendsPerSecond = 20;
+static bool Send(int fd, const char *buffer, size_t length)
+{
+  size_t chunk = opts.bandwidth > 0 ? opts.bandwidth / kSendsPerSecond : length;
+  if (chunk == 0) chunk = 1;
+  while (length > 0) {
+    size_t n = length < chunk ? length : chunk;
+    ssize_t sent = write(fd, buffer, n);
+    if (sent <= 0) return false;
+    __atomic_add_fetch(&stats.bytes, sent, __ATOMIC_RELAXED);
+    buffer += sent;
+    length -= sent;
+    if (opts.bandwidth > 0 && length > 0) usleep(1000000 / kSendsPerSecond);
+  }
+  return true;
+}
+
+static void Respond(int fd, int code, const char *message, const char *contentType, const char *location,
+		    const char *body, size_t bodyLength)
+{
+  char header[1024];
+  int length = snprintf(header, sizeof(header), "HTTP/1.0 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n",
+			code, message, contentType, bodyLength);
+  if (location != NULL) length += snprintf(header + length, sizeof(header) - length, "Location: %s\r\n", location);
+  length += snprintf(header + length, sizeof(header) - length, "Connection: close\r\n\r\n");
+  __atomic_add_fetch(&stats.byClass[code / 100 % 6], 1, __ATOMIC_RELAXED);
+  if (Send(fd, header, length) && bodyLength > 0) Send(fd, body, bodyLength);
+}
+
+static void RespondWithError(int fd, int code, const char *message)
+{
+  char body[256];
+  int length = sprintf(body, "<html><body><h1>%d %s</h1></body></html>\n", code, message);
+  Respond(fd, code, message, "text/html", NULL, body, length);
+}
+
+// Writes the items of a moving feed: its newest items, newest first.  Item k of feed n
+// (numbered from 0 for the first published after the server started, and negative for
+// those it already listed then) links to article (k + items per feed) * feeds + n.
+static void WriteMovingFeedItems(FILE *outfile, long n)
+{
+  double exponent = opts.numFeeds == 1 ? 0 : (double) n / (opts.numFeeds - 1);
+  double perSecond = opts.publishRate / 3600 / pow(opts.publishSpread, exponent);
+  double elapsed = (MonotonicNanos() - startNanos) / 1e9;
+  long newest = (long) floor(elapsed * perSecond);
+  for (int i = 0; i < opts.itemsPerFeed; i++) {
+    long k = newest - i;
+    char articleURL[128], pubDate[32];
+    long id = (k + opts.itemsPerFeed) * opts.numFeeds + n;
+    sprintf(articleURL, "%s/articles/%ld.html", baseURL, id);
+    FormatPubDate(startTime + (time_t) floor(k / perSecond), pubDate, sizeof(pubDate));
+    SyntheticWriteFeedItem(outfile, id, articleURL, pubDate);
+  }
+}
+
+// Renders a feed or article into memory so it can be sent at a controlled rate
+static void RespondWithDocument(int fd, const char *contentType, bool isFeed, long n)
+{
+  char *body;
+  size_t bodyLength;
+  FILE *outfile = open_memstream(&body, &bodyLength);
+  if (isFeed) {
+    SyntheticWriteFeedStart(outfile, (int) n, baseURL);
+    if (opts.ttlMinutes > 0) fprintf(outfile, "<ttl>%d</ttl>\n", opts.ttlMinutes);
+    if (opts.publishRate > 0) WriteMovingFeedItems(outfile, n);
+    for (int i = 0; i < opts.itemsPerFeed && opts.publishRate == 0; i++) {
+      long item = n * opts.itemsPerFeed + i;
+      unsigned long long state = SyntheticSeed(text.seed, ~item);
+      long id = item;
+      if (item > 0 && SyntheticUniform(&state) < opts.duplicateRate) id = SyntheticRandom(&state) % item;
+      char articleURL[128];
+      sprintf(articleURL, "%s/articles/%ld.html", baseURL, id);
+      SyntheticWriteFeedItem(outfile, id, articleURL, NULL);
+    }
+    SyntheticWriteFeedEnd(outfile);
+  } else {
+    SyntheticWriteArticle(&text, n, outfile);
+  }
+  fclose(outfile);
+  Respond(fd, 200, "OK", contentType, NULL, body, bodyLength);
+  free(body);
+}
+
+static const int kErrorCodes[] = { 403, 404, 500, 503 };
+static const char *const kErrorMessages[] = { "Forbidden", "Not Found", "Internal Server Error", "Service Unavailable" };
+
+/**
+ * Function: ServeArticle
+ * ----------------------
+ * Articles live at /articles/<id>.html.  Whether an article fails or redirects is
+ * decided by a generator seeded with its id; redirected articles send the client to
+ * /moved/<k>/articles/<id>.html, with k counting down the hops left in the chain,
+ * and are finally served from /moved/0/articles/<id>.html.
+ */
+
+static void ServeArticle(int fd, long id, int hopsLeft)
+{
+  if (hopsLeft < 0) { // requested by its original URL
+    unsigned long long state = SyntheticSeed(text.seed ^ 0x5EED, id);
+    double u = SyntheticUniform(&state);
+    if (u < opts.errorRate) {
+      int which = SyntheticRandom(&state) % (sizeof(kErrorCodes) / sizeof(kErrorCodes[0]));
+      RespondWithError(fd, kErrorCodes[which], kErrorMessages[which]);
+      return;
+    }
+    hopsLeft = u < opts.errorRate + opts.redirectRate ? opts.redirectChain : 0;
+  }
+
+  if (hopsLeft == 0) {
+    RespondWithDocument(fd, "text/html", false, id);
+    return;
+  }
+
+  char location[128];
+  sprintf(location, "%s/moved/%d/articles/%ld.html", baseURL, hopsLeft - 1, id);
+  if (hopsLeft % 2 == 0) Respond(fd, 301, "Moved Permanently", "text/html", location, "", 0);
+  else Respond(fd, 302, "Found", "text/html", location, "", 0);
+}
+
+static void Route(int fd, const char *path)
+{
+  long n;
+  int hopsLeft;
+  char tail;
+  if (sscanf(path, "/feeds/%ld.xm%c", &n, &tail) == 2 && n >= 0 && n < opts.numFeeds) {
+    RespondWithDocument(fd, "text/xml", true, n);
+  } else if (sscanf(path, "/articles/%ld.htm%c", &n, &tail) == 2 && n >= 0) {
+    ServeArticle(fd, n, -1);
+  } else if (sscanf(path, "/moved/%d/articles/%ld.htm%c", &hopsLeft, &n, &tail) == 3 && hopsLeft >= 0 && n >= 0) {
+    ServeArticle(fd, n, hopsLeft);
+  } else {
+    RespondWithError(fd, 404, "Not Found");
+  }
+}
+
+static void UpdatePeak(int inFlight)
+{
+  int peak = __atomic_load_n(&stats.peakInFlight, __ATOMIC_RELAXED);
+  while (inFlight > peak &&
+	 !__atomic_compare_exchange_n(&stats.peakInFlight, &peak, inFlight, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void *HandleConnection(void *aux)
+{
+  int fd = (int) (long) aux;
+  long long start = MonotonicNanos();
+  long long expected = 0;
+  __atomic_compare_exchange_n(&stats.firstStart, &expected, start, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+  UpdatePeak(__atomic_add_fetch(&stats.inFlight, 1, __ATOMIC_RELAXED));
+  __atomic_add_fetch(&stats.requests, 1, __ATOMIC_RELAXED);
+
+  // read the request line, then discard headers up through the blank line
+  FILE *conn = fdopen(dup(fd), "r");
+  char line[2048], path[1024];
+  bool wellFormed = conn != NULL && fgets(line, sizeof(line), conn) != NULL &&
+                    sscanf(line, "GET %1023s", path) == 1;
+  while (wellFormed && fgets(line, sizeof(line), conn) != NULL && strcmp(line, "\r\n") != 0 && strcmp(line, "\n") != 0);
+
+  unsigned long long state = SyntheticSeed(text.seed, __atomic_add_fetch(&stats.requestCounter, 1, __ATOMIC_RELAXED));
+  if (!wellFormed) {
+    RespondWithError(fd, 400, "Bad Request");
+  } else if (SyntheticUniform(&state) < opts.stallRate) {
+    __atomic_add_fetch(&stats.stalls, 1, __ATOMIC_RELAXED);
+    sleep(opts.stallSeconds);
+  } else {
+    if (opts.latencyMillis > 0) usleep(opts.latencyMillis * 1000);
+    Route(fd, path);
+  }
+
+  if (conn != NULL) fclose(conn);
+  close(fd);
+  long long end = MonotonicNanos();
+  __atomic_add_fetch(&stats.busyNanos, end - start, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.lastEnd, end, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&stats.inFlight, 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void ReportStats(FILE *outfile)
+{
+  long long span = stats.lastEnd - stats.firstStart;
+  fprintf(outfile, "origin requests %ld  2xx %ld  3xx %ld  4xx %ld  5xx %ld  stalled %ld  bytes %ld  "
+	  "peak-concurrency %d  mean-concurrency %.2f  active-seconds %.3f\n",
+	  stats.requests, stats.byClass[2], stats.byClass[3], stats.byClass[4], stats.byClass[5], stats.stalls,
+	  stats.bytes, stats.peakInFlight, span > 0 ? (double) stats.busyNanos / span : 0.0, span / 1e9);
+}
+
+// Waits for SIGINT or SIGTERM, which every other thread has blocked, and then reports and exits
+static void *AwaitTermination(void *aux)
+{
+  sigset_t *signals = aux;
+  int signal;
+  sigwait(signals, &signal);
+  ReportStats(stderr);
+  exit(0);
+}
+
+static void WriteFeedList(const char *fileName)
+{
+  FILE *outfile = fopen(fileName, "w");
+  if (outfile == NULL) {
+    fprintf(stderr, "Unable to create \"%s\".\n", fileName);
+    exit(1);
+  }
+  for (int i = 0; i < opts.numFeeds; i++) fprintf(outfile, "Mock Feed %d: %s/feeds/%d.xml\n", i, baseURL, i);
+  fclose(outfile);
+}
+
+static int Listen(unsigned short port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char **argv)
+{
+  static const struct option kLongOptions[] = {
+    { "port", required_argument, NULL, 'p' },
+    { "feeds", required_argument, NULL, 'f' },
+    { "items-per-feed", required_argument, NULL, 'i' },
+    { "duplicates", required_argument, NULL, 'd' },
+    { "words", required_argument, NULL, 'w' },
+    { "vocabulary", required_argument, NULL, 'v' },
+    { "zipf", required_argument, NULL, 'z' },
+    { "seed", required_argument, NULL, 's' },
+    { "latency", required_argument, NULL, 'l' },
+    { "bandwidth", required_argument, NULL, 'b' },
+    { "redirects", required_argument, NULL, 'r' },
+    { "redirect-chain", required_argument, NULL, 'c' },
+    { "errors", required_argument, NULL, 'e' },
+    { "stalls", required_argument, NULL, 'S' },
+    { "stall-seconds", required_argument, NULL, 'T' },
+    { "publish", required_argument, NULL, 'P' },
+    { "publish-spread", required_argument, NULL, 'R' },
+    { "ttl", required_argument, NULL, 't' },
+    { "feed-list", required_argument, NULL, 'F' },
+    { NULL, 0, NULL, 0 }
+  };
+
+  int meanWords = 300, vocabularySize = 50000;
+  double zipfExponent = 1.0;
+  unsigned long long seed = 107;
+  opts = (originoptions) { 0, 10, 100, 0.1, 0, 0, 0, 2, 0, 0, 10, 0, 100, 0, NULL };
+  int c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'p': opts.port = atoi(optarg); break;
+      case 'f': opts.numFeeds = atoi(optarg); break;
+      case 'i': opts.itemsPerFeed = atoi(optarg); break;
+      case 'd': opts.duplicateRate = atof(optarg); break;
+      case 'w': meanWords = atoi(optarg); break;
+      case 'v': vocabularySize = atoi(optarg); break;
+      case 'z': zipfExponent = atof(optarg); break;
+      case 's': seed = strtoull(optarg, NULL, 10); break;
+      case 'l': opts.latencyMillis = atoi(optarg); break;
+      case 'b': opts.bandwidth = atol(optarg); break;
+      case 'r': opts.redirectRate = atof(optarg); break;
+      case 'c': opts.redirectChain = atoi(optarg); break;
+      case 'e': opts.errorRate = atof(optarg); break;
+      case 'S': opts.stallRate = atof(optarg); break;
+      case 'T': opts.stallSeconds = atoi(optarg); break;
+      case 'P': opts.publishRate = atof(optarg); break;
+      case 'R': opts.publishSpread = atof(optarg); break;
+      case 't': opts.ttlMinutes = atoi(optarg); break;
+      case 'F': opts.feedListName = optarg; break;
+      default: Usage(argv[0]);
+    }
+  }
+  if (opts.port == 0 || opts.numFeeds < 1 || opts.itemsPerFeed < 1 || meanWords < 1 || vocabularySize < 1 ||
+      opts.latencyMillis < 0 || opts.bandwidth < 0 || opts.redirectChain < 0 || opts.stallSeconds < 0 ||
+      opts.errorRate + opts.redirectRate > 1 || opts.publishRate < 0 || opts.publishSpread < 1 || opts.ttlMinutes < 0)
+    Usage(argv[0]);
+
+  sprintf(baseURL, "http://127.0.0.1:%d", opts.port);
+  startNanos = MonotonicNanos();
+  startTime = time(NULL);
+  SyntheticTextNew(&text, vocabularySize, zipfExponent, meanWords, seed);
+  if (opts.feedListName != NULL) WriteFeedList(opts.feedListName);
+  int listener = Listen(opts.port);
+  if (listener < 0) {
+    perror("Unable to listen");
+    return 1;
+  }
+
+  // block the termination signals everywhere but in the thread that waits for them
+  static sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  pthread_t waiter;
+  pthread_create(&waiter, NULL, AwaitTermination, &signals);
+  fprintf(stderr, "Serving %d feeds of %d items at %s\n", opts.numFeeds, opts.itemsPerFeed, baseURL);
+
+  while (true) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) continue;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, HandleConnection, (void *) (long) fd) != 0) {
+      close(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+  return 0;
+}
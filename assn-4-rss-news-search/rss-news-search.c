@@ -3,6 +3,11 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
 //
 #include "url.h"
 #include "bool.h"
@@ -11,82 +16,554 @@
 #include "html-utils.h"
 #include "hashset.h"
 #include "hashsets-functions.h"
+#include "newsindex.h"
+#include "querycache.h"
+#include "latency.h"
+#include "queryserver.h"
+#include "snapshot.h"
+#include "corpus.h"
+#include "instrument.h"
+#include "hashsetstats.h"
+#include "stopwords.h"
+#include "htmlscanner.h"
+#include "feedparser.h"
+#include "entities.h"
+#include "coordinator.h"
+#include "pubdate.h"
+#include "feedscheduler.h"
+
+// Where the items of a feed being crawled are indexed
+struct feedcontext {
+  newsindex *index;
+  stopwordlist *stopWords;
+  const char *feed;  // the URL of the feed, as the feed list gives it
+};
+
+// The articles a query's site: and feed: terms allow
+typedef struct {
+  bitmap sites, feeds;
+  bool bySite, byFeed;
+} sourcefilter;
+
+// A server or feed, and how many of a query's matches are from it
+typedef struct {
+  int count;
+  const char *kind;  // "server" or "feed"
+  const char *name;
+} sourcecount;
 
 static void Welcome(const char *welcomeTextFileName);
-static void BuildIndices(hashset *index, hashset *seenArticles, hashset *stopWords);
-static void ProcessFeed(const char *remoteDocumentName, hashset *index, hashset *seenArticles, hashset *stopWords);
-static void PullAllNewsItems(urlconnection *urlconn, hashset *index, hashset *seenArticles, hashset *stopWords);
-static bool GetNextItemTag(streamtokenizer *st);
-static void ProcessSingleNewsItem(streamtokenizer *st, hashset *index, hashset *seenArticles, hashset *stopWords);
-static void ExtractElement(streamtokenizer *st, const char *htmlTag, char dataBuffer[], int bufferLength);
-static void ParseArticle(const char *articleTitle, const char *articleDescription, const char *articleURL, 
-			 hashset *index, hashset *seenArticles, hashset *stopWords);
-static void ScanArticle(streamtokenizer *st, const char *articleTitle, const char *serverName, 
-			const char *articleURL, hashset *index, hashset *stopWords);
-static void ProcessWord(const char *word, const char *articleTitle, const char *articleURL, 
-			const char *serverName, hashset *index);
-static void ProcessArticle(struct wordArticles *wordArt, void *found, struct article *art, hashset *index);
-static void QueryIndices(hashset *stopWords, hashset *index);
-static void ProcessResponse(const char *word, hashset *stopWords, hashset *index);
-static void GetResults(const char *word, hashset *index);
-static void PrintResults(vector *results, int n);
+static void BuildIndices(newsindex *index, stopwordlist *stopWords);
+static void ReportIndexFootprint(newsindex *index);
+static void ReportBenchmark(newsindex *index, long long elapsedNanos);
+static void ReportFilterBenchmark(newsindex *index);
+static void ReportNearDuplicates(newsindex *index);
+static void ReportSpill(newsindex *index);
+static void ReportSegments(newsindex *index);
+static void ReportDictionary(newsindex *index);
+static void ReportSpelling(newsindex *index);
+static void ReportFacets(newsindex *index);
+static void ReportTermStats(newsindex *index);
+static void AttachDictionary(newsindex *index);
+static void ProcessFeed(const char *remoteDocumentName, newsindex *index, stopwordlist *stopWords);
+static void ProcessLocalFeed(const char *feed, newsindex *index, stopwordlist *stopWords);
+static void PullAllNewsItems(urlconnection *urlconn, const char *feed, newsindex *index, stopwordlist *stopWords);
+static void ProcessSingleNewsItem(feeditem *item, void *auxData);
+static bool ParseArticle(const char *articleTitle, const char *articleDescription, const char *articleURL, 
+			 const char *feed, time_t published, newsindex *index, stopwordlist *stopWords);
+static void ScanArticle(FILE *infile, int docID, newsindex *index, stopwordlist *stopWords);
+static void ProcessWord(const char *word, int docID, newsindex *index);
+static void RankResults(const char *word, newsindex *index, querycache *cache, vector *results);
+static void GetResults(const char *query, const char *status, newsindex *index, vector *results, querycache *cache);
+static void SuggestCorrections(const char *word, newsindex *index, querycache *cache);
+
+/**
+ * Type: queryengine
+ * -----------------
+ * Everything needed to answer a query, bundled so it can be handed to
+ * worker threads and connection handlers as a single piece of auxData.
+ * The index itself is published through a snapshot, so that it can be
+ * replaced by a freshly built one while queries are being answered;
+ * each query acquires the current index, uses it, and releases it.
+ */
+
+typedef struct {
+  stopwordlist *stopWords;
+  snapshot *indices;        // publishes a newsindex *
+  querycache *cache;
+  coordinator *coordinator; // where the words are, if the index holds only articles (--coordinate)
+} queryengine;
+
+static void QueryIndices(queryengine *engine);
+static void ProcessResponse(const char *query, queryengine *engine, newsindex *index);
+static void ProcessCommand(const char *command, queryengine *engine);
+static const char *AnswerQuery(const char *query, queryengine *engine, newsindex *index, vector *results);
+static FILE *OpenBatchResults(const char *outputFileName);
+static void RunBatchQueries(const char *queryFileName, FILE *outfile, int numThreads, queryengine *engine);
+static void ServeQuery(const char *query, FILE *reply, void *auxData);
+static void ServeMatches(const char *word, FILE *reply, queryengine *engine);
+static void ServeExpansions(const char *term, FILE *reply, queryengine *engine);
+static bool GatherResults(const char *terms[], int numTerms, queryengine *engine, newsindex *index, vector *results);
+static void AppendMatches(newsindex *index, const char *word, vector *matches);
+static void AppendTermMatches(newsindex *index, const char *term, vector *matches);
+static void ServeCompletions(const char *prefix, FILE *reply, queryengine *engine);
+static void PrintCompletions(const char *prefix, queryengine *engine);
+static void ServeFacets(const char *query, FILE *reply, queryengine *engine);
+static void PrintFacets(const char *query, queryengine *engine);
+static void PrintTrending(queryengine *engine);
+static void ApplyFilter(const sourcefilter *filter, vector *results);
+static int CountSources(const newsindex *index, const vector *results, sourcecount counts[]);
+static int CompareByDocID(const void *elemAddr1, const void *elemAddr2);
+static void SumMatches(vector *matches);
+static void FormatDay(int day, char buffer[], int bufferLength);
+static void StopRefreshing(void);
+static void StopPolling(FILE *reportFile);
+static void ReportFeedSchedules(FILE *outfile);
+static newsindex *AcquireIndex(snapshot *indices, int *reader);
+static void ReleaseIndex(snapshot *indices, int reader);
+static void PrintResults(newsindex *index, vector *results, int n);
 static bool WordIsWellFormed(const char *word);
-void AddStopWords(hashset *stopWords);
-static bool IsStopWord(hashset *stopWords, const char *word);
+static void AddStopWords(stopwordlist *stopWords, const char *fileName);
+static bool IsStopWord(stopwordlist *stopWords, const char *word);
+
 
+static const char *const kDefaultDataDirectory = "../assn-4-rss-news-search-data";
+static const char *const kWelcomeTextFile = "welcome.txt";
+static const char *const kDefaultFeedsFile = "rss-feeds.txt";
+static const char *const kLocalFeedPrefix = "file:";
 
-static const char *const kWelcomeTextFile = "/home/suvov/CS107/A4/assn-4-rss-news-search-data/welcome.txt";
-static const char *const kDefaultFeedsFile = "/home/suvov/CS107/A4/assn-4-rss-news-search-data/rss-feeds.txt";
-static const char *const kDefaultStopWordsFile = "/home/suvov/CS107/A4/assn-4-rss-news-search-data/stop-words.txt";
+// Full paths of the data files, resolved against the data directory by ParseOptions
+static char welcomeTextFile[1024];
+static char feedsFile[1024];
+static char stopWordsFile[1024];
+static const char *dataDirectory;
+static bool legacyHTML;  // scan articles the way they were scanned before htmlscanner (--legacy-html)
+static long long dictionaryBuilt, dictionaryNanos;  // when AttachDictionary last attached a dictionary, and how long it took
 static const char *const kNewLineDelimiters = "\r\n";
+static const int kDefaultCacheEntries = 1024;
+static const long kDefaultCacheBytes = 16 << 20;
+static const char *const kDefaultSpillDirectory = "/tmp";
+static const int kDefaultPollSeconds = 60;
+static const int kDictionaryRebuildSeconds = 10;
+static const int kFacetsListed = 10;  // of each of servers and feeds, by CountSources
 
-//from high to low cmp func for article struct
+//from high to low cmp func for matches, ties broken by article id so rankings are repeatable
 static int CompareByOccur(const void *elemAddr1, const void *elemAddr2)
 {
-  struct article *art1 = *(struct article **) elemAddr1;
-  struct article *art2 = *(struct article **) elemAddr2;
-  if(art1->occurrences < art2->occurrences) return 1;
-  else if(art1->occurrences  > art2->occurrences) return -1;
-  return 0;
+  const match *m1 = elemAddr1;
+  const match *m2 = elemAddr2;
+  if(m1->occurrences < m2->occurrences) return 1;
+  else if(m1->occurrences  > m2->occurrences) return -1;
+  return m1->docID - m2->docID;
+}
+
+
+
+/**
+ * Type: options
+ * -------------
+ * Settings pulled from the command line by ParseOptions.
+ *
+ *   --cache-entries <n>   bound the query cache to n result lists (0 means no entry bound)
+ *   --cache-bytes <n>     bound the query cache to n bytes (0 means no byte bound)
+ *   --batch <file>        answer every query in file (one per line) instead of prompting
+ *   --threads <n>         number of threads used to answer batch queries (default: one per CPU)
+ *   --output <file>       where batch results are written (default: standard output)
+ *   --serve <port>        answer queries from TCP clients on 127.0.0.1:port instead of prompting
+ *   --refresh <seconds>   recrawl every so many seconds in the background, swapping in each new index
+ *   --poll <seconds>      crawl continuously instead, polling each feed on a schedule of its own,
+ *                         first every so many seconds and then as often as the feed publishes
+ *                         (between an eighth of that and sixteen times it), and adding the
+ *                         articles of new items to the index as they're found
+ *   --poll-for <seconds>  with --bench, poll for this long and then report (default 60)
+ *   --data <dir>          directory holding welcome.txt and the feed lists
+ *                         (default: ../assn-4-rss-news-search-data)
+ *   --feeds <file>        feed list to crawl, relative to the data directory unless absolute
+ *                         (default: rss-feeds.txt)
+ *   --record <dir>        crawl the network as usual, saving every response into a corpus directory
+ *   --replay <dir>        crawl a previously recorded corpus directory instead of the network
+ *   --stop-words <file>   load the stop words from file, relative to the data directory unless
+ *                         absolute, rather than using the list compiled in from stop-words.txt
+ *   --bloom <bits>        put a Bloom filter with at least bits bits per word in front of the word
+ *                         index, so lookups of words it doesn't hold usually skip the hashset
+ *   --near-duplicates <similarity>
+ *                         fold each article whose text is at least this similar (0 to 1, as
+ *                         estimated by MinHash) to an article already indexed into that article,
+ *                         rather than indexing its words all over again
+ *   --memory-budget <MB>  hold at most about this many megabytes of words in memory while
+ *                         building, spilling sorted runs to disk and merging them at the end
+ *   --spill-dir <dir>     where those runs are written (default: /tmp)
+ *   --save-index <file>   write the index to file once it's built (and after each refresh)
+ *   --load-index <file>   load a saved index from file rather than crawling the feeds
+ *   --retain-days <n>     divide the index by the day each article was published (from its
+ *                         item's <pubDate>, or the day it was crawled if it hasn't one), keeping
+ *                         only the newest n days of news and dropping older days whole
+ *   --shard <i>/<n>       keep only the words of shard i of n (numbered from 0), so that n
+ *                         processes serving the same index each hold a share of its words
+ *   --coordinate <ports>  answer queries (with --serve or --batch) by asking the shard servers
+ *                         listening on these comma-separated ports, in shard order, for their
+ *                         words; the index (normally --load-index of the shards' index) then
+ *                         supplies only the article table
+ *   --legacy-html         scan articles with the streamtokenizer and SkipIrrelevantContent, as
+ *                         before the in-tree HTML scanner, rather than with the scanner
+ *   --bench               build the index, report indexing throughput and memory use on
+ *                         standard error, and exit without answering any queries
+ *   --instrument <file>   when the program ends, write the per-phase crawl and index timings to
+ *                         file as JSON (needs a build made with make INSTRUMENT=1)
+ *
+ * Setting both cache bounds to 0 turns the query cache off.
+ */
+
+typedef struct {
+  int cacheEntries;
+  long cacheBytes;
+  const char *batchFileName;
+  const char *outputFileName;
+  int numThreads;
+  int servePort;
+  int refreshInterval;
+  int pollInterval;               // 0 to crawl once, rather than polling the feeds
+  int pollSeconds;
+  corpusmode corpusMode;
+  const char *corpusDirectory;
+  bool benchmark;
+  const char *instrumentFileName;
+  const char *stopWordsFileName;  // NULL for the compiled-in list
+  int filterBitsPerWord;          // 0 for no Bloom filter
+  double nearDuplicateThreshold;  // 0 for no near-duplicate detection
+  long memoryBudget;              // 0 for no budget
+  const char *spillDirectory;
+  const char *saveIndexFileName;
+  const char *loadIndexFileName;
+  int retentionDays;              // 0 to keep every day's news
+  int shard, numShards;           // numShards is 0 unless --shard was given
+  unsigned short *shardPorts;     // the numShardPorts ports of --coordinate, or NULL
+  int numShardPorts;
+  bool legacyHTML;
+} options;
+
+// Parses the comma-separated ports of --coordinate into opts->shardPorts
+static void ParseShardPorts(const char *list, options *opts)
+{
+  char copy[strlen(list) + 1], *rest;
+  strcpy(copy, list);
+  opts->numShardPorts = 0;
+  opts->shardPorts = malloc((strlen(list) / 2 + 1) * sizeof(unsigned short));
+  for (char *port = strtok_r(copy, ",", &rest); port != NULL; port = strtok_r(NULL, ",", &rest)) {
+    int n = atoi(port);
+    if (n <= 0 || n > 65535) {
+      fprintf(stderr, "\"%s\" isn't a port to coordinate.\n", port);
+      exit(1);
+    }
+    opts->shardPorts[opts->numShardPorts++] = n;
+  }
+}
+
+// Resolves fileName against the data directory, unless it's already an absolute path
+static void DataFilePath(const char *fileName, char path[], int pathLength)
+{
+  if (fileName[0] == '/') snprintf(path, pathLength, "%s", fileName);
+  else snprintf(path, pathLength, "%s/%s", dataDirectory, fileName);
+}
+
+static void ParseOptions(int argc, char **argv, options *opts)
+{
+  static const struct option kLongOptions[] = {
+    { "cache-entries", required_argument, NULL, 'e' },
+    { "cache-bytes", required_argument, NULL, 'b' },
+    { "batch", required_argument, NULL, 'q' },
+    { "threads", required_argument, NULL, 't' },
+    { "output", required_argument, NULL, 'o' },
+    { "serve", required_argument, NULL, 's' },
+    { "refresh", required_argument, NULL, 'r' },
+    { "poll", required_argument, NULL, 'Y' },
+    { "poll-for", required_argument, NULL, 'U' },
+    { "data", required_argument, NULL, 'd' },
+    { "feeds", required_argument, NULL, 'f' },
+    { "record", required_argument, NULL, 'R' },
+    { "replay", required_argument, NULL, 'P' },
+    { "bench", no_argument, NULL, 'B' },
+    { "instrument", required_argument, NULL, 'I' },
+    { "stop-words", required_argument, NULL, 'W' },
+    { "bloom", required_argument, NULL, 'F' },
+    { "legacy-html", no_argument, NULL, 'L' },
+    { "near-duplicates", required_argument, NULL, 'N' },
+    { "memory-budget", required_argument, NULL, 'M' },
+    { "spill-dir", required_argument, NULL, 'T' },
+    { "save-index", required_argument, NULL, 'O' },
+    { "load-index", required_argument, NULL, 'i' },
+    { "retain-days", required_argument, NULL, 'D' },
+    { "shard", required_argument, NULL, 'H' },
+    { "coordinate", required_argument, NULL, 'C' },
+    { NULL, 0, NULL, 0 }
+  };
+  
+  opts->cacheEntries = kDefaultCacheEntries;
+  opts->cacheBytes = kDefaultCacheBytes;
+  opts->batchFileName = NULL;
+  opts->outputFileName = NULL;
+  opts->numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  opts->servePort = 0;
+  opts->refreshInterval = 0;
+  opts->pollInterval = 0;
+  opts->pollSeconds = kDefaultPollSeconds;
+  opts->corpusMode = kCorpusLive;
+  opts->corpusDirectory = NULL;
+  opts->benchmark = false;
+  opts->instrumentFileName = NULL;
+  opts->stopWordsFileName = NULL;
+  opts->filterBitsPerWord = 0;
+  opts->nearDuplicateThreshold = 0;
+  opts->memoryBudget = 0;
+  opts->spillDirectory = kDefaultSpillDirectory;
+  opts->saveIndexFileName = NULL;
+  opts->loadIndexFileName = NULL;
+  opts->retentionDays = 0;
+  opts->shard = opts->numShards = 0;
+  opts->shardPorts = NULL;
+  opts->numShardPorts = 0;
+  opts->legacyHTML = false;
+  dataDirectory = kDefaultDataDirectory;
+  const char *feedsFileName = kDefaultFeedsFile;
+  int c;
+  while ((c = getopt_long(argc, argv, "", kLongOptions, NULL)) != -1) {
+    switch (c) {
+      case 'e': opts->cacheEntries = atoi(optarg); break;
+      case 'b': opts->cacheBytes = atol(optarg); break;
+      case 'q': opts->batchFileName = optarg; break;
+      case 't': opts->numThreads = atoi(optarg); break;
+      case 'o': opts->outputFileName = optarg; break;
+      case 's': opts->servePort = atoi(optarg); break;
+      case 'r': opts->refreshInterval = atoi(optarg); break;
+      case 'Y': opts->pollInterval = atoi(optarg); break;
+      case 'U': opts->pollSeconds = atoi(optarg); break;
+      case 'd': dataDirectory = optarg; break;
+      case 'f': feedsFileName = optarg; break;
+      case 'R': opts->corpusMode = kCorpusRecord; opts->corpusDirectory = optarg; break;
+      case 'P': opts->corpusMode = kCorpusReplay; opts->corpusDirectory = optarg; break;
+      case 'B': opts->benchmark = true; break;
+      case 'I': opts->instrumentFileName = optarg; break;
+      case 'W': opts->stopWordsFileName = optarg; break;
+      case 'F': opts->filterBitsPerWord = atoi(optarg); break;
+      case 'L': opts->legacyHTML = true; break;
+      case 'N': opts->nearDuplicateThreshold = atof(optarg); break;
+      case 'M': opts->memoryBudget = (long) (atof(optarg) * (1 << 20)); break;
+      case 'T': opts->spillDirectory = optarg; break;
+      case 'O': opts->saveIndexFileName = optarg; break;
+      case 'i': opts->loadIndexFileName = optarg; break;
+      case 'D': opts->retentionDays = atoi(optarg); break;
+      case 'H':
+	if (sscanf(optarg, "%d/%d", &opts->shard, &opts->numShards) != 2 || opts->numShards < 1 ||
+	    opts->shard < 0 || opts->shard >= opts->numShards) {
+	  fprintf(stderr, "The --shard must be given as <i>/<n>, with 0 <= i < n.\n");
+	  exit(1);
+	}
+	break;
+      case 'C': ParseShardPorts(optarg, opts); break;
+      default: fprintf(stderr, "Usage: %s [--cache-entries n] [--cache-bytes n] "
+		       "[--batch file [--threads n] [--output file] | --serve port] [--refresh seconds | --poll seconds [--poll-for seconds]] "
+		       "[--data dir] [--feeds file] [--record dir | --replay dir] [--stop-words file] [--bloom bits] [--near-duplicates similarity] "
+		       "[--memory-budget MB [--spill-dir dir]] [--save-index file | --load-index file] [--retain-days n] [--shard i/n | --coordinate ports] "
+		       "[--legacy-html] [--bench] [--instrument file]\n", argv[0]);
+	       exit(1);
+    }
+  }
+  DataFilePath(kWelcomeTextFile, welcomeTextFile, sizeof(welcomeTextFile));
+  if (opts->stopWordsFileName != NULL) {
+    DataFilePath(opts->stopWordsFileName, stopWordsFile, sizeof(stopWordsFile));
+    opts->stopWordsFileName = stopWordsFile;
+  }
+  DataFilePath(feedsFileName, feedsFile, sizeof(feedsFile));
+  if (opts->instrumentFileName != NULL && !InstrumentEnabled()) {
+    fprintf(stderr, "Warning: --instrument has no effect, since this build isn't instrumented (make INSTRUMENT=1).\n");
+    opts->instrumentFileName = NULL;
+  }
+  if (opts->numThreads < 1) opts->numThreads = 1;
+  if (opts->nearDuplicateThreshold < 0 || opts->nearDuplicateThreshold > 1) {
+    fprintf(stderr, "The --near-duplicates similarity must be between 0 and 1.\n");
+    exit(1);
+  }
+  if (opts->retentionDays < 0 || (opts->retentionDays > 0 && (opts->memoryBudget > 0 || opts->saveIndexFileName != NULL ||
+								opts->loadIndexFileName != NULL))) {
+    fprintf(stderr, "--retain-days must be positive, and can't be combined with --memory-budget, --save-index or --load-index.\n");
+    exit(1);
+  }
+  if (opts->pollInterval < 0 || opts->pollSeconds < 1 ||
+      (opts->pollInterval > 0 && (opts->refreshInterval > 0 || opts->memoryBudget > 0 || opts->saveIndexFileName != NULL ||
+				  opts->loadIndexFileName != NULL || opts->numShards > 0 || opts->numShardPorts > 0))) {
+    fprintf(stderr, "--poll and --poll-for must be positive, and --poll can't be combined with --refresh, --memory-budget, "
+	    "--save-index, --load-index, --shard or --coordinate.\n");
+    exit(1);
+  }
+  if (opts->numShardPorts > 0 && (opts->numShards > 0 || (opts->servePort == 0 && opts->batchFileName == NULL))) {
+    fprintf(stderr, "--coordinate needs --serve or --batch, and can't be combined with --shard.\n");
+    exit(1);
+  }
+}
+
+// Writes the instrumentation report, if one was asked for
+static void WriteInstrumentReport(const char *fileName)
+{
+  if (fileName == NULL) return;
+  FILE *outfile = fopen(fileName, "w");
+  if (outfile == NULL) {
+    fprintf(stderr, "Unable to write instrumentation report to \"%s\".\n", fileName);
+    return;
+  }
+  InstrumentWriteReport(outfile);
+  fclose(outfile);
+}
+
+// Snapshot free function for published indices
+static void FreeNewsIndex(void *object)
+{
+  NewsIndexDispose(object);
+  free(object);
+}
+
+static void StartRefreshing(snapshot *indices, stopwordlist *stopWords, const options *opts);
+static void StartPolling(snapshot *indices, stopwordlist *stopWords, const options *opts);
+
+// Creates an empty index set up as the options ask: with a Bloom filter in front of its
+// words, detecting near-duplicate articles, building within a memory budget, and holding
+// one shard's words, or none at all for a coordinator
+static newsindex *NewIndex(const options *opts)
+{
+  newsindex *index = malloc(sizeof(newsindex));
+  NewsIndexNew(index);
+  if (opts->retentionDays > 0) NewsIndexDivideByDay(index, opts->retentionDays);
+  if (opts->filterBitsPerWord > 0) NewsIndexUseFilter(index, opts->filterBitsPerWord);
+  if (opts->nearDuplicateThreshold > 0) NewsIndexDetectNearDuplicates(index, opts->nearDuplicateThreshold);
+  if (opts->memoryBudget > 0) NewsIndexSetMemoryBudget(index, opts->memoryBudget, opts->spillDirectory);
+  if (opts->numShards > 0) NewsIndexSetPartition(index, opts->shard, opts->numShards);
+  if (opts->numShardPorts > 0) NewsIndexSetPartition(index, -1, opts->numShardPorts);
+  return index;
 }
 
+/**
+ * Function: FinishIndex
+ * ---------------------
+ * Saves a newly built index to the --save-index file, if there is one.  An index
+ * built within a memory budget that had to spill runs isn't complete until it's
+ * saved: its runs are merged into the --save-index file (or into a scratch file in
+ * the spill directory, deleted once it's been read), and the merged index is then
+ * loaded back in to be queried.  The peak resident set size just before that load is
+ * noted for ReportBenchmark, since it's the peak of the build itself.
+ */
+
+static long buildPeakKB;  // 0 unless a merged index was loaded back
+
+static void FinishIndex(newsindex *index, const options *opts)
+{
+  bool spilled = index->spill != NULL && index->spill->runsWritten > 0;
+  if (!spilled && opts->saveIndexFileName == NULL) return;
+  char scratch[2048];
+  const char *fileName = opts->saveIndexFileName;
+  if (fileName == NULL) {
+    snprintf(scratch, sizeof(scratch), "%s/rss-index-%d.idx", opts->spillDirectory, (int) getpid());
+    fileName = scratch;
+  }
+  if (!NewsIndexSave(index, fileName)) {
+    fprintf(stderr, "Unable to save the index to \"%s\".\n", fileName);
+    if (spilled) exit(1);  // the words are gone from memory, so there's no index without the file
+    return;
+  }
+  if (!spilled) return;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  buildPeakKB = usage.ru_maxrss;
+  if (!NewsIndexLoad(index, fileName)) {
+    fprintf(stderr, "Unable to load the merged index back from \"%s\".\n", fileName);
+    exit(1);
+  }
+  if (fileName == scratch) unlink(scratch);
+}
 
+// Loads the index saved in fileName, in place of crawling
+static void LoadIndex(newsindex *index, const char *fileName)
+{
+  if (!NewsIndexLoad(index, fileName)) {
+    fprintf(stderr, "Unable to load an index from \"%s\".\n", fileName);
+    exit(1);
+  }
+}
 
 int main(int argc, char **argv)
 {
-  hashset index;
-  hashset seenArticles;
-  hashset stopWords;
-  AddStopWords(&stopWords);
-  HashSetNew(&seenArticles, sizeof(struct article *), 1009, ArticleHash, ArticleCmp, FreeArticle);
-  HashSetNew(&index, sizeof(struct wordArticles *), 1009, IndexHash, IndexCmp, FreeIndex);
-  Welcome(kWelcomeTextFile);
-  BuildIndices(&index, &seenArticles, &stopWords);
-  QueryIndices(&stopWords, &index);//
-  HashSetDispose(&index);
-  HashSetDispose(&seenArticles);
-  HashSetDispose(&stopWords);
+  options opts;
+  snapshot indices;
+  stopwordlist stopWords;
+  querycache cache;
+  ParseOptions(argc, argv, &opts);
+  CorpusSetMode(opts.corpusMode, opts.corpusDirectory);
+  legacyHTML = opts.legacyHTML;
+  bool caching = opts.cacheEntries > 0 || opts.cacheBytes > 0;
+  if (caching) QueryCacheNew(&cache, opts.cacheEntries, opts.cacheBytes);
+  AddStopWords(&stopWords, opts.stopWordsFileName);
+  FILE *batchResults = opts.batchFileName != NULL ? OpenBatchResults(opts.outputFileName) : NULL;
+  newsindex *index = NewIndex(&opts);
+  bool interactive = opts.batchFileName == NULL && opts.servePort == 0 && !opts.benchmark;
+  if (interactive) Welcome(welcomeTextFile);
+  long long start = MonotonicNanos();
+  if (opts.loadIndexFileName != NULL) LoadIndex(index, opts.loadIndexFileName);
+  else if (opts.pollInterval == 0) {
+    BuildIndices(index, &stopWords);
+    FinishIndex(index, &opts);
+  }  // and otherwise the index starts out empty, and fills as the feeds are polled
+  AttachDictionary(index);
+  if (opts.benchmark && opts.pollInterval == 0) {
+    ReportBenchmark(index, MonotonicNanos() - start);
+    ReportFilterBenchmark(index);
+    ReportNearDuplicates(index);
+    ReportSpill(index);
+    ReportSegments(index);
+    ReportDictionary(index);
+    ReportSpelling(index);
+    ReportFacets(index);
+    ReportTermStats(index);
+    WriteInstrumentReport(opts.instrumentFileName);
+    FreeNewsIndex(index);
+    StopWordListDispose(&stopWords);
+    if (caching) QueryCacheDispose(&cache);
+    return 0;
+  }
+  ReportIndexFootprint(index);
+  SnapshotNew(&indices, index, FreeNewsIndex);
+  coordinator shards;
+  if (opts.numShardPorts > 0) CoordinatorNew(&shards, opts.shardPorts, opts.numShardPorts);
+  queryengine engine = { &stopWords, &indices, caching ? &cache : NULL, opts.numShardPorts > 0 ? &shards : NULL };
+  if (opts.refreshInterval > 0) StartRefreshing(&indices, &stopWords, &opts);
+  if (opts.pollInterval > 0) StartPolling(&indices, &stopWords, &opts);
+  if (opts.benchmark) {
+    sleep(opts.pollSeconds);  // only a polling benchmark gets this far
+  } else if (opts.batchFileName != NULL) {
+    RunBatchQueries(opts.batchFileName, batchResults, opts.numThreads, &engine);
+  } else if (opts.servePort != 0) {
+    QueryServerRun(opts.servePort, ServeQuery, &engine);
+  } else {
+    QueryIndices(&engine);//
+  }
+  if (opts.refreshInterval > 0) StopRefreshing();
+  if (opts.pollInterval > 0) StopPolling(opts.benchmark ? stderr : NULL);
+  if (opts.benchmark) ReportBenchmark(index, MonotonicNanos() - start);
+  WriteInstrumentReport(opts.instrumentFileName);
+  SnapshotDispose(&indices);
+  StopWordListDispose(&stopWords);
+  if (caching) QueryCacheDispose(&cache);
+  if (opts.numShardPorts > 0) CoordinatorDispose(&shards);
+  free(opts.shardPorts);
   return 0;
 }
 
 
 
-// Adds stop-words, read from a file to hashset
-void AddStopWords(hashset *stopWords)
+// Sets up the stop words: the list compiled in from stop-words.txt, unless fileName names another
+static void AddStopWords(stopwordlist *stopWords, const char *fileName)
 {
-  HashSetNew(stopWords, sizeof(char *), 1009, StringHash, StrCmp, FreeString); 
-  FILE *infile;
-  infile = fopen(kDefaultStopWordsFile, "r");
-  assert(infile != NULL);
-  streamtokenizer st;
-  char word[128];
-  STNew(&st, infile, kNewLineDelimiters, true);
-  while(STNextToken(&st, word, sizeof(word))) { 
-    char *copy = strdup(word);
-    HashSetEnter(stopWords, &copy);
+  if (!StopWordListNew(stopWords, fileName)) {
+    fprintf(stderr, "Unable to read stop words from \"%s\".\n", fileName);
+    exit(1);
   }
-  STDispose(&st);
-  fclose(infile);
 }
 
 /** 
@@ -137,403 +614,2012 @@ static void Welcome(const char *welcomeTextFileName)
  * document and index its content.
  */
 
-static void BuildIndices(hashset *index, hashset *seenArticles, hashset *stopWords)
+typedef void (*FeedURLFunction)(const char *url, void *auxData);
+
+// Calls fn with the URL of each feed in the feed list, in order
+static void MapFeedList(FeedURLFunction fn, void *auxData)
 {
   FILE *infile;
   streamtokenizer st;
   char remoteFileName[1024];
   
-  infile = fopen(kDefaultFeedsFile, "r");
+  infile = fopen(feedsFile, "r");
   assert(infile != NULL);
   STNew(&st, infile, kNewLineDelimiters, true);
   while (STSkipUntil(&st, ":") != EOF) { // ignore everything up to the first semicolon of the line
     STSkipOver(&st, ": ");		 // now ignore the semicolon and any whitespace directly after it
     STNextToken(&st, remoteFileName, sizeof(remoteFileName));   
-    ProcessFeed(remoteFileName, index, seenArticles, stopWords);
+    fn(remoteFileName, auxData);
   }
   
   STDispose(&st);
   fclose(infile);
+}
+
+static void BuildFeed(const char *url, void *auxData)
+{
+  struct feedcontext *context = auxData;
+  ProcessFeed(url, context->index, context->stopWords);
+}
+
+static void BuildIndices(newsindex *index, stopwordlist *stopWords)
+{
+  struct feedcontext context = { index, stopWords, NULL };
+  MapFeedList(BuildFeed, &context);
   printf("\n");
 }
 
 
 /**
- * Function: ProcessFeed
- * ---------------------
- * ProcessFeed locates the specified RSS document, and if a (possibly redirected) connection to that remote
- * document can be established, then PullAllNewsItems is tapped to actually read the feed.  Check out the
- * documentation of the PullAllNewsItems function for more information, and inspect the documentation
- * for ParseArticle for information about what the different response codes mean.
+ * Function: ReportIndexFootprint
+ * ------------------------------
+ * Prints how much memory the compressed posting lists occupy, expressed
+ * as bytes per posting, and how quickly the full set of posting lists
+ * can be decoded.  The decode pass is timed against the monotonic clock
+ * so that it's unaffected by adjustments to the wall clock.
  */
 
-static void ProcessFeed(const char *remoteDocumentName, hashset *index, hashset *seenArticles, hashset *stopWords)
+struct footprint {
+  int words;
+  long postings;
+  long bytes;
+  long dictionaryBytes;
+  long checksum; // keeps the decode loop from being optimized away
+};
+
+static void AccumulateFootprint(void *elemAddr, void *auxData)
 {
-  url u;
-  urlconnection urlconn;
-  
-  URLNewAbsolute(&u, remoteDocumentName);
-  URLConnectionNew(&urlconn, &u);
+  struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
+  struct footprint *fp = auxData;
+  fp->words++;
+  fp->postings += PostingsLength(&wordArt->articles);
+  fp->bytes += PostingsBytes(&wordArt->articles);
+  fp->dictionaryBytes += strlen(wordArt->word) + 1 + sizeof(struct wordArticles);
+}
+
+static void DecodePostings(void *elemAddr, void *auxData)
+{
+  struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
+  struct footprint *fp = auxData;
+  postingsiterator it;
+  int docID, freq;
+  PostingsIteratorNew(&it, &wordArt->articles);
+  while (PostingsIteratorNext(&it, &docID, &freq)) fp->checksum += docID + freq;
+}
+
+static void ReportIndexFootprint(newsindex *index)
+{
+  struct footprint fp = { 0, 0, 0, 0, 0 };
+  struct timespec start, end;
   
-  switch (urlconn.responseCode) {
-      case 0: printf("Unable to connect to \"%s\".  Ignoring...", u.serverName);
-              break;
-  case 200: PullAllNewsItems(&urlconn, index, seenArticles, stopWords);
-                break;
-      case 301: 
-  case 302: ProcessFeed(urlconn.newUrl, index, seenArticles, stopWords);
-                break;
-      default: printf("Connection to \"%s\" was established, but unable to retrieve \"%s\". [response code: %d, response message:\"%s\"]\n",
-		      u.serverName, u.fileName, urlconn.responseCode, urlconn.responseMessage);
-	       break;
-  };
+  NewsIndexMapWords(index, AccumulateFootprint, &fp);
+  if (fp.postings == 0) return;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  NewsIndexMapWords(index, DecodePostings, &fp);
+  clock_gettime(CLOCK_MONOTONIC, &end);
   
-  URLConnectionDispose(&urlconn);
-  URLDispose(&u);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("Indexed %d articles: %d words, %ld postings in %ld bytes (%.2f bytes/posting).\n",
+	 NewsIndexArticleCount(index), fp.words, fp.postings, fp.bytes, (double) fp.bytes / fp.postings);
+  if (seconds > 0)
+    printf("Decoded all posting lists in %.3f ms (%.1f million postings/sec).\n\n",
+	   seconds * 1e3, fp.postings / seconds / 1e6);
 }
 
 /**
- * Function: PullAllNewsItems
- * --------------------------
- * Steps though the data of what is assumed to be an RSS feed identifying the names and
- * URLs of online news articles.  Check out "datafiles/sample-rss-feed.txt" for an idea of what an
- * RSS feed from the www.nytimes.com (or anything other server that syndicates is stories).
- *
- * PullAllNewsItems views a typical RSS feed as a sequence of "items", where each item is detailed
- * using a generalization of HTML called XML.  A typical XML fragment for a single news item will certainly
- * adhere to the format of the following example:
- *
- * <item>
- *   <title>At Installation Mass, New Pope Strikes a Tone of Openness</title>
- *   <link>http://www.nytimes.com/2005/04/24/international/worldspecial2/24cnd-pope.html</link>
- *   <description>The Mass, which drew 350,000 spectators, marked an important moment in the transformation of Benedict XVI.</description>
- *   <author>By IAN FISHER and LAURIE GOODSTEIN</author>
- *   <pubDate>Sun, 24 Apr 2005 00:00:00 EDT</pubDate>
- *   <guid isPermaLink="false">http://www.nytimes.com/2005/04/24/international/worldspecial2/24cnd-pope.html</guid>
- * </item>
- *
- * PullAllNewsItems reads and discards all characters up through the opening <item> tag (discarding the <item> tag
- * as well, because once it's read and indentified, it's been pulled,) and then hands the state of the stream to
- * ProcessSingleNewsItem, which handles the job of pulling and analyzing everything up through and including the </item>
- * tag. PullAllNewsItems processes the entire RSS feed and repeatedly advancing to the next <item> tag and then allowing
- * ProcessSingleNewsItem do process everything up until </item>.
+ * Function: ReportBenchmark
+ * -------------------------
+ * Prints a one-line summary of a --bench run to standard error (standard output
+ * is left to the per-article progress messages, which benchmarks usually discard):
+ * how many articles and tokens were indexed, the throughput of each over the whole
+ * build, the peak resident set size of the process, and the size of the finished
+ * index, which counts the compressed posting lists plus the dictionary's words and
+ * their records.  The throughput figures include reading the corpus, so they're
+ * most meaningful for replayed corpora, where no time is spent on the network.
+ * The line also gives the bytes of article bodies scanned and the time spent
+ * scanning them (ScanArticle's time, which includes adding their words to the
+ * index), so that ways of scanning articles can be compared on their own.
  */
 
-static const char *const kTextDelimiters = " \t\n\r\b!@$%^*()_+={[}]|\\'\":;/?.>,<~`";
-static void PullAllNewsItems(urlconnection *urlconn, hashset *index, hashset *seenArticles, hashset *stopWords)
+static long tokensScanned;  // well-formed words pulled from article bodies, tags excluded
+static long wordsIndexed;   // those that weren't stop words, and so were added to the index
+static long bytesScanned;   // bytes of article bodies read, where the stream could tell
+static long long scanNanos; // time spent in ScanArticle
+static long wordsFolded;    // words of near-duplicate articles, which were never added to the index
+
+static void ReportBenchmark(newsindex *index, long long elapsedNanos)
 {
-  streamtokenizer st;
-  STNew(&st, urlconn->dataStream, kTextDelimiters, false);
-  while (GetNextItemTag(&st)) { // if true is returned, then assume that <item ...> has just been read and pulled from the data stream
-    ProcessSingleNewsItem(&st, index, seenArticles, stopWords);
-  }
-  
-  STDispose(&st);
+  struct footprint fp = { 0, 0, 0, 0, 0 };
+  struct rusage usage;
+  NewsIndexMapWords(index, AccumulateFootprint, &fp);
+  getrusage(RUSAGE_SELF, &usage);
+  double seconds = elapsedNanos / 1e9;
+  if (seconds <= 0) seconds = 1e-9;
+  double scanSeconds = __atomic_load_n(&scanNanos, __ATOMIC_RELAXED) / 1e9;
+  fprintf(stderr, "articles %d  tokens %ld  indexed %ld  seconds %.3f  articles/sec %.0f  tokens/sec %.0f  "
+	  "scan-bytes %ld  scan-seconds %.3f  scan-bytes/sec %.0f  "
+	  "peak-rss-kb %ld  index-bytes %ld  (postings %ld, dictionary %ld, %d words)\n",
+	  NewsIndexArticleCount(index), __atomic_load_n(&tokensScanned, __ATOMIC_RELAXED),
+	  __atomic_load_n(&wordsIndexed, __ATOMIC_RELAXED), seconds, NewsIndexArticleCount(index) / seconds,
+	  __atomic_load_n(&tokensScanned, __ATOMIC_RELAXED) / seconds, __atomic_load_n(&bytesScanned, __ATOMIC_RELAXED),
+	  scanSeconds, scanSeconds <= 0 ? 0 : __atomic_load_n(&bytesScanned, __ATOMIC_RELAXED) / scanSeconds,
+	  buildPeakKB > 0 ? buildPeakKB : usage.ru_maxrss,
+	  fp.bytes + fp.dictionaryBytes, fp.bytes, fp.dictionaryBytes, fp.words);
 }
 
 /**
- * Function: GetNextItemTag
- * ------------------------
- * Works more or less like GetNextTag below, but this time
- * we're searching for an <item> tag, since that marks the
- * beginning of a block of HTML that's relevant to us.  
- * 
- * Note that each tag is compared to "<item" and not "<item>".
- * That's because the item tag, though unlikely, could include
- * attributes and perhaps look like any one of these:
- *
- *   <item>
- *   <item rdf:about="Latin America reacts to the Vatican">
- *   <item requiresPassword=true>
- *
- * We're just trying to be as general as possible without
- * going overboard.  (Note that we use strncasecmp so that
- * string comparisons are case-insensitive.  That's the case
- * throughout the entire code base.)
+ * Function: ReportFilterBenchmark
+ * -------------------------------
+ * Measures the word index's Bloom filter, if it has one, and prints one line about it
+ * to standard error.  The workload is miss-heavy: every probe is an indexed word with
+ * a '#' appended, which no indexed word can contain, so every probe misses and lands
+ * in the word index's buckets just as an unknown query word would.  The probes are
+ * looked up kFilterPasses times over with the filter, and again with the filter
+ * detached, and the line gives the false-positive rate seen (probes the filter let
+ * through) beside the rate predicted from the filter's fill, and the mean time per
+ * lookup both ways.  Indexed words are timed the same way, since for those the filter
+ * is pure overhead.
  */
 
-static const char *const kItemTagPrefix = "<item";
-static bool GetNextItemTag(streamtokenizer *st)
+static const int kFilterProbes = 1 << 16;
+static const int kFilterPasses = 16;
+
+static void CollectWords(void *elemAddr, void *auxData)
 {
-  char htmlTag[1024];
-  while (GetNextTag(st, htmlTag, sizeof(htmlTag))) {
-    if (strncasecmp(htmlTag, kItemTagPrefix, strlen(kItemTagPrefix)) == 0) {
-      return true;
-    }
-  }	 
-  return false;
+  struct wordArticles *wordArt = *(struct wordArticles **) elemAddr;
+  VectorAppend(auxData, &wordArt->word);
 }
 
-/**
- * Function: ProcessSingleNewsItem
- * -------------------------------
- * Code which parses the contents of a single <item> node within an RSS/XML feed.
- * At the moment this function is called, we're to assume that the <item> tag was just
- * read and that the streamtokenizer is currently pointing to everything else, as with:
- *   
- *      <title>Carrie Underwood takes American Idol Crown</title>
- *      <description>Oklahoma farm girl beats out Alabama rocker Bo Bice and 100,000 other contestants to win competition.</description>
- *      <link>http://www.nytimes.com/frontpagenews/2841028302.html</link>
- *   </item>
- *
- * ProcessSingleNewsItem parses everything up through and including the </item>, storing the title, link, and article
- * description in local buffers long enough so that the online new article identified by the link can itself be parsed
- * and indexed.  We don't rely on <title>, <link>, and <description> coming in any particular order.  We do asssume that
- * the link field exists (although we can certainly proceed if the title and article descrption are missing.)  There
- * are often other tags inside an item, but we ignore them.
- */
-
-static const char *const kItemEndTag = "</item>";
-static const char *const kTitleTagPrefix = "<title";
-static const char *const kDescriptionTagPrefix = "<description";
-static const char *const kLinkTagPrefix = "<link";
-static void ProcessSingleNewsItem(streamtokenizer *st, hashset *index, hashset *seenArticles, hashset *stopWords)
-{
-  char htmlTag[1024];
-  char articleTitle[1024];
-  char articleDescription[1024];
-  char articleURL[1024];
-  articleTitle[0] = articleDescription[0] = articleURL[0] = '\0';
-  
-  while (GetNextTag(st, htmlTag, sizeof(htmlTag)) && (strcasecmp(htmlTag, kItemEndTag) != 0)) {
-    if (strncasecmp(htmlTag, kTitleTagPrefix, strlen(kTitleTagPrefix)) == 0) ExtractElement(st, htmlTag, articleTitle, sizeof(articleTitle));
-    if (strncasecmp(htmlTag, kDescriptionTagPrefix, strlen(kDescriptionTagPrefix)) == 0) ExtractElement(st, htmlTag, articleDescription, sizeof(articleDescription));
-    if (strncasecmp(htmlTag, kLinkTagPrefix, strlen(kLinkTagPrefix)) == 0) ExtractElement(st, htmlTag, articleURL, sizeof(articleURL));
+// Returns the mean nanoseconds taken to look up each of the n words, passes times over
+static double TimeLookups(newsindex *index, char **words, int n, int passes)
+{
+  long found = 0;
+  long long start = MonotonicNanos();
+  for (int p = 0; p < passes; p++)
+    for (int i = 0; i < n; i++)
+      for (int s = 0; s < NewsIndexSegmentCount(index); s++) found += NewsIndexLookup(index, s, words[i]) != NULL;
+  long long elapsed = MonotonicNanos() - start;
+  __asm__ volatile("" : : "r"(found));  // keeps the lookups from being optimized away
+  return (double) elapsed / ((long) n * passes);
+}
+
+static void ReportFilterBenchmark(newsindex *index)
+{
+  bloomfilter *filter = index->filter;
+  if (filter == NULL || NewsIndexWordCount(index) == 0) return;
+  vector words;
+  VectorNew(&words, sizeof(char *), NULL, 0);
+  NewsIndexMapWords(index, CollectWords, &words);
+  int n = VectorLength(&words) < kFilterProbes ? VectorLength(&words) : kFilterProbes;
+  char *hits[n], *misses[n];
+  int passed = 0;
+  for (int i = 0; i < n; i++) {
+    hits[i] = *(char **) VectorNth(&words, (long) i * VectorLength(&words) / n);
+    misses[i] = malloc(strlen(hits[i]) + 2);
+    sprintf(misses[i], "%s#", hits[i]);
+    if (NewsIndexMayContain(index, misses[i])) passed++;
   }
-  
-  if (strncmp(articleURL, "", sizeof(articleURL)) == 0) return;     // punt, since it's not going to take us anywhere
-  ParseArticle(articleTitle, articleDescription, articleURL, index, seenArticles, stopWords);
+
+  double missNanos = TimeLookups(index, misses, n, kFilterPasses);
+  double hitNanos = TimeLookups(index, hits, n, kFilterPasses);
+  index->filter = NULL;  // detached just while timing the bare word index
+  double bareMissNanos = TimeLookups(index, misses, n, kFilterPasses);
+  double bareHitNanos = TimeLookups(index, hits, n, kFilterPasses);
+  index->filter = filter;
+
+  fprintf(stderr, "filter  bits/word %.1f  hashes %d  bytes %ld  false-positive-rate %.4f  (predicted %.4f)  "
+	  "miss-ns %.1f  (without filter %.1f)  hit-ns %.1f  (without filter %.1f)\n",
+	  8.0 * BloomFilterBytes(filter) / filter->numElems, filter->numHashes, BloomFilterBytes(filter),
+	  (double) passed / n, BloomFilterFalsePositiveRate(filter), missNanos, bareMissNanos, hitNanos, bareHitNanos);
+  for (int i = 0; i < n; i++) free(misses[i]);
+  VectorDispose(&words);
 }
 
 /**
- * Function: ExtractElement
- * ------------------------
- * Potentially pulls text from the stream up through and including the matching end tag.  It assumes that
- * the most recently extracted HTML tag resides in the buffer addressed by htmlTag.  The implementation
- * populates the specified data buffer with all of the text up to but not including the opening '<' of the
- * closing tag, and then skips over all of the closing tag as irrelevant.  Assuming for illustration purposes
- * that htmlTag addresses a buffer containing "<description" followed by other text, these three scanarios are
- * handled:
- *
- *    Normal Situation:     <description>http://some.server.com/someRelativePath.html</description>
- *    Uncommon Situation:   <description></description>
- *    Uncommon Situation:   <description/>
- *
- * In each of the second and third scenarios, the document has omitted the data.  This is not uncommon
- * for the description data to be missing, so we need to cover all three scenarious (I've actually seen all three.)
- * It would be quite unusual for the title and/or link fields to be empty, but this handles those possibilities too.
+ * Function: ReportNearDuplicates
+ * ------------------------------
+ * Prints one line to standard error about the near-duplicate articles the index
+ * detected, if it was detecting them: how many articles were folded into others,
+ * how many words those articles held that were never added to the index, and the
+ * bytes taken by the articles' MinHash signatures and their band table.
  */
- 
-static void ExtractElement(streamtokenizer *st, const char *htmlTag, char dataBuffer[], int bufferLength)
+
+static void ReportNearDuplicates(newsindex *index)
 {
-  assert(htmlTag[strlen(htmlTag) - 1] == '>');
-  if (htmlTag[strlen(htmlTag) - 2] == '/') return;    // e.g. <description/> would state that a description is not being supplied
-  STNextTokenUsingDifferentDelimiters(st, dataBuffer, bufferLength, "<");
-  RemoveEscapeCharacters(dataBuffer);
-  if (dataBuffer[0] == '<') strcpy(dataBuffer, "");  // e.g. <description></description> also means there's no description
-  STSkipUntil(st, ">");
-  STSkipOver(st, ">");
+  if (index->signatures == NULL) return;
+  fprintf(stderr, "near-duplicates  threshold %.2f  folded %d  (of %d articles)  words-folded %ld  signature-bytes %ld\n",
+	  index->signatures->threshold, NewsIndexFoldedCount(index), NewsIndexArticleCount(index),
+	  __atomic_load_n(&wordsFolded, __ATOMIC_RELAXED), MinHashIndexBytes(index->signatures));
 }
 
-/** 
- * Function: ParseArticle
- * ----------------------
- * Attempts to establish a network connect to the news article identified by the three
- * parameters.  The network connection is either established of not.  The implementation
- * is prepared to handle a subset of possible (but by far the most common) scenarios,
- * and those scenarios are categorized by response code:
- *
- *    0 means that the server in the URL doesn't even exist or couldn't be contacted.
- *    200 means that the document exists and that a connection to that very document has
- *        been established.
- *    301 means that the document has moved to a new location
- *    302 also means that the document has moved to a new location
- *    4xx and 5xx (which are covered by the default case) means that either
- *        we didn't have access to the document (403), the document didn't exist (404),
- *        or that the server failed in some undocumented way (5xx).
- *
- * The are other response codes, but for the time being we're punting on them, since
- * no others appears all that often, and it'd be tedious to be fully exhaustive in our
- * enumeration of all possibilities.
+/**
+ * Function: ReportSpill
+ * ---------------------
+ * Prints one line to standard error about a build made within a memory budget: the
+ * budget, the number and total size of the runs spilled, and the time taken to merge
+ * them.  (The --bench line's peak-rss-kb is then the peak before the merged index was
+ * loaded back, which is what the budget bounds.)
  */
 
-static void ParseArticle(const char *articleTitle, const char *articleDescription, const char *articleURL, 
-			 hashset *index, hashset *seenArticles, hashset *stopWords)
+static void ReportSpill(newsindex *index)
 {
-  url u;
-  urlconnection urlconn;
-  streamtokenizer st;
+  spillstate *spill = index->spill;
+  if (spill == NULL) return;
+  fprintf(stderr, "spill  budget-bytes %ld  runs %d  run-bytes %ld  merge-seconds %.3f\n",
+	  spill->budget, spill->runsWritten, spill->bytesSpilled, spill->mergeNanos / 1e9);
+}
 
-  URLNewAbsolute(&u, articleURL);
-  URLConnectionNew(&urlconn, &u);
-  
-  switch (urlconn.responseCode) {
-      case 0: printf("Unable to connect to \"%s\".  Domain name or IP address is nonexistent.\n", articleURL);
-	      break;
-      case 200: printf("Scanning \"%s\" from \"http://%s\"\n", articleTitle, u.serverName);
-	        STNew(&st, urlconn.dataStream, kTextDelimiters, false);
-		struct article *art = malloc(sizeof(struct article));
-		strcpy(art->title, articleTitle);
-		strcpy(art->URL, articleURL);
-		strcpy(art->server, u.serverName);
-		void *found = HashSetLookup(seenArticles, &art);
-		if(found == NULL && strlen(articleTitle) > 0) {
-		  HashSetEnter(seenArticles, &art);
-		  ScanArticle(&st, articleTitle, u.serverName, articleURL, index, stopWords);
-		}
-		STDispose(&st);
-		break;
-      case 301:
-      case 302: // just pretend we have the redirected URL all along, though index using the new URL and not the old one...
-	ParseArticle(articleTitle, articleDescription, urlconn.newUrl, index, seenArticles, stopWords);
-		break;
-      default: printf("Unable to pull \"%s\" from \"%s\". [Response code: %d] Punting...\n", articleTitle, u.serverName, urlconn.responseCode);
-	       break;
+/**
+ * Function: ReportSegments
+ * ------------------------
+ * Prints one line to standard error about an index divided by day: the days it
+ * keeps, the segments it holds and the days they span, the articles still in
+ * them, the articles dropped with older segments, those turned away as too old,
+ * and the bytes the segments' words and posting lists take.
+ */
+
+// Writes a segment's day, counted from 1970-01-01, as an RFC 822 date without the time
+static void FormatDay(int day, char buffer[], int bufferLength)
+{
+  FormatPubDate((time_t) day * 24 * 60 * 60, buffer, bufferLength);
+  if (bufferLength > 16) buffer[16] = '\0';  // "Sun, 24 Apr 2005"
+}
+
+static void ReportSegments(newsindex *index)
+{
+  if (index->retentionDays == 0) return;
+  int numSegments = NewsIndexSegmentCount(index);
+  int live = NewsIndexArticleCount(index) - NewsIndexExpiredCount(index);
+  char newest[32] = "-", oldest[32] = "-";
+  if (numSegments > 0) {
+    FormatDay(NewsIndexSegmentDay(index, 0), newest, sizeof(newest));
+    FormatDay(NewsIndexSegmentDay(index, numSegments - 1), oldest, sizeof(oldest));
   }
-  
-  URLConnectionDispose(&urlconn);
-  URLDispose(&u);
+  fprintf(stderr, "segments  retain-days %d  live %d  (%s to %s)  articles-live %d  expired %d  too-old %d  "
+	  "word-bytes %ld\n", index->retentionDays, numSegments, oldest, newest, live, NewsIndexExpiredCount(index),
+	  NewsIndexTooOldCount(index), index->wordBytes);
 }
 
 /**
- * Function: ScanArticle
- * ---------------------
- * Parses the specified article, skipping over all HTML tags, and counts the numbers
- * of well-formed words that could potentially serve as keys in the set of indices.
- * Once the full article has been scanned, the number of well-formed words is
- * printed, and the longest well-formed word we encountered along the way
- * is printed as well.
- *
- * This is really a placeholder implementation for what will ultimately be
- * code that indexes the specified content.
+ * Function: ReportDictionary
+ * --------------------------
+ * Prints one line to standard error about the index's term dictionary: the words it
+ * holds, the bytes it takes and how long it took to build, and the median and 99th
+ * percentile time to find the kCompletionsListed most frequent completions of a
+ * prefix.  The prefixes timed are the first one to four letters of kDictionaryProbes
+ * words spread evenly through the dictionary, so the short prefixes, which have
+ * the most words to choose among, are timed as often as the long ones.
  */
 
-static void ScanArticle(streamtokenizer *st, const char *articleTitle, const char *serverName, 
-			const char *articleURL, hashset *index, hashset *stopWords)
+static const int kDictionaryProbes = 1 << 14;
+static const int kCompletionsListed = 10;
+
+static void ReportDictionary(newsindex *index)
 {
-  char word[1024];
-  while (STNextToken(st, word, sizeof(word))) {
-    if (strcasecmp(word, "<") == 0) {
-      SkipIrrelevantContent(st); // in html-utls.h
-    } else {
-      RemoveEscapeCharacters(word);
-      if (WordIsWellFormed(word) && !IsStopWord(stopWords, word)) {
-	ProcessWord(word, articleTitle, articleURL, serverName, index);
-      }
-    }
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (dictionary == NULL || TermDictionaryCount(dictionary) == 0) return;
+  int numTerms = TermDictionaryCount(dictionary), completions[kCompletionsListed];
+  long found = 0;
+  latencysamples samples;
+  LatencyNew(&samples);
+  for (int i = 0; i < kDictionaryProbes; i++) {
+    char prefix[1024];
+    TermDictionaryTerm(dictionary, (long) i * numTerms / kDictionaryProbes, prefix, sizeof(prefix));
+    int length = 1 + i % 4;
+    if (strlen(prefix) > length) prefix[length] = '\0';
+    long long start = MonotonicNanos();
+    found += TermDictionaryComplete(dictionary, prefix, kCompletionsListed, completions);
+    LatencyRecord(&samples, MonotonicNanos() - start);
   }
-    printf("\n");
+  fprintf(stderr, "dictionary  terms %d  bytes %ld  (%.1f bytes/term)  build-seconds %.3f  "
+	  "complete-p50-us %.1f  complete-p99-us %.1f  (%.1f completions/prefix)\n",
+	  numTerms, TermDictionaryBytes(dictionary), (double) TermDictionaryBytes(dictionary) / numTerms,
+	  dictionaryNanos / 1e9, LatencyPercentile(&samples, 50) / 1e3, LatencyPercentile(&samples, 99) / 1e3,
+	  (double) found / kDictionaryProbes);
+  LatencyDispose(&samples);
 }
 
-//
-static void ProcessWord(const char *word, const char *articleTitle, const char *articleURL, 
-			const char *serverName, hashset *index)
-{ 
-  struct wordArticles *wordArt = malloc(sizeof(struct wordArticles));
-  strcpy(wordArt->word, word);
-  struct article *art = malloc(sizeof(struct article));
-  strcpy(art->title, articleTitle);
-  strcpy(art->URL, articleURL);
-  strcpy(art->server, serverName);
-  art->occurrences = 1;
-  void *found = HashSetLookup(index, &wordArt); // compares only by word, so it's enough
-  if(found == NULL) { // word seen first time
-    VectorNew(&wordArt->articles, sizeof(struct article *), FreeArticle, 0);
-    VectorAppend(&wordArt->articles, &art);
-    HashSetEnter(index, &wordArt);
-  }else{ // word already in index
-    ProcessArticle(wordArt, found, art, index);
-  }  
-}
+/**
+ * Function: ReportSpelling
+ * ------------------------
+ * Prints one line to standard error about the index's trigram index: the bytes it
+ * takes, and how quickly and how well it corrects kSpellingProbes misspelled words.
+ * Each probe is a dictionary word, spread evenly through the dictionary, with one
+ * letter replaced, dropped or added; the recall is the fraction of probes whose
+ * original word is among the kSuggestions corrections offered.
+ */
 
-//
-static void ProcessArticle(struct wordArticles *wordArt, void *found, struct article *art, hashset *index)
-{ 
-  free(wordArt); // don't need that memory anymore
-  wordArt = *(struct wordArticles **) found; 
-  int vfound = VectorSearch(&wordArt->articles, &art, ArticleCmp, 0, false); // look if article already in the vector
-  if(vfound == -1) {
-    VectorAppend(&wordArt->articles, &art); // if given article isn't in vector of word's articles, append it
-  }else{
-    free(art); // don't need this memory
-    art = *(struct article **)VectorNth(&wordArt->articles, vfound);
-    art->occurrences++; // if article is already in vector, increment it occurrences value
+static const int kSpellingProbes = 1 << 12;
+static const int kSuggestions = 5;
+
+static void ReportSpelling(newsindex *index)
+{
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  const trigramindex *trigrams = NewsIndexTrigrams(index);
+  if (trigrams == NULL || TermDictionaryCount(dictionary) == 0) return;
+  int numTerms = TermDictionaryCount(dictionary), probes = 0, recalled = 0;
+  int corrections[kSuggestions], distances[kSuggestions];
+  unsigned int seed = 1;
+  latencysamples samples;
+  LatencyNew(&samples);
+  for (int i = 0; i < kSpellingProbes; i++) {
+    char word[1024], probe[1026];
+    int n = (long) i * numTerms / kSpellingProbes;
+    TermDictionaryTerm(dictionary, n, word, sizeof(word));
+    int length = strlen(word);
+    if (length < 4 || length > kMaxCorrectableLength) continue;
+    seed = seed * 1103515245 + 12345;
+    int at = (seed >> 8) % length, edit = i % 3;
+    char letter = 'a' + (seed >> 20) % 26;
+    strcpy(probe, word);
+    if (edit == 0) probe[at] = letter;
+    else if (edit == 1) memmove(probe + at, probe + at + 1, length - at);
+    else {
+      memmove(probe + at + 1, probe + at, length - at + 1);
+      probe[at] = letter;
+    }
+    long long start = MonotonicNanos();
+    int found = TrigramIndexCorrect(trigrams, probe, kSuggestions, corrections, distances);
+    LatencyRecord(&samples, MonotonicNanos() - start);
+    probes++;
+    for (int c = 0; c < found; c++)
+      if (corrections[c] == n) recalled++;
   }
+  fprintf(stderr, "spelling  trigram-bytes %ld  probes %d  recall %.3f  correct-p50-us %.1f  correct-p99-us %.1f\n",
+	  TrigramIndexBytes(trigrams), probes, probes == 0 ? 0.0 : (double) recalled / probes,
+	  LatencyPercentile(&samples, 50) / 1e3, LatencyPercentile(&samples, 99) / 1e3);
+  LatencyDispose(&samples);
 }
 
-/** 
- * Function: QueryIndices
+/**
+ * Function: ReportFacets
  * ----------------------
- * Standard query loop that allows the user to specify a single search term, and
- * then proceeds (via ProcessResponse) to list up to 10 articles (sorted by relevance)
- * that contain that word.
+ * Prints one line to standard error about the index's facets: the servers and feeds
+ * it has, the bytes their bitmaps take, next to the four bytes an id an array of ids
+ * would take, and the median and 99th percentile times to limit a word's matches to
+ * the server with the most articles and to count its matches by source.  The words
+ * are kFacetProbes dictionary words spread evenly through the dictionary.
  */
 
-static void QueryIndices(hashset *stopWords, hashset *index)
+static const int kFacetProbes = 1 << 10;
+
+static void ReportFacets(newsindex *index)
 {
-  char response[1024];
-  while (true) {
-    printf("Please enter a single query term that might be in our set of indices [enter to quit]: ");
-    fgets(response, sizeof(response), stdin);
-    response[strlen(response) - 1] = '\0';
-    if (strcasecmp(response, "") == 0) break;
-    ProcessResponse(response, stopWords, index);
-    printf("\n");
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  const facet *servers = NewsIndexServers(index), *feeds = NewsIndexFeeds(index);
+  if (dictionary == NULL || TermDictionaryCount(dictionary) == 0 || FacetCount(servers) == 0) return;
+  long ids = 0;
+  int largest = 0;
+  for (int n = 0; n < FacetCount(servers); n++) {
+    ids += BitmapCardinality(FacetArticles(servers, n));
+    if (BitmapCardinality(FacetArticles(servers, n)) > BitmapCardinality(FacetArticles(servers, largest))) largest = n;
   }
+  for (int n = 0; n < FacetCount(feeds); n++) ids += BitmapCardinality(FacetArticles(feeds, n));
+  sourcefilter filter = { .bySite = true, .byFeed = false };
+  BitmapNew(&filter.sites);
+  BitmapNew(&filter.feeds);
+  BitmapOr(&filter.sites, FacetArticles(servers, largest));
+  int numTerms = TermDictionaryCount(dictionary);
+  long matched = 0, kept = 0;
+  latencysamples filtering, counting;
+  LatencyNew(&filtering);
+  LatencyNew(&counting);
+  for (int i = 0; i < kFacetProbes; i++) {
+    char word[1024];
+    sourcecount counts[2 * kFacetsListed];
+    vector results;
+    TermDictionaryTerm(dictionary, (long) i * numTerms / kFacetProbes, word, sizeof(word));
+    VectorNew(&results, sizeof(match), NULL, 0);
+    RankResults(word, index, NULL, &results);
+    matched += VectorLength(&results);
+    long long start = MonotonicNanos();
+    CountSources(index, &results, counts);
+    LatencyRecord(&counting, MonotonicNanos() - start);
+    start = MonotonicNanos();
+    ApplyFilter(&filter, &results);
+    LatencyRecord(&filtering, MonotonicNanos() - start);
+    kept += VectorLength(&results);
+    VectorDispose(&results);
+  }
+  long bytes = FacetBytes(servers) + FacetBytes(feeds);
+  fprintf(stderr, "facets  servers %d  feeds %d  bitmap-bytes %ld  (%.2f bytes/id vs %ld as an array)  "
+	  "filter-p50-us %.1f  filter-p99-us %.1f  (%.1f of %.1f matches kept)  count-p50-us %.1f  count-p99-us %.1f\n",
+	  FacetCount(servers), FacetCount(feeds), bytes, ids == 0 ? 0.0 : (double) bytes / ids, 4 * ids,
+	  LatencyPercentile(&filtering, 50) / 1e3, LatencyPercentile(&filtering, 99) / 1e3,
+	  (double) kept / kFacetProbes, (double) matched / kFacetProbes,
+	  LatencyPercentile(&counting, 50) / 1e3, LatencyPercentile(&counting, 99) / 1e3);
+  LatencyDispose(&filtering);
+  LatencyDispose(&counting);
+  BitmapDispose(&filter.sites);
+  BitmapDispose(&filter.feeds);
 }
 
-/** 
- * Function: ProcessResponse
+/**
+ * Function: ReportTermStats
  * -------------------------
- * Placeholder implementation for what will become the search of a set of indices
- * for a list of web documents containing the specified word.
+ * Prints one line to standard error about the index's term statistics: the words
+ * counted, the bytes the statistics take, and what counting a word cost, timed for
+ * one word in kStatsTimingInterval as ProcessWord counts them, less what reading the
+ * clock around it costs.  Their accuracy is measured against the true counts, which
+ * the index's posting lists hold: how many of the kTrendingListed most frequent words
+ * the statistics list among their own kTrendingListed, how many of the dictionary's
+ * words have exact estimates, and how far the estimates are over, on average, for all
+ * words and for the kStatsChecked most frequent.
  */
 
-static void ProcessResponse(const char *word, hashset *stopWords, hashset *index)
+static const int kStatsTimingInterval = 64;
+static const int kTrendingListed = 20;
+static const int kStatsChecked = 1000;
+static const int kClockReadings = 1000;
+static long statsTimed;        // words whose counting was timed
+static long long statsNanos;   // and the time it took
+
+struct truecounts {
+  newsindex *index;
+  int *counts;
+};
+
+static void CountTrueOccurrences(int n, const char *term, void *auxData)
 {
-  if (WordIsWellFormed(word)) {
-    if(IsStopWord(stopWords, word)) {
-      printf("Too common a word to be taken seriously. Try something more specific.\n");
-      return; // break out 
-    }else{
-      GetResults(word, index);
-    } 
-  } else {
-    printf("\tWe won't be allowing words like \"%s\" into our set of indices.\n", word);
-  }
+  struct truecounts *t = auxData;
+  vector matches;
+  VectorNew(&matches, sizeof(match), NULL, 0);
+  AppendMatches(t->index, term, &matches);
+  t->counts[n] = 0;
+  for (int i = 0; i < VectorLength(&matches); i++) t->counts[n] += ((match *) VectorNth(&matches, i))->occurrences;
+  VectorDispose(&matches);
 }
 
-//
-static void GetResults(const char *word, hashset *index)
-{
-  struct wordArticles *wordArt = malloc(sizeof(struct wordArticles));
-  strcpy(wordArt->word, word);
-  void *found = HashSetLookup(index, &wordArt);
-  free(wordArt); // silly, but it's the easiest way to look up a word in index table
-  if(found == NULL) {
-    printf("None of today's news articles contain the word \"%s\" \n", word);
-  }else{
-    wordArt = *(struct wordArticles **) found;
-    vector *results = &wordArt->articles;
-    VectorSort(results, CompareByOccur);
-    int n = VectorLength(results);
-    printf("Nice! We found \"%d\" articles that include the word: \"%s\". \n", n, word); 
-    PrintResults(results, n);
-  } 
+static int *byCount;  // the true counts CompareByTrueCount orders dictionary numbers by
+static int CompareByTrueCount(const void *elemAddr1, const void *elemAddr2)
+{
+  int a = *(const int *) elemAddr1, b = *(const int *) elemAddr2;
+  if (byCount[a] != byCount[b]) return byCount[b] - byCount[a];
+  return a - b;
 }
 
-//
-static void PrintResults(vector *results, int n)
+static void ReportTermStats(newsindex *index)
 {
-  struct article *art;
-  for(int i = 0; i < n; i++) {
-    int index = i+1;
-    art = *(struct article **)VectorNth(results, i);
-    printf("%d.) \"%s\" [search term occurs %d times]\n\"%s\"\n", index, art->title, art->occurrences, art->URL);
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (dictionary == NULL || TermDictionaryCount(dictionary) == 0 || TermStatsWords(&index->stats) == 0) return;
+  int numTerms = TermDictionaryCount(dictionary);
+  struct truecounts t = { index, malloc(numTerms * sizeof(int)) };
+  int *order = malloc(numTerms * sizeof(int));
+  assert(t.counts != NULL && order != NULL);
+  TermDictionaryMap(dictionary, CountTrueOccurrences, &t);
+  for (int n = 0; n < numTerms; n++) order[n] = n;
+  byCount = t.counts;
+  qsort(order, numTerms, sizeof(int), CompareByTrueCount);
+
+  const char *trending[kTrendingListed];
+  unsigned int counts[kTrendingListed];
+  int listed = TermStatsTop(&index->stats, kTrendingListed, trending, counts), found = 0;
+  for (int i = 0; i < kTrendingListed && i < numTerms; i++) {
+    char word[1024];
+    TermDictionaryTerm(dictionary, order[i], word, sizeof(word));
+    for (int j = 0; j < listed; j++)
+      if (strcasecmp(trending[j], word) == 0) found++;
   }
+  int exact = 0;
+  double over = 0, overTop = 0;
+  for (int i = 0; i < numTerms; i++) {
+    char word[1024];
+    TermDictionaryTerm(dictionary, order[i], word, sizeof(word));
+    long error = (long) TermStatsEstimate(&index->stats, word) - t.counts[order[i]];
+    exact += error == 0;
+    over += error;
+    if (i < kStatsChecked) overTop += (double) error / t.counts[order[i]];
+  }
+  int checked = numTerms < kStatsChecked ? numTerms : kStatsChecked;
+  long timed = __atomic_load_n(&statsTimed, __ATOMIC_RELAXED);
+  long long clockNanos = MonotonicNanos();
+  for (int i = 0; i < kClockReadings; i++) MonotonicNanos();
+  clockNanos = (MonotonicNanos() - clockNanos) / (kClockReadings + 1);
+  fprintf(stderr, "termstats  words %lld  bytes %ld  add-ns %.1f  top%d-recall %d/%d  exact-estimates %.3f  "
+	  "mean-overestimate %.2f  top%d-relative-overestimate %.4f\n",
+	  TermStatsWords(&index->stats), TermStatsBytes(&index->stats),
+	  timed == 0 ? 0.0 : (double) __atomic_load_n(&statsNanos, __ATOMIC_RELAXED) / timed - clockNanos,
+	  kTrendingListed, found, kTrendingListed < numTerms ? kTrendingListed : numTerms, (double) exact / numTerms,
+	  over / numTerms, kStatsChecked, overTop / checked);
+  free(order);
+  free(t.counts);
 }
 
-//
+/**
+ * Function: StartRefreshing
+ * -------------------------
+ * Launches a background thread that recrawls every feed each --refresh interval.
+ * Each recrawl builds a brand new index from scratch while queries continue to be
+ * answered from the published one; once the new index is complete, it's published
+ * with SnapshotPublish, and the old index is reclaimed as soon as the last query
+ * still reading it finishes.  Queries never wait on the rebuild, and the reclaiming
+ * happens on the refresh thread rather than on any query's time.  StopRefreshing
+ * asks the thread to exit and waits for it, which means waiting for a recrawl to
+ * finish if one is underway.
+ */
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  bool stopping;
+  snapshot *indices;
+  stopwordlist *stopWords;
+  const options *opts;
+} refresher = { .lock = PTHREAD_MUTEX_INITIALIZER, .wakeup = PTHREAD_COND_INITIALIZER };
+
+static void *RefreshIndices(void *unused)
+{
+  pthread_mutex_lock(&refresher.lock);
+  while (!refresher.stopping) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += refresher.opts->refreshInterval;
+    while (!refresher.stopping && pthread_cond_timedwait(&refresher.wakeup, &refresher.lock, &deadline) == 0);
+    if (refresher.stopping) break;
+    pthread_mutex_unlock(&refresher.lock);
+    
+    newsindex *fresh = NewIndex(refresher.opts);
+    BuildIndices(fresh, refresher.stopWords);
+    FinishIndex(fresh, refresher.opts);
+    AttachDictionary(fresh);
+    ReportIndexFootprint(fresh);
+    SnapshotPublish(refresher.indices, fresh);
+    
+    pthread_mutex_lock(&refresher.lock);
+  }
+  pthread_mutex_unlock(&refresher.lock);
+  return NULL;
+}
+
+static void StartRefreshing(snapshot *indices, stopwordlist *stopWords, const options *opts)
+{
+  refresher.stopping = false;
+  refresher.indices = indices;
+  refresher.stopWords = stopWords;
+  refresher.opts = opts;
+  pthread_create(&refresher.thread, NULL, RefreshIndices, NULL);
+}
+
+static void StopRefreshing(void)
+{
+  pthread_mutex_lock(&refresher.lock);
+  refresher.stopping = true;
+  pthread_cond_signal(&refresher.wakeup);
+  pthread_mutex_unlock(&refresher.lock);
+  pthread_join(refresher.thread, NULL);
+}
+
+/**
+ * Function: StartPolling
+ * ----------------------
+ * With --poll, the crawl never ends.  Rather than rebuilding the index, a poll thread
+ * keeps adding to the published one: each feed is polled on a schedule of its own (see
+ * feedscheduler.h), and of each poll's items only those the feed didn't list the last
+ * time are fetched and indexed, so feeds that publish often are polled often, and quiet
+ * feeds cost next to nothing.  The thread sleeps until the next feed is due, and is woken
+ * early only to stop.
+ *
+ * Queries read the index as it grows, so while polling they hold indexLock for reading
+ * (see AcquireIndex), and the poll thread takes it for writing only while it adds an
+ * article or the words of one it has finished scanning, never while it waits on the
+ * network.  The lock prefers writers, so a steady stream of queries can't starve the poll.
+ */
+
+static pthread_rwlock_t indexLock;
+static bool polling;  // set before the poll thread starts, and cleared only once it's stopped
+static bool dictionaryStale;  // a poll has found items since the dictionary was last built (poll thread only)
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;       // guards the schedule, which :feeds reads from other threads
+  pthread_cond_t wakeup;
+  bool stopping;
+  feedscheduler schedule;
+  feedschedule *current;      // the feed being polled, or NULL
+  int ttlMinutes;             // the <ttl> it gave
+  snapshot *indices;
+  stopwordlist *stopWords;
+} poller = { .lock = PTHREAD_MUTEX_INITIALIZER, .wakeup = PTHREAD_COND_INITIALIZER };
+
+static void *PollFeeds(void *unused)
+{
+  pthread_mutex_lock(&poller.lock);
+  while (!poller.stopping) {
+    long long due = FeedSchedulerNextDue(&poller.schedule), wait;
+    while (!poller.stopping && (due == -1 || (wait = due - MonotonicNanos()) > 0)) {
+      if (due == -1) {  // no feeds to poll
+	pthread_cond_wait(&poller.wakeup, &poller.lock);
+	continue;
+      }
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      long long until = deadline.tv_nsec + wait;
+      deadline.tv_sec += until / 1000000000;
+      deadline.tv_nsec = until % 1000000000;
+      pthread_cond_timedwait(&poller.wakeup, &poller.lock, &deadline);
+    }
+    if (poller.stopping) break;
+    feedschedule *feed = FeedSchedulerBeginPoll(&poller.schedule);
+    poller.current = feed;
+    poller.ttlMinutes = 0;
+    pthread_mutex_unlock(&poller.lock);
+    
+    int reader;
+    newsindex *index = SnapshotAcquire(poller.indices, &reader);
+    ProcessFeed(feed->url, index, poller.stopWords);
+    dictionaryStale |= feed->newThisPoll > 0;
+    if (dictionaryStale && MonotonicNanos() - dictionaryBuilt > kDictionaryRebuildSeconds * 1000000000LL) {
+      AttachDictionary(index);
+      dictionaryStale = false;
+    }
+    SnapshotRelease(poller.indices, reader);
+    
+    pthread_mutex_lock(&poller.lock);
+    FeedSchedulerFinishPoll(&poller.schedule, feed, MonotonicNanos(), poller.ttlMinutes);
+    poller.current = NULL;
+  }
+  pthread_mutex_unlock(&poller.lock);
+  return NULL;
+}
+
+static void ScheduleFeed(const char *url, void *auxData)
+{
+  FeedSchedulerAdd(auxData, url);
+}
+
+static void StartPolling(snapshot *indices, stopwordlist *stopWords, const options *opts)
+{
+  pthread_rwlockattr_t attributes;
+  pthread_rwlockattr_init(&attributes);
+  pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&indexLock, &attributes);
+  pthread_rwlockattr_destroy(&attributes);
+  polling = true;
+  FeedSchedulerNew(&poller.schedule, opts->pollInterval, opts->pollInterval / 8.0, opts->pollInterval * 16.0);
+  MapFeedList(ScheduleFeed, &poller.schedule);
+  FeedSchedulerStart(&poller.schedule, MonotonicNanos());
+  poller.stopping = false;
+  poller.indices = indices;
+  poller.stopWords = stopWords;
+  pthread_create(&poller.thread, NULL, PollFeeds, NULL);
+}
+
+// Stops the poll thread, waiting for the poll underway, if there is one, to finish, and
+// then reports every feed's schedule to reportFile, unless it's NULL, and frees them
+static void StopPolling(FILE *reportFile)
+{
+  pthread_mutex_lock(&poller.lock);
+  poller.stopping = true;
+  pthread_cond_signal(&poller.wakeup);
+  pthread_mutex_unlock(&poller.lock);
+  pthread_join(poller.thread, NULL);
+  if (reportFile != NULL) ReportFeedSchedules(reportFile);
+  FeedSchedulerDispose(&poller.schedule);
+  pthread_rwlock_destroy(&indexLock);
+  polling = false;
+}
+
+// Acquires the published index for a query, holding indexLock for reading while polling
+static newsindex *AcquireIndex(snapshot *indices, int *reader)
+{
+  newsindex *index = SnapshotAcquire(indices, reader);
+  if (polling) pthread_rwlock_rdlock(&indexLock);
+  return index;
+}
+
+static void ReleaseIndex(snapshot *indices, int reader)
+{
+  if (polling) pthread_rwlock_unlock(&indexLock);
+  SnapshotRelease(indices, reader);
+}
+
+// Bracket every change the poll thread makes to the published index
+static void BeginIndexUpdate(void)
+{
+  if (polling) pthread_rwlock_wrlock(&indexLock);
+}
+
+static void EndIndexUpdate(void)
+{
+  if (polling) pthread_rwlock_unlock(&indexLock);
+}
+
+/**
+ * Function: AttachDictionary
+ * --------------------------
+ * Gives the index a term dictionary of its words, for prefix queries and completions
+ * (see termdictionary.h), and a trigram index of the dictionary, for correcting
+ * misspelled words (see trigramindex.h), once it's been built or loaded, and compacts
+ * the bitmaps of its servers and feeds (see facet.h) while it's at it.  While polling,
+ * the index goes on growing, so the poll thread builds it a new dictionary at the end of
+ * any poll that comes at least kDictionaryRebuildSeconds after the last build, if any
+ * poll since that build has found new items.  The dictionary is built without holding
+ * indexLock, since the poll thread is the only one that changes the index, and only
+ * swapped in under it.
+ */
+
+static void AttachDictionary(newsindex *index)
+{
+  long long start = MonotonicNanos();
+  termdictionary *dictionary = NewsIndexBuildDictionary(index);
+  trigramindex *trigrams = malloc(sizeof(trigramindex));
+  assert(trigrams != NULL);
+  TrigramIndexNew(trigrams, dictionary);
+  BeginIndexUpdate();
+  NewsIndexSetDictionary(index, dictionary, trigrams);
+  NewsIndexOptimizeFacets(index);
+  EndIndexUpdate();
+  dictionaryBuilt = MonotonicNanos();
+  dictionaryNanos = dictionaryBuilt - start;
+}
+
+/**
+ * Function: ReportFeedSchedules
+ * -----------------------------
+ * Prints each polled feed's schedule and what its polls have found, followed by a line
+ * summing them up:
+ *
+ *   feed <polls> <new items> <items listed> <idle polls> <failed polls> <interval> <rate> <ttl> <lag> <url>
+ *   polling feeds <n> polls <n> new-items <n> listed-items <n> skipped-items <n> idle-polls <n>
+ *           failed-polls <n> polls/minute <x> mean-lag-seconds <x>
+ *
+ * The rate is new items per hour, and the lag is the mean time from a new item's
+ * <pubDate> to the poll that found it.  skipped-items counts items listed again by a
+ * later poll, which were known not to need fetching.
+ */
+
+static void ReportFeedSchedules(FILE *outfile)
+{
+  if (!polling) {
+    fprintf(outfile, "The feeds aren't being polled (see --poll).\n");
+    return;
+  }
+  long polls = 0, newItems = 0, listedItems = 0, idlePolls = 0, failures = 0, datedItems = 0;
+  double lagSeconds = 0, elapsed = (MonotonicNanos() - poller.schedule.started) / 1e9;
+  pthread_mutex_lock(&poller.lock);
+  for (int i = 0; i < FeedSchedulerCount(&poller.schedule); i++) {
+    const feedschedule *f = FeedSchedulerNth(&poller.schedule, i);
+    fprintf(outfile, "feed %4ld %6ld %6ld %4ld %4ld  interval %7.1fs  rate %8.1f/h  ttl %5ds  lag %7.1fs  %s\n",
+	    f->polls, f->newItems, f->listedItems, f->idlePolls, f->failures, f->interval / 1e9,
+	    f->itemRate < 0 ? 0 : f->itemRate * 3600, f->ttlSeconds,
+	    f->datedItems == 0 ? 0 : f->lagSeconds / f->datedItems, f->url);
+    polls += f->polls;
+    newItems += f->newItems;
+    listedItems += f->listedItems;
+    idlePolls += f->idlePolls;
+    failures += f->failures;
+    lagSeconds += f->lagSeconds;
+    datedItems += f->datedItems;
+  }
+  fprintf(outfile, "polling feeds %d  polls %ld  new-items %ld  listed-items %ld  skipped-items %ld  idle-polls %ld  "
+	  "failed-polls %ld  polls/minute %.1f  mean-lag-seconds %.1f\n",
+	  FeedSchedulerCount(&poller.schedule), polls, newItems, listedItems, listedItems - newItems, idlePolls,
+	  failures, elapsed <= 0 ? 0 : 60 * polls / elapsed, datedItems == 0 ? 0 : lagSeconds / datedItems);
+  pthread_mutex_unlock(&poller.lock);
+}
+
+/**
+ * Function: ProcessFeed
+ * ---------------------
+ * ProcessFeed locates the specified RSS document, and if a (possibly redirected) connection to that remote
+ * document can be established, then PullAllNewsItems is tapped to actually read the feed.  Check out the
+ * documentation of the PullAllNewsItems function for more information, and inspect the documentation
+ * for ParseArticle for information about what the different response codes mean.
+ */
+
+static void ProcessFeed(const char *remoteDocumentName, newsindex *index, stopwordlist *stopWords)
+{
+  url u;
+  urlconnection urlconn;
+  
+  if (strncasecmp(remoteDocumentName, kLocalFeedPrefix, strlen(kLocalFeedPrefix)) == 0) {
+    ProcessLocalFeed(remoteDocumentName, index, stopWords);
+    return;
+  }
+  
+  URLNewAbsolute(&u, remoteDocumentName);
+  INSTRUMENT_CONTEXT(remoteDocumentName, u.serverName);
+  CorpusConnectionNew(&urlconn, &u);
+  
+  switch (urlconn.responseCode) {
+      case 0: printf("Unable to connect to \"%s\".  Ignoring...", u.serverName);
+              break;
+  case 200: PullAllNewsItems(&urlconn, remoteDocumentName, index, stopWords);
+                break;
+      case 301: 
+  case 302: ProcessFeed(urlconn.newUrl, index, stopWords);
+                break;
+      default: printf("Connection to \"%s\" was established, but unable to retrieve \"%s\". [response code: %d, response message:\"%s\"]\n",
+		      u.serverName, u.fileName, urlconn.responseCode, urlconn.responseMessage);
+	       break;
+  };
+  
+  CorpusConnectionDispose(&urlconn);
+  INSTRUMENT_CONTEXT_END();
+  URLDispose(&u);
+}
+
+/**
+ * Function: ProcessLocalFeed
+ * --------------------------
+ * Handles feed list entries of the form file:<path>, which name an RSS document on
+ * the local disk rather than on a web server.  Relative paths are resolved against
+ * the data directory, so the feed list rss-feeds-fixture.txt can point at the
+ * recorded feed in .test/index.xml.bak and exercise the whole feed-processing path
+ * without any network access.  The articles such a feed links to are still fetched
+ * through the corpus layer like any others.
+ */
+
+static void ProcessLocalFeed(const char *feed, newsindex *index, stopwordlist *stopWords)
+{
+  char path[1024];
+  urlconnection urlconn;
+  const char *fileName = feed + strlen(kLocalFeedPrefix);
+  DataFilePath(fileName, path, sizeof(path));
+  INSTRUMENT_CONTEXT(fileName, "localhost");
+  if (CorpusOpenFile(&urlconn, path)) {
+    PullAllNewsItems(&urlconn, feed, index, stopWords);
+  } else {
+    printf("Unable to open local feed \"%s\".  Ignoring...\n", path);
+  }
+  CorpusConnectionDispose(&urlconn);
+  INSTRUMENT_CONTEXT_END();
+}
+
+/**
+ * Function: PullAllNewsItems
+ * --------------------------
+ * Steps though the data of what is assumed to be an RSS feed identifying the names and
+ * URLs of online news articles.  Check out "datafiles/sample-rss-feed.txt" for an idea of what an
+ * RSS feed from the www.nytimes.com (or anything other server that syndicates is stories).
+ *
+ * PullAllNewsItems views a typical RSS feed as a sequence of "items", where each item is detailed
+ * using a generalization of HTML called XML.  A typical XML fragment for a single news item will certainly
+ * adhere to the format of the following example:
+ *
+ * <item>
+ *   <title>At Installation Mass, New Pope Strikes a Tone of Openness</title>
+ *   <link>http://www.nytimes.com/2005/04/24/international/worldspecial2/24cnd-pope.html</link>
+ *   <description>The Mass, which drew 350,000 spectators, marked an important moment in the transformation of Benedict XVI.</description>
+ *   <author>By IAN FISHER and LAURIE GOODSTEIN</author>
+ *   <pubDate>Sun, 24 Apr 2005 00:00:00 EDT</pubDate>
+ *   <guid isPermaLink="false">http://www.nytimes.com/2005/04/24/international/worldspecial2/24cnd-pope.html</guid>
+ * </item>
+ *
+ * Atom feeds, whose <entry> elements play the part of <item>s, are handled as well.  PullAllNewsItems
+ * hands the stream to a feedparser (see feedparser.h), which reads the feed in a single pass and calls
+ * ProcessSingleNewsItem with the title, link, description and date of each item as it reaches the item's end.
+ */
+
+static const char *const kTextDelimiters = " \t\n\r\b!@$%^*()_+={[}]|\\'\":;/?.>,<~`";
+
+static void PullAllNewsItems(urlconnection *urlconn, const char *feed, newsindex *index, stopwordlist *stopWords)
+{
+  feedparser parser;
+  struct feedcontext context = { index, stopWords, feed };
+  INSTRUMENT_PHASE(kPhaseParse);
+  FeedParserNew(&parser, ProcessSingleNewsItem, &context);
+  FeedParserParse(&parser, urlconn->dataStream);
+  if (polling) poller.ttlMinutes = FeedParserTTL(&parser);
+  FeedParserDispose(&parser);
+  INSTRUMENT_RESTORE();
+}
+
+/**
+ * Function: ProcessSingleNewsItem
+ * -------------------------------
+ * Feed parser callback that handles a single news item, given its title, link,
+ * description and publication date as slices of the parser's buffer.  The fields are decoded in place and
+ * cut to the lengths an article record can hold (they used to be copied into
+ * 1024-byte buffers), and the article the link points to is then parsed and indexed.
+ * We do assume that the link field exists, although we can certainly proceed if the
+ * title and article description are missing.  While polling, items the feed already
+ * listed the last time it was polled are skipped, since their articles are indexed;
+ * a new item counts as listed only once its article has been fetched, so one that
+ * couldn't be is tried again on the next poll.
+ */
+
+static const int kMaxFieldLength = 1023;
+static void ProcessSingleNewsItem(feeditem *item, void *auxData)
+{
+  struct feedcontext *context = auxData;
+  for (int f = 0; f < kNumFeedFields; f++) {
+    feedslice *field = &item->fields[f];
+    if (field->length > kMaxFieldLength) field->text[kMaxFieldLength] = '\0';
+    DecodeEntities(field->text);
+  }
+  
+  if (item->fields[kFeedLink].text[0] == '\0') return;     // punt, since it's not going to take us anywhere
+  time_t published = ParsePubDate(item->fields[kFeedDate].text);
+  if (polling) {
+    pthread_mutex_lock(&poller.lock);
+    bool listedBefore = !FeedScheduleListItem(poller.current, item->fields[kFeedLink].text, published, time(NULL));
+    pthread_mutex_unlock(&poller.lock);
+    if (listedBefore) return;  // and so already indexed
+  }
+  bool fetched = ParseArticle(item->fields[kFeedTitle].text, item->fields[kFeedDescription].text,
+			      item->fields[kFeedLink].text, context->feed, published, context->index, context->stopWords);
+  if (polling && fetched) {  // and otherwise it's fetched again next poll
+    pthread_mutex_lock(&poller.lock);
+    FeedScheduleKeepItem(poller.current, item->fields[kFeedLink].text);
+    pthread_mutex_unlock(&poller.lock);
+  }
+}
+
+/** 
+ * Function: ParseArticle
+ * ----------------------
+ * Attempts to establish a network connect to the news article identified by the three
+ * parameters.  The network connection is either established of not.  The implementation
+ * is prepared to handle a subset of possible (but by far the most common) scenarios,
+ * and those scenarios are categorized by response code:
+ *
+ *    0 means that the server in the URL doesn't even exist or couldn't be contacted.
+ *    200 means that the document exists and that a connection to that very document has
+ *        been established.
+ *    301 means that the document has moved to a new location
+ *    302 also means that the document has moved to a new location
+ *    4xx and 5xx (which are covered by the default case) means that either
+ *        we didn't have access to the document (403), the document didn't exist (404),
+ *        or that the server failed in some undocumented way (5xx).
+ *
+ * The are other response codes, but for the time being we're punting on them, since
+ * no others appears all that often, and it'd be tedious to be fully exhaustive in our
+ * enumeration of all possibilities.  Returns true if the article was fetched, and so
+ * indexed or else turned away for good (as one the index already has, for instance).
+ */
+
+static bool ParseArticle(const char *articleTitle, const char *articleDescription, const char *articleURL, 
+			 const char *feed, time_t published, newsindex *index, stopwordlist *stopWords)
+{
+  url u;
+  urlconnection urlconn;
+  bool fetched = false;
+
+  long long start = INSTRUMENT_CLOCK();
+  URLNewAbsolute(&u, articleURL);
+  INSTRUMENT_CONTEXT(NULL, u.serverName);
+  CorpusConnectionNew(&urlconn, &u);
+  
+  switch (urlconn.responseCode) {
+      case 0: printf("Unable to connect to \"%s\".  Domain name or IP address is nonexistent.\n", articleURL);
+	      break;
+      case 200: printf("Scanning \"%s\" from \"http://%s\"\n", articleTitle, u.serverName);
+		if(strlen(articleTitle) > 0) {
+		  BeginIndexUpdate();
+		  int docID = NewsIndexAddArticle(index, articleTitle, articleURL, u.serverName, feed, published);
+		  EndIndexUpdate();
+		  if(docID != -1) ScanArticle(urlconn.dataStream, docID, index, stopWords);
+		}
+		INSTRUMENT_SAMPLE(kSampleArticle, INSTRUMENT_CLOCK() - start);
+		fetched = true;
+		break;
+      case 301:
+      case 302: // just pretend we have the redirected URL all along, though index using the new URL and not the old one...
+	fetched = ParseArticle(articleTitle, articleDescription, urlconn.newUrl, feed, published, index, stopWords);
+		break;
+      default: printf("Unable to pull \"%s\" from \"%s\". [Response code: %d] Punting...\n", articleTitle, u.serverName, urlconn.responseCode);
+	       break;
+  }
+  
+  CorpusConnectionDispose(&urlconn);
+  INSTRUMENT_CONTEXT_END();
+  URLDispose(&u);
+  return fetched;
+}
+
+/**
+ * Function: ScanArticle
+ * ---------------------
+ * Reads the specified article through to its end, and indexes every well-formed word
+ * of its visible text that isn't a stop word.  The words are pulled out by an
+ * htmlscanner, which skips tags, comments, scripts and style sheets in the same pass
+ * that splits the text into words.  With --legacy-html, the article is instead split
+ * into tokens by a streamtokenizer, and each "<" token hands the stream to
+ * SkipIrrelevantContent to skip the markup it starts.
+ *
+ * When the index detects near-duplicates, words aren't added as they're found.  They're
+ * held back while a MinHash signature of them is built, and only once the article has
+ * been read, and its signature checked against those of the articles already indexed,
+ * are they added, or, for a near-duplicate, dropped as the article is folded into the
+ * one it duplicates.  Adding words is most of the cost of scanning, and the folded
+ * article's words would only have bloated the posting lists the original is already in.
+ * Words are held back while polling, too, so that queries are kept waiting on indexLock
+ * only as long as it takes to add them, rather than for as long as the article takes to
+ * arrive.
+ */
+
+static const int kMinSignatureWords = 16;  // articles shorter than this are never folded
+static const int kInitialHeldBytes = 4096;
+
+// Where ScanToken sends an article's words: straight into the index, or, when held is
+// non-NULL, into held (one null-terminated word after another) and, if the index detects
+// near-duplicates, the article's signature
+typedef struct {
+  newsindex *index;
+  int docID;
+  char *held;
+  long heldBytes, allocatedBytes;
+  minhashbuilder signature;
+} articlewords;
+
+static void HoldWord(articlewords *words, const char *word)
+{
+  long length = strlen(word) + 1;
+  if (words->heldBytes + length > words->allocatedBytes) {
+    while (words->heldBytes + length > words->allocatedBytes) words->allocatedBytes *= 2;
+    words->held = realloc(words->held, words->allocatedBytes);
+    assert(words->held != NULL);
+  }
+  memcpy(words->held + words->heldBytes, word, length);
+  words->heldBytes += length;
+  if (words->index->signatures != NULL) MinHashBuilderAddWord(&words->signature, word);
+}
+
+// Indexes one token of an article's text, counting it in *tokens if it's a well-formed
+// word and in *indexed if it's also not a stop word
+static void ScanToken(char *word, articlewords *words, stopwordlist *stopWords, long *tokens, long *indexed)
+{
+  DecodeEntities(word);
+  if (WordIsWellFormed(word)) {
+    (*tokens)++;
+    if (!IsStopWord(stopWords, word)) {
+      if (words->held == NULL) ProcessWord(word, words->docID, words->index);
+      else HoldWord(words, word);
+      (*indexed)++;
+    }
+  }
+}
+
+// Adds the held words of a fully read article to the index, unless the article's signature
+// shows it to be a near-duplicate, in which case it's folded and false is returned
+static bool AddHeldWords(articlewords *words)
+{
+  minhashsignature signature;
+  bool complete = words->index->signatures != NULL && MinHashBuilderFinish(&words->signature, &signature, kMinSignatureWords);
+  int originalID = complete ? NewsIndexFindNearDuplicate(words->index, &signature) : -1;
+  if (originalID != -1) {
+    NewsIndexFoldArticle(words->index, words->docID, originalID);
+    printf("Folded into \"%s\" as a near-duplicate.\n", NewsIndexArticle(words->index, originalID)->title);
+    return false;
+  }
+  for (long offset = 0; offset < words->heldBytes; offset += strlen(words->held + offset) + 1)
+    ProcessWord(words->held + offset, words->docID, words->index);
+  if (complete) NewsIndexAddSignature(words->index, words->docID, &signature);
+  return true;
+}
+
+static void ScanArticle(FILE *infile, int docID, newsindex *index, stopwordlist *stopWords)
+{
+  char word[1024];
+  long tokens = 0, indexed = 0, bytes;
+  long long start = MonotonicNanos();
+  articlewords words = { index, docID, NULL, 0, 0 };
+  if (index->signatures != NULL || polling) {
+    words.allocatedBytes = kInitialHeldBytes;
+    words.held = malloc(words.allocatedBytes);
+    assert(words.held != NULL);
+    MinHashBuilderNew(&words.signature);
+  }
+  INSTRUMENT_PHASE(kPhaseScan);
+  if (legacyHTML) {
+    streamtokenizer st;
+    long offset = ftell(infile);  // -1 for streams that can't tell, such as sockets
+    STNew(&st, infile, kTextDelimiters, false);
+    while (STNextToken(&st, word, sizeof(word))) {
+      if (strcasecmp(word, "<") == 0) SkipIrrelevantContent(&st); // in html-utls.h
+      else ScanToken(word, &words, stopWords, &tokens, &indexed);
+    }
+    STDispose(&st);
+    bytes = offset < 0 ? 0 : ftell(infile) - offset;
+  } else {
+    htmlscanner scanner;
+    HTMLScannerNew(&scanner, infile, kTextDelimiters);
+    while (HTMLScannerNextWord(&scanner, word, sizeof(word))) ScanToken(word, &words, stopWords, &tokens, &indexed);
+    bytes = HTMLScannerBytesScanned(&scanner);
+    HTMLScannerDispose(&scanner);
+  }
+  if (words.held != NULL) {
+    BeginIndexUpdate();
+    bool added = AddHeldWords(&words);
+    EndIndexUpdate();
+    if (!added) {
+      __atomic_add_fetch(&wordsFolded, indexed, __ATOMIC_RELAXED);
+      indexed = 0;
+    }
+    free(words.held);
+  }
+  // the refresh thread scans too, so the totals are updated atomically, once per article
+  __atomic_add_fetch(&tokensScanned, tokens, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&wordsIndexed, indexed, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&bytesScanned, bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&scanNanos, MonotonicNanos() - start, __ATOMIC_RELAXED);
+  INSTRUMENT_COUNT(kCounterArticles, 1);
+  INSTRUMENT_COUNT(kCounterTokens, tokens);
+  INSTRUMENT_COUNT(kCounterIndexed, indexed);
+  INSTRUMENT_RESTORE();
+    printf("\n");
+}
+
+// Adds one occurrence of word in article docID to the index; since articles are scanned one
+// at a time, the posting list just bumps the count of its open posting or starts a new one.
+// The word is counted in the index's term statistics too, and one word in kStatsTimingInterval
+// is timed doing so, for ReportTermStats.
+static void ProcessWord(const char *word, int docID, newsindex *index)
+{ 
+  INSTRUMENT_PHASE(kPhaseInsert);
+  NewsIndexAddWord(index, word, docID);
+  if (TermStatsWords(&index->stats) % kStatsTimingInterval == 0) {
+    long long start = MonotonicNanos();
+    TermStatsAdd(&index->stats, word);
+    __atomic_add_fetch(&statsNanos, MonotonicNanos() - start, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&statsTimed, 1, __ATOMIC_RELAXED);
+  } else TermStatsAdd(&index->stats, word);
+  INSTRUMENT_RESTORE();
+}
+
+/** 
+ * Function: QueryIndices
+ * ----------------------
+ * Standard query loop that allows the user to enter a query, one or more terms as
+ * AnswerQuery describes them (words, prefixes such as elect*, and site: and feed:
+ * filters), and then proceeds (via ProcessResponse) to list the articles that match it,
+ * sorted by relevance.  Responses beginning with a ':' are diagnostic commands
+ * rather than queries, and are handed to ProcessCommand instead.
+ */
+
+static const char kCommandPrefix = ':';
+static void QueryIndices(queryengine *engine)
+{
+  char response[1024];
+  while (true) {
+    printf("Please enter a query of one or more terms that might be in our set of indices [enter to quit]: ");
+    fgets(response, sizeof(response), stdin);
+    response[strlen(response) - 1] = '\0';
+    if (strcasecmp(response, "") == 0) break;
+    if (response[0] == kCommandPrefix) {
+      ProcessCommand(response + 1, engine);
+    } else {
+      int reader;
+      newsindex *index = AcquireIndex(engine->indices, &reader);
+      ProcessResponse(response, engine, index);
+      ReleaseIndex(engine->indices, reader);
+    }
+    printf("\n");
+  }
+}
+
+/**
+ * Function: RunBatchQueries
+ * -------------------------
+ * Non-interactive alternative to QueryIndices, meant for scripting and load testing.
+ * Every line of the query file is treated as a single query, and the queries are
+ * divided among numThreads threads that all search the same index.  Each query holds
+ * the index through AcquireIndex, which, with --poll, holds indexLock for reading so
+ * the poll thread can't change the index mid-query; the query cache, which reorders
+ * itself on every lookup, takes a lock of its own.
+ *
+ * Results are written to outfile (see OpenBatchResults), which is closed once they're
+ * all written, in query-file order, one tab-separated line per query:
+ *
+ *   <query> <status> <number of matches> <latency in microseconds> <docID>:<occurrences>,...
+ *
+ * where status is one of ok, none, stopword, malformed or unavailable (see AnswerQuery),
+ * and at most kBatchResultsPerQuery of the best matches are listed.  Once all queries are answered,
+ * the throughput and latency percentiles are printed to standard error.
+ */
+
+static const int kBatchResultsPerQuery = 10;
+
+struct batchquery {
+  char *query;
+  const char *status;
+  vector results;           // of match, best first
+  long long latency;        // in nanoseconds
+};
+
+struct batchjob {
+  struct batchquery *queries;
+  int numQueries;
+  int nextQuery;            // claimed with an atomic increment by each thread
+  queryengine *engine;
+};
+
+/**
+ * Function: AnswerQuery
+ * ---------------------
+ * Fills results (an initialized vector of matches) with the matches for the query and
+ * returns its status.  A query is one or more terms separated by spaces.  It's
+ * "malformed" if any of its terms is, and otherwise its stop words are dropped, and a
+ * query of nothing but stop words is a "stopword" query.  The matches of a query of
+ * several terms are the articles holding any of them, ranked as RankResults ranks a single
+ * term's matches, by the occurrences of all of the terms added together.  The status is
+ * "ok" if there are matches and "none" if there aren't, unless the shards holding the
+ * words couldn't be reached (with --coordinate), in which case it's "unavailable".
+ *
+ * A term ending in kPrefixWildcard, as in elect*, is a prefix, and stands for the
+ * kMaxPrefixExpansions words beginning with it that are in the most articles, as the
+ * index's term dictionary has them, or, for a coordinator, as the shards' dictionaries
+ * have them together; the prefix itself must be well formed, but it's never a stop word.
+ *
+ * Terms of the form site:<host> and feed:<URL> aren't searched for, but limit the matches
+ * to the articles from the servers named host or ending in .host, and to those listed by
+ * the feed with that URL, using the index's facets (see facet.h).  Several site: terms
+ * allow any of their servers, and likewise feed: terms; with both, an article must pass
+ * each.  The matches are found and ranked (and cached) as they would be without the
+ * filters, which then drop the articles they don't allow, so the status is "none" if they
+ * drop them all.  A query must have a term to search for, besides its filters.  The
+ * facets are those of the index being searched, which, for a coordinator, holds the
+ * articles but not their words, so a coordinator filters the shards' matches itself.
+ */
+
+static const int kMaxQueryTerms = 16;
+static const char kPrefixWildcard = kCoordinatorPrefixWildcard;
+static const int kMaxPrefixExpansions = 64;
+
+// Returns true if the term is a prefix, which it checks is well formed
+static bool IsPrefixTerm(const char *term, bool *wellFormed)
+{
+  int length = strlen(term);
+  if (length < 2 || term[length - 1] != kPrefixWildcard) {
+    *wellFormed = WordIsWellFormed(term);
+    return false;
+  }
+  char prefix[length];
+  memcpy(prefix, term, length - 1);
+  prefix[length - 1] = '\0';
+  *wellFormed = WordIsWellFormed(prefix);
+  return true;
+}
+
+static const char *const kSiteFilter = "site:";
+static const char *const kFeedFilter = "feed:";
+
+// Returns true if the server is the host or one of its subdomains
+static bool ServerIsOnHost(const char *server, const char *host)
+{
+  int length = strlen(server), hostLength = strlen(host);
+  if (length < hostLength) return false;
+  if (length > hostLength && server[length - hostLength - 1] != '.') return false;
+  return strcasecmp(server + length - hostLength, host) == 0;
+}
+
+// Returns true if the term is a filter, adding the articles of the sources it names to the
+// filter's, and otherwise copies it to the end of words, the query's other terms
+static bool ParseFilterTerm(const char *term, const newsindex *index, sourcefilter *filter, char *words, bool *wellFormed)
+{
+  *wellFormed = true;
+  if (strncasecmp(term, kSiteFilter, strlen(kSiteFilter)) == 0) {
+    const char *host = term + strlen(kSiteFilter);
+    const facet *servers = NewsIndexServers(index);
+    *wellFormed = host[0] != '\0';
+    for (int n = 0; n < FacetCount(servers); n++)
+      if (ServerIsOnHost(FacetName(servers, n), host)) BitmapOr(&filter->sites, FacetArticles(servers, n));
+    filter->bySite = true;
+    return true;
+  }
+  if (strncasecmp(term, kFeedFilter, strlen(kFeedFilter)) == 0) {
+    const facet *feeds = NewsIndexFeeds(index);
+    int n = FacetFind(feeds, term + strlen(kFeedFilter));
+    *wellFormed = term[strlen(kFeedFilter)] != '\0';
+    if (n != -1) BitmapOr(&filter->feeds, FacetArticles(feeds, n));
+    filter->byFeed = true;
+    return true;
+  }
+  sprintf(words + strlen(words), "%s%s", words[0] == '\0' ? "" : " ", term);
+  return false;
+}
+
+// Drops the results the filter doesn't allow, keeping the rest in order
+static void ApplyFilter(const sourcefilter *filter, vector *results)
+{
+  int n = 0;
+  for (int i = 0; i < VectorLength(results); i++) {
+    const match *m = VectorNth(results, i);
+    if ((!filter->bySite || BitmapContains(&filter->sites, m->docID)) &&
+	(!filter->byFeed || BitmapContains(&filter->feeds, m->docID)))
+      VectorReplace(results, m, n++);
+  }
+  while (VectorLength(results) > n) VectorDelete(results, VectorLength(results) - 1);
+}
+
+// Answers a query without filters, as AnswerQuery describes
+static const char *AnswerTerms(const char *query, queryengine *engine, newsindex *index, vector *results)
+{
+  char copy[strlen(query) + 1], *terms[kMaxQueryTerms], *rest;
+  int numTerms = 0, numStopWords = 0;
+  bool prefixed = false, wellFormed;
+  strcpy(copy, query);
+  for (char *term = strtok_r(copy, " ", &rest); term != NULL; term = strtok_r(NULL, " ", &rest)) {
+    bool prefix = IsPrefixTerm(term, &wellFormed);
+    if (!wellFormed || numTerms == kMaxQueryTerms) return "malformed";
+    prefixed |= prefix;
+    if (!prefix && IsStopWord(engine->stopWords, term)) numStopWords++;
+    else terms[numTerms++] = term;
+  }
+  if (numTerms == 0 && numStopWords > 0) return "stopword";
+  if (numTerms == 1 && !prefixed && engine->coordinator == NULL) RankResults(terms[0], index, engine->cache, results);
+  else if (numTerms > 0 && !GatherResults((const char **) terms, numTerms, engine, index, results)) return "unavailable";
+  return VectorLength(results) == 0 ? "none" : "ok";
+}
+
+static const char *AnswerQuery(const char *query, queryengine *engine, newsindex *index, vector *results)
+{
+  char copy[strlen(query) + 1], words[strlen(query) + 1], *rest;
+  bool filtered = false, wellFormed = true;
+  sourcefilter filter = { .bySite = false, .byFeed = false };
+  BitmapNew(&filter.sites);
+  BitmapNew(&filter.feeds);
+  strcpy(copy, query);
+  words[0] = '\0';
+  for (char *term = strtok_r(copy, " ", &rest); term != NULL && wellFormed; term = strtok_r(NULL, " ", &rest))
+    filtered |= ParseFilterTerm(term, index, &filter, words, &wellFormed);
+  const char *status;
+  if (!wellFormed || (filtered && words[0] == '\0')) status = "malformed";
+  else status = AnswerTerms(words, engine, index, results);
+  if (filtered && strcmp(status, "ok") == 0) {
+    ApplyFilter(&filter, results);
+    if (VectorLength(results) == 0) status = "none";
+  }
+  BitmapDispose(&filter.sites);
+  BitmapDispose(&filter.feeds);
+  return status;
+}
+
+static void *BatchWorker(void *aux)
+{
+  struct batchjob *job = aux;
+  while (true) {
+    int i = __atomic_fetch_add(&job->nextQuery, 1, __ATOMIC_RELAXED);
+    if (i >= job->numQueries) break;
+    struct batchquery *bq = &job->queries[i];
+    long long start = MonotonicNanos();
+    int reader;
+    newsindex *index = AcquireIndex(job->engine->indices, &reader);
+    VectorNew(&bq->results, sizeof(match), NULL, 0);
+    bq->status = AnswerQuery(bq->query, job->engine, index, &bq->results);
+    ReleaseIndex(job->engine->indices, reader);
+    bq->latency = MonotonicNanos() - start;
+  }
+  return NULL;
+}
+
+// Opens where the batch results go: the --output file, or else standard output, which is
+// then kept for the results alone, so they can be piped straight into a script.  Everything
+// else the program writes there, from the crawl's progress to the index's footprint, goes
+// to standard error instead.
+static FILE *OpenBatchResults(const char *outputFileName)
+{
+  FILE *outfile;
+  if (outputFileName != NULL) {
+    outfile = fopen(outputFileName, "w");
+  } else {
+    outfile = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    setvbuf(stdout, NULL, _IOLBF, 0);  // so it interleaves with the rest of standard error
+  }
+  assert(outfile != NULL);
+  return outfile;
+}
+
+static void RunBatchQueries(const char *queryFileName, FILE *outfile, int numThreads, queryengine *engine)
+{
+  FILE *infile = fopen(queryFileName, "r");
+  assert(infile != NULL);
+  
+  vector queries;
+  VectorNew(&queries, sizeof(struct batchquery), NULL, 0);
+  char line[1024];
+  while (fgets(line, sizeof(line), infile) != NULL) {
+    line[strcspn(line, kNewLineDelimiters)] = '\0';
+    if (strcmp(line, "") == 0) continue;
+    struct batchquery bq = { strdup(line), NULL };
+    VectorAppend(&queries, &bq);
+  }
+  fclose(infile);
+  
+  struct batchjob job = { VectorLength(&queries) == 0 ? NULL : VectorNth(&queries, 0), VectorLength(&queries), 0, engine };
+  pthread_t threads[numThreads];
+  long long start = MonotonicNanos();
+  for (int t = 0; t < numThreads; t++) pthread_create(&threads[t], NULL, BatchWorker, &job);
+  for (int t = 0; t < numThreads; t++) pthread_join(threads[t], NULL);
+  long long elapsed = MonotonicNanos() - start;
+  
+  latencysamples latencies;
+  LatencyNew(&latencies);
+  for (int i = 0; i < job.numQueries; i++) {
+    struct batchquery *bq = &job.queries[i];
+    int n = VectorLength(&bq->results);
+    fprintf(outfile, "%s\t%s\t%d\t%.1f\t", bq->query, bq->status, n, bq->latency / 1e3);
+    for (int r = 0; r < n && r < kBatchResultsPerQuery; r++) {
+      const match *m = VectorNth(&bq->results, r);
+      fprintf(outfile, "%s%d:%d", r == 0 ? "" : ",", m->docID, m->occurrences);
+    }
+    fprintf(outfile, "\n");
+    LatencyRecord(&latencies, bq->latency);
+    VectorDispose(&bq->results);
+    free(bq->query);
+  }
+  
+  char label[64];
+  sprintf(label, "Batch queries (%d threads)", numThreads);
+  LatencyReport(&latencies, stderr, label, elapsed);
+  LatencyDispose(&latencies);
+  VectorDispose(&queries);
+  fclose(outfile);
+}
+
+/**
+ * Function: ServeQuery
+ * --------------------
+ * Connection handler used by server mode (see queryserver.h).  Each request is a
+ * query, as AnswerQuery describes it, on a line of its own, and each reply is a header line
+ *
+ *   <status> <number of matches> <number of matches listed>
+ *
+ * followed by one tab-separated line per listed match, best first:
+ *
+ *   <occurrences> <docID> <URL> <title>
+ *
+ * status is one of ok, none, stopword, malformed or unavailable, as in batch mode, and at
+ * most kServerResultsPerQuery matches are listed.  A line too long for the server to
+ * read whole (see queryserver.h) is malformed.  Each request holds the index through
+ * AcquireIndex, so with --poll it waits out the poll thread's changes to the published
+ * index, and otherwise takes no lock at all.  Requests from a coordinator
+ * (see coordinator.h) are handed to ServeMatches instead.
+ *
+ * A request of kCompletionRequestPrefix followed by a prefix asks instead for the words
+ * beginning with it, as a search box completes them, and the reply's header line is
+ * followed by one line per word, most frequent first:
+ *
+ *   <number of articles with the word> <word>
+ *
+ * status is ok, none, malformed, or, when the words are held by shard servers, unavailable.
+ *
+ * A request of kFacetRequestPrefix followed by a query asks for the sources of its
+ * matches: the header line gives the query's status and number of matches, and the
+ * number of sources listed, and is followed by a line for each of the kFacetsListed
+ * servers, and then feeds, with the most matches, most first:
+ *
+ *   <number of matches from the source> <server or feed> <name>
+ */
+
+static const int kServerResultsPerQuery = 10;
+static const char kCompletionRequestPrefix = '~';
+static const char kFacetRequestPrefix = '@';
+static void ServeQuery(const char *query, FILE *reply, void *auxData)
+{
+  queryengine *engine = auxData;
+  if (query == NULL) {  // too long a line to be a query
+    fprintf(reply, "malformed 0 0\n");
+    return;
+  }
+  if (query[0] == kCoordinatorRequestPrefix) {
+    ServeMatches(query + 1, reply, engine);
+    return;
+  }
+  if (query[0] == kCompletionRequestPrefix) {
+    ServeCompletions(query + 1, reply, engine);
+    return;
+  }
+  if (query[0] == kFacetRequestPrefix) {
+    ServeFacets(query + 1, reply, engine);
+    return;
+  }
+  vector results;
+  int reader;
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  VectorNew(&results, sizeof(match), NULL, 0);
+  const char *status = AnswerQuery(query, engine, index, &results);
+  int n = VectorLength(&results);
+  int listed = n < kServerResultsPerQuery ? n : kServerResultsPerQuery;
+  fprintf(reply, "%s %d %d\n", status, n, listed);
+  for (int i = 0; i < listed; i++) {
+    const match *m = VectorNth(&results, i);
+    const struct article *art = NewsIndexArticle(index, m->docID);
+    fprintf(reply, "%d\t%d\t%s\t%s\n", m->occurrences, m->docID, art->URL, art->title);
+  }
+  ReleaseIndex(engine->indices, reader);
+  VectorDispose(&results);
+}
+
+/**
+ * Function: ServeMatches
+ * ----------------------
+ * Answers a coordinator's request for every match of one word, in the
+ * form coordinator.h describes: the number of matches, and then all of
+ * them, in docID order, on a line of their own.  A request for a prefix
+ * is handed to ServeExpansions instead.
+ */
+
+static void ServeMatches(const char *word, FILE *reply, queryengine *engine)
+{
+  bool wellFormed;
+  if (IsPrefixTerm(word, &wellFormed)) {
+    ServeExpansions(word, reply, engine);
+    return;
+  }
+  int reader;
+  vector matches;
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  VectorNew(&matches, sizeof(match), NULL, 0);
+  AppendMatches(index, word, &matches);
+  if (NewsIndexSegmentCount(index) > 1) VectorSort(&matches, CompareByDocID);  // segments are by day, not docID
+  fprintf(reply, "%d\n", VectorLength(&matches));
+  for (int i = 0; i < VectorLength(&matches); i++) {
+    const match *m = VectorNth(&matches, i);
+    fprintf(reply, i == 0 ? "%d %d" : " %d %d", m->docID, m->occurrences);
+  }
+  fprintf(reply, "\n");
+  ReleaseIndex(engine->indices, reader);
+  VectorDispose(&matches);
+}
+
+/**
+ * Function: ServeExpansions
+ * -------------------------
+ * Answers a coordinator's request for the words a prefix term expands to, in
+ * the form coordinator.h describes: the kMaxPrefixExpansions words beginning
+ * with the prefix that are in the most articles, as the shard's dictionary has
+ * them, so the coordinator can choose the best of every shard's.
+ */
+
+static void ServeExpansions(const char *term, FILE *reply, queryengine *engine)
+{
+  int length = strlen(term), reader, expansions[kMaxPrefixExpansions], n = 0;
+  char prefix[length], word[1024];
+  memcpy(prefix, term, length - 1);
+  prefix[length - 1] = '\0';
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (dictionary != NULL) n = TermDictionaryComplete(dictionary, prefix, kMaxPrefixExpansions, expansions);
+  fprintf(reply, "%d\n", n);
+  for (int i = 0; i < n; i++) {
+    TermDictionaryTerm(dictionary, expansions[i], word, sizeof(word));
+    fprintf(reply, "%d %s\n", TermDictionaryFrequency(dictionary, expansions[i]), word);
+  }
+  ReleaseIndex(engine->indices, reader);
+}
+
+/**
+ * Function: ServeCompletions
+ * --------------------------
+ * Answers a request for the completions of a prefix, as ServeQuery describes.
+ */
+
+static void ServeCompletions(const char *prefix, FILE *reply, queryengine *engine)
+{
+  if (!WordIsWellFormed(prefix) || prefix[0] == '\0') {
+    fprintf(reply, "malformed 0 0\n");
+    return;
+  }
+  int reader, completions[kServerResultsPerQuery];
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (engine->coordinator != NULL || dictionary == NULL) {
+    fprintf(reply, "unavailable 0 0\n");
+  } else {
+    int first, last, total = TermDictionaryPrefixRange(dictionary, prefix, &first, &last);
+    int n = TermDictionaryComplete(dictionary, prefix, kServerResultsPerQuery, completions);
+    fprintf(reply, "%s %d %d\n", n > 0 ? "ok" : "none", total, n);
+    for (int i = 0; i < n; i++) {
+      char word[1024];
+      TermDictionaryTerm(dictionary, completions[i], word, sizeof(word));
+      fprintf(reply, "%d\t%s\n", TermDictionaryFrequency(dictionary, completions[i]), word);
+    }
+  }
+  ReleaseIndex(engine->indices, reader);
+}
+
+/**
+ * Function: CountSources
+ * ----------------------
+ * Fills counts with the kFacetsListed servers with the most of the results, and then
+ * the kFacetsListed feeds, and returns how many are listed.  The results are made a
+ * bitmap of their own, which is intersected with each source's bitmap without building
+ * the intersection, so the article table is never read.
+ */
+
+static int CompareByCount(const void *elemAddr1, const void *elemAddr2)
+{
+  const sourcecount *a = elemAddr1, *b = elemAddr2;
+  if (a->count != b->count) return b->count - a->count;
+  return strcmp(a->name, b->name);
+}
+
+static int CompareInts(const void *elemAddr1, const void *elemAddr2)
+{
+  return *(const int *) elemAddr1 - *(const int *) elemAddr2;
+}
+
+// Appends the facet's kFacetsListed values with the most of the matched articles to counts
+static int CountFacet(const facet *f, const char *kind, const bitmap *matched, sourcecount counts[])
+{
+  int numValues = FacetCount(f), n = 0;
+  sourcecount *all = malloc((numValues + 1) * sizeof(sourcecount));
+  assert(all != NULL);
+  for (int v = 0; v < numValues; v++) {
+    sourcecount c = { BitmapAndCardinality(matched, FacetArticles(f, v)), kind, FacetName(f, v) };
+    if (c.count > 0) all[n++] = c;
+  }
+  qsort(all, n, sizeof(sourcecount), CompareByCount);
+  if (n > kFacetsListed) n = kFacetsListed;
+  memcpy(counts, all, n * sizeof(sourcecount));
+  free(all);
+  return n;
+}
+
+static int CountSources(const newsindex *index, const vector *results, sourcecount counts[])
+{
+  int n = VectorLength(results), docIDs[n + 1];
+  for (int i = 0; i < n; i++) docIDs[i] = ((const match *) VectorNth(results, i))->docID;
+  qsort(docIDs, n, sizeof(int), CompareInts);  // so each is added at the end of its container
+  bitmap matched;
+  BitmapNew(&matched);
+  for (int i = 0; i < n; i++) BitmapAdd(&matched, docIDs[i]);
+  int listed = CountFacet(NewsIndexServers(index), "server", &matched, counts);
+  listed += CountFacet(NewsIndexFeeds(index), "feed", &matched, counts + listed);
+  BitmapDispose(&matched);
+  return listed;
+}
+
+/**
+ * Function: ServeFacets
+ * ---------------------
+ * Answers a request for the sources of a query's matches, as ServeQuery describes.
+ */
+
+static void ServeFacets(const char *query, FILE *reply, queryengine *engine)
+{
+  vector results;
+  int reader;
+  sourcecount counts[2 * kFacetsListed];
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  VectorNew(&results, sizeof(match), NULL, 0);
+  const char *status = AnswerQuery(query, engine, index, &results);
+  int listed = CountSources(index, &results, counts);
+  fprintf(reply, "%s %d %d\n", status, VectorLength(&results), listed);
+  for (int i = 0; i < listed; i++) fprintf(reply, "%d\t%s\t%s\n", counts[i].count, counts[i].kind, counts[i].name);
+  ReleaseIndex(engine->indices, reader);
+  VectorDispose(&results);
+}
+
+/**
+ * Function: ProcessCommand
+ * ------------------------
+ * Handles the diagnostic commands understood by the query loop:
+ *
+ *   :cache      prints the query cache's hit rate and memory use
+ *   :hashsets   prints the load, chain lengths and lookup costs of the word index,
+ *               the set of seen articles (of each day's, for an index divided by day)
+ *               and the stop words, and the size and false-positive rate of the word
+ *               index's Bloom filter, if it has one
+ *   :feeds      prints each feed's polling schedule and what its polls have found, with --poll
+ *   :complete <prefix>
+ *               prints the words beginning with prefix that are in the most articles
+ *   :facets <query>
+ *               prints the servers and feeds with the most of the query's matches
+ *   :trending   prints the words the crawl has indexed most, as the term statistics have them
+ *   :estimate <word>
+ *               prints the term statistics' estimate of how often the crawl has indexed word
+ */
+
+static void ProcessCommand(const char *command, queryengine *engine)
+{
+  querycache *cache = engine->cache;
+  if (strcasecmp(command, "cache") == 0) {
+    if (cache == NULL) {
+      printf("The query cache is turned off.\n");
+      return;
+    }
+    querycachestats stats;
+    QueryCacheGetStats(cache, &stats);
+    long lookups = stats.hits + stats.misses;
+    printf("Query cache: %d entries, %ld bytes (limits: %d entries, %ld bytes)\n",
+	   stats.entries, stats.bytes, stats.maxEntries, stats.maxBytes);
+    printf("  %ld hits, %ld misses (%.1f%% hit rate), %ld evictions, %ld invalidations\n",
+	   stats.hits, stats.misses, lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups,
+	   stats.evictions, stats.invalidations);
+  } else if (strcasecmp(command, "hashsets") == 0) {
+    hashsetstats stats;
+    int reader;
+    newsindex *index = AcquireIndex(engine->indices, &reader);
+    for (int s = 0; s < NewsIndexSegmentCount(index); s++) {
+      newssegment *segment = *(newssegment **) VectorNth(&index->segments, s);
+      char words[64] = "Word index", seen[64] = "Seen articles", day[32];
+      if (segment->day != -1) {
+	FormatDay(segment->day, day, sizeof(day));
+	snprintf(words, sizeof(words), "Word index (%s)", day);
+	snprintf(seen, sizeof(seen), "Seen articles (%s)", day);
+      }
+      HashSetGetStats(&segment->words, &stats);
+      HashSetPrintStats(&stats, stdout, words);
+      HashSetGetStats(&segment->seenArticles, &stats);
+      HashSetPrintStats(&stats, stdout, seen);
+    }
+    if (index->filter != NULL)
+      printf("Word filter: %d words in %ld bytes (%.1f bits/word, %d hashes), predicted false-positive rate %.2f%%\n",
+	     index->filter->numElems, BloomFilterBytes(index->filter),
+	     index->filter->numElems == 0 ? 0.0 : 8.0 * BloomFilterBytes(index->filter) / index->filter->numElems,
+	     index->filter->numHashes, 100 * BloomFilterFalsePositiveRate(index->filter));
+    ReleaseIndex(engine->indices, reader);
+    if (engine->stopWords->compiled) {
+      printf("Stop words: %d words in the compiled perfect hash table, so every lookup is a single probe\n",
+	     StopWordListCount(engine->stopWords));
+    } else {
+      HashSetGetStats(&engine->stopWords->custom, &stats);
+      HashSetPrintStats(&stats, stdout, "Stop words");
+    }
+  } else if (strcasecmp(command, "feeds") == 0) {
+    ReportFeedSchedules(stdout);
+  } else if (strncasecmp(command, "complete ", strlen("complete ")) == 0) {
+    PrintCompletions(command + strlen("complete "), engine);
+  } else if (strncasecmp(command, "facets ", strlen("facets ")) == 0) {
+    PrintFacets(command + strlen("facets "), engine);
+  } else if (strcasecmp(command, "trending") == 0) {
+    PrintTrending(engine);
+  } else if (strncasecmp(command, "estimate ", strlen("estimate ")) == 0) {
+    int reader;
+    newsindex *index = AcquireIndex(engine->indices, &reader);
+    printf("\"%s\" was indexed about %u times, of %lld words.\n", command + strlen("estimate "),
+	   TermStatsEstimate(&index->stats, command + strlen("estimate ")), TermStatsWords(&index->stats));
+    ReleaseIndex(engine->indices, reader);
+  } else {
+    printf("Unrecognized command \"%c%s\".\n", kCommandPrefix, command);
+  }
+}
+
+// Prints the completions of a prefix for the :complete command
+static void PrintCompletions(const char *prefix, queryengine *engine)
+{
+  int reader, completions[kCompletionsListed];
+  if (!WordIsWellFormed(prefix) || prefix[0] == '\0') {
+    printf("\tWe won't be completing prefixes like \"%s\".\n", prefix);
+    return;
+  }
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (engine->coordinator != NULL || dictionary == NULL) {
+    printf("There's no term dictionary to complete prefixes from.\n");
+  } else {
+    int first, last, total = TermDictionaryPrefixRange(dictionary, prefix, &first, &last);
+    int n = TermDictionaryComplete(dictionary, prefix, kCompletionsListed, completions);
+    printf("%d words begin with \"%s\"%s\n", total, prefix, n > 0 ? "; those in the most articles:" : ".");
+    for (int i = 0; i < n; i++) {
+      char word[1024];
+      TermDictionaryTerm(dictionary, completions[i], word, sizeof(word));
+      printf("%2d.) %s [in %d articles]\n", i + 1, word, TermDictionaryFrequency(dictionary, completions[i]));
+    }
+  }
+  ReleaseIndex(engine->indices, reader);
+}
+
+// Prints the sources of a query's matches for the :facets command
+static void PrintFacets(const char *query, queryengine *engine)
+{
+  vector results;
+  int reader;
+  sourcecount counts[2 * kFacetsListed];
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  VectorNew(&results, sizeof(match), NULL, 0);
+  const char *status = AnswerQuery(query, engine, index, &results);
+  if (strcmp(status, "ok") != 0) {
+    printf("No articles to count for \"%s\" (%s).\n", query, status);
+  } else {
+    int listed = CountSources(index, &results, counts);
+    printf("%d articles match \"%s\"; the sources with the most of them:\n", VectorLength(&results), query);
+    for (int i = 0; i < listed; i++) printf("%6d  %-6s  %s\n", counts[i].count, counts[i].kind, counts[i].name);
+  }
+  ReleaseIndex(engine->indices, reader);
+  VectorDispose(&results);
+}
+
+// Prints the most frequent words the index's term statistics have seen for the :trending command
+static void PrintTrending(queryengine *engine)
+{
+  int reader;
+  const char *words[kTrendingListed];
+  unsigned int counts[kTrendingListed];
+  newsindex *index = AcquireIndex(engine->indices, &reader);
+  long long total = TermStatsWords(&index->stats);
+  int n = TermStatsTop(&index->stats, kTrendingListed, words, counts);
+  if (n == 0) printf("No words have been counted (an index loaded from a file has none).\n");
+  else printf("The words indexed most, of %lld:\n", total);
+  for (int i = 0; i < n; i++) printf("%2d.) %s [about %u times, %.2f%%]\n", i + 1, words[i], counts[i], 100.0 * counts[i] / total);
+  ReleaseIndex(engine->indices, reader);
+}
+
+/** 
+ * Function: ProcessResponse
+ * -------------------------
+ * Answers the query with AnswerQuery, as batch and server mode do, and prints what it
+ * found, or why it found nothing (see GetResults).
+ */
+
+static void ProcessResponse(const char *query, queryengine *engine, newsindex *index)
+{
+  vector results;
+  VectorNew(&results, sizeof(match), NULL, 0);
+  const char *status = AnswerQuery(query, engine, index, &results);
+  if (strcmp(status, "malformed") == 0) {
+    printf("\tWe won't be allowing words like \"%s\" into our set of indices.\n", query);
+  } else if (strcmp(status, "stopword") == 0) {
+    printf("Too common a word to be taken seriously. Try something more specific.\n");
+  } else if (strcmp(status, "unavailable") == 0) {
+    printf("The shards holding the words of \"%s\" couldn't be reached.  Try again shortly.\n", query);
+  } else {
+    GetResults(query, status, index, &results, engine->cache);
+  }
+  VectorDispose(&results);
+}
+
+// Appends every match of the word to matches, searching the index's segments newest first
+static void AppendMatches(newsindex *index, const char *word, vector *matches)
+{
+  for (int s = 0; s < NewsIndexSegmentCount(index); s++) {
+    const postings *docs = NewsIndexLookup(index, s, word);
+    if (docs == NULL) continue;
+    postingsiterator it;
+    match m;
+    PostingsIteratorNew(&it, docs);
+    while (PostingsIteratorNext(&it, &m.docID, &m.occurrences)) VectorAppend(matches, &m);
+  }
+}
+
+// Appends the matches of a query term: of the word, or, for a prefix, of each of the words
+// the index's term dictionary expands it to
+static void AppendTermMatches(newsindex *index, const char *term, vector *matches)
+{
+  int length = strlen(term);
+  const termdictionary *dictionary = NewsIndexDictionary(index);
+  if (length < 2 || term[length - 1] != kPrefixWildcard) {
+    AppendMatches(index, term, matches);
+    return;
+  }
+  if (dictionary == NULL) return;
+  char prefix[length], word[1024];
+  memcpy(prefix, term, length - 1);
+  prefix[length - 1] = '\0';
+  int expansions[kMaxPrefixExpansions];
+  int n = TermDictionaryComplete(dictionary, prefix, kMaxPrefixExpansions, expansions);
+  for (int i = 0; i < n; i++) {
+    TermDictionaryTerm(dictionary, expansions[i], word, sizeof(word));
+    AppendMatches(index, word, matches);
+  }
+}
+
+// Fills results with the word's matches, most occurrences first, from the cache when it can
+static void RankResults(const char *word, newsindex *index, querycache *cache, vector *results)
+{
+  if(cache != NULL && QueryCacheLookup(cache, word, NewsIndexVersion(index), results)) return;
+  AppendMatches(index, word, results);
+  VectorSort(results, CompareByOccur);
+  if(cache != NULL) QueryCacheInsert(cache, word, NewsIndexVersion(index), results);
+}
+
+// Orders matches by article id, so the matches of several terms can be added up
+static int CompareByDocID(const void *elemAddr1, const void *elemAddr2)
+{
+  return ((const match *) elemAddr1)->docID - ((const match *) elemAddr2)->docID;
+}
+
+// Sorts matches by docID and sums the occurrences of each article's matches into one
+static void SumMatches(vector *matches)
+{
+  VectorSort(matches, CompareByDocID);
+  int n = 0;
+  for (int i = 0; i < VectorLength(matches); i++) {
+    match *m = VectorNth(matches, i);
+    if (n > 0 && ((match *) VectorNth(matches, n - 1))->docID == m->docID)
+      ((match *) VectorNth(matches, n - 1))->occurrences += m->occurrences;
+    else VectorReplace(matches, m, n++);
+  }
+  while (VectorLength(matches) > n) VectorDelete(matches, VectorLength(matches) - 1);
+}
+
+// Asks the shards for the matches of the terms, expanding each prefix first to the words
+// of all the shards that a single index's dictionary would expand it to
+static bool GatherFromShards(const char *terms[], int numTerms, coordinator *c, vector *results)
+{
+  const char *words[numTerms * kMaxPrefixExpansions];
+  char *expansions[numTerms * kMaxPrefixExpansions];
+  int numWords = 0, numExpansions = 0;
+  bool ok = true, wellFormed;
+  for (int t = 0; t < numTerms && ok; t++) {
+    if (!IsPrefixTerm(terms[t], &wellFormed)) {
+      words[numWords++] = terms[t];
+      continue;
+    }
+    int length = strlen(terms[t]);
+    char prefix[length];
+    memcpy(prefix, terms[t], length - 1);
+    prefix[length - 1] = '\0';
+    int n = CoordinatorExpand(c, prefix, kMaxPrefixExpansions, expansions + numExpansions);
+    ok = n >= 0;
+    for (int i = 0; i < n; i++) words[numWords++] = expansions[numExpansions++];
+  }
+  if (ok && numWords > 0) ok = CoordinatorGather(c, words, numWords, results);
+  for (int i = 0; i < numExpansions; i++) free(expansions[i]);
+  return ok;
+}
+
+// Fills results with the matches of all of the terms, each article once with the terms'
+// occurrences added up and ranked as RankResults ranks them, asking the shards for them
+// when there's a coordinator.  Returns false if the shards couldn't be reached.
+static bool GatherResults(const char *terms[], int numTerms, queryengine *engine, newsindex *index, vector *results)
+{
+  char key[1024] = "";  // the cache's key: the terms, as a query of their own
+  for (int i = 0; i < numTerms; i++) snprintf(key + strlen(key), sizeof(key) - strlen(key), "%s%s", i == 0 ? "" : " ", terms[i]);
+  if (engine->cache != NULL && QueryCacheLookup(engine->cache, key, NewsIndexVersion(index), results)) return true;
+  if (engine->coordinator != NULL) {
+    if (!GatherFromShards(terms, numTerms, engine->coordinator, results)) return false;
+  } else {
+    for (int i = 0; i < numTerms; i++) AppendTermMatches(index, terms[i], results);
+    SumMatches(results);
+  }
+  VectorSort(results, CompareByOccur);
+  if (engine->cache != NULL) QueryCacheInsert(engine->cache, key, NewsIndexVersion(index), results);
+  return true;
+}
+
+// Lists the articles with the word the misspelled word was most likely meant to be, if
+// the index's trigram index finds one that's in any, and suggests the others it finds
+static void SuggestCorrections(const char *word, newsindex *index, querycache *cache)
+{
+  const trigramindex *trigrams = NewsIndexTrigrams(index);
+  int corrections[kSuggestions], distances[kSuggestions];
+  if (trigrams == NULL) return;
+  int found = TrigramIndexCorrect(trigrams, word, kSuggestions, corrections, distances);
+  bool searched = false, suggested = false;
+  for (int i = 0; i < found; i++) {
+    char correction[1024];
+    TermDictionaryTerm(NewsIndexDictionary(index), corrections[i], correction, sizeof(correction));
+    if (distances[i] == 0) continue;  // the word itself, which the index has since dropped
+    if (!searched) {
+      vector results;
+      VectorNew(&results, sizeof(match), NULL, 0);
+      RankResults(correction, index, cache, &results);
+      int n = VectorLength(&results);
+      if (n > 0) {
+	printf("Showing the \"%d\" articles that include the word \"%s\" instead.\n", n, correction);
+	PrintResults(index, &results, n);
+	searched = true;
+      }
+      VectorDispose(&results);
+      if (searched) continue;
+    }
+    printf(suggested ? ", \"%s\"" : "Did you mean \"%s\"", correction);
+    suggested = true;
+  }
+  if (suggested) printf("?\n");
+}
+
+// Prints the results of a query whose status is ok or none; a single word that's in no
+// article may be misspelled, so its likely corrections are offered
+static void GetResults(const char *query, const char *status, newsindex *index, vector *results, querycache *cache)
+{
+  int n = VectorLength(results);
+  if(strcmp(status, "none") == 0) {
+    printf("None of today's news articles match \"%s\" \n", query);
+    if (WordIsWellFormed(query)) SuggestCorrections(query, index, cache);  // and so a word, not a prefix or filter
+  }else{
+    printf("Nice! We found \"%d\" articles that match: \"%s\". \n", n, query); 
+    PrintResults(index, results, n);
+  } 
+}
+
+//
+static void PrintResults(newsindex *index, vector *results, int n)
+{
+  for(int i = 0; i < n; i++) {
+    const match *m = VectorNth(results, i);
+    const struct article *art = NewsIndexArticle(index, m->docID);
+    printf("%d.) \"%s\" [search term occurs %d times]\n\"%s\"\n", i + 1, art->title, m->occurrences, art->URL);
+  }
+}
+
+//
 static bool WordIsWellFormed(const char *word)
 {
   int i;
@@ -546,10 +2632,7 @@ static bool WordIsWellFormed(const char *word)
 }
 
 //
-static bool IsStopWord(hashset *stopWords, const char *word)
+static bool IsStopWord(stopwordlist *stopWords, const char *word)
 {
-  char *dummy = strdup(word);
-  void *result = HashSetLookup(stopWords, &dummy);
-  if(result != NULL) return true;
-  return false;
+  return StopWordListContains(stopWords, word);
 }
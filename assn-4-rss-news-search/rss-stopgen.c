@@ -0,0 +1,199 @@
+/**
+ * File: rss-stopgen.c
+ * -------------------
+ * Build step that turns a stop-word list (one word per line) into a C header
+ * holding a perfect hash table of its words, which stopwords.c
+ * compiles in.  Checking a word against the generated table takes one pass
+ * over the word to hash it, one table probe, and one memcmp.
+ *
+ *   rss-stopgen <stop-words file> <output header>
+ *
+ * The table is built by hash and displace.  Every word is hashed once, with
+ * the 32-bit FNV-1a hash of its lowercased spelling.  That hash picks one of
+ * roughly n/4 buckets, and each bucket gets a displacement chosen so that
+ * mixing it into the hashes of the bucket's words sends every one of them to a
+ * slot no other word occupies.  Buckets are placed largest first, while the
+ * table is emptiest, which is what makes small displacements easy to find.
+ * The hash function itself is shared with stopwords.c through stopwords.h, so
+ * the two can't drift apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "bool.h"
+#include "stopwords.h"
+
+static const int kWordsPerBucket = 4;
+static const unsigned kMaxDisplacement = 65535;  // displacements are stored as unsigned shorts
+
+typedef struct {
+  char *word;
+  unsigned hashcode;
+} entry;
+
+typedef struct {
+  int *members;
+  int count;
+} bucket;
+
+static int ReadWords(const char *fileName, entry **entries, int *maxLength)
+{
+  FILE *infile = fopen(fileName, "r");
+  if (infile == NULL) return -1;
+  char line[1024];
+  int n = 0, allocated = 0;
+  *entries = NULL;
+  *maxLength = 0;
+  while (fgets(line, sizeof(line), infile) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0') continue;
+    for (char *c = line; *c != '\0'; c++) *c = tolower((unsigned char) *c);
+    bool duplicate = false;
+    for (int i = 0; i < n && !duplicate; i++) duplicate = strcmp((*entries)[i].word, line) == 0;
+    if (duplicate) continue;
+    if (n == allocated) {
+      allocated = allocated == 0 ? 256 : 2 * allocated;
+      *entries = realloc(*entries, allocated * sizeof(entry));
+      assert(*entries != NULL);
+    }
+    (*entries)[n].word = strdup(line);
+    (*entries)[n].hashcode = StopWordHash(line, strlen(line));
+    if ((int) strlen(line) > *maxLength) *maxLength = strlen(line);
+    n++;
+  }
+  fclose(infile);
+  return n;
+}
+
+// Orders bucket numbers by decreasing size of the buckets in sortedBuckets
+static const bucket *sortedBuckets;
+static int CompareBucketSizes(const void *a, const void *b)
+{
+  return sortedBuckets[*(const int *) b].count - sortedBuckets[*(const int *) a].count;
+}
+
+/**
+ * Function: PlaceWords
+ * --------------------
+ * Fills in slots (numSlots of them, each -1 or the index of the word placed
+ * there) and displacements (one per bucket).  Returns false if some bucket
+ * can't be placed, which in practice only happens if two words share a hash.
+ */
+
+static bool PlaceWords(const entry *entries, int n, int numBuckets, int numSlots,
+		       int *slots, unsigned short *displacements)
+{
+  bucket *buckets = calloc(numBuckets, sizeof(bucket));
+  int *order = malloc(numBuckets * sizeof(int));
+  assert(buckets != NULL && order != NULL);
+  for (int i = 0; i < numBuckets; i++) {
+    buckets[i].members = malloc(n * sizeof(int));
+    order[i] = i;
+  }
+  for (int i = 0; i < n; i++) {
+    bucket *b = &buckets[entries[i].hashcode % numBuckets];
+    b->members[b->count++] = i;
+  }
+  sortedBuckets = buckets;
+  qsort(order, numBuckets, sizeof(int), CompareBucketSizes);
+
+  for (int i = 0; i < numSlots; i++) slots[i] = -1;
+  memset(displacements, 0, numBuckets * sizeof(unsigned short));
+  bool placed = true;
+  for (int i = 0; i < numBuckets && placed; i++) {
+    bucket *b = &buckets[order[i]];
+    if (b->count == 0) break;
+    placed = false;
+    for (unsigned d = 0; d <= kMaxDisplacement && !placed; d++) {
+      int j;
+      for (j = 0; j < b->count; j++) {
+	int slot = StopWordSlot(entries[b->members[j]].hashcode, d, numSlots);
+	if (slots[slot] != -1) break;
+	slots[slot] = b->members[j];
+      }
+      if (j == b->count) {
+	displacements[order[i]] = d;
+	placed = true;
+      } else {
+	while (--j >= 0) slots[StopWordSlot(entries[b->members[j]].hashcode, d, numSlots)] = -1;
+      }
+    }
+  }
+
+  for (int i = 0; i < numBuckets; i++) free(buckets[i].members);
+  free(buckets);
+  free(order);
+  return placed;
+}
+
+static void WriteHeader(FILE *outfile, const char *source, const entry *entries, int n, int maxLength,
+			int numBuckets, int numSlots, const int *slots, const unsigned short *displacements)
+{
+  fprintf(outfile, "/**\n * File: stopwords-table.h\n * ----------------------\n"
+	  " * Generated by rss-stopgen from %s; do not edit.\n */\n\n", source);
+  fprintf(outfile, "#define kStopWordCount %d\n#define kStopWordMaxLength %d\n"
+	  "#define kStopWordBuckets %d\n#define kStopWordSlots %d\n\n", n, maxLength, numBuckets, numSlots);
+  fprintf(outfile, "static const unsigned short kStopWordDisplacements[kStopWordBuckets] = {");
+  for (int i = 0; i < numBuckets; i++)
+    fprintf(outfile, "%s%u", i == 0 ? "\n  " : i % 16 == 0 ? ",\n  " : ", ", displacements[i]);
+  fprintf(outfile, "\n};\n\n");
+  fprintf(outfile, "// each slot holds a word's length followed by its spelling, or length 0 if it's empty\n");
+  fprintf(outfile, "static const struct {\n  unsigned char length;\n  char word[kStopWordMaxLength];\n}"
+	  " kStopWordTable[kStopWordSlots] = {\n");
+  for (int i = 0; i < numSlots; i++) {
+    if (slots[i] == -1) fprintf(outfile, "  { 0, \"\" },\n");
+    else fprintf(outfile, "  { %d, \"%s\" },\n", (int) strlen(entries[slots[i]].word), entries[slots[i]].word);
+  }
+  fprintf(outfile, "};\n");
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <stop-words file> <output header>\n", argv[0]);
+    return 1;
+  }
+
+  entry *entries;
+  int maxLength;
+  int n = ReadWords(argv[1], &entries, &maxLength);
+  if (n <= 0) {
+    fprintf(stderr, "No stop words could be read from \"%s\".\n", argv[1]);
+    return 1;
+  }
+  for (int i = 0; i < n; i++) {
+    for (const char *c = entries[i].word; *c != '\0'; c++) {
+      if (*c == '"' || *c == '\\' || !isprint((unsigned char) *c)) {
+	fprintf(stderr, "Stop word \"%s\" has characters that can't be written into the table.\n", entries[i].word);
+	return 1;
+      }
+    }
+  }
+
+  int numBuckets = (n + kWordsPerBucket - 1) / kWordsPerBucket;
+  int numSlots = 1;
+  while (numSlots < n + n / 4) numSlots *= 2;  // a power of two, at most 80% full
+  int *slots = malloc(numSlots * sizeof(int));
+  unsigned short *displacements = malloc(numBuckets * sizeof(unsigned short));
+  assert(slots != NULL && displacements != NULL);
+  if (!PlaceWords(entries, n, numBuckets, numSlots, slots, displacements)) {
+    fprintf(stderr, "Unable to build a perfect hash table for \"%s\" (do two words share a hash?).\n", argv[1]);
+    return 1;
+  }
+
+  FILE *outfile = fopen(argv[2], "w");
+  if (outfile == NULL) {
+    fprintf(stderr, "Unable to create \"%s\".\n", argv[2]);
+    return 1;
+  }
+  WriteHeader(outfile, argv[1], entries, n, maxLength, numBuckets, numSlots, slots, displacements);
+  fclose(outfile);
+  for (int i = 0; i < n; i++) free(entries[i].word);
+  free(entries);
+  free(slots);
+  free(displacements);
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <assert.h>
+#include "bool.h"
+#include "snapshot.h"
+
+void SnapshotNew(snapshot *s, void *initial, SnapshotFreeFunction freefn)
+{
+  memset(s, 0, sizeof(snapshot));
+  s->current = initial;
+  s->epoch = 1; // slots use 0 to mean free, so epochs start at 1
+  s->freefn = freefn;
+}
+
+void SnapshotDispose(snapshot *s)
+{
+  if (s->freefn != NULL) s->freefn(s->current);
+}
+
+void *SnapshotAcquire(snapshot *s, int *reader)
+{
+  // start the search for a free slot somewhere that depends on the thread, so
+  // concurrent readers usually claim different slots on their first try
+  int start = (int) (((unsigned long) pthread_self() >> 6) % kMaxSnapshotReaders);
+  while (1) {
+    unsigned long epoch = __atomic_load_n(&s->epoch, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < kMaxSnapshotReaders; i++) {
+      int slot = (start + i) % kMaxSnapshotReaders;
+      unsigned long expected = 0;
+      if (__atomic_load_n(&s->slots[slot].epoch, __ATOMIC_RELAXED) == 0 &&
+	  __atomic_compare_exchange_n(&s->slots[slot].epoch, &expected, epoch, false,
+				      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+	*reader = slot;
+	return __atomic_load_n(&s->current, __ATOMIC_SEQ_CST);
+      }
+    }
+    sched_yield(); // every slot is taken
+  }
+}
+
+void SnapshotRelease(snapshot *s, int reader)
+{
+  assert(reader >= 0 && reader < kMaxSnapshotReaders);
+  __atomic_store_n(&s->slots[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+void SnapshotPublish(snapshot *s, void *next)
+{
+  void *old = __atomic_exchange_n(&s->current, next, __ATOMIC_SEQ_CST);
+  unsigned long epoch = __atomic_add_fetch(&s->epoch, 1, __ATOMIC_SEQ_CST);
+
+  // any reader stamped with an earlier epoch may have loaded the old object
+  for (int i = 0; i < kMaxSnapshotReaders; i++) {
+    while (1) {
+      unsigned long seen = __atomic_load_n(&s->slots[i].epoch, __ATOMIC_SEQ_CST);
+      if (seen == 0 || seen >= epoch) break;
+      sched_yield();
+    }
+  }
+
+  if (s->freefn != NULL) s->freefn(old);
+}
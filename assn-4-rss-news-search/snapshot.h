@@ -0,0 +1,116 @@
+/**
+ * File: snapshot.h
+ * ----------------
+ * Defines the interface for the snapshot, which publishes a read-only
+ * object (in practice, an index) to any number of reader threads and
+ * lets a single writer replace it at any time without making readers
+ * wait.
+ *
+ * Readers bracket each use of the object with SnapshotAcquire and
+ * SnapshotRelease.  Neither call takes a lock: acquiring records the
+ * current epoch in a free reader slot and then loads the published
+ * pointer, and releasing clears the slot.  The writer swaps in the
+ * new object with a single atomic exchange, advances the epoch, and then
+ * waits until every slot is either empty or stamped with the new epoch.
+ * At that point no reader can still hold the old object, so it's handed
+ * to the free function.  This is the same grace-period idea that
+ * read-copy-update schemes rely on.
+ */
+
+#ifndef __snapshot_
+#define __snapshot_
+
+/**
+ * Constant: kMaxSnapshotReaders
+ * -----------------------------
+ * The maximum number of readers that may hold a snapshot at the same
+ * moment.  Acquiring spins while all slots are taken.
+ */
+
+#define kMaxSnapshotReaders 256
+
+/**
+ * Type: SnapshotFreeFunction
+ * --------------------------
+ * Class of function used to dispose of a published object once
+ * it's been replaced and all readers have let go of it.
+ */
+
+typedef void (*SnapshotFreeFunction)(void *object);
+
+/**
+ * Type: snapshotslot
+ * ------------------
+ * A reader slot, padded out to a cache line so that readers on different
+ * cores don't contend for the same line.
+ */
+
+typedef struct {
+  unsigned long epoch;          // 0 if the slot is free
+  char padding[64 - sizeof(unsigned long)];
+} snapshotslot;
+
+/**
+ * Type: snapshot
+ * --------------
+ * The concrete representation of the snapshot.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  void *current;
+  unsigned long epoch;
+  SnapshotFreeFunction freefn;
+  snapshotslot slots[kMaxSnapshotReaders];
+} snapshot;
+
+/**
+ * Function: SnapshotNew
+ * ---------------------
+ * Initializes the snapshot to publish initial.  freefn (which may be NULL)
+ * is applied to each object once it's been replaced and to the final
+ * object when the snapshot is disposed of.
+ */
+
+void SnapshotNew(snapshot *s, void *initial, SnapshotFreeFunction freefn);
+
+/**
+ * Function: SnapshotDispose
+ * -------------------------
+ * Frees the currently published object.  No reader may hold the snapshot,
+ * and no writer may be publishing, when this is called.
+ */
+
+void SnapshotDispose(snapshot *s);
+
+/**
+ * Function: SnapshotAcquire
+ * -------------------------
+ * Returns the currently published object, which stays valid until the
+ * matching SnapshotRelease call, however many times it's replaced in the
+ * meantime.  *reader is set to the slot that must be passed to
+ * SnapshotRelease.
+ */
+
+void *SnapshotAcquire(snapshot *s, int *reader);
+
+/**
+ * Function: SnapshotRelease
+ * -------------------------
+ * Ends the read that began with the SnapshotAcquire call that returned reader.
+ */
+
+void SnapshotRelease(snapshot *s, int reader);
+
+/**
+ * Function: SnapshotPublish
+ * -------------------------
+ * Replaces the published object with next, waits for every reader that
+ * might still be using the old object to release it, and then frees the old
+ * object.  Readers are never blocked; only the caller waits.  Only one thread
+ * may publish at a time.
+ */
+
+void SnapshotPublish(snapshot *s, void *next);
+
+#endif
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "streamtokenizer.h"
+#include "hashsets-functions.h"
+#include "stopwords.h"
+#include "stopwords-table.h"
+
+static const int kCustomBuckets = 1009;
+static const char *const kNewLineDelimiters = "\r\n";
+
+bool StopWordListNew(stopwordlist *list, const char *fileName)
+{
+  list->compiled = fileName == NULL;
+  if (list->compiled) return true;
+
+  FILE *infile = fopen(fileName, "r");
+  if (infile == NULL) return false;
+  HashSetNew(&list->custom, sizeof(char *), kCustomBuckets, StringHash, StrCmp, FreeString);
+  streamtokenizer st;
+  char word[128];
+  STNew(&st, infile, kNewLineDelimiters, true);
+  while (STNextToken(&st, word, sizeof(word))) {
+    char *copy = strdup(word);
+    if (HashSetLookup(&list->custom, &copy) != NULL) free(copy); // the hashset would replace, and leak, the original
+    else HashSetEnter(&list->custom, &copy);
+  }
+  STDispose(&st);
+  fclose(infile);
+  return true;
+}
+
+void StopWordListDispose(stopwordlist *list)
+{
+  if (!list->compiled) HashSetDispose(&list->custom);
+}
+
+bool StopWordListContains(stopwordlist *list, const char *word)
+{
+  if (!list->compiled) {
+    const char *key = word;
+    return HashSetLookup(&list->custom, &key) != NULL;
+  }
+
+  char lowercased[kStopWordMaxLength];
+  int length;
+  for (length = 0; word[length] != '\0'; length++) {
+    if (length == kStopWordMaxLength) return false; // longer than any stop word
+    lowercased[length] = tolower((unsigned char) word[length]);
+  }
+  unsigned hashcode = StopWordHash(lowercased, length);
+  unsigned displacement = kStopWordDisplacements[hashcode % kStopWordBuckets];
+  int slot = StopWordSlot(hashcode, displacement, kStopWordSlots);
+  return length > 0 && kStopWordTable[slot].length == length && memcmp(kStopWordTable[slot].word, lowercased, length) == 0;
+}
+
+int StopWordListCount(stopwordlist *list)
+{
+  return list->compiled ? kStopWordCount : HashSetCount(&list->custom);
+}
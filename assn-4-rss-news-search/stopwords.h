@@ -0,0 +1,95 @@
+/**
+ * File: stopwords.h
+ * -----------------
+ * Defines the stop-word list, the set of words too common to be worth
+ * indexing or searching for.  Every token of every article is checked
+ * against it, so membership tests need to be fast.
+ *
+ * By default the list is the one compiled into the program: the build runs
+ * rss-stopgen over the data directory's stop-words.txt to generate a
+ * perfect hash table (stopwords-table.h), in which checking a word takes
+ * one hash, one probe and one memcmp, with no allocation.  A different list
+ * can still be loaded at run time, in which case it's kept in a hashset.
+ * Either way, words are matched without regard to case.
+ */
+
+#ifndef __stopwords_
+#define __stopwords_
+
+#include "bool.h"
+#include "hashset.h"
+
+/**
+ * Type: stopwordlist
+ * ------------------
+ * The concrete representation of the stop-word list.  custom is only
+ * initialized when compiled is false.
+ */
+
+typedef struct {
+  bool compiled;
+  hashset custom;
+} stopwordlist;
+
+/**
+ * Function: StopWordListNew
+ * -------------------------
+ * Initializes the list to the compiled-in stop words if fileName is NULL,
+ * and otherwise to the words in the named file (one per line).  Returns
+ * false, leaving the list uninitialized, if the file can't be read.
+ */
+
+bool StopWordListNew(stopwordlist *list, const char *fileName);
+
+/**
+ * Function: StopWordListDispose
+ * -----------------------------
+ * Frees whatever the list allocated.
+ */
+
+void StopWordListDispose(stopwordlist *list);
+
+/**
+ * Function: StopWordListContains
+ * ------------------------------
+ * Returns true if and only if word, compared case-insensitively, is a stop word.
+ * Safe to call from any number of threads at once.
+ */
+
+bool StopWordListContains(stopwordlist *list, const char *word);
+
+/**
+ * Function: StopWordListCount
+ * ---------------------------
+ * Returns the number of words in the list.
+ */
+
+int StopWordListCount(stopwordlist *list);
+
+/**
+ * Functions: StopWordHash, StopWordSlot
+ * -------------------------------------
+ * The hash function behind the compiled table, defined here so that rss-stopgen,
+ * which builds the table, and stopwords.c, which probes it, agree on it exactly.
+ * StopWordHash is the 32-bit FNV-1a hash of the first length characters of an
+ * already lowercased word.  StopWordSlot mixes a bucket's displacement into a
+ * word's hash and reduces it to a slot in a table of numSlots (a power of two).
+ */
+
+static inline unsigned StopWordHash(const char *lowercased, int length)
+{
+  unsigned hashcode = 2166136261u;
+  for (int i = 0; i < length; i++) hashcode = (hashcode ^ (unsigned char) lowercased[i]) * 16777619u;
+  return hashcode;
+}
+
+static inline int StopWordSlot(unsigned hashcode, unsigned displacement, int numSlots)
+{
+  unsigned mixed = hashcode ^ (displacement * 0x9E3779B9u);
+  mixed ^= mixed >> 16;
+  mixed *= 0x85EBCA6Bu;
+  mixed ^= mixed >> 13;
+  return mixed & (numSlots - 1);
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "synthetic.h"
+
+static const int kWordsPerParagraph = 60;
+static const char *const kConsonants = "bcdfghjklmnprstvwz";
+static const char *const kVowels = "aeiou";
+
+unsigned long long SyntheticSeed(unsigned long long seed, unsigned long long stream)
+{
+  // splitmix64 finalizer, so that neighboring streams start far apart
+  unsigned long long z = seed * 0x9E3779B97F4A7C15ULL + stream + 1;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z == 0 ? 1 : z;
+}
+
+unsigned long long SyntheticRandom(unsigned long long *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+double SyntheticUniform(unsigned long long *state)
+{
+  return (SyntheticRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Spells out rank in alternating consonant-vowel digits, so rank 0 is "ba", rank 1 is "ca",
+// and so on.  Short words come first and so end up the most frequent, much as in real text.
+static char *SpellRank(long rank)
+{
+  char word[32];
+  int length = 0;
+  int numConsonants = strlen(kConsonants), numVowels = strlen(kVowels);
+  do {
+    word[length++] = kConsonants[rank % numConsonants];
+    rank /= numConsonants;
+    word[length++] = kVowels[rank % numVowels];
+    rank /= numVowels;
+  } while (rank > 0);
+  word[length] = '\0';
+  return strdup(word);
+}
+
+void SyntheticTextNew(synthetictext *text, int vocabularySize, double zipfExponent, int meanWords,
+		      unsigned long long seed)
+{
+  assert(vocabularySize > 0 && meanWords > 0);
+  text->words = malloc(vocabularySize * sizeof(char *));
+  text->cumulative = malloc(vocabularySize * sizeof(double));
+  assert(text->words != NULL && text->cumulative != NULL);
+  text->vocabularySize = vocabularySize;
+  text->meanWords = meanWords;
+  text->seed = seed;
+
+  double total = 0;
+  for (int rank = 0; rank < vocabularySize; rank++) {
+    text->words[rank] = SpellRank(rank);
+    total += 1.0 / pow(rank + 1, zipfExponent);
+    text->cumulative[rank] = total;
+  }
+  for (int rank = 0; rank < vocabularySize; rank++) text->cumulative[rank] /= total;
+}
+
+void SyntheticTextDispose(synthetictext *text)
+{
+  for (int i = 0; i < text->vocabularySize; i++) free(text->words[i]);
+  free(text->words);
+  free(text->cumulative);
+}
+
+// Draws a rank from the Zipfian distribution by binary search over the cumulative distribution
+static int NextRank(const synthetictext *text, unsigned long long *state)
+{
+  double u = SyntheticUniform(state);
+  int low = 0, high = text->vocabularySize - 1;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (text->cumulative[mid] < u) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+// Writes article id, whose words are those of article bodyID, each replaced by a freshly drawn
+// word with probability editRate (drawn from a stream of id's own, so edits never disturb the
+// words they don't replace)
+static void WriteArticle(const synthetictext *text, long id, long bodyID, double editRate, FILE *outfile)
+{
+  unsigned long long state = SyntheticSeed(text->seed, bodyID);
+  unsigned long long edits = SyntheticSeed(~text->seed, id);
+  int numWords = text->meanWords / 2 + (int) (SyntheticRandom(&state) % (text->meanWords + 1));
+  fprintf(outfile, "<html>\n<head><title>Synthetic article %ld</title></head>\n<body>\n<p>", id);
+  for (int i = 0; i < numWords; i++) {
+    if (i > 0 && i % kWordsPerParagraph == 0) fprintf(outfile, "</p>\n<p>");
+    int rank = NextRank(text, &state);
+    if (editRate > 0 && SyntheticUniform(&edits) < editRate) rank = NextRank(text, &edits);
+    fprintf(outfile, "%s%s", i % kWordsPerParagraph == 0 ? "" : " ", text->words[rank]);
+  }
+  fprintf(outfile, "</p>\n</body>\n</html>\n");
+}
+
+void SyntheticWriteArticle(const synthetictext *text, long id, FILE *outfile)
+{
+  WriteArticle(text, id, id, 0, outfile);
+}
+
+void SyntheticWriteNearDuplicate(const synthetictext *text, long id, long originalID, double editRate, FILE *outfile)
+{
+  WriteArticle(text, id, originalID, editRate, outfile);
+}
+
+void SyntheticWriteQuery(const synthetictext *text, long id, int numTerms, FILE *outfile)
+{
+  unsigned long long state = SyntheticSeed(text->seed, -2 - id);  // articles use 0, 1, 2, ..., and feeds -1
+  for (int i = 0; i < numTerms; i++) fprintf(outfile, "%s%s", i == 0 ? "" : " ", text->words[NextRank(text, &state)]);
+  fprintf(outfile, "\n");
+}
+
+void SyntheticWriteFeedStart(FILE *outfile, int feed, const char *link)
+{
+  fprintf(outfile, "<?xml version=\"1.0\"?>\n<rss version=\"2.0\">\n<channel>\n"
+	  "<title>Synthetic Feed %d</title>\n<link>%s</link>\n", feed, link);
+}
+
+void SyntheticWriteFeedItem(FILE *outfile, long id, const char *articleURL, const char *pubDate)
+{
+  fprintf(outfile, "<item>\n<title>Synthetic article %ld</title>\n"
+	  "<link>%s</link>\n<description>Article %ld</description>\n", id, articleURL, id);
+  if (pubDate != NULL) fprintf(outfile, "<pubDate>%s</pubDate>\n", pubDate);
+  fprintf(outfile, "</item>\n");
+}
+
+void SyntheticWriteFeedEnd(FILE *outfile)
+{
+  fprintf(outfile, "</channel>\n</rss>\n");
+}
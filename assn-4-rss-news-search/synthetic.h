@@ -0,0 +1,104 @@
+/**
+ * File: synthetic.h
+ * -----------------
+ * Produces synthetic news articles and RSS feeds for benchmarks and load
+ * tests.  Article text is drawn from a vocabulary of made-up words whose
+ * frequencies follow a Zipfian distribution, and everything is derived from
+ * a seed and the article's id, so a given article always comes out the same
+ * no matter which tool generates it or in what order.  Both rss-corpusgen,
+ * which writes articles into a corpus for replay, and rss-mockorigin, which
+ * serves them over HTTP, are built on this.
+ */
+
+#ifndef __synthetic_
+#define __synthetic_
+
+#include <stdio.h>
+
+/**
+ * Type: synthetictext
+ * -------------------
+ * The vocabulary and settings shared by every generated article.  The
+ * structure is read-only once initialized, so any number of threads may
+ * write articles from it at the same time.
+ */
+
+typedef struct {
+  char **words;               // words[r] is the word of rank r
+  double *cumulative;         // Zipfian cumulative distribution over the ranks
+  int vocabularySize;
+  int meanWords;
+  unsigned long long seed;
+} synthetictext;
+
+/**
+ * Function: SyntheticTextNew
+ * --------------------------
+ * Builds a vocabulary of vocabularySize distinct, pronounceable words, in which
+ * the word of rank r is drawn with probability proportional to 1/r^zipfExponent.
+ * Articles will have between meanWords/2 and 3*meanWords/2 words.
+ */
+
+void SyntheticTextNew(synthetictext *text, int vocabularySize, double zipfExponent, int meanWords,
+		      unsigned long long seed);
+
+/**
+ * Function: SyntheticTextDispose
+ * ------------------------------
+ * Frees the vocabulary.
+ */
+
+void SyntheticTextDispose(synthetictext *text);
+
+/**
+ * Function: SyntheticWriteArticle
+ * -------------------------------
+ * Writes the complete HTML document for article id to outfile.
+ */
+
+void SyntheticWriteArticle(const synthetictext *text, long id, FILE *outfile);
+
+/**
+ * Function: SyntheticWriteNearDuplicate
+ * -------------------------------------
+ * Writes article id as a lightly edited copy of article originalID, the way a
+ * syndicated story reappears elsewhere: the same words, except that each is
+ * replaced by another with probability editRate, under id's own title.
+ */
+
+void SyntheticWriteNearDuplicate(const synthetictext *text, long id, long originalID, double editRate, FILE *outfile);
+
+/**
+ * Function: SyntheticWriteQuery
+ * -----------------------------
+ * Writes query id to outfile as a line of numTerms words, drawn from the
+ * same distribution as the articles' words (from a stream no article uses).
+ */
+
+void SyntheticWriteQuery(const synthetictext *text, long id, int numTerms, FILE *outfile);
+
+/**
+ * Functions: SyntheticWriteFeedStart, SyntheticWriteFeedItem, SyntheticWriteFeedEnd
+ * ---------------------------------------------------------------------------------
+ * Write an RSS 2.0 feed: the opening of feed number feed, one item linking
+ * to article id at articleURL, published on pubDate (or, if pubDate is NULL,
+ * without a date), and the closing of the feed.
+ */
+
+void SyntheticWriteFeedStart(FILE *outfile, int feed, const char *link);
+void SyntheticWriteFeedItem(FILE *outfile, long id, const char *articleURL, const char *pubDate);
+void SyntheticWriteFeedEnd(FILE *outfile);
+
+/**
+ * Functions: SyntheticRandom, SyntheticUniform
+ * --------------------------------------------
+ * A small xorshift64* generator, the same on every platform.  state must
+ * not be zero; SyntheticSeed derives a usable state from any pair of
+ * numbers.  SyntheticUniform is uniformly distributed over [0, 1).
+ */
+
+unsigned long long SyntheticSeed(unsigned long long seed, unsigned long long stream);
+unsigned long long SyntheticRandom(unsigned long long *state);
+double SyntheticUniform(unsigned long long *state);
+
+#endif
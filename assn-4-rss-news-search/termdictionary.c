@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "termdictionary.h"
+
+#define kMaxTermLength 1024    // null included; no word scanned from an article is longer
+static const int kMaxShared = 255;  // the longest shared prefix a single byte can record
+
+// Decodes the words of the dictionary in order, starting anywhere
+typedef struct {
+  const termdictionary *d;
+  int n;                       // the number of the word in term, or one less than the first word wanted
+  const unsigned char *next;   // where the word after it is coded
+  char term[kMaxTermLength];
+} termcursor;
+
+// Positions the cursor just before the first word of the block
+static void CursorSeek(termcursor *c, const termdictionary *d, int block)
+{
+  c->d = d;
+  c->n = block * kTermsPerBlock - 1;
+  c->next = d->blocks + (block < d->numBlocks ? d->blockOffsets[block] : d->blockBytes);
+}
+
+static bool CursorNext(termcursor *c)
+{
+  if (c->n + 1 >= c->d->numTerms) return false;
+  int shared = 0;
+  if (++c->n % kTermsPerBlock != 0) shared = *c->next++;
+  int length = strlen((const char *) c->next);
+  memcpy(c->term + shared, c->next, length + 1);
+  c->next += length + 1;
+  return true;
+}
+
+static int SharedPrefix(const char *a, const char *b)
+{
+  int n = 0;
+  while (a[n] != '\0' && a[n] == b[n] && n < kMaxShared) n++;
+  return n;
+}
+
+// Returns whichever of words a and b is in more documents, ties going to the one that sorts
+// first; either may be -1, for no word at all
+static int MoreFrequent(const termdictionary *d, int a, int b)
+{
+  if (a == -1) return b;
+  if (b == -1) return a;
+  if (d->frequencies[a] != d->frequencies[b]) return d->frequencies[a] > d->frequencies[b] ? a : b;
+  return a < b ? a : b;
+}
+
+void TermDictionaryNew(termdictionary *d, char *const terms[], const int frequencies[], int numTerms)
+{
+  d->numTerms = numTerms;
+  d->numBlocks = (numTerms + kTermsPerBlock - 1) / kTermsPerBlock;
+  d->blockOffsets = malloc((d->numBlocks + 1) * sizeof(int));
+  d->frequencies = malloc((numTerms + 1) * sizeof(int));
+  assert(d->blockOffsets != NULL && d->frequencies != NULL);
+  memcpy(d->frequencies, frequencies, numTerms * sizeof(int));
+
+  long allocated = 1;
+  for (int i = 0; i < numTerms; i++) allocated += strlen(terms[i]) + 2;  // enough even with nothing shared
+  d->blocks = malloc(allocated);
+  assert(d->blocks != NULL);
+  long bytes = 0;
+  for (int i = 0; i < numTerms; i++) {
+    int length = strlen(terms[i]);
+    assert(length < kMaxTermLength);
+    if (i % kTermsPerBlock == 0) {
+      d->blockOffsets[i / kTermsPerBlock] = bytes;
+      memcpy(d->blocks + bytes, terms[i], length + 1);
+      bytes += length + 1;
+    } else {
+      assert(strcmp(terms[i - 1], terms[i]) < 0);
+      int shared = SharedPrefix(terms[i - 1], terms[i]);
+      d->blocks[bytes++] = shared;
+      memcpy(d->blocks + bytes, terms[i] + shared, length - shared + 1);
+      bytes += length - shared + 1;
+    }
+  }
+  d->blockBytes = bytes;
+  d->blocks = realloc(d->blocks, bytes + 1);
+
+  // leaf numLeaves + b of the tree holds block b's most frequent word, and node i the more
+  // frequent of nodes 2i and 2i + 1
+  for (d->numLeaves = 1; d->numLeaves < d->numBlocks; d->numLeaves *= 2);
+  d->mostFrequent = malloc(2 * d->numLeaves * sizeof(int));
+  assert(d->mostFrequent != NULL);
+  for (int leaf = 0; leaf < d->numLeaves; leaf++) {
+    int best = -1;
+    for (int i = leaf * kTermsPerBlock; i < (leaf + 1) * kTermsPerBlock && i < numTerms; i++)
+      best = MoreFrequent(d, best, i);
+    d->mostFrequent[d->numLeaves + leaf] = best;
+  }
+  for (int node = d->numLeaves - 1; node > 0; node--)
+    d->mostFrequent[node] = MoreFrequent(d, d->mostFrequent[2 * node], d->mostFrequent[2 * node + 1]);
+}
+
+void TermDictionaryDispose(termdictionary *d)
+{
+  free(d->blocks);
+  free(d->blockOffsets);
+  free(d->frequencies);
+  free(d->mostFrequent);
+}
+
+int TermDictionaryCount(const termdictionary *d)
+{
+  return d->numTerms;
+}
+
+long TermDictionaryBytes(const termdictionary *d)
+{
+  return d->blockBytes + (long) d->numBlocks * sizeof(int) + (long) d->numTerms * sizeof(int) +
+    2L * d->numLeaves * sizeof(int);
+}
+
+// Returns the number of the first word that doesn't sort before key (numTerms if there's none)
+static int LowerBound(const termdictionary *d, const char *key)
+{
+  int low = 0, high = d->numBlocks;  // the block wanted is the last one whose first word sorts before key
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (strcmp((const char *) d->blocks + d->blockOffsets[mid], key) < 0) low = mid + 1;
+    else high = mid;
+  }
+  if (low == 0) return 0;
+  termcursor c;
+  CursorSeek(&c, d, low - 1);
+  while (CursorNext(&c) && c.n < low * kTermsPerBlock)
+    if (strcmp(c.term, key) >= 0) return c.n;
+  return low * kTermsPerBlock < d->numTerms ? low * kTermsPerBlock : d->numTerms;
+}
+
+int TermDictionaryPrefixRange(const termdictionary *d, const char *prefix, int *first, int *last)
+{
+  char key[kMaxTermLength];
+  int length = 0;
+  for (; prefix[length] != '\0' && length < kMaxTermLength - 1; length++) key[length] = tolower((unsigned char) prefix[length]);
+  key[length] = '\0';
+  *first = LowerBound(d, key);
+
+  // the words with the prefix end just before the first word at or after the prefix's successor,
+  // the shortest string that sorts after every word beginning with it
+  while (length > 0 && (unsigned char) key[length - 1] == 0xFF) key[--length] = '\0';
+  if (length == 0) *last = d->numTerms;
+  else {
+    key[length - 1]++;
+    *last = LowerBound(d, key);
+  }
+  return *last - *first;
+}
+
+void TermDictionaryTerm(const termdictionary *d, int n, char buffer[], int bufferLength)
+{
+  assert(n >= 0 && n < d->numTerms);
+  termcursor c;
+  CursorSeek(&c, d, n / kTermsPerBlock);
+  while (c.n < n) CursorNext(&c);
+  snprintf(buffer, bufferLength, "%s", c.term);
+}
+
+int TermDictionaryFrequency(const termdictionary *d, int n)
+{
+  assert(n >= 0 && n < d->numTerms);
+  return d->frequencies[n];
+}
+
+void TermDictionaryMap(const termdictionary *d, TermDictionaryMapFunction mapfn, void *auxData)
+{
+  termcursor c;
+  CursorSeek(&c, d, 0);
+  while (CursorNext(&c)) mapfn(c.n, c.term, auxData);
+}
+
+// Returns the most frequent of words low through high - 1, or -1 if there are none
+static int MostFrequent(const termdictionary *d, int low, int high)
+{
+  if (low >= high) return -1;
+  int best = -1;
+  int firstBlock = low / kTermsPerBlock, lastBlock = (high - 1) / kTermsPerBlock;
+  if (firstBlock == lastBlock) {
+    for (int i = low; i < high; i++) best = MoreFrequent(d, best, i);
+    return best;
+  }
+  for (int i = low; i < (firstBlock + 1) * kTermsPerBlock; i++) best = MoreFrequent(d, best, i);
+  for (int i = lastBlock * kTermsPerBlock; i < high; i++) best = MoreFrequent(d, best, i);
+  // the whole blocks between, as the nodes of the tree that cover them
+  for (int l = firstBlock + 1 + d->numLeaves, r = lastBlock + d->numLeaves; l < r; l /= 2, r /= 2) {
+    if (l & 1) best = MoreFrequent(d, best, d->mostFrequent[l++]);
+    if (r & 1) best = MoreFrequent(d, best, d->mostFrequent[--r]);
+  }
+  return best;
+}
+
+// A range of words still to be searched for completions, and the most frequent word in it
+typedef struct {
+  int best, low, high;
+} candidaterange;
+
+// Adds the range to the heap of ranges, most frequent best word first, if the range isn't empty
+static void PushRange(const termdictionary *d, candidaterange heap[], int *size, int low, int high)
+{
+  candidaterange range = { MostFrequent(d, low, high), low, high };
+  if (range.best == -1) return;
+  int i = (*size)++;
+  while (i > 0 && MoreFrequent(d, heap[(i - 1) / 2].best, range.best) == range.best) {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = range;
+}
+
+static candidaterange PopRange(const termdictionary *d, candidaterange heap[], int *size)
+{
+  candidaterange top = heap[0], last = heap[--(*size)];
+  int i = 0;
+  while (2 * i + 1 < *size) {
+    int child = 2 * i + 1;
+    if (child + 1 < *size && MoreFrequent(d, heap[child].best, heap[child + 1].best) == heap[child + 1].best) child++;
+    if (MoreFrequent(d, last.best, heap[child].best) == last.best) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = last;
+  return top;
+}
+
+int TermDictionaryComplete(const termdictionary *d, const char *prefix, int n, int completions[])
+{
+  int first, last, found = 0, size = 0;
+  if (n <= 0 || TermDictionaryPrefixRange(d, prefix, &first, &last) == 0) return 0;
+  // the most frequent word of a range is the range's best completion; taking it splits the
+  // range in two, whose best words are the next candidates
+  candidaterange heap[n + 1];
+  PushRange(d, heap, &size, first, last);
+  while (found < n && size > 0) {
+    candidaterange range = PopRange(d, heap, &size);
+    completions[found++] = range.best;
+    PushRange(d, heap, &size, range.low, range.best);
+    PushRange(d, heap, &size, range.best + 1, range.high);
+  }
+  return found;
+}
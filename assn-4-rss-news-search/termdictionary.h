@@ -0,0 +1,124 @@
+/**
+ * File: termdictionary.h
+ * ----------------------
+ * Defines the termdictionary, an ordered, read-only dictionary of an
+ * index's words, which the word index's hashset can't be: it answers
+ * "which words begin with elect", and "which of them are in the most
+ * articles", as a search-as-you-type box needs.
+ *
+ * The words are kept sorted and front coded, kTermsPerBlock to a block:
+ * the first word of each block is stored whole, and each of the others
+ * as the length of the prefix it shares with the word before it followed
+ * by the rest of it.  Sorted words share long prefixes, so the dictionary
+ * is a fraction of the size of the words themselves.  A prefix's words are
+ * found by binary search over the blocks' first words, and then a scan of
+ * at most two blocks.
+ *
+ * Each word's document frequency is kept beside it, and a segment tree over
+ * the blocks holds the most frequent word of each range of blocks, so the n
+ * most frequent words with a prefix are found in O(n log words) time however
+ * many words the prefix has.
+ *
+ * Words are compared byte by byte and are expected to be lowercase; the
+ * prefixes asked about are lowercased before they're looked up.
+ */
+
+#ifndef __termdictionary_
+#define __termdictionary_
+
+#include "bool.h"
+
+/**
+ * Constant: kTermsPerBlock
+ * ------------------------
+ * How many words share a front-coded block.
+ */
+
+#define kTermsPerBlock 16
+
+/**
+ * Type: termdictionary
+ * --------------------
+ * The concrete representation of the dictionary.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  int numTerms, numBlocks;
+  unsigned char *blocks;   // the front-coded words
+  int *blockOffsets;       // where each block starts in blocks
+  int *frequencies;        // the document frequency of each word, in word order
+  int *mostFrequent;       // segment tree over the blocks: the most frequent word in each node's blocks
+  int numLeaves;           // leaves of the tree, numBlocks rounded up to a power of two
+  long blockBytes;
+} termdictionary;
+
+/**
+ * Function: TermDictionaryNew
+ * ---------------------------
+ * Initializes the dictionary to hold the numTerms words of terms, which
+ * must be lowercase, distinct and sorted by strcmp, word i appearing in
+ * frequencies[i] documents.
+ */
+
+void TermDictionaryNew(termdictionary *d, char *const terms[], const int frequencies[], int numTerms);
+
+/**
+ * Function: TermDictionaryDispose
+ * -------------------------------
+ * Frees the dictionary.
+ */
+
+void TermDictionaryDispose(termdictionary *d);
+
+/**
+ * Functions: TermDictionaryCount, TermDictionaryBytes
+ * ---------------------------------------------------
+ * Return the number of words in the dictionary and the bytes it occupies.
+ */
+
+int TermDictionaryCount(const termdictionary *d);
+long TermDictionaryBytes(const termdictionary *d);
+
+/**
+ * Function: TermDictionaryPrefixRange
+ * -----------------------------------
+ * Sets *first and *last so that the words beginning with prefix are
+ * words *first through *last - 1, in sorted order, and returns the
+ * number of them.
+ */
+
+int TermDictionaryPrefixRange(const termdictionary *d, const char *prefix, int *first, int *last);
+
+/**
+ * Functions: TermDictionaryTerm, TermDictionaryFrequency
+ * ------------------------------------------------------
+ * Copy word n, in sorted order, into buffer (cut to bufferLength - 1
+ * characters), and return its document frequency.
+ */
+
+void TermDictionaryTerm(const termdictionary *d, int n, char buffer[], int bufferLength);
+int TermDictionaryFrequency(const termdictionary *d, int n);
+
+/**
+ * Function: TermDictionaryMap
+ * ---------------------------
+ * Calls mapfn on every word of the dictionary, in sorted order, with its
+ * number and the client's auxData.  The word passed is only valid for the
+ * duration of the call.
+ */
+
+typedef void (*TermDictionaryMapFunction)(int n, const char *term, void *auxData);
+void TermDictionaryMap(const termdictionary *d, TermDictionaryMapFunction mapfn, void *auxData);
+
+/**
+ * Function: TermDictionaryComplete
+ * --------------------------------
+ * Fills completions with the numbers of the (at most) n words beginning
+ * with prefix that are in the most documents, most first, ties going to
+ * the word that sorts first, and returns how many there are.
+ */
+
+int TermDictionaryComplete(const termdictionary *d, const char *prefix, int n, int completions[]);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <assert.h>
+#include "termstats.h"
+#include "wordhash.h"
+
+static const int kNumSlots = 2 * kHeavyHitters;
+
+// The word's counter in row r, by double hashing the two halves of its hash
+static unsigned int *Counter(const termstats *s, unsigned long long hash, int r)
+{
+  unsigned int h1 = hash, h2 = (hash >> 32) | 1;
+  return &s->counters[r * kTermStatsWidth + ((h1 + r * h2) & (kTermStatsWidth - 1))];
+}
+
+// Returns the heap position of the monitored word, or -1
+static int Monitored(const termstats *s, unsigned long long hash, const char *word)
+{
+  for (int slot = hash & (kNumSlots - 1); s->slots[slot] != -1; slot = (slot + 1) & (kNumSlots - 1)) {
+    const heavyhitter *h = &s->heap[s->slots[slot]];
+    if (h->hash == hash && strcasecmp(h->word, word) == 0) return s->slots[slot];
+  }
+  return -1;
+}
+
+// Moves the heap entry to position at, noting the move in its slot
+static void Place(termstats *s, heavyhitter h, int at)
+{
+  s->heap[at] = h;
+  s->slots[h.slot] = at;
+}
+
+// Restores heap order after the count of the entry at position at has gone up
+static void SiftDown(termstats *s, int at)
+{
+  heavyhitter h = s->heap[at];
+  while (2 * at + 1 < s->numHeavyHitters) {
+    int child = 2 * at + 1;
+    if (child + 1 < s->numHeavyHitters && s->heap[child + 1].count < s->heap[child].count) child++;
+    if (h.count <= s->heap[child].count) break;
+    Place(s, s->heap[child], at);
+    at = child;
+  }
+  Place(s, h, at);
+}
+
+static void SiftUp(termstats *s, int at)
+{
+  heavyhitter h = s->heap[at];
+  while (at > 0 && s->heap[(at - 1) / 2].count > h.count) {
+    Place(s, s->heap[(at - 1) / 2], at);
+    at = (at - 1) / 2;
+  }
+  Place(s, h, at);
+}
+
+// Empties the slot, shifting back the entries after it that probed past it
+static void FreeSlot(termstats *s, int slot)
+{
+  int hole = slot;
+  for (int next = (slot + 1) & (kNumSlots - 1); s->slots[next] != -1; next = (next + 1) & (kNumSlots - 1)) {
+    int home = s->heap[s->slots[next]].hash & (kNumSlots - 1);
+    // the entry can fill the hole unless its home lies cyclically after the hole, up to it
+    if (((next - home) & (kNumSlots - 1)) >= ((next - hole) & (kNumSlots - 1))) {
+      s->slots[hole] = s->slots[next];
+      s->heap[s->slots[hole]].slot = hole;
+      hole = next;
+    }
+  }
+  s->slots[hole] = -1;
+}
+
+static int TakeSlot(termstats *s, unsigned long long hash, int at)
+{
+  int slot = hash & (kNumSlots - 1);
+  while (s->slots[slot] != -1) slot = (slot + 1) & (kNumSlots - 1);
+  s->slots[slot] = at;
+  return slot;
+}
+
+void TermStatsNew(termstats *s)
+{
+  s->counters = calloc(kTermStatsDepth * kTermStatsWidth, sizeof(unsigned int));
+  assert(s->counters != NULL);
+  s->words = 0;
+  s->numHeavyHitters = 0;
+  for (int slot = 0; slot < kNumSlots; slot++) s->slots[slot] = -1;
+}
+
+void TermStatsDispose(termstats *s)
+{
+  for (int i = 0; i < s->numHeavyHitters; i++) free(s->heap[i].word);
+  free(s->counters);
+}
+
+void TermStatsAdd(termstats *s, const char *word)
+{
+  unsigned long long hash = WordHash(word);
+  unsigned int *counters[kTermStatsDepth], estimate = ~0U;
+  for (int r = 0; r < kTermStatsDepth; r++) {
+    counters[r] = Counter(s, hash, r);
+    if (*counters[r] < estimate) estimate = *counters[r];
+  }
+  estimate++;
+  for (int r = 0; r < kTermStatsDepth; r++)
+    if (*counters[r] < estimate) *counters[r] = estimate;
+  s->words++;
+
+  // a monitored word's estimate has gone up from its count, which is at least the least count
+  // monitored, so a word whose estimate doesn't pass that isn't monitored or about to be
+  if (s->numHeavyHitters == kHeavyHitters && estimate <= s->heap[0].count) return;
+  int at = Monitored(s, hash, word);
+  if (at != -1) {
+    s->heap[at].count = estimate;
+    SiftDown(s, at);
+    return;
+  }
+  if (s->numHeavyHitters == kHeavyHitters) {
+    FreeSlot(s, s->heap[0].slot);
+    free(s->heap[0].word);
+    at = 0;
+  } else at = s->numHeavyHitters++;
+  heavyhitter h = { strdup(word), hash, estimate, TakeSlot(s, hash, at) };
+  for (char *c = h.word; *c != '\0'; c++) *c = tolower((unsigned char) *c);
+  s->heap[at] = h;
+  if (at == 0) SiftDown(s, at);
+  else SiftUp(s, at);
+}
+
+unsigned int TermStatsEstimate(const termstats *s, const char *word)
+{
+  unsigned long long hash = WordHash(word);
+  unsigned int estimate = ~0U;
+  for (int r = 0; r < kTermStatsDepth; r++)
+    if (*Counter(s, hash, r) < estimate) estimate = *Counter(s, hash, r);
+  return estimate;
+}
+
+static int CompareByCount(const void *elemAddr1, const void *elemAddr2)
+{
+  const heavyhitter *a = elemAddr1, *b = elemAddr2;
+  if (a->count != b->count) return a->count < b->count ? 1 : -1;
+  return strcmp(a->word, b->word);
+}
+
+int TermStatsTop(const termstats *s, int n, const char *words[], unsigned int counts[])
+{
+  heavyhitter sorted[kHeavyHitters];
+  memcpy(sorted, s->heap, s->numHeavyHitters * sizeof(heavyhitter));
+  qsort(sorted, s->numHeavyHitters, sizeof(heavyhitter), CompareByCount);
+  if (n > s->numHeavyHitters) n = s->numHeavyHitters;
+  for (int i = 0; i < n; i++) {
+    words[i] = sorted[i].word;
+    counts[i] = sorted[i].count;
+  }
+  return n;
+}
+
+long long TermStatsWords(const termstats *s)
+{
+  return s->words;
+}
+
+long TermStatsBytes(const termstats *s)
+{
+  long bytes = sizeof(termstats) + (long) kTermStatsDepth * kTermStatsWidth * sizeof(unsigned int);
+  for (int i = 0; i < s->numHeavyHitters; i++) bytes += strlen(s->heap[i].word) + 1;
+  return bytes;
+}
@@ -0,0 +1,120 @@
+/**
+ * File: termstats.h
+ * -----------------
+ * Defines the termstats, which keeps approximate statistics about the
+ * stream of words a crawl indexes, in memory fixed from the start: an
+ * estimate of how often any word has appeared, and the words that have
+ * appeared most, without walking the word index.
+ *
+ * Frequencies come from a Count-Min sketch: kTermStatsDepth rows of
+ * kTermStatsWidth counters, each word counting in one counter of every
+ * row, chosen by hashing it.  Other words share those counters, so each
+ * one only overestimates the word's count, and the smallest is the
+ * estimate.  Counting is conservative: only the counters at that smallest
+ * value are raised, which overestimates far less and never
+ * underestimates.
+ *
+ * The most frequent words are kept Space-Saving style, as kHeavyHitters
+ * monitored words in a heap with the least frequent on top.  A word that
+ * isn't monitored replaces the top word once its estimate passes that
+ * word's count, so the monitored words are always the ones with the
+ * highest estimates the sketch has given.
+ *
+ * Each word costs one hash of it and kTermStatsDepth counter updates; only
+ * the words whose estimates pass the least monitored count, which a
+ * monitored word's always does, go on to look for themselves among the
+ * monitored words.  Words are compared without regard to case.
+ */
+
+#ifndef __termstats_
+#define __termstats_
+
+/**
+ * Constants: kTermStatsDepth, kTermStatsWidth, kHeavyHitters
+ * ----------------------------------------------------------
+ * The sketch's rows and the counters in each, which estimate a word's
+ * count to within e/kTermStatsWidth of all the words counted, with
+ * probability 1 - e^-kTermStatsDepth (e being 2.718...), and the most
+ * frequent words kept.
+ */
+
+#define kTermStatsDepth 4
+#define kTermStatsWidth (1 << 14)
+#define kHeavyHitters 128
+
+/**
+ * Type: termstats
+ * ---------------
+ * The concrete representation of the statistics.  Clients should
+ * interact with them only via the functions below.
+ */
+
+typedef struct {
+  char *word;                // lowercased
+  unsigned long long hash;
+  unsigned int count;        // the sketch's estimate, as of the word's last appearance
+  int slot;                  // where it's found in the table of monitored words
+} heavyhitter;
+
+typedef struct {
+  unsigned int *counters;    // row r is counters[r * kTermStatsWidth] on
+  long long words;           // counted so far
+  heavyhitter heap[kHeavyHitters];  // a min-heap on count
+  int numHeavyHitters;
+  int slots[2 * kHeavyHitters];     // heap positions by hash, with linear probing, or -1
+} termstats;
+
+/**
+ * Function: TermStatsNew
+ * ----------------------
+ * Initializes the statistics to having counted nothing.
+ */
+
+void TermStatsNew(termstats *s);
+
+/**
+ * Function: TermStatsDispose
+ * --------------------------
+ * Frees the statistics.
+ */
+
+void TermStatsDispose(termstats *s);
+
+/**
+ * Function: TermStatsAdd
+ * ----------------------
+ * Counts one appearance of the word.
+ */
+
+void TermStatsAdd(termstats *s, const char *word);
+
+/**
+ * Function: TermStatsEstimate
+ * ---------------------------
+ * Returns an estimate of how many times the word has been counted, never
+ * less than the true count.
+ */
+
+unsigned int TermStatsEstimate(const termstats *s, const char *word);
+
+/**
+ * Function: TermStatsTop
+ * ----------------------
+ * Fills words and counts with (at most) n of the monitored words and their
+ * estimated counts, most frequent first, and returns how many there are.
+ * The words belong to the statistics, and last only until the next call
+ * to TermStatsAdd.
+ */
+
+int TermStatsTop(const termstats *s, int n, const char *words[], unsigned int counts[]);
+
+/**
+ * Functions: TermStatsWords, TermStatsBytes
+ * -----------------------------------------
+ * Return the number of words counted, and the bytes the statistics take.
+ */
+
+long long TermStatsWords(const termstats *s);
+long TermStatsBytes(const termstats *s);
+
+#endif
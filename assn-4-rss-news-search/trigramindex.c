@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "trigramindex.h"
+
+static const int kNumTrigrams = kTrigramSymbols * kTrigramSymbols * kTrigramSymbols;
+static const int kMaxTermLength = 1024;  // as the dictionary holds them
+static const int kLongestLength = kMaxCorrectableLength + 3;  // lengths recorded; longer words are never corrections
+
+// The blank is 0, so padding needs no special case
+static int Symbol(char c)
+{
+  if (c >= 'a' && c <= 'z') return 1 + c - 'a';
+  if (c >= '0' && c <= '9') return 27 + c - '0';
+  if (c == '-') return 37;
+  return 38;
+}
+
+static int CompareInts(const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+  return x < y ? -1 : x > y;
+}
+
+// Fills trigrams with the distinct trigrams of the word, padded two blanks either side, in
+// increasing order, and returns how many there are; trigrams needs room for length + 2
+static int Trigrams(const char *word, int length, int trigrams[])
+{
+  int n = 0;
+  for (int i = -2; i < length; i++) {
+    int key = 0;
+    for (int j = i; j < i + 3; j++) key = key * kTrigramSymbols + (j < 0 || j >= length ? 0 : Symbol(word[j]));
+    trigrams[n++] = key;
+  }
+  qsort(trigrams, n, sizeof(int), CompareInts);
+  int distinct = 0;
+  for (int i = 0; i < n; i++)
+    if (distinct == 0 || trigrams[distinct - 1] != trigrams[i]) trigrams[distinct++] = trigrams[i];
+  return distinct;
+}
+
+// Counts each word under each of its trigrams, and then, once offsets are set, files it there
+static void CountTrigrams(int n, const char *term, void *auxData)
+{
+  trigramindex *t = auxData;
+  int length = strlen(term), trigrams[length + 2];
+  int distinct = Trigrams(term, length, trigrams);
+  t->lengths[n] = length < kLongestLength ? length : kLongestLength;
+  for (int i = 0; i < distinct; i++) t->offsets[trigrams[i] + 1]++;
+}
+
+static void FileTrigrams(int n, const char *term, void *auxData)
+{
+  trigramindex *t = auxData;
+  int length = strlen(term), trigrams[length + 2];
+  int distinct = Trigrams(term, length, trigrams);
+  for (int i = 0; i < distinct; i++) t->words[t->offsets[trigrams[i]]++] = n;
+}
+
+// Orders each trigram's words by length, keeping those of a length in increasing order, with
+// a counting sort of each list
+static void SortByLength(trigramindex *t)
+{
+  int *sorted = malloc((t->numPostings + 1) * sizeof(int));
+  assert(sorted != NULL);
+  for (int key = 0; key < kNumTrigrams; key++) {
+    int counts[kLongestLength + 2];
+    memset(counts, 0, sizeof(counts));
+    for (int i = t->offsets[key]; i < t->offsets[key + 1]; i++) counts[t->lengths[t->words[i]] + 1]++;
+    for (int length = 0; length <= kLongestLength; length++) counts[length + 1] += counts[length];
+    for (int i = t->offsets[key]; i < t->offsets[key + 1]; i++)
+      sorted[t->offsets[key] + counts[t->lengths[t->words[i]]]++] = t->words[i];
+  }
+  free(t->words);
+  t->words = sorted;
+}
+
+void TrigramIndexNew(trigramindex *t, const termdictionary *d)
+{
+  int numTerms = TermDictionaryCount(d);
+  t->d = d;
+  t->offsets = calloc(kNumTrigrams + 1, sizeof(int));
+  t->lengths = malloc(numTerms + 1);
+  assert(t->offsets != NULL && t->lengths != NULL);
+  TermDictionaryMap(d, CountTrigrams, t);
+  for (int key = 0; key < kNumTrigrams; key++) t->offsets[key + 1] += t->offsets[key];
+  t->numPostings = t->offsets[kNumTrigrams];
+  t->words = malloc((t->numPostings + 1) * sizeof(int));
+  assert(t->words != NULL);
+  // filing advances each trigram's offset to the start of the next trigram's words
+  TermDictionaryMap(d, FileTrigrams, t);
+  memmove(t->offsets + 1, t->offsets, kNumTrigrams * sizeof(int));
+  t->offsets[0] = 0;
+  SortByLength(t);
+}
+
+void TrigramIndexDispose(trigramindex *t)
+{
+  free(t->offsets);
+  free(t->words);
+  free(t->lengths);
+}
+
+long TrigramIndexBytes(const trigramindex *t)
+{
+  return (kNumTrigrams + 1L) * sizeof(int) + t->numPostings * sizeof(int) + TermDictionaryCount(t->d);
+}
+
+// Returns the edit distance between the pattern whose bit masks are in peq and text, or
+// maxEdits + 1 if it's more than maxEdits, by Myers' bit-parallel algorithm: bit i of pv and
+// mv records whether the distance to pattern character i went up or down from the row
+// above, for the text read so far, and score is the distance to the whole pattern
+static int EditDistance(const unsigned long long peq[], int m, const char *text, int maxEdits)
+{
+  unsigned long long pv = ~0ULL, mv = 0, high = 1ULL << (m - 1);
+  int score = m, n = strlen(text);
+  for (int j = 0; j < n; j++) {
+    unsigned long long eq = peq[(unsigned char) text[j]];
+    unsigned long long xv = eq | mv;
+    unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+    unsigned long long ph = mv | ~(xh | pv);
+    unsigned long long mh = pv & xh;
+    if (ph & high) score++;
+    else if (mh & high) score--;
+    ph = (ph << 1) | 1;  // the whole text is matched, so the top row goes up by one a column
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    if (score - (n - j - 1) > maxEdits) return maxEdits + 1;  // each character left lowers it by one at most
+  }
+  return score;
+}
+
+// A posting list of the misspelling's, as it's walked
+typedef struct {
+  const int *next, *end;
+} trigramlist;
+
+static int CompareListLengths(const void *a, const void *b)
+{
+  const trigramlist *x = a, *y = b;
+  return (x->end - x->next) - (y->end - y->next);
+}
+
+// Returns the index of the first of words low through high - 1 that's at least length
+// characters long, the words being in order of length
+static const int *FirstOfLength(const trigramindex *t, const int *low, const int *high, int length)
+{
+  while (low < high) {
+    const int *mid = low + (high - low) / 2;
+    if (t->lengths[*mid] < length) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+// Advances the list to the first word at or after the given one, which candidates only ever
+// increase to, and returns true if it's that word
+static bool SkipTo(trigramlist *l, int word)
+{
+  const int *low = l->next, *high = l->end;
+  while (low < high) {
+    const int *mid = low + (high - low) / 2;
+    if (*mid < word) low = mid + 1;
+    else high = mid;
+  }
+  l->next = low;
+  return low < l->end && *low == word;
+}
+
+// Returns true if word c, cDistance edits away, is a better correction than w, wDistance away
+static bool Better(const trigramindex *t, int c, int cDistance, int w, int wDistance)
+{
+  if (cDistance != wDistance) return cDistance < wDistance;
+  int cf = TermDictionaryFrequency(t->d, c), wf = TermDictionaryFrequency(t->d, w);
+  if (cf != wf) return cf > wf;
+  return c < w;
+}
+
+int TrigramIndexCorrect(const trigramindex *t, const char *word, int n, int corrections[], int distances[])
+{
+  int m = strlen(word);
+  if (n <= 0 || m < 3 || m > kMaxCorrectableLength) return 0;
+  char lower[m + 1];
+  for (int i = 0; i <= m; i++) lower[i] = tolower((unsigned char) word[i]);
+  int trigrams[m + 2], numLists = Trigrams(lower, m, trigrams);
+  int maxEdits = m <= 5 ? 1 : 2;
+  while (maxEdits > 0 && numLists - 3 * maxEdits < 1) maxEdits--;
+  if (maxEdits == 0) return 0;
+  int threshold = numLists - 3 * maxEdits;
+
+  unsigned long long peq[256];
+  memset(peq, 0, sizeof(peq));
+  for (int i = 0; i < m; i++) peq[(unsigned char) lower[i]] |= 1ULL << i;
+
+  // the words of each length within reach are searched on their own, as the part of each
+  // list that holds them, and every one of them sharing threshold trigrams is in one of the
+  // numLists - threshold + 1 shortest such parts
+  int found = 0, numShort = numLists - threshold + 1;
+  char term[kMaxTermLength];
+  trigramlist lists[numLists];
+  for (int length = m - maxEdits; length <= m + maxEdits; length++) {
+    for (int i = 0; i < numLists; i++) {
+      const int *first = t->words + t->offsets[trigrams[i]], *last = t->words + t->offsets[trigrams[i] + 1];
+      lists[i].next = FirstOfLength(t, first, last, length);
+      lists[i].end = FirstOfLength(t, lists[i].next, last, length + 1);
+    }
+    qsort(lists, numLists, sizeof(trigramlist), CompareListLengths);
+    while (true) {
+      int candidate = -1, shared = 0;
+      for (int i = 0; i < numShort; i++)
+	if (lists[i].next < lists[i].end && (candidate == -1 || *lists[i].next < candidate)) candidate = *lists[i].next;
+      if (candidate == -1) break;
+      for (int i = 0; i < numShort; i++)
+	if (lists[i].next < lists[i].end && *lists[i].next == candidate) {
+	  lists[i].next++;
+	  shared++;
+	}
+      for (int i = numShort; i < numLists && shared < threshold && shared + numLists - i >= threshold; i++)
+	if (SkipTo(&lists[i], candidate)) shared++;
+      if (shared < threshold) continue;
+
+      TermDictionaryTerm(t->d, candidate, term, sizeof(term));
+      int distance = EditDistance(peq, m, term, maxEdits);
+      if (distance > maxEdits) continue;
+      if (found == n && !Better(t, candidate, distance, corrections[n - 1], distances[n - 1])) continue;
+      int i = found < n ? found++ : n - 1;
+      for (; i > 0 && Better(t, candidate, distance, corrections[i - 1], distances[i - 1]); i--) {
+	corrections[i] = corrections[i - 1];
+	distances[i] = distances[i - 1];
+      }
+      corrections[i] = candidate;
+      distances[i] = distance;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,94 @@
+/**
+ * File: trigramindex.h
+ * --------------------
+ * Defines the trigramindex, an inverted index from each three-character
+ * sequence to the words of a term dictionary (see termdictionary.h) that
+ * contain it, which finds the words within an edit or two of a misspelled
+ * one without comparing it to every word there is.
+ *
+ * Each word is padded with two blanks either side, so "news" has the
+ * trigrams "  n", " ne", "new", "ews", "ws " and "s  ".  A single edit
+ * changes at most three of a word's trigrams, so a word within k edits of
+ * the misspelling shares all but 3k of its distinct trigrams.  Candidates
+ * are found by counting, for each word, the misspelling's trigrams it
+ * shares: the words that could reach the count all appear in at least one
+ * of the shortest lists, and the longest lists are only probed, by binary
+ * search, for those words.  Each list is ordered by word length, so only
+ * the words whose lengths are within k of the misspelling's are counted at
+ * all, and the candidates are checked with a bit-parallel (Myers) edit
+ * distance bounded by k.
+ *
+ * Words of three to five characters are corrected within one edit, and
+ * longer words within two, fewer when a word has too few distinct
+ * trigrams to filter on; words shorter than three characters or longer
+ * than kMaxCorrectableLength aren't corrected at all.
+ */
+
+#ifndef __trigramindex_
+#define __trigramindex_
+
+#include "termdictionary.h"
+
+/**
+ * Constants: kTrigramSymbols, kMaxCorrectableLength
+ * -------------------------------------------------
+ * The characters trigrams are built from (the blank, the letters, the
+ * digits, '-', and one symbol standing for everything else), and the
+ * longest word the bit-parallel edit distance can correct.
+ */
+
+#define kTrigramSymbols 39
+#define kMaxCorrectableLength 64
+
+/**
+ * Type: trigramindex
+ * ------------------
+ * The concrete representation of the index.  Clients should interact
+ * with it only via the functions below.
+ */
+
+typedef struct {
+  const termdictionary *d;  // the dictionary whose words are indexed, which must outlive the index
+  int *offsets;             // trigram t's words are words[offsets[t]] through words[offsets[t + 1] - 1]
+  int *words;               // the dictionary's numbers for them, by length and then number
+  unsigned char *lengths;   // each word's length, capped just past kMaxCorrectableLength
+  long numPostings;
+} trigramindex;
+
+/**
+ * Function: TrigramIndexNew
+ * -------------------------
+ * Initializes the index to hold the trigrams of every word of d.
+ */
+
+void TrigramIndexNew(trigramindex *t, const termdictionary *d);
+
+/**
+ * Function: TrigramIndexDispose
+ * -----------------------------
+ * Frees the index, but not the dictionary.
+ */
+
+void TrigramIndexDispose(trigramindex *t);
+
+/**
+ * Function: TrigramIndexBytes
+ * ---------------------------
+ * Returns the bytes the index occupies.
+ */
+
+long TrigramIndexBytes(const trigramindex *t);
+
+/**
+ * Function: TrigramIndexCorrect
+ * -----------------------------
+ * Fills corrections with the dictionary's numbers for (at most) n words
+ * within a correctable distance of word, fewest edits first, then those
+ * in the most documents, then those that sort first, and distances with
+ * their edit distances from word; returns how many there are.  word is
+ * compared without regard to case.
+ */
+
+int TrigramIndexCorrect(const trigramindex *t, const char *word, int n, int corrections[], int distances[]);
+
+#endif
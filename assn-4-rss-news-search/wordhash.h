@@ -0,0 +1,29 @@
+/**
+ * File: wordhash.h
+ * ----------------
+ * Defines the 64-bit hash of a word that the index's filter and
+ * partitioning, the near-duplicate signatures and the term statistics all
+ * build on, so that they hash words in one place and the same way.
+ */
+
+#ifndef __wordhash_
+#define __wordhash_
+
+#include <ctype.h>
+
+/**
+ * Function: WordHash
+ * ------------------
+ * Returns the 64-bit FNV-1a hash of the word, lowercased, so that words
+ * differing only in case hash alike.  FNV's top bits are weakly mixed, so
+ * clients that pick anything with them mix the hash first.
+ */
+
+static inline unsigned long long WordHash(const char *word)
+{
+  unsigned long long hashcode = 14695981039346656037ULL;
+  for (; *word != '\0'; word++) hashcode = (hashcode ^ (unsigned char) tolower((unsigned char) *word)) * 1099511628211ULL;
+  return hashcode;
+}
+
+#endif